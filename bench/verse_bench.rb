@@ -0,0 +1,340 @@
+#!/usr/bin/env ruby19
+
+# The benchmark suite for the extension's hot paths. It forks a loopback
+# Verse::Server on localhost, then measures:
+#
+#   callback_throughput    pings dispatched per second with one observer
+#   observer_fanout        the cost of each observer call as observers are added
+#   node_alloc_free        Verse::ObjectNodes allocated and garbage-collected per second
+#   node_wrap              node objects created per second from a subscribed node index
+#   node_create_roundtrip  nodes created per second via Session#create_nodes
+#   session_lock           commands sent per second by threads sharing one session
+#                          and each driving their own
+#   update_latency         the latency of Verse.update as connected sessions are added
+#
+# The results are written as JSON to the given file (or to STDOUT) so they can
+# be compared between releases. Set VERSE_BENCH_SCALE to multiply the
+# iteration counts, e.g., 0.1 for a quick run.
+#
+# Usage: verse_bench.rb [output_file] [port]
+
+BEGIN {
+	require 'pathname'
+
+	basedir = Pathname( __FILE__ ).dirname.parent
+	libdir = basedir + 'lib'
+
+	$LOAD_PATH.unshift( libdir.to_s )
+}
+
+require 'benchmark'
+require 'json'
+require 'time'
+require 'verse'
+require 'verse/server'
+
+OUTPUT_FILE = ARGV.shift
+PORT        = Integer( ARGV.shift || 45201 )
+CLIENT_PORT = PORT + 1
+ADDRESS     = "127.0.0.1:#{PORT}"
+SCALE       = Float( ENV['VERSE_BENCH_SCALE'] || 1.0 )
+INDEX_SIZE  = ( 20_000 * SCALE ).ceil
+
+
+# The loopback server the client benchmarks talk to. It accepts every
+# connection, announces its INDEX_SIZE object nodes to anyone who subscribes
+# to the ObjectNode index, and creates every node it's asked to.
+class LoopbackServer < Verse::Server
+
+	# Creates nodes for a single session's #create_node requests.
+	class NodeMaker
+		include Verse::SessionObserver
+
+		def initialize( server, session )
+			@server  = server
+			@session = session
+		end
+
+		def on_create_node( nodeclass )
+			node = @server.add_node( nodeclass.new )
+			node.session = @session
+			@session.node_created( node )
+		end
+	end
+
+
+	def initialize( count )
+		@host_id = Verse.create_host_id
+		@next_id = 0
+		@index = (1..count).collect { self.add_node(Verse::ObjectNode.new) }
+	end
+
+	def add_node( node )
+		node.id = ( @next_id += 1 )
+		return node
+	end
+
+	def on_connect( user, pass, address, expected_host_id )
+		avatar = self.add_node( Verse::ObjectNode.new )
+		session = self.accept_connection( avatar, address, @host_id )
+		session.add_observer( NodeMaker.new(self, session) )
+	end
+
+	def on_node_index_subscribe( session, *classes )
+		return unless classes.include?( Verse::ObjectNode )
+		session.batch {|s| @index.each {|node| s.node_created(node) } }
+	end
+
+end
+
+
+# Counts pings.
+class PingCounter
+	include Verse::PingObserver
+
+	def initialize; @count = 0; end
+	attr_reader :count
+
+	def on_ping( address, message ); @count += 1; end
+end
+
+
+# Wants a node object for every node it's told about.
+class CreationObserver
+	include Verse::SessionObserver
+
+	def initialize; @count = 0; end
+	attr_reader :count
+
+	def on_node_created( node ); @count += 1; end
+end
+
+
+### Return the given +count+ of iterations adjusted by the VERSE_BENCH_SCALE.
+def scaled( count )
+	return [ (count * SCALE).ceil, 1 ].max
+end
+
+
+### Call Verse.update until the block returns true, raising if it takes longer than
+### +timeout+ seconds.
+def wait_for( timeout=30 )
+	deadline = Time.now + timeout
+	until yield
+		raise "timed out after %ds" % [ timeout ] if Time.now > deadline
+		Verse.update( 0.01 )
+	end
+end
+
+
+### Run the block, which should do +iterations+ operations, and return a Hash of
+### how long it took and the resulting rate.
+def measure( iterations )
+	seconds = Benchmark.realtime { yield }
+	return {
+		:iterations => iterations,
+		:seconds    => seconds,
+		:per_second => iterations / seconds,
+	}
+end
+
+
+### Return a Hash describing the distribution of the given +samples+ (in seconds)
+### in microseconds.
+def distribution( samples )
+	sorted = samples.sort
+	pick = lambda {|pct| sorted[ ((sorted.length - 1) * pct).round ] * 1_000_000 }
+
+	return {
+		:count => sorted.length,
+		:mean  => sorted.inject( 0.0, :+ ) / sorted.length * 1_000_000,
+		:min   => pick[ 0.0 ],
+		:p50   => pick[ 0.5 ],
+		:p90   => pick[ 0.9 ],
+		:p99   => pick[ 0.99 ],
+		:max   => pick[ 1.0 ],
+	}
+end
+
+
+### Connect a new session to the loopback server and wait for it to be accepted.
+def connect_session( name='bench' )
+	session = Verse::Session.new( ADDRESS )
+	session.connect( name, 'bench' )
+	wait_for { session.connected? }
+	return session
+end
+
+
+### Send +count+ pings to ourselves with the given +observers+ listening, and
+### return the measurement.
+def ping_self( count, observers )
+	observers.each {|observer| Verse.add_observer(observer) }
+	target = observers.first.count + count
+
+	return measure( count ) do
+		count.times {|i| Verse.ping("127.0.0.1:#{CLIENT_PORT}", "bench #{i}") }
+		wait_for { observers.first.count >= target }
+	end
+ensure
+	Verse.remove_observers
+end
+
+
+#
+# Benchmarks
+#
+
+def bench_callback_throughput
+	return ping_self( scaled(20_000), [PingCounter.new] )
+end
+
+
+def bench_observer_fanout
+	count = scaled( 5_000 )
+	baseline = ping_self( count, [PingCounter.new] )
+
+	return [ 1, 8, 64 ].inject( {} ) do |results, observers|
+		result = ping_self( count, (1..observers).collect { PingCounter.new } )
+		extra = result[:seconds] - baseline[:seconds]
+		result[:usec_per_observer_call] = result[:seconds] / (count * observers) * 1_000_000
+		result[:usec_per_extra_observer] = extra / (count * observers) * 1_000_000
+		results.merge( observers.to_s => result )
+	end
+end
+
+
+def bench_node_alloc_free
+	count = scaled( 200_000 )
+	GC.start
+
+	return measure( count ) do
+		count.times { Verse::ObjectNode.new }
+		GC.start
+	end
+end
+
+
+def bench_node_wrap
+	session = connect_session( 'wrap' )
+	observer = CreationObserver.new
+	session.add_observer( observer )
+
+	result = measure( INDEX_SIZE ) do
+		session.subscribe_to_node_index( Verse::ObjectNode )
+		wait_for { observer.count >= INDEX_SIZE }
+	end
+	session.terminate( ADDRESS, 'done' )
+
+	return result
+end
+
+
+def bench_node_create_roundtrip
+	count = scaled( 5_000 )
+	session = connect_session( 'create' )
+
+	result = measure( count ) do
+		futures = session.create_nodes( Verse::ObjectNode, count )
+		wait_for { futures.all?(&:resolved?) }
+	end
+	session.terminate( ADDRESS, 'done' )
+
+	return result
+end
+
+
+def bench_session_lock
+	commands = scaled( 20_000 )
+	sessions = (0...8).collect {|i| connect_session("lock#{i}") }
+	results = {}
+
+	updater = Thread.new do
+		Verse.update( 0.01 ) until Thread.current[:halt]
+	end
+
+	[ 1, 2, 4, 8 ].each do |count|
+		[ :shared, :separate ].each do |mode|
+			results[ "#{count}_threads_#{mode}" ] = measure( commands * count ) do
+				(0...count).collect do |i|
+					session = ( mode == :shared ? sessions.first : sessions[i] )
+					Thread.new { commands.times { session.subscribe_to_node_index } }
+				end.each( &:join )
+			end
+		end
+	end
+
+	return results
+ensure
+	if updater
+		updater[:halt] = true
+		updater.join
+	end
+	sessions.each {|session| session.terminate(ADDRESS, 'done') } if sessions
+end
+
+
+def bench_update_latency
+	updates = scaled( 2_000 )
+	sessions = []
+
+	return [ 1, 4, 16 ].inject( {} ) do |results, count|
+		sessions << connect_session( "update#{sessions.length}" ) while sessions.length < count
+		samples = (1..updates).collect { Benchmark.realtime { Verse.update(0) } }
+		results.merge( count.to_s => distribution(samples) )
+	end
+ensure
+	sessions.each {|session| session.terminate(ADDRESS, 'done') }
+end
+
+
+#
+# Main
+#
+
+Verse.logger.level = Logger::WARN
+
+server_pid = Process.fork do
+	Verse.port = PORT
+	server = LoopbackServer.new( INDEX_SIZE )
+	server.run
+	Verse.update while true
+end
+
+begin
+	Verse.port = CLIENT_PORT
+	sleep 0.5
+
+	results = {
+		:version         => Verse.version_string( true ),
+		:library_version => Verse.library_version,
+		:ruby            => RUBY_DESCRIPTION,
+		:time            => Time.now.utc.iso8601,
+		:scale           => SCALE,
+		:benchmarks      => {},
+	}
+
+	%w[
+		callback_throughput
+		observer_fanout
+		node_alloc_free
+		node_wrap
+		node_create_roundtrip
+		session_lock
+		update_latency
+	].each do |name|
+		$stderr.puts "Running #{name}..."
+		results[:benchmarks][ name ] = send( "bench_#{name}" )
+	end
+
+	json = JSON.pretty_generate( results )
+	if OUTPUT_FILE
+		File.open( OUTPUT_FILE, 'w' ) {|io| io.puts(json) }
+		$stderr.puts "Wrote results to #{OUTPUT_FILE}."
+	else
+		puts json
+	end
+ensure
+	Process.kill( :TERM, server_pid )
+	Process.wait( server_pid )
+end
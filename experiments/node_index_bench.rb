@@ -0,0 +1,121 @@
+#!/usr/bin/env ruby19
+
+# This is a benchmark for subscribing to a large node index. It forks a
+# loopback server with N object nodes, then connects to it from a forked
+# client and subscribes to the ObjectNode index, reporting how long it
+# took to receive every node and how much memory that used.
+#
+# The client runs twice: once with no observers, where the session just
+# keeps a native record of each node, and once with a SessionObserver
+# that implements #on_node_created, which needs a Verse::Node object for
+# every node (this is what always happened before node objects were
+# created lazily).
+#
+# Usage: node_index_bench.rb [node_count] [port]
+
+BEGIN {
+	require 'pathname'
+
+	basedir = Pathname( __FILE__ ).dirname.parent
+	libdir = basedir + 'lib'
+
+	$LOAD_PATH.unshift( libdir.to_s )
+}
+
+require 'benchmark'
+require 'verse'
+require 'verse/server'
+
+NODE_COUNT = Integer( ARGV.shift || 100_000 )
+PORT       = Integer( ARGV.shift || 45197 )
+
+
+# A server that announces NODE_COUNT object nodes to anyone who subscribes to
+# the index.
+class IndexServer < Verse::Server
+
+	def initialize( count )
+		@host_id = Verse.create_host_id
+		@nodes = (1..count).collect do |id|
+			node = Verse::ObjectNode.new
+			node.id = id
+			node
+		end
+	end
+
+	def on_connect( user, pass, address, expected_host_id )
+		self.accept_connection( @nodes.first, address, @host_id )
+	end
+
+	def on_node_index_subscribe( session, *classes )
+		session.batch {|s| @nodes.each {|node| s.node_created(node) } }
+	end
+
+end
+
+
+# An observer that wants every node object
+class CreationObserver
+	include Verse::SessionObserver
+
+	def on_node_created( node ); end
+end
+
+
+### Return the resident set size of the current process in kilobytes.
+def rss_kb
+	if File.exist?( "/proc/self/status" )
+		return File.read( "/proc/self/status" )[ /VmRSS:\s+(\d+)/, 1 ].to_i
+	else
+		return `ps -o rss= -p #$$`.to_i
+	end
+end
+
+
+### Connect a client, subscribe to the index, and report on how long it took to
+### know about all the nodes. If +observed+ is true, observe the session with a
+### CreationObserver.
+def run_client( label, observed )
+	pid = Process.fork do
+		GC.start
+		rss_before = rss_kb()
+		objects_before = ObjectSpace.count_objects[:T_DATA]
+
+		session = Verse::Session.new( "localhost:#{PORT}" )
+		session.add_observer( CreationObserver.new ) if observed
+		session.connect( 'bench', 'bench' )
+
+		elapsed = Benchmark.realtime do
+			Verse.update( 0.01 ) until session.connected?
+			session.subscribe_to_node_index( Verse::ObjectNode )
+			Verse.update( 0.01 ) until session.node_count >= NODE_COUNT
+		end
+
+		objects = ObjectSpace.count_objects[:T_DATA] - objects_before
+		puts "%-10s %8.3fs  %10.0f nodes/s  %8d KB RSS  %8d new T_DATA objects" %
+			[ label, elapsed, NODE_COUNT / elapsed, rss_kb() - rss_before, objects ]
+		exit!
+	end
+
+	Process.wait( pid )
+end
+
+
+Verse.logger.level = Logger::WARN
+
+server_pid = Process.fork do
+	Verse.port = PORT
+	server = IndexServer.new( NODE_COUNT )
+	server.run
+	Verse.update while true
+end
+
+begin
+	sleep 0.5
+	puts "Subscribing to an index of %d nodes" % [ NODE_COUNT ]
+	run_client( "lazy", false )
+	run_client( "eager", true )
+ensure
+	Process.kill( :TERM, server_pid )
+	Process.wait( server_pid )
+end
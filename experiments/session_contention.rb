@@ -0,0 +1,86 @@
+#!/usr/bin/env ruby19
+
+# This is a benchmark for contention between threads that are sending
+# commands via Verse sessions. It runs N threads that each send a batch of
+# commands, first with all of them sharing one session, then with each one
+# driving its own session. With per-session locking, the second case
+# shouldn't get slower as threads are added, even while another thread
+# is sitting in Verse.update. The last case sends each thread's commands
+# inside a Session#batch block.
+#
+# It doesn't need a server; commands for an unanswered connection just get
+# queued by Verse.
+#
+# Usage: session_contention.rb [max_threads] [commands_per_thread]
+
+BEGIN {
+	require 'pathname'
+
+	basedir = Pathname( __FILE__ ).dirname.parent
+	libdir = basedir + 'lib'
+
+	$LOAD_PATH.unshift( libdir.to_s )
+}
+
+require 'benchmark'
+require 'verse'
+
+MAX_THREADS = Integer( ARGV.shift || 8 )
+COMMANDS    = Integer( ARGV.shift || 20_000 )
+ADDRESS     = 'localhost:45199'
+
+
+### Connect a new session to the (nonexistent) test server.
+def make_session( i )
+	session = Verse::Session.new( ADDRESS )
+	session.connect( "bench#{i}", 'bench' )
+	return session
+end
+
+
+### Run +count+ threads, each of which sends COMMANDS commands via the session
+### returned by the block, inside a Session#batch if +batched+ is true.
+def run_threads( count, batched=false )
+	threads = (0...count).collect do |i|
+		session = yield( i )
+		Thread.new do
+			if batched
+				session.batch {|s| COMMANDS.times { s.subscribe_to_node_index(Verse::ObjectNode) } }
+			else
+				COMMANDS.times { session.subscribe_to_node_index(Verse::ObjectNode) }
+			end
+		end
+	end
+	threads.each( &:join )
+end
+
+
+Verse.logger.level = Logger::WARN
+shared = make_session( 0 )
+sessions = (0...MAX_THREADS).collect {|i| make_session(i) }
+
+updater = Thread.new do
+	Thread.current.abort_on_exception = true
+	Verse.update( 0.01 ) until Thread.current[:halt]
+end
+
+puts "%d commands per thread" % [ COMMANDS ]
+Benchmark.bm( 32 ) do |bench|
+	threadcounts = [ 1 ]
+	threadcounts << threadcounts.last * 2 while threadcounts.last * 2 <= MAX_THREADS
+
+	threadcounts.each do |count|
+		bench.report( "%2d threads, 1 session" % [count] ) do
+			run_threads( count ) { shared }
+		end
+		bench.report( "%2d threads, %2d sessions" % [count, count] ) do
+			run_threads( count ) {|i| sessions[i] }
+		end
+		bench.report( "%2d threads, %2d sessions, batched" % [count, count] ) do
+			run_threads( count, true ) {|i| sessions[i] }
+		end
+	end
+end
+
+updater[:halt] = true
+updater.join
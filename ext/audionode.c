@@ -40,6 +40,7 @@
 #include "verse_ext.h"
 
 VALUE rbverse_cVerseAudioNode;
+VALUE rbverse_mVerseAudioNodeObserver;
 
 
 /*
@@ -48,12 +49,22 @@ VALUE rbverse_cVerseAudioNode;
 static void
 rbverse_audionode_gc_mark( struct rbverse_node *ptr ) {
 	if ( ptr ) {
-		rb_gc_mark( ptr->audio.buffers );
-		rb_gc_mark( ptr->audio.streams );
+		rbverse_gc_mark_movable( ptr->audio.buffers );
+		rbverse_gc_mark_movable( ptr->audio.streams );
 	}
 }
 
 
+/*
+ * Update references in the audio part of a node to objects moved by GC compaction.
+ */
+static void
+rbverse_audionode_gc_compact( struct rbverse_node *ptr ) {
+	rbverse_gc_update( ptr->audio.buffers );
+	rbverse_gc_update( ptr->audio.streams );
+}
+
+
 /*
  * Free the audio part of a node.
  */
@@ -93,6 +104,22 @@ rbverse_verse_audionode_initialize( VALUE self ) {
 
 
 
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+RBVERSE_NODE_TRAMPOLINE( 4, a_buffer_create, RBVERSE_ON_BUFFER_CREATE, UINT16, STRING, UINT32, REAL64 )
+RBVERSE_NODE_TRAMPOLINE( 1, a_buffer_destroy, RBVERSE_ON_BUFFER_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, a_buffer_subscribe, RBVERSE_ON_BUFFER_SUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, a_buffer_unsubscribe, RBVERSE_ON_BUFFER_UNSUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 2, a_block_clear, RBVERSE_ON_BLOCK_CLEAR, UINT16, UINT32 )
+RBVERSE_NODE_TRAMPOLINE( 2, a_stream_create, RBVERSE_ON_STREAM_CREATE, UINT16, STRING )
+RBVERSE_NODE_TRAMPOLINE( 1, a_stream_destroy, RBVERSE_ON_STREAM_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, a_stream_subscribe, RBVERSE_ON_STREAM_SUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, a_stream_unsubscribe, RBVERSE_ON_STREAM_UNSUBSCRIBE, UINT16 )
+
+
+
 /*
  * Verse::AudioNode class
  */
@@ -100,6 +127,9 @@ void
 rbverse_init_verse_audionode( void ) {
 	rbverse_log( "debug", "Initializing Verse::AudioNode" );
 
+	/* Related modules */
+	rbverse_mVerseAudioNodeObserver = rb_define_module_under( rbverse_mVerse, "AudioNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseAudioNode = rb_define_class_under( rbverse_mVerse, "AudioNode", rbverse_cVerseNode );
 
@@ -113,17 +143,18 @@ rbverse_init_verse_audionode( void ) {
 	rbverse_nodetype_to_nodeclass[ V_NT_AUDIO ] = rbverse_cVerseAudioNode;
 	node_mark_funcs[ V_NT_AUDIO ] = &rbverse_audionode_gc_mark;
 	node_free_funcs[ V_NT_AUDIO ] = &rbverse_audionode_gc_free;
+	node_compact_funcs[ V_NT_AUDIO ] = &rbverse_audionode_gc_compact;
 
-	// verse_callback_set( verse_send_a_buffer_create, rbverse_a_buffer_create_callback, NULL );
-	// verse_callback_set( verse_send_a_buffer_destroy, rbverse_a_buffer_destroy_callback, NULL );
-	// verse_callback_set( verse_send_a_buffer_subscribe, rbverse_a_buffer_subscribe_callback, NULL );
-	// verse_callback_set( verse_send_a_buffer_unsubscribe, rbverse_a_buffer_unsubscribe_callback, NULL );
+	RBVERSE_CALLBACK_SET( a_buffer_create, rbverse_cb_a_buffer_create );
+	RBVERSE_CALLBACK_SET( a_buffer_destroy, rbverse_cb_a_buffer_destroy );
+	RBVERSE_CALLBACK_SET( a_buffer_subscribe, rbverse_cb_a_buffer_subscribe );
+	RBVERSE_CALLBACK_SET( a_buffer_unsubscribe, rbverse_cb_a_buffer_unsubscribe );
 	// verse_callback_set( verse_send_a_block_set, rbverse_a_block_set_callback, NULL );
-	// verse_callback_set( verse_send_a_block_clear, rbverse_a_block_clear_callback, NULL );
-	// verse_callback_set( verse_send_a_stream_create, rbverse_a_stream_create_callback, NULL );
-	// verse_callback_set( verse_send_a_stream_destroy, rbverse_a_stream_destroy_callback, NULL );
-	// verse_callback_set( verse_send_a_stream_subscribe, rbverse_a_stream_subscribe_callback, NULL );
-	// verse_callback_set( verse_send_a_stream_unsubscribe, rbverse_a_stream_unsubscribe_callback, NULL );
+	RBVERSE_CALLBACK_SET( a_block_clear, rbverse_cb_a_block_clear );
+	RBVERSE_CALLBACK_SET( a_stream_create, rbverse_cb_a_stream_create );
+	RBVERSE_CALLBACK_SET( a_stream_destroy, rbverse_cb_a_stream_destroy );
+	RBVERSE_CALLBACK_SET( a_stream_subscribe, rbverse_cb_a_stream_subscribe );
+	RBVERSE_CALLBACK_SET( a_stream_unsubscribe, rbverse_cb_a_stream_unsubscribe );
 	// verse_callback_set( verse_send_a_stream, rbverse_a_stream_callback, NULL );
 
 }
@@ -40,6 +40,7 @@
 #include "verse_ext.h"
 
 VALUE rbverse_cVerseBitmapNode;
+VALUE rbverse_mVerseBitmapNodeObserver;
 
 
 /*
@@ -89,6 +90,21 @@ rbverse_verse_bitmapnode_initialize( VALUE self ) {
 }
 
 
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+RBVERSE_NODE_TRAMPOLINE( 3, b_dimensions_set, RBVERSE_ON_DIMENSIONS_SET, UINT16, UINT16, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 3, b_layer_create, RBVERSE_ON_BITMAP_LAYER_CREATE, UINT16, STRING, UINT32 )
+RBVERSE_NODE_TRAMPOLINE( 1, b_layer_destroy, RBVERSE_ON_BITMAP_LAYER_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 2, b_layer_subscribe, RBVERSE_ON_BITMAP_LAYER_SUBSCRIBE, UINT16, UINT8 )
+RBVERSE_NODE_TRAMPOLINE( 1, b_layer_unsubscribe, RBVERSE_ON_BITMAP_LAYER_UNSUBSCRIBE, UINT16 )
+
+/* b_tile_set passes a VNBTile union that needs a hand-written callback, so it isn't 
+ * set yet. */
+
+
 /*
  * Verse::BitmapNode class
  */
@@ -96,6 +112,9 @@ void
 rbverse_init_verse_bitmapnode( void ) {
 	rbverse_log( "debug", "Initializing Verse::BitmapNode" );
 
+	/* Related modules */
+	rbverse_mVerseBitmapNodeObserver = rb_define_module_under( rbverse_mVerse, "BitmapNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseBitmapNode = rb_define_class_under( rbverse_mVerse, "BitmapNode", rbverse_cVerseNode );
 
@@ -109,5 +128,11 @@ rbverse_init_verse_bitmapnode( void ) {
 	rbverse_nodetype_to_nodeclass[ V_NT_BITMAP ] = rbverse_cVerseBitmapNode;
 	node_mark_funcs[ V_NT_BITMAP ] = &rbverse_bitmapnode_gc_mark;
 	node_free_funcs[ V_NT_BITMAP ] = &rbverse_bitmapnode_gc_free;
+
+	RBVERSE_CALLBACK_SET( b_dimensions_set, rbverse_cb_b_dimensions_set );
+	RBVERSE_CALLBACK_SET( b_layer_create, rbverse_cb_b_layer_create );
+	RBVERSE_CALLBACK_SET( b_layer_destroy, rbverse_cb_b_layer_destroy );
+	RBVERSE_CALLBACK_SET( b_layer_subscribe, rbverse_cb_b_layer_subscribe );
+	RBVERSE_CALLBACK_SET( b_layer_unsubscribe, rbverse_cb_b_layer_unsubscribe );
 }
 
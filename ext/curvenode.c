@@ -40,6 +40,7 @@
 #include "verse_ext.h"
 
 VALUE rbverse_cVerseCurveNode;
+VALUE rbverse_mVerseCurveNodeObserver;
 
 
 /*
@@ -89,6 +90,21 @@ rbverse_verse_curvenode_initialize( VALUE self ) {
 }
 
 
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+RBVERSE_NODE_TRAMPOLINE( 3, c_curve_create, RBVERSE_ON_CURVE_CREATE, UINT16, STRING, UINT8 )
+RBVERSE_NODE_TRAMPOLINE( 1, c_curve_destroy, RBVERSE_ON_CURVE_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, c_curve_subscribe, RBVERSE_ON_CURVE_SUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, c_curve_unsubscribe, RBVERSE_ON_CURVE_UNSUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 2, c_key_destroy, RBVERSE_ON_KEY_DESTROY, UINT16, UINT32 )
+
+/* c_key_set passes arrays of values and positions that need a hand-written callback, 
+ * so it isn't set yet. */
+
+
 /*
  * Verse::CurveNode class
  */
@@ -96,6 +112,9 @@ void
 rbverse_init_verse_curvenode( void ) {
 	rbverse_log( "debug", "Initializing Verse::CurveNode" );
 
+	/* Related modules */
+	rbverse_mVerseCurveNodeObserver = rb_define_module_under( rbverse_mVerse, "CurveNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseCurveNode = rb_define_class_under( rbverse_mVerse, "CurveNode", rbverse_cVerseNode );
 
@@ -109,5 +128,11 @@ rbverse_init_verse_curvenode( void ) {
 	rbverse_nodetype_to_nodeclass[ V_NT_CURVE ] = rbverse_cVerseCurveNode;
 	node_mark_funcs[ V_NT_CURVE ] = &rbverse_curvenode_gc_mark;
 	node_free_funcs[ V_NT_CURVE ] = &rbverse_curvenode_gc_free;
+
+	RBVERSE_CALLBACK_SET( c_curve_create, rbverse_cb_c_curve_create );
+	RBVERSE_CALLBACK_SET( c_curve_destroy, rbverse_cb_c_curve_destroy );
+	RBVERSE_CALLBACK_SET( c_curve_subscribe, rbverse_cb_c_curve_subscribe );
+	RBVERSE_CALLBACK_SET( c_curve_unsubscribe, rbverse_cb_c_curve_unsubscribe );
+	RBVERSE_CALLBACK_SET( c_key_destroy, rbverse_cb_c_key_destroy );
 }
 
@@ -0,0 +1,569 @@
+/*
+ * Verse event queue -- deferred dispatch of Verse callbacks
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include "verse_ext.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_PTHREAD_H
+#	include <errno.h>
+#endif
+
+/*
+ * Verse calls its callbacks from inside verse_callback_update(), which runs without
+ * the GVL. Instead of re-acquiring the GVL for every command, the callbacks copy
+ * their arguments into an event in this queue, and the whole queue is dispatched
+ * to Ruby in one go once Verse.update has the GVL again.
+ *
+ * Events are packed back-to-back into large blocks, so queueing one is usually
+ * just a pointer bump. Since no Ruby API can be called without the GVL, the blocks
+ * are allocated with plain malloc() instead of ALLOC().
+ * 
+ * A callback fills in its event after it's been queued, so new events aren't visible
+ * to rbverse_drain_events() until the thread that called verse_callback_update()
+ * publishes them with rbverse_event_publish(). That thread can be the network thread
+ * (see network.c), so the queue's bookkeeping is protected by a lock. Callbacks are
+ * only called with the session switch lock held, and events are only published 
+ * before it's released, so every event that's published has been filled in, whichever
+ * thread queued it.
+ * 
+ * Verse doesn't expose its socket, so an event loop that wants to wait on Verse along
+ * with its other IO uses Verse.event_io instead: the read end of a pipe that has a
+ * byte written to it whenever events are published, and is emptied again once they've
+ * all been dispatched.
+ */
+
+/* Block of packed events */
+struct rbverse_event_block {
+	struct rbverse_event_block *next;
+	size_t capacity;
+	size_t used;
+	size_t published;
+	size_t read;
+	char   data[1];
+};
+
+/* Header that precedes every event's payload */
+struct rbverse_event {
+	rbverse_event_handler handler;
+	VSession              session;
+	uint32                size;
+	int                   kind;
+	char                  *strings;
+};
+
+#define RBVERSE_EVENT_BLOCK_SIZE 65536
+#define RBVERSE_EVENT_ALIGN(size) ( ((size) + 7) & ~((size_t)7) )
+#define RBVERSE_EVENT_HEADER_SIZE RBVERSE_EVENT_ALIGN( sizeof(struct rbverse_event) )
+
+static struct rbverse_event_block *event_head = NULL;
+static struct rbverse_event_block *event_tail = NULL;
+static struct rbverse_event_block *event_free_blocks = NULL;
+static int drain_depth = 0;
+
+/* The session of the event that's being dispatched. Verse's current session belongs to
+ * whichever thread holds the session switch lock, so handlers mustn't switch it; they 
+ * find their session through this instead (see rbverse_get_current_session()). It's
+ * only used with the GVL held. */
+VSession rbverse_dispatch_session = NULL;
+
+/* The number of blocks that have been allocated and not freed, including free ones */
+static unsigned long event_blocks = 0;
+
+/* Events that have been queued but not published yet, and events that have been
+ * published but not dispatched yet */
+static unsigned long event_unpublished = 0;
+static unsigned long event_pending = 0;
+
+/* The pipe behind Verse.event_io, and whether its read end is currently readable */
+static int event_pipe[2] = { -1, -1 };
+static int event_pipe_signalled = 0;
+static VALUE event_io = Qnil;
+
+/* Running count of events that have been queued. Events are only queued by Verse 
+ * callbacks, so it only changes with the session switch lock held, and a thread that 
+ * holds the lock can read it to count the events it queues. */
+unsigned long rbverse_event_count = 0;
+
+/* Counts of events queued of each kind, for Verse.stats */
+static unsigned long event_received[ RBVERSE_EVENT_KIND_COUNT ];
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_published = PTHREAD_COND_INITIALIZER;
+static int event_wait_interrupted = 0;
+#	define RBVERSE_EVENT_LOCK()		pthread_mutex_lock( &event_lock )
+#	define RBVERSE_EVENT_UNLOCK()	pthread_mutex_unlock( &event_lock )
+#else
+#	define RBVERSE_EVENT_LOCK()
+#	define RBVERSE_EVENT_UNLOCK()
+#endif
+
+
+/*
+ * Fetch a block with room for at least +size+ bytes, either from the free list or from
+ * malloc().
+ */
+static struct rbverse_event_block *
+rbverse_event_block_new( size_t size ) {
+	struct rbverse_event_block *block = NULL;
+	size_t capacity = RBVERSE_EVENT_BLOCK_SIZE;
+
+	if ( size <= RBVERSE_EVENT_BLOCK_SIZE && event_free_blocks ) {
+		block = event_free_blocks;
+		event_free_blocks = block->next;
+	} else {
+		if ( size > capacity ) capacity = size;
+		if ( !(block = malloc( sizeof(struct rbverse_event_block) + capacity )) ) {
+			fprintf( stderr, "Ruby-Verse: out of memory queueing a Verse event.\n" );
+			abort();
+		}
+		block->capacity = capacity;
+		event_blocks++;
+	}
+
+	block->next = NULL;
+	block->used = block->published = block->read = 0;
+
+	return block;
+}
+
+
+/*
+ * Return a fully-read +block+ to the free list, or free it if it's an oversized one.
+ */
+static void
+rbverse_event_block_release( struct rbverse_event_block *block ) {
+	if ( block->capacity > RBVERSE_EVENT_BLOCK_SIZE ) {
+		free( block );
+		event_blocks--;
+	} else {
+		block->next = event_free_blocks;
+		event_free_blocks = block;
+	}
+}
+
+
+/*
+ * Make the read end of the event pipe readable if it isn't already. This must be 
+ * called with the queue locked.
+ */
+static void
+rbverse_event_pipe_signal( void ) {
+	if ( event_pipe[1] < 0 || event_pipe_signalled ) return;
+	if ( write(event_pipe[1], "!", 1) == 1 ) event_pipe_signalled = 1;
+}
+
+
+/*
+ * Empty the event pipe once there's nothing left to dispatch. This must be called with
+ * the queue locked.
+ */
+static void
+rbverse_event_pipe_clear( void ) {
+	char buf[ 64 ];
+
+	if ( event_pipe[0] < 0 || !event_pipe_signalled || event_pending ) return;
+	while ( read(event_pipe[0], buf, sizeof(buf)) > 0 ) ;
+	event_pipe_signalled = 0;
+}
+
+
+/*
+ * Append a new event to the queue that will call +handler+ with the payload once the
+ * GVL is held again. The +kind+ of event is either the observer callback it's for, or 
+ * one of the RBVERSE_EVENT_SERVER_* kinds. The payload is +size+ bytes long, and is 
+ * followed by +strsize+ bytes of space for copies of any strings the event needs (see 
+ * rbverse_event_strdup()). Returns a pointer to the (uninitialized) payload. This is 
+ * safe to call without the GVL.
+ */
+void *
+rbverse_event_new( rbverse_event_handler handler, int kind, size_t size, size_t strsize ) {
+	const size_t payload_size = RBVERSE_EVENT_ALIGN( size );
+	const size_t event_size = RBVERSE_EVENT_HEADER_SIZE + payload_size + RBVERSE_EVENT_ALIGN( strsize );
+	struct rbverse_event *event;
+	char *payload;
+
+	RBVERSE_EVENT_LOCK();
+
+	if ( !event_tail ) {
+		event_head = event_tail = rbverse_event_block_new( event_size );
+	} else if ( event_tail->capacity - event_tail->used < event_size ) {
+		event_tail->next = rbverse_event_block_new( event_size );
+		event_tail = event_tail->next;
+	}
+
+	event = (struct rbverse_event *)( event_tail->data + event_tail->used );
+	event_tail->used += event_size;
+	payload = (char *)event + RBVERSE_EVENT_HEADER_SIZE;
+
+	event->handler = handler;
+	event->session = verse_session_get();
+	event->size    = (uint32)event_size;
+	event->kind    = kind;
+	event->strings = payload + payload_size;
+
+	event_unpublished++;
+	rbverse_event_count++;
+	if ( rbverse_stats_enabled ) event_received[ kind ]++;
+
+	RBVERSE_EVENT_UNLOCK();
+	RBVERSE_PROBE_CALLBACK_QUEUED( kind, event_size );
+
+	return payload;
+}
+
+
+/*
+ * Copy +len+ bytes from +ptr+ into the string space of the event with the specified 
+ * +payload+, returning the copy. Returns NULL if +ptr+ is NULL.
+ */
+const void *
+rbverse_event_memdup( void *payload, const void *ptr, size_t len ) {
+	struct rbverse_event *event = (struct rbverse_event *)( (char *)payload - RBVERSE_EVENT_HEADER_SIZE );
+	char *copy = event->strings;
+
+	if ( !ptr ) return NULL;
+
+	memcpy( copy, ptr, len );
+	event->strings += len;
+
+	return copy;
+}
+
+
+/*
+ * Copy +str+ into the string space of the event with the specified +payload+, returning
+ * the copy. Returns NULL if +str+ is NULL.
+ */
+const char *
+rbverse_event_strdup( void *payload, const char *str ) {
+	if ( !str ) return NULL;
+	return rbverse_event_memdup( payload, str, strlen(str) + 1 );
+}
+
+
+/*
+ * Make the events that have been queued visible to rbverse_drain_events(), waking up 
+ * anything waiting in rbverse_event_wait(). This must be called after 
+ * verse_callback_update() returns, but before the session switch lock is released, so
+ * no other thread can be in the middle of filling in an event. It's safe to call 
+ * without the GVL.
+ */
+void
+rbverse_event_publish( void ) {
+	struct rbverse_event_block *block;
+
+	RBVERSE_EVENT_LOCK();
+
+	if ( event_unpublished ) {
+		for ( block = event_head; block; block = block->next )
+			block->published = block->used;
+
+		event_pending += event_unpublished;
+		event_unpublished = 0;
+
+		rbverse_event_pipe_signal();
+#ifdef HAVE_PTHREAD_H
+		pthread_cond_broadcast( &event_published );
+#endif
+	}
+
+	RBVERSE_EVENT_UNLOCK();
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * Wait for up to +microseconds+ for there to be published events to dispatch. Returns
+ * non-zero if there are any. This must be called without the GVL; the wait can be 
+ * cut short with rbverse_event_wait_interrupt().
+ */
+int
+rbverse_event_wait( uint32 microseconds ) {
+	struct timespec deadline;
+	struct timeval now;
+	int pending;
+
+	gettimeofday( &now, NULL );
+	deadline.tv_sec  = now.tv_sec + ( now.tv_usec + microseconds ) / 1000000;
+	deadline.tv_nsec = ( ( now.tv_usec + microseconds ) % 1000000 ) * 1000;
+
+	RBVERSE_EVENT_LOCK();
+	while ( !event_pending && !event_wait_interrupted ) {
+		if ( pthread_cond_timedwait(&event_published, &event_lock, &deadline) == ETIMEDOUT )
+			break;
+	}
+	event_wait_interrupted = 0;
+	pending = event_pending ? 1 : 0;
+	RBVERSE_EVENT_UNLOCK();
+
+	return pending;
+}
+
+
+/*
+ * Interrupt a thread that's waiting in rbverse_event_wait(). This is the unblocking
+ * function for waits that are done in a blocking region.
+ */
+void
+rbverse_event_wait_interrupt( void *unused ) {
+	RBVERSE_EVENT_LOCK();
+	event_wait_interrupted = 1;
+	pthread_cond_broadcast( &event_published );
+	RBVERSE_EVENT_UNLOCK();
+}
+#endif
+
+
+/*
+ * Body of rbverse_drain_events(); calls the handler for every published event. The 
+ * queue isn't locked while a handler is running, so the network thread can keep 
+ * queueing events.
+ */
+static VALUE
+rbverse_drain_events_body( VALUE countptr ) {
+	unsigned long *count = (unsigned long *)countptr;
+	struct rbverse_event_block *block;
+	struct rbverse_event *event;
+	uint64_t start, end;
+
+	RBVERSE_EVENT_LOCK();
+
+	while ( (block = event_head) ) {
+		if ( block->read < block->published ) {
+			event = (struct rbverse_event *)( block->data + block->read );
+			block->read += event->size;
+			event_pending--;
+			(*count)++;
+
+			RBVERSE_EVENT_UNLOCK();
+			rbverse_dispatch_session = event->session;
+			RBVERSE_PROBE_CALLBACK_DISPATCH_START( event->kind, event->session );
+
+			if ( RBVERSE_TIMING_ENABLED() ) {
+				start = rbverse_usec_now();
+				event->handler( (char *)event + RBVERSE_EVENT_HEADER_SIZE );
+				end = rbverse_usec_now();
+
+				if ( rbverse_stats_enabled ) {
+					rbverse_stats.events[ event->kind ].dispatched++;
+					rbverse_stats.events[ event->kind ].dispatch_usec += end - start;
+				}
+				RBVERSE_TRACE_SPAN( "dispatch", rbverse_event_kind_name(event->kind), start, end );
+			} else {
+				event->handler( (char *)event + RBVERSE_EVENT_HEADER_SIZE );
+			}
+
+			RBVERSE_PROBE_CALLBACK_DISPATCH_DONE( event->kind, event->session );
+			RBVERSE_EVENT_LOCK();
+		}
+
+		/* Blocks can only be recycled by the outermost drain, as a handler further up
+		 * the stack (e.g., one that called Verse.update) may still be using its event. 
+		 * Blocks that still have unpublished events in them are still being written. */
+		else if ( drain_depth > 1 || block->read < block->used ) {
+			break;
+		}
+
+		/* Keep the last block around for the next batch */
+		else if ( block == event_tail ) {
+			block->used = block->published = block->read = 0;
+			break;
+		}
+
+		else {
+			event_head = block->next;
+			rbverse_event_block_release( block );
+		}
+	}
+
+	rbverse_event_pipe_clear();
+	RBVERSE_EVENT_UNLOCK();
+
+	return Qnil;
+}
+
+
+/*
+ * Ensure function for rbverse_drain_events(); restores the +outer_session+ that was
+ * being dispatched when it was called.
+ */
+static VALUE
+rbverse_drain_events_ensure( VALUE outer_session ) {
+	drain_depth--;
+	rbverse_dispatch_session = (VSession)outer_session;
+	return Qnil;
+}
+
+
+/*
+ * Call the handler for every published event, returning the number of events that were
+ * dispatched. This must be called with the GVL held. Each event is consumed before its 
+ * handler is called, so if a handler raises, the rest of the queue is left intact for 
+ * the next call.
+ */
+unsigned long
+rbverse_drain_events( void ) {
+	unsigned long count = 0;
+
+	drain_depth++;
+	rb_ensure( rbverse_drain_events_body, (VALUE)&count, 
+	           rbverse_drain_events_ensure, (VALUE)rbverse_dispatch_session );
+
+	return count;
+}
+
+
+/*
+ * Returns the number of event blocks the queue has allocated, whether they're in use or
+ * waiting on the free list.
+ */
+unsigned long
+rbverse_event_block_count( void ) {
+	unsigned long count;
+
+	RBVERSE_EVENT_LOCK();
+	count = event_blocks;
+	RBVERSE_EVENT_UNLOCK();
+
+	return count;
+}
+
+
+/*
+ * Copy the number of events of each kind that have been queued into +counts+, which
+ * must have room for RBVERSE_EVENT_KIND_COUNT of them, then zero them if +reset+ is
+ * non-zero.
+ */
+void
+rbverse_event_received_counts( unsigned long *counts, int reset ) {
+	RBVERSE_EVENT_LOCK();
+	MEMCPY( counts, event_received, unsigned long, RBVERSE_EVENT_KIND_COUNT );
+	if ( reset ) MEMZERO( event_received, unsigned long, RBVERSE_EVENT_KIND_COUNT );
+	RBVERSE_EVENT_UNLOCK();
+}
+
+
+/*
+ * call-seq:
+ *    Verse.pending_events   -> integer
+ *
+ * Returns the number of Verse events that have been received but not yet
+ * dispatched to their observers.
+ *
+ */
+static VALUE
+rbverse_verse_s_pending_events( VALUE module ) {
+	unsigned long count;
+
+	RBVERSE_EVENT_LOCK();
+	count = event_pending;
+	RBVERSE_EVENT_UNLOCK();
+
+	return ULONG2NUM( count );
+}
+
+
+/*
+ * call-seq:
+ *    Verse.event_io   -> io
+ *
+ * Returns an IO that becomes readable whenever there are Verse events waiting to be 
+ * dispatched, and stops being readable once Verse.process_pending (or Verse.update) 
+ * has dispatched them all. Don't read from it yourself; just wait on it with 
+ * IO.select, IO#wait_readable, or a Fiber scheduler, e.g.:
+ * 
+ *    Verse.start_network_thread
+ *    loop do
+ *        ready, = IO.select( [Verse.event_io, *other_ios] )
+ *        Verse.process_pending if ready.include?( Verse.event_io )
+ *        # ...
+ *    end
+ * 
+ * Events are only published as the network is read, so unless the network thread is
+ * running (see Verse.start_network_thread), something still has to call 
+ * Verse.update_nonblock periodically.
+ *
+ */
+static VALUE
+rbverse_verse_s_event_io( VALUE module ) {
+	int fds[2];
+	int i;
+
+	if ( !NIL_P(event_io) ) return event_io;
+
+	if ( pipe(fds) < 0 )
+		rb_sys_fail( "pipe" );
+	for ( i = 0; i < 2; i++ ) {
+		fcntl( fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK );
+		fcntl( fds[i], F_SETFD, FD_CLOEXEC );
+	}
+
+	event_io = rb_funcall( rb_cIO, rb_intern("for_fd"), 2, INT2FIX(fds[0]), rb_str_new2("r") );
+
+	/* Events that were published before the pipe existed still need to be signalled */
+	RBVERSE_EVENT_LOCK();
+	event_pipe[0] = fds[0];
+	event_pipe[1] = fds[1];
+	if ( event_pending ) rbverse_event_pipe_signal();
+	RBVERSE_EVENT_UNLOCK();
+
+	return event_io;
+}
+
+
+/*
+ * Verse event queue
+ */
+void
+rbverse_init_verse_eventqueue( void ) {
+	rbverse_log( "debug", "Initializing the event queue" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+#endif
+
+	rb_global_variable( &event_io );
+
+	rb_define_singleton_method( rbverse_mVerse, "pending_events", rbverse_verse_s_pending_events, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "event_io", rbverse_verse_s_event_io, 0 );
+}
+
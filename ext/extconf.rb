@@ -22,6 +22,17 @@ have_header( 'stdio.h' )    or fail( "missing stdio.h" )
 have_header( 'string.h' )   or fail( "missing string.h" )
 have_header( 'inttypes.h' ) or fail( "missing inttypes.h" )
 
+have_header( 'pthread.h' )
+have_header( 'sys/sdt.h' )
+have_func( 'rb_gc_location' )
+have_header( 'ruby/io/buffer.h' )
+
+have_func( 'clock_gettime', 'time.h' ) or have_library( 'rt', 'clock_gettime', 'time.h' )
+
+# Verse::Testing lets Ruby code fake commands from the server, so it's only built for 
+# the specs
+$defs.push( '-DRBVERSE_TESTING' ) if enable_config( 'testing', false )
+
 # find_library( 'efence', 'malloc', *ADDITIONAL_INCLUDE_DIRS )
 
 create_makefile( 'verse_ext' )
@@ -39,56 +39,2222 @@
 
 #include "verse_ext.h"
 
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
 VALUE rbverse_cVerseGeometryNode;
+VALUE rbverse_mVerseGeometryNodeObserver;
+
+/* 
+ * The values of each layer are kept in the layer's packed buffer as they arrive, so a
+ * mesh with millions of vertices doesn't create millions of Floats; only the layer 
+ * create and destroy commands are passed on to observers. The buffers grow as higher 
+ * vertex and polygon IDs are set, and can be exported in one piece with #layer_data, or
+ * read in place through #layer_buffer.
+ */
+
+/* Layers won't grow past this many vertices or polygons */
+#define RBVERSE_GEOMETRY_MAX_ELEMENTS	( 1U << 28 )
+
+/* How many vertices or polygons a layer grows to for values set by the server, unless
+ * GeometryNode.max_elements is changed */
+#define RBVERSE_GEOMETRY_DEFAULT_MAX_ELEMENTS	( 1U << 22 )
+
+/* The format of a set event that deletes a vertex or polygon from a base layer */
+#define RBVERSE_GEOMETRY_DELETE			0xff
+
+/* The base layers, which hold the vertex positions and the polygons' corners */
+#define RBVERSE_GEOMETRY_VERTEX_LAYER	0
+#define RBVERSE_GEOMETRY_POLYGON_LAYER	1
+
+/* How many vertices or polygons a delta sync compares at once before looking for the
+ * ones that changed */
+#define RBVERSE_GEOMETRY_SYNC_BLOCK		32
+
+/* The parent of a bone that's attached to the node itself */
+#define RBVERSE_GEOMETRY_NO_BONE		0xffff
+
+/* Names and sizes of the layer formats */
+static const char *rbverse_geometry_format_names[] = { "uint8", "uint32", "real32", "real64" };
+static const size_t rbverse_geometry_format_sizes[] = {
+	sizeof(uint8), sizeof(uint32), sizeof(real32), sizeof(real64)
+};
+
+/* The highest vertex or polygon ID + 1 the server can set (see GeometryNode.max_elements) */
+static uint32 rbverse_geometry_max_elements = RBVERSE_GEOMETRY_DEFAULT_MAX_ELEMENTS;
+
+/* The hidden instance variable that keeps a layer buffer's node alive */
+static ID rbverse_id_node;
+
+/* Structs for passing callback data back into Ruby */
+struct rbverse_g_layer_create_event {
+	VNodeID      node_id;
+	VLayerID     layer_id;
+	const char   *name;
+	VNGLayerType type;
+	uint32       def_uint;
+	real64       def_real;
+};
+struct rbverse_g_layer_destroy_event {
+	VNodeID  node_id;
+	VLayerID layer_id;
+};
+struct rbverse_g_bone_create_event {
+	VNodeID    node_id;
+	uint16     bone_id;
+	uint16     parent;
+	const char *weight;
+	const char *reference;
+	const char *position_label;
+	const char *rotation_label;
+	real64     position[ 3 ];
+	VNQuat64   rotation;
+};
+struct rbverse_g_bone_destroy_event {
+	VNodeID  node_id;
+	uint16   bone_id;
+};
+struct rbverse_g_upload_args {
+	VNodeID    node_id;
+	VLayerID   layer_id;
+	uint32     offset;
+	uint8      format;
+	uint8      components;
+	long       count;
+	const char *data;
+
+	/* Delta syncs only */
+	struct rbverse_node *node;
+	struct rbverse_session *session;
+	real64     epsilon;
+	long       skipped;
+};
+struct rbverse_g_set_event {
+	VNodeID  node_id;
+	VLayerID layer_id;
+	uint8    format;
+	uint8    count;
+	uint32   index;
+	union {
+		uint32 uint[ 4 ];
+		real64 real[ 4 ];
+	} values;
+};
+
+
+
+/* --------------------------------------------------------------
+ * Layers
+ * -------------------------------------------------------------- */
+
+/*
+ * Set the number of +components+ per vertex or polygon and the value +format+ for a 
+ * layer of the given +type+. Real layers start off as real64, but take the precision of 
+ * the first values they're sent.
+ */
+static void
+rbverse_geometry_layer_shape( VNGLayerType type, uint8 *components, uint8 *format ) {
+	switch ( type ) {
+	  case VN_G_LAYER_VERTEX_XYZ:
+		*components = 3;
+		*format     = RBVERSE_GEOMETRY_REAL64;
+		break;
+
+	  case VN_G_LAYER_POLYGON_CORNER_UINT32:
+		*components = 4;
+		*format     = RBVERSE_GEOMETRY_UINT32;
+		break;
+
+	  case VN_G_LAYER_POLYGON_CORNER_REAL:
+		*components = 4;
+		*format     = RBVERSE_GEOMETRY_REAL64;
+		break;
+
+	  case VN_G_LAYER_VERTEX_UINT32:
+	  case VN_G_LAYER_POLYGON_FACE_UINT32:
+		*components = 1;
+		*format     = RBVERSE_GEOMETRY_UINT32;
+		break;
+
+	  case VN_G_LAYER_POLYGON_FACE_UINT8:
+		*components = 1;
+		*format     = RBVERSE_GEOMETRY_UINT8;
+		break;
+
+	  default:
+		*components = 1;
+		*format     = RBVERSE_GEOMETRY_REAL64;
+	}
+}
+
+
+/* Return the size of one vertex or polygon's values in the given +layer+. */
+static inline size_t
+rbverse_geometry_layer_stride( const struct rbverse_geometry_layer *layer ) {
+	return layer->components * rbverse_geometry_format_sizes[ layer->format ];
+}
+
+
+/*
+ * Fill the values of the vertices or polygons from +from+ up to +to+ in the +layer+ with 
+ * its defaults. The base layers are filled with Verse's markers for unused vertices 
+ * and polygons instead, as are the elements of them that are deleted if +deleted+ is 
+ * set.
+ */
+static void
+rbverse_geometry_layer_fill( struct rbverse_geometry_layer *layer, uint32 from, uint32 to, 
+                             int deleted )
+{
+	const size_t first = (size_t)from * layer->components, last = (size_t)to * layer->components;
+	const int unused = deleted || layer->id == RBVERSE_GEOMETRY_VERTEX_LAYER || 
+		layer->id == RBVERSE_GEOMETRY_POLYGON_LAYER;
+	size_t i;
+
+	switch ( layer->format ) {
+	  case RBVERSE_GEOMETRY_UINT8:
+		memset( (uint8 *)layer->data + first, unused ? 0xff : (uint8)layer->def_uint, last - first );
+		break;
+
+	  case RBVERSE_GEOMETRY_UINT32:
+		for ( i = first; i < last; i++ )
+			((uint32 *)layer->data)[ i ] = unused ? ~0U : layer->def_uint;
+		break;
+
+	  case RBVERSE_GEOMETRY_REAL32:
+		for ( i = first; i < last; i++ )
+			((real32 *)layer->data)[ i ] = unused ? V_REAL32_MAX : (real32)layer->def_real;
+		break;
+
+	  case RBVERSE_GEOMETRY_REAL64:
+		for ( i = first; i < last; i++ )
+			((real64 *)layer->data)[ i ] = unused ? V_REAL64_MAX : layer->def_real;
+		break;
+	}
+}
+
+
+/*
+ * Free the IO::Buffer over the values of the +layer+, if there is one, so reading from
+ * it raises instead of reading memory the layer no longer uses. Must not be called
+ * while the node is being freed, as the buffer might have been freed already.
+ */
+static void
+rbverse_geometry_layer_release_buffer( struct rbverse_geometry_layer *layer ) {
+#ifdef HAVE_RUBY_IO_BUFFER_H
+	if ( NIL_P(layer->buffer) ) return;
+
+	rb_io_buffer_unlock( layer->buffer );
+	rb_io_buffer_free( layer->buffer );
+	rb_ivar_set( layer->buffer, rbverse_id_node, Qnil );
+	layer->buffer = Qnil;
+#endif
+}
+
+
+/*
+ * Grow the +layer+ so it has values for at least +count+ vertices or polygons. The 
+ * buffer's capacity is doubled as necessary, so filling a layer in order is amortized
+ * O(1) per vertex.
+ */
+static void
+rbverse_geometry_layer_reserve( struct rbverse_geometry_layer *layer, uint32 count ) {
+	uint32 capacity = layer->capacity ? layer->capacity : 64;
+
+	if ( count <= layer->count ) return;
+
+	rbverse_geometry_layer_release_buffer( layer );
+	if ( count > layer->capacity ) {
+		while ( capacity < count ) capacity *= 2;
+		layer->data = ruby_xrealloc2( layer->data, capacity, rbverse_geometry_layer_stride(layer) );
+		layer->capacity = capacity;
+	}
+
+	rbverse_geometry_layer_fill( layer, layer->count, count, FALSE );
+	layer->count = count;
+}
+
+
+/*
+ * Copy the position of the vertex at +index+ in the XYZ +layer+ into +xyz+. Returns 
+ * non-zero if the vertex is in use, i.e., it's been set and it isn't the 'unused' 
+ * marker.
+ */
+static int
+rbverse_geometry_layer_vertex( const struct rbverse_geometry_layer *layer, uint32 index, 
+                               real64 xyz[3] )
+{
+	const size_t offset = (size_t)index * 3;
+	uint8 i;
+
+	if ( index >= layer->count ) return FALSE;
+
+	if ( layer->format == RBVERSE_GEOMETRY_REAL32 ) {
+		for ( i = 0; i < 3; i++ ) xyz[i] = ((real32 *)layer->data)[ offset + i ];
+		return ((real32 *)layer->data)[ offset ] != V_REAL32_MAX;
+	} else {
+		for ( i = 0; i < 3; i++ ) xyz[i] = ((real64 *)layer->data)[ offset + i ];
+		return xyz[0] != V_REAL64_MAX;
+	}
+}
+
+
+/*
+ * Update the bounds of the base vertex +layer+ for a vertex that's changed from +from+ 
+ * to +to+ (either of which is NULL if the vertex wasn't or isn't in use). Moving a 
+ * vertex outwards just grows the bounds, but moving or deleting one that was on them 
+ * means they have to be recomputed.
+ */
+static void
+rbverse_geometry_bounds_update( struct rbverse_geometry_layer *layer, const real64 *from, 
+                                const real64 *to )
+{
+	uint8 i;
+
+	if ( from ) {
+		layer->used--;
+		for ( i = 0; i < 3 && !layer->bounds_dirty; i++ ) {
+			if ( (from[i] <= layer->min[i] && !(to && to[i] <= from[i])) ||
+			     (from[i] >= layer->max[i] && !(to && to[i] >= from[i])) )
+				layer->bounds_dirty = TRUE;
+		}
+	}
+
+	if ( !layer->used ) layer->bounds_dirty = FALSE;
+	if ( !to ) return;
+
+	if ( !layer->used++ ) {
+		for ( i = 0; i < 3; i++ ) layer->min[i] = layer->max[i] = to[i];
+	} else {
+		for ( i = 0; i < 3; i++ ) {
+			if ( to[i] < layer->min[i] ) layer->min[i] = to[i];
+			if ( to[i] > layer->max[i] ) layer->max[i] = to[i];
+		}
+	}
+}
+
+
+/*
+ * Recompute the bounds and the number of used vertices of the base vertex +layer+ from 
+ * all of its values. With SSE2, each vertex's coordinates are compared at once.
+ */
+static void
+rbverse_geometry_bounds_recompute( struct rbverse_geometry_layer *layer ) {
+	real64 lo[ 3 ] = { HUGE_VAL, HUGE_VAL, HUGE_VAL }, hi[ 3 ] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+	uint32 i = 0, used = 0;
+	uint8 c;
+
+	if ( layer->format == RBVERSE_GEOMETRY_REAL32 ) {
+		const real32 *v = layer->data;
+#ifdef __SSE2__
+		__m128 vmin = _mm_set1_ps( HUGE_VALF ), vmax = _mm_set1_ps( -HUGE_VALF );
+		float fmin[ 4 ], fmax[ 4 ];
+
+		/* Each load takes the next vertex's x too, so the last one is done below */
+		for ( ; i + 1 < layer->count; i++, v += 3 ) {
+			if ( v[0] == V_REAL32_MAX ) continue;
+			vmin = _mm_min_ps( _mm_loadu_ps(v), vmin );
+			vmax = _mm_max_ps( _mm_loadu_ps(v), vmax );
+			used++;
+		}
+
+		_mm_storeu_ps( fmin, vmin );
+		_mm_storeu_ps( fmax, vmax );
+		for ( c = 0; c < 3; c++ ) {
+			lo[c] = fmin[c];
+			hi[c] = fmax[c];
+		}
+#endif
+		for ( ; i < layer->count; i++, v += 3 ) {
+			if ( v[0] == V_REAL32_MAX ) continue;
+			for ( c = 0; c < 3; c++ ) {
+				if ( v[c] < lo[c] ) lo[c] = v[c];
+				if ( v[c] > hi[c] ) hi[c] = v[c];
+			}
+			used++;
+		}
+	} else {
+		const real64 *v = layer->data;
+#ifdef __SSE2__
+		__m128d xymin = _mm_set1_pd( HUGE_VAL ), xymax = _mm_set1_pd( -HUGE_VAL );
+		__m128d zmin = xymin, zmax = xymax;
+
+		for ( ; i < layer->count; i++, v += 3 ) {
+			if ( v[0] == V_REAL64_MAX ) continue;
+			xymin = _mm_min_pd( _mm_loadu_pd(v), xymin );
+			xymax = _mm_max_pd( _mm_loadu_pd(v), xymax );
+			zmin  = _mm_min_sd( _mm_load_sd(v + 2), zmin );
+			zmax  = _mm_max_sd( _mm_load_sd(v + 2), zmax );
+			used++;
+		}
+
+		_mm_storeu_pd( lo, xymin );
+		_mm_storeu_pd( hi, xymax );
+		_mm_store_sd( lo + 2, zmin );
+		_mm_store_sd( hi + 2, zmax );
+#endif
+		for ( ; i < layer->count; i++, v += 3 ) {
+			if ( v[0] == V_REAL64_MAX ) continue;
+			for ( c = 0; c < 3; c++ ) {
+				if ( v[c] < lo[c] ) lo[c] = v[c];
+				if ( v[c] > hi[c] ) hi[c] = v[c];
+			}
+			used++;
+		}
+	}
+
+	for ( c = 0; c < 3; c++ ) {
+		layer->min[c] = lo[c];
+		layer->max[c] = hi[c];
+	}
+	layer->used         = used;
+	layer->bounds_dirty = FALSE;
+}
+
+
+/*
+ * Store the values from the given set +event+ in the +layer+, converting them into the 
+ * layer's format.
+ */
+static void
+rbverse_geometry_layer_set( struct rbverse_geometry_layer *layer, 
+                            const struct rbverse_g_set_event *event )
+{
+	const int real = ( event->format == RBVERSE_GEOMETRY_REAL32 || 
+	                   event->format == RBVERSE_GEOMETRY_REAL64 );
+	const size_t offset = (size_t)event->index * layer->components;
+	const int bounded = ( layer->id == RBVERSE_GEOMETRY_VERTEX_LAYER && 
+	                      layer->type == VN_G_LAYER_VERTEX_XYZ );
+	real64 from[ 3 ], to[ 3 ];
+	int was_used = FALSE;
+	uint8 i, count = layer->components;
+
+	/* Deleting a vertex or polygon that was never set doesn't change anything */
+	if ( event->format == RBVERSE_GEOMETRY_DELETE && event->index >= layer->count )
+		return;
+
+	if ( event->index >= rbverse_geometry_max_elements ) {
+		if ( !layer->over_limit ) {
+			rbverse_log( "warn", "Ignoring values for element %u of geometry layer %d: "
+			             "past GeometryNode.max_elements (%u).", event->index, layer->id, 
+			             rbverse_geometry_max_elements );
+			layer->over_limit = TRUE;
+		}
+		return;
+	}
+
+	if ( !layer->count && layer->format == RBVERSE_GEOMETRY_REAL64 && 
+	     event->format == RBVERSE_GEOMETRY_REAL32 )
+		layer->format = RBVERSE_GEOMETRY_REAL32;
+
+	if ( bounded ) was_used = rbverse_geometry_layer_vertex( layer, event->index, from );
+
+	rbverse_geometry_layer_reserve( layer, event->index + 1 );
+	layer->data_string = Qnil;
+
+	if ( event->format == RBVERSE_GEOMETRY_DELETE ) {
+		rbverse_geometry_layer_fill( layer, event->index, event->index + 1, TRUE );
+		if ( bounded && was_used ) rbverse_geometry_bounds_update( layer, from, NULL );
+		return;
+	}
+
+	if ( event->count < count ) count = event->count;
+	for ( i = 0; i < count; i++ ) {
+		switch ( layer->format ) {
+		  case RBVERSE_GEOMETRY_UINT8:
+			((uint8 *)layer->data)[ offset + i ] = 
+				real ? (uint8)event->values.real[i] : (uint8)event->values.uint[i];
+			break;
+
+		  case RBVERSE_GEOMETRY_UINT32:
+			((uint32 *)layer->data)[ offset + i ] = 
+				real ? (uint32)event->values.real[i] : event->values.uint[i];
+			break;
+
+		  case RBVERSE_GEOMETRY_REAL32:
+			((real32 *)layer->data)[ offset + i ] = 
+				real ? (real32)event->values.real[i] : (real32)event->values.uint[i];
+			break;
+
+		  case RBVERSE_GEOMETRY_REAL64:
+			((real64 *)layer->data)[ offset + i ] = 
+				real ? event->values.real[i] : (real64)event->values.uint[i];
+			break;
+		}
+	}
+
+	if ( bounded ) {
+		const int is_used = rbverse_geometry_layer_vertex( layer, event->index, to );
+		if ( was_used || is_used )
+			rbverse_geometry_bounds_update( layer, was_used ? from : NULL, is_used ? to : NULL );
+	}
+}
+
+
+/*
+ * Free the given +layer+ and its values.
+ */
+static void
+rbverse_geometry_layer_free( struct rbverse_geometry_layer *layer ) {
+	xfree( layer->data );
+	xfree( layer );
+}
+
+
+/*
+ * Pin the object of the geometry node +ptr+ to its session while it has any layers or
+ * bones, and unpin it once it has neither. The server only sends them once, so an 
+ * object made after the old one was collected would be missing them.
+ */
+static void
+rbverse_geometrynode_update_pin( struct rbverse_node *ptr ) {
+	boolean in_use = FALSE;
+	uint32 i;
+
+	if ( NIL_P(ptr->session) ) return;
+
+	for ( i = 0; !in_use && i < ptr->geometry.layer_slots; i++ )
+		in_use = ptr->geometry.layers[i] != NULL;
+	for ( i = 0; !in_use && i < ptr->geometry.bone_slots; i++ )
+		in_use = ptr->geometry.bones[i] != NULL;
+
+	if ( in_use )
+		rbverse_session_pin_node( ptr->session, ptr );
+	else
+		rbverse_session_unpin_node( ptr->session, ptr->id );
+}
+
+
+/*
+ * Return the layer of the geometry node +ptr+ with the given +id+, or NULL if it 
+ * doesn't have one.
+ */
+static inline struct rbverse_geometry_layer *
+rbverse_geometrynode_layer( const struct rbverse_node *ptr, VLayerID id ) {
+	return id < ptr->geometry.layer_slots ? ptr->geometry.layers[ id ] : NULL;
+}
+
+
+/*
+ * Create the layer of the geometry node +ptr+ with the given +id+, or update its 
+ * settings if it already exists. A layer that's re-created with a different type loses
+ * its values.
+ */
+static struct rbverse_geometry_layer *
+rbverse_geometrynode_layer_create( struct rbverse_node *ptr, VLayerID id, const char *name, 
+                                   VNGLayerType type, uint32 def_uint, real64 def_real )
+{
+	struct rbverse_geometry_layer *layer;
+	uint32 slots;
+
+	if ( id >= ptr->geometry.layer_slots ) {
+		slots = ptr->geometry.layer_slots ? ptr->geometry.layer_slots : 4;
+		while ( slots <= id ) slots *= 2;
+
+		REALLOC_N( ptr->geometry.layers, struct rbverse_geometry_layer *, slots );
+		MEMZERO( ptr->geometry.layers + ptr->geometry.layer_slots, struct rbverse_geometry_layer *,
+		         slots - ptr->geometry.layer_slots );
+		ptr->geometry.layer_slots = slots;
+	}
+
+	if ( (layer = ptr->geometry.layers[ id ]) && layer->type != type ) {
+		rbverse_geometry_layer_release_buffer( layer );
+		rbverse_geometry_layer_free( layer );
+		layer = NULL;
+	}
+
+	if ( !layer ) {
+		layer = ALLOC( struct rbverse_geometry_layer );
+		MEMZERO( layer, struct rbverse_geometry_layer, 1 );
+
+		layer->id          = id;
+		layer->type        = type;
+		layer->data        = NULL;
+		layer->data_string = Qnil;
+		layer->buffer      = Qnil;
+		rbverse_geometry_layer_shape( type, &layer->components, &layer->format );
+
+		ptr->geometry.layers[ id ] = layer;
+	}
+
+	strncpy( layer->name, name ? name : "", sizeof(layer->name) - 1 );
+	layer->name[ sizeof(layer->name) - 1 ] = '\0';
+	layer->def_uint = def_uint;
+	layer->def_real = def_real;
+
+	rbverse_geometrynode_update_pin( ptr );
+	return layer;
+}
+
+
+/*
+ * Destroy the layer of the geometry node +ptr+ with the given +id+, if it has one.
+ */
+static void
+rbverse_geometrynode_layer_destroy( struct rbverse_node *ptr, VLayerID id ) {
+	struct rbverse_geometry_layer *layer = rbverse_geometrynode_layer( ptr, id );
+
+	if ( !layer ) return;
+	rbverse_geometry_layer_release_buffer( layer );
+	rbverse_geometry_layer_free( layer );
+	ptr->geometry.layers[ id ] = NULL;
+
+	rbverse_geometrynode_update_pin( ptr );
+}
+
+
+/*
+ * Return the struct of the wrapped geometry node with the given +node_id+ in the current
+ * session, or NULL if there isn't one. Values are only kept for geometry nodes that have
+ * been wrapped, as a client has to have the node object to subscribe to its layers.
+ */
+static struct rbverse_node *
+rbverse_lookup_geometry_node( VNodeID node_id, VALUE *nodeobj ) {
+	const VALUE node = rbverse_lookup_wrapped_node( node_id );
+	struct rbverse_node *ptr;
+
+	if ( NIL_P(node) ) return NULL;
+	if ( (ptr = rbverse_get_node( node ))->type != V_NT_GEOMETRY ) return NULL;
+
+	if ( nodeobj ) *nodeobj = node;
+	return ptr;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Shadows
+ * -------------------------------------------------------------- */
+
+/*
+ * Return the shadow of the layer of the geometry node +ptr+ with the given +id+, or NULL
+ * if nothing's been synced to it.
+ */
+static inline struct rbverse_geometry_shadow *
+rbverse_geometrynode_shadow( const struct rbverse_node *ptr, VLayerID id ) {
+	return id < ptr->geometry.shadow_slots ? ptr->geometry.shadows[ id ] : NULL;
+}
+
+
+/*
+ * Return the shadow of the layer of the geometry node +ptr+ with the given +id+, 
+ * creating it if necessary, with room for at least +count+ vertices or polygons of 
+ * +components+ values of the given +format+. Elements the shadow didn't have yet are 
+ * filled with Verse's 'unused' markers, which is what the server has for them until 
+ * they're set, and a shadow that was synced in a different format starts over.
+ */
+static struct rbverse_geometry_shadow *
+rbverse_geometrynode_shadow_reserve( struct rbverse_node *ptr, VLayerID id, uint8 format, 
+                                     uint8 components, uint32 count )
+{
+	struct rbverse_geometry_shadow *shadow;
+	uint32 slots, capacity;
+	size_t i;
+
+	if ( id >= ptr->geometry.shadow_slots ) {
+		slots = ptr->geometry.shadow_slots ? ptr->geometry.shadow_slots : 4;
+		while ( slots <= id ) slots *= 2;
+
+		REALLOC_N( ptr->geometry.shadows, struct rbverse_geometry_shadow *, slots );
+		MEMZERO( ptr->geometry.shadows + ptr->geometry.shadow_slots, struct rbverse_geometry_shadow *,
+		         slots - ptr->geometry.shadow_slots );
+		ptr->geometry.shadow_slots = slots;
+	}
+
+	if ( !(shadow = ptr->geometry.shadows[ id ]) ) {
+		shadow = ALLOC( struct rbverse_geometry_shadow );
+		MEMZERO( shadow, struct rbverse_geometry_shadow, 1 );
+		ptr->geometry.shadows[ id ] = shadow;
+	}
+
+	if ( shadow->format != format || shadow->components != components ) {
+		xfree( shadow->data );
+		shadow->data       = NULL;
+		shadow->count      = shadow->capacity = 0;
+		shadow->format     = format;
+		shadow->components = components;
+	}
+
+	if ( count <= shadow->count ) return shadow;
+
+	if ( count > shadow->capacity ) {
+		capacity = shadow->capacity ? shadow->capacity : 64;
+		while ( capacity < count ) capacity *= 2;
+		shadow->data = ruby_xrealloc2( shadow->data, capacity, 
+			components * rbverse_geometry_format_sizes[format] );
+		shadow->capacity = capacity;
+	}
+
+	for ( i = (size_t)shadow->count * components; i < (size_t)count * components; i++ ) {
+		switch ( format ) {
+		  case RBVERSE_GEOMETRY_UINT32:
+			((uint32 *)shadow->data)[ i ] = ~0U;
+			break;
+		  case RBVERSE_GEOMETRY_REAL32:
+			((real32 *)shadow->data)[ i ] = V_REAL32_MAX;
+			break;
+		  case RBVERSE_GEOMETRY_REAL64:
+			((real64 *)shadow->data)[ i ] = V_REAL64_MAX;
+			break;
+		}
+	}
+	shadow->count = count;
+
+	return shadow;
+}
+
+
+/*
+ * Forget the shadow of the layer of the geometry node +ptr+ with the given +id+, if it 
+ * has one.
+ */
+static void
+rbverse_geometrynode_shadow_destroy( struct rbverse_node *ptr, VLayerID id ) {
+	struct rbverse_geometry_shadow *shadow = rbverse_geometrynode_shadow( ptr, id );
+
+	if ( !shadow ) return;
+	xfree( shadow->data );
+	xfree( shadow );
+	ptr->geometry.shadows[ id ] = NULL;
+}
+
+
+/*
+ * Returns non-zero if any of the +count+ values of the given +format+ at +a+ differ from
+ * the ones at +b+. Real values have to differ by more than +epsilon+ unless it's zero, 
+ * in which case they're compared bit-for-bit like integers. Neither needs to be aligned. 
+ * With SSE2 it compares 16 bytes at a time, so runs of unchanged vertices are skipped 
+ * over about as fast as they can be read.
+ */
+static int
+rbverse_geometry_values_differ( const void *a, const void *b, size_t count, uint8 format, 
+                                real64 epsilon )
+{
+	size_t i = 0;
+
+	if ( epsilon <= 0.0 || format == RBVERSE_GEOMETRY_UINT8 || format == RBVERSE_GEOMETRY_UINT32 ) {
+		const char *ba = a, *bb = b;
+		const size_t size = count * rbverse_geometry_format_sizes[ format ];
+#ifdef __SSE2__
+		for ( ; i + 16 <= size; i += 16 ) {
+			const __m128i va = _mm_loadu_si128( (const __m128i *)(ba + i) );
+			const __m128i vb = _mm_loadu_si128( (const __m128i *)(bb + i) );
+			if ( _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xffff ) return TRUE;
+		}
+#endif
+		return memcmp( ba + i, bb + i, size - i ) != 0;
+	}
+
+	/* NaNs fail the <= test, so they always count as changed */
+	if ( format == RBVERSE_GEOMETRY_REAL64 ) {
+		const real64 *da = a, *db = b;
+#ifdef __SSE2__
+		const __m128d eps = _mm_set1_pd( epsilon );
+		const __m128d abs = _mm_castsi128_pd( _mm_set1_epi64x(0x7fffffffffffffffLL) );
+		for ( ; i + 2 <= count; i += 2 ) {
+			const __m128d diff = _mm_and_pd( abs, _mm_sub_pd(_mm_loadu_pd(da + i), _mm_loadu_pd(db + i)) );
+			if ( _mm_movemask_pd(_mm_cmpnle_pd(diff, eps)) ) return TRUE;
+		}
+#endif
+		for ( ; i < count; i++ )
+			if ( !(fabs(da[i] - db[i]) <= epsilon) ) return TRUE;
+	} else {
+		const real32 *fa = a, *fb = b;
+		const real32 feps = (real32)epsilon;
+#ifdef __SSE2__
+		const __m128 eps = _mm_set1_ps( feps );
+		const __m128 abs = _mm_castsi128_ps( _mm_set1_epi32(0x7fffffff) );
+		for ( ; i + 4 <= count; i += 4 ) {
+			const __m128 diff = _mm_and_ps( abs, _mm_sub_ps(_mm_loadu_ps(fa + i), _mm_loadu_ps(fb + i)) );
+			if ( _mm_movemask_ps(_mm_cmpnle_ps(diff, eps)) ) return TRUE;
+		}
+#endif
+		for ( ; i < count; i++ )
+			if ( !(fabsf(fa[i] - fb[i]) <= feps) ) return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Bones
+ * -------------------------------------------------------------- */
+
+/*
+ * Return the bone of the geometry node +ptr+ with the given +id+, or NULL if it doesn't
+ * have one.
+ */
+static inline struct rbverse_geometry_bone *
+rbverse_geometrynode_bone( const struct rbverse_node *ptr, uint16 id ) {
+	if ( id == RBVERSE_GEOMETRY_NO_BONE ) return NULL;
+	return id < ptr->geometry.bone_slots ? ptr->geometry.bones[ id ] : NULL;
+}
+
+
+/*
+ * Copy the label +src+ into the Verse-sized buffer +dst+.
+ */
+static inline void
+rbverse_geometry_label_copy( char dst[16], const char *src ) {
+	strncpy( dst, src ? src : "", 15 );
+	dst[ 15 ] = '\0';
+}
+
+
+/*
+ * Create the bone of the geometry node +ptr+ described by the given +event+, or update 
+ * it if it already exists. Only the bone is marked dirty; its descendants are 
+ * recomputed along with it the next time the world matrices are needed.
+ */
+static void
+rbverse_geometrynode_bone_create( struct rbverse_node *ptr, 
+                                  const struct rbverse_g_bone_create_event *event )
+{
+	struct rbverse_geometry_bone *bone;
+	uint32 slots;
+
+	if ( event->bone_id == RBVERSE_GEOMETRY_NO_BONE ) return;
+
+	if ( event->bone_id >= ptr->geometry.bone_slots ) {
+		slots = ptr->geometry.bone_slots ? ptr->geometry.bone_slots : 16;
+		while ( slots <= event->bone_id ) slots *= 2;
+
+		REALLOC_N( ptr->geometry.bones, struct rbverse_geometry_bone *, slots );
+		MEMZERO( ptr->geometry.bones + ptr->geometry.bone_slots, struct rbverse_geometry_bone *,
+		         slots - ptr->geometry.bone_slots );
+		REALLOC_N( ptr->geometry.bone_order, struct rbverse_geometry_bone *, slots );
+		ptr->geometry.bone_slots = slots;
+	}
+
+	if ( !(bone = ptr->geometry.bones[ event->bone_id ]) ) {
+		bone = ALLOC( struct rbverse_geometry_bone );
+		MEMZERO( bone, struct rbverse_geometry_bone, 1 );
+
+		bone->id = event->bone_id;
+		bone->parent = RBVERSE_GEOMETRY_NO_BONE;
+		ptr->geometry.bones[ event->bone_id ] = bone;
+		ptr->geometry.bones_unordered = TRUE;
+	}
+
+	if ( bone->parent != event->parent ) ptr->geometry.bones_unordered = TRUE;
+
+	bone->parent = event->parent;
+	rbverse_geometry_label_copy( bone->weight, event->weight );
+	rbverse_geometry_label_copy( bone->reference, event->reference );
+	rbverse_geometry_label_copy( bone->position_label, event->position_label );
+	rbverse_geometry_label_copy( bone->rotation_label, event->rotation_label );
+	MEMCPY( bone->position, event->position, real64, 3 );
+	bone->rotation = event->rotation;
+
+	bone->dirty = TRUE;
+	ptr->geometry.bones_dirty   = TRUE;
+	ptr->geometry.bone_matrices = Qnil;
+
+	rbverse_geometrynode_update_pin( ptr );
+}
+
+
+/*
+ * Destroy the bone of the geometry node +ptr+ with the given +id+, if it has one. Its 
+ * children become roots.
+ */
+static void
+rbverse_geometrynode_bone_destroy( struct rbverse_node *ptr, uint16 id ) {
+	struct rbverse_geometry_bone *bone = rbverse_geometrynode_bone( ptr, id );
+
+	if ( !bone ) return;
+	xfree( bone );
+	ptr->geometry.bones[ id ] = NULL;
+
+	ptr->geometry.bones_unordered = TRUE;
+	ptr->geometry.bones_dirty     = TRUE;
+	ptr->geometry.bone_matrices   = Qnil;
+
+	rbverse_geometrynode_update_pin( ptr );
+}
+
+
+/*
+ * Put the bones of the geometry node +ptr+ in topological order, so every bone comes 
+ * after its parent. Bones whose parent doesn't exist (or that are part of a cycle) are 
+ * treated as roots, and any bone whose effective parent changes is marked dirty.
+ */
+static void
+rbverse_geometrynode_bones_sort( struct rbverse_node *ptr ) {
+	struct rbverse_geometry_bone **order = ptr->geometry.bone_order, *bone, *up, *tmp;
+	uint32 i, first, last, count = 0;
+
+	for ( i = 0; i < ptr->geometry.bone_slots; i++ )
+		if ( ptr->geometry.bones[i] ) ptr->geometry.bones[i]->placed = FALSE;
+
+	/* Walk up from each bone that isn't placed yet to the first ancestor that is (or 
+	 * that doesn't exist), then reverse the chain so it's placed parent-first */
+	for ( i = 0; i < ptr->geometry.bone_slots; i++ ) {
+		if ( !(bone = ptr->geometry.bones[i]) || bone->placed ) continue;
+
+		first = count;
+		for ( up = bone; up && !up->placed; up = rbverse_geometrynode_bone(ptr, up->parent) ) {
+			up->placed = TRUE;
+			order[ count++ ] = up;
+		}
+
+		for ( last = count - 1; first < last; first++, last-- ) {
+			tmp = order[ first ];
+			order[ first ] = order[ last ];
+			order[ last ] = tmp;
+		}
+	}
+
+	for ( i = 0; i < count; i++ ) order[i]->rank = i;
+
+	for ( i = 0; i < count; i++ ) {
+		bone = order[ i ];
+		up = rbverse_geometrynode_bone( ptr, bone->parent );
+		if ( up && up->rank >= i ) up = NULL;
+
+		if ( up != bone->up ) {
+			bone->up = up;
+			bone->dirty = TRUE;
+		}
+	}
+
+	ptr->geometry.bone_count      = count;
+	ptr->geometry.bones_unordered = FALSE;
+}
+
+
+/*
+ * Compute the world matrix of the given +bone+ from its position and rotation and its
+ * parent's world matrix. Matrices are 4x4, column-major.
+ */
+static void
+rbverse_geometry_bone_transform( struct rbverse_geometry_bone *bone ) {
+	const VNQuat64 *q = &bone->rotation;
+	const real64 norm = q->x * q->x + q->y * q->y + q->z * q->z + q->w * q->w;
+	const real64 s = norm > 0.0 ? 2.0 / norm : 0.0;
+	real64 local[ 16 ];
+	uint8 r, c, k;
+
+	local[0]  = 1.0 - s * ( q->y * q->y + q->z * q->z );
+	local[1]  = s * ( q->x * q->y + q->w * q->z );
+	local[2]  = s * ( q->x * q->z - q->w * q->y );
+	local[3]  = 0.0;
+	local[4]  = s * ( q->x * q->y - q->w * q->z );
+	local[5]  = 1.0 - s * ( q->x * q->x + q->z * q->z );
+	local[6]  = s * ( q->y * q->z + q->w * q->x );
+	local[7]  = 0.0;
+	local[8]  = s * ( q->x * q->z + q->w * q->y );
+	local[9]  = s * ( q->y * q->z - q->w * q->x );
+	local[10] = 1.0 - s * ( q->x * q->x + q->y * q->y );
+	local[11] = 0.0;
+	local[12] = bone->position[0];
+	local[13] = bone->position[1];
+	local[14] = bone->position[2];
+	local[15] = 1.0;
+
+	if ( !bone->up ) {
+		MEMCPY( bone->world, local, real64, 16 );
+		return;
+	}
+
+	for ( c = 0; c < 4; c++ ) {
+		for ( r = 0; r < 4; r++ ) {
+			bone->world[ c * 4 + r ] = 0.0;
+			for ( k = 0; k < 4; k++ )
+				bone->world[ c * 4 + r ] += bone->up->world[ k * 4 + r ] * local[ c * 4 + k ];
+		}
+	}
+}
+
+
+/*
+ * Bring the world matrices of the bones of the geometry node +ptr+ up to date in one 
+ * pass over the topologically-ordered bones. A bone is recomputed if it's dirty or if 
+ * its parent was recomputed earlier in the same pass, so only the subtrees under bones
+ * that changed are touched.
+ */
+static void
+rbverse_geometrynode_bones_update( struct rbverse_node *ptr ) {
+	struct rbverse_geometry_bone *bone;
+	uint32 i;
+
+	if ( ptr->geometry.bones_unordered ) rbverse_geometrynode_bones_sort( ptr );
+	if ( !ptr->geometry.bones_dirty ) return;
+
+	for ( i = 0; i < ptr->geometry.bone_count; i++ ) {
+		bone = ptr->geometry.bone_order[ i ];
+
+		if ( bone->dirty || (bone->up && bone->up->moved) ) {
+			rbverse_geometry_bone_transform( bone );
+			bone->dirty = FALSE;
+			bone->moved = TRUE;
+		} else {
+			bone->moved = FALSE;
+		}
+	}
+
+	ptr->geometry.bones_dirty = FALSE;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Memory-management functions
+ * -------------------------------------------------------------- */
+
+/*
+ * Mark the geometry part of a node.
+ */
+static void
+rbverse_geometrynode_gc_mark( struct rbverse_node *ptr ) {
+	uint32 i;
+
+	if ( ptr ) {
+		for ( i = 0; i < ptr->geometry.layer_slots; i++ )
+			if ( ptr->geometry.layers[i] ) {
+				rbverse_gc_mark_movable( ptr->geometry.layers[i]->data_string );
+				rbverse_gc_mark_movable( ptr->geometry.layers[i]->buffer );
+			}
+		rbverse_gc_mark_movable( ptr->geometry.bone_matrices );
+	}
+}
+
+
+/*
+ * Update references in the geometry part of a node to objects moved by GC compaction.
+ */
+static void
+rbverse_geometrynode_gc_compact( struct rbverse_node *ptr ) {
+	uint32 i;
+
+	for ( i = 0; i < ptr->geometry.layer_slots; i++ )
+		if ( ptr->geometry.layers[i] ) {
+			rbverse_gc_update( ptr->geometry.layers[i]->data_string );
+			rbverse_gc_update( ptr->geometry.layers[i]->buffer );
+		}
+	rbverse_gc_update( ptr->geometry.bone_matrices );
+}
+
+
+/*
+ * Free the geometry part of a node.
+ */
+static void
+rbverse_geometrynode_gc_free( struct rbverse_node *ptr ) {
+	uint32 i;
+
+	if ( ptr ) {
+		for ( i = 0; i < ptr->geometry.layer_slots; i++ )
+			if ( ptr->geometry.layers[i] ) rbverse_geometry_layer_free( ptr->geometry.layers[i] );
+
+		xfree( ptr->geometry.layers );
+		ptr->geometry.layers      = NULL;
+		ptr->geometry.layer_slots = 0;
+
+		for ( i = 0; i < ptr->geometry.shadow_slots; i++ )
+			rbverse_geometrynode_shadow_destroy( ptr, (VLayerID)i );
+
+		xfree( ptr->geometry.shadows );
+		ptr->geometry.shadows      = NULL;
+		ptr->geometry.shadow_slots = 0;
+
+		for ( i = 0; i < ptr->geometry.bone_slots; i++ )
+			xfree( ptr->geometry.bones[i] );
+
+		xfree( ptr->geometry.bones );
+		xfree( ptr->geometry.bone_order );
+		ptr->geometry.bones      = ptr->geometry.bone_order = NULL;
+		ptr->geometry.bone_slots = ptr->geometry.bone_count = 0;
+	}
+}
+
+
+/*
+ * Return the memory used by the geometry part of a node.
+ */
+static size_t
+rbverse_geometrynode_gc_memsize( const struct rbverse_node *ptr ) {
+	const struct rbverse_geometry_layer *layer;
+	const struct rbverse_geometry_shadow *shadow;
+	size_t size = ptr->geometry.layer_slots * sizeof( struct rbverse_geometry_layer * ) +
+		ptr->geometry.shadow_slots * sizeof( struct rbverse_geometry_shadow * );
+	uint32 i;
+
+	for ( i = 0; i < ptr->geometry.layer_slots; i++ ) {
+		if ( !(layer = ptr->geometry.layers[i]) ) continue;
+		size += sizeof( struct rbverse_geometry_layer ) + 
+			layer->capacity * rbverse_geometry_layer_stride( layer );
+	}
+
+	for ( i = 0; i < ptr->geometry.shadow_slots; i++ ) {
+		if ( !(shadow = ptr->geometry.shadows[i]) ) continue;
+		size += sizeof( struct rbverse_geometry_shadow ) + 
+			(size_t)shadow->capacity * shadow->components * rbverse_geometry_format_sizes[ shadow->format ];
+	}
+
+	size += ptr->geometry.bone_slots * 2 * sizeof( struct rbverse_geometry_bone * );
+	for ( i = 0; i < ptr->geometry.bone_slots; i++ )
+		if ( ptr->geometry.bones[i] ) size += sizeof( struct rbverse_geometry_bone );
+
+	return size;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Class Methods
+ * -------------------------------------------------------------- */
+
+/*
+ * call-seq:
+ *    Verse::GeometryNode.max_elements   -> integer
+ *
+ * Returns how many vertices or polygons a layer can grow to for values set by the 
+ * server. Values for higher IDs are ignored, with a warning the first time it happens
+ * to each layer.
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_s_max_elements( VALUE klass ) {
+	return UINT2NUM( rbverse_geometry_max_elements );
+}
+
+
+/*
+ * call-seq:
+ *    Verse::GeometryNode.max_elements = integer
+ *
+ * Set how many vertices or polygons a layer can grow to for values set by the server,
+ * up to 268435456. The default is 4194304.
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_s_max_elements_eq( VALUE klass, VALUE count ) {
+	const long max = NUM2LONG( count );
+
+	if ( max < 1 || (unsigned long)max > RBVERSE_GEOMETRY_MAX_ELEMENTS )
+		rb_raise( rb_eArgError, "max elements must be between 1 and %u", RBVERSE_GEOMETRY_MAX_ELEMENTS );
+	rbverse_geometry_max_elements = (uint32)max;
+
+	return count;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Instance Methods
+ * -------------------------------------------------------------- */
+
+/*
+ * call-seq:
+ *    Verse::GeometryNode.initialize
+ *
+ * Set up a new Verse::GeometryNode.
+ */
+static VALUE
+rbverse_verse_geometrynode_initialize( VALUE self ) {
+	struct rbverse_node *ptr;
+
+	rb_call_super( 0, NULL );
+
+	ptr = rbverse_get_node( self );
+	ptr->type = V_NT_GEOMETRY;
+
+	/* The node starts out with no layers or bones until the server describes them */
+	ptr->geometry.layers       = NULL;
+	ptr->geometry.layer_slots  = 0;
+	ptr->geometry.shadows      = NULL;
+	ptr->geometry.shadow_slots = 0;
+
+	ptr->geometry.bones           = NULL;
+	ptr->geometry.bone_order      = NULL;
+	ptr->geometry.bone_slots      = 0;
+	ptr->geometry.bone_count      = 0;
+	ptr->geometry.bones_unordered = FALSE;
+	ptr->geometry.bones_dirty     = FALSE;
+	ptr->geometry.bone_matrices   = Qnil;
+
+	return self;
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.layers   -> hash
+ *
+ * Returns a frozen Hash of the node's layers, keyed by layer ID. Each one is a frozen
+ * Hash of the layer's +:name+, its +:type+ (one of the LAYER_* constants), the 
+ * +:format+ of its values (+:uint8+, +:uint32+, +:real32+, or +:real64+), the number of
+ * +:components+ per vertex or polygon, and the +:count+ of vertices or polygons it has
+ * values for.
+ *
+ * @example
+ *    node.layers[0]
+ *    # => {:name=>"vertex", :type=>0, :format=>:real64, :components=>3, :count=>20480}
+ */
+static VALUE
+rbverse_verse_geometrynode_layers( VALUE self ) {
+	const struct rbverse_node *ptr = rbverse_get_node( self );
+	const struct rbverse_geometry_layer *layer;
+	VALUE layers = rb_hash_new(), info;
+	uint32 i;
+
+	for ( i = 0; i < ptr->geometry.layer_slots; i++ ) {
+		if ( !(layer = ptr->geometry.layers[i]) ) continue;
+
+		info = rb_hash_new();
+		rb_hash_aset( info, ID2SYM(rb_intern("name")), rb_str_new2(layer->name) );
+		rb_hash_aset( info, ID2SYM(rb_intern("type")), INT2FIX(layer->type) );
+		rb_hash_aset( info, ID2SYM(rb_intern("format")),
+		              ID2SYM(rb_intern(rbverse_geometry_format_names[layer->format])) );
+		rb_hash_aset( info, ID2SYM(rb_intern("components")), INT2FIX(layer->components) );
+		rb_hash_aset( info, ID2SYM(rb_intern("count")), UINT2NUM(layer->count) );
+
+		rb_hash_aset( layers, INT2FIX(layer->id), rb_obj_freeze(info) );
+	}
+
+	return rb_obj_freeze( layers );
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.layer_data( layer_id )   -> string or nil
+ *
+ * Returns the values of the layer with the given +layer_id+ as a frozen binary String 
+ * (or +nil+ if the node doesn't have the layer). They're packed in native byte order, 
+ * +:components+ values of the layer's +:format+ per vertex or polygon (see #layers), 
+ * and vertices and polygons that haven't been set have the layer's default value (or 
+ * the Verse 'unused' marker, in the base layers). 
+ * 
+ * The String is copied from the layer in one piece, and the same one is returned until
+ * the layer changes. It can be wrapped in an IO::Buffer or unpacked without copying 
+ * each value into a Ruby object. Use #layer_buffer instead to read a layer that's 
+ * still streaming in, as every change makes the next call copy the whole layer again.
+ *
+ * @example
+ *    xyz = node.layer_data( 0 )
+ *    buffer = IO::Buffer.for( xyz )
+ *    buffer.get_value( :F64, 8 * 3 )  # => the x coordinate of vertex 1
+ */
+static VALUE
+rbverse_verse_geometrynode_layer_data( VALUE self, VALUE layer_id ) {
+	const struct rbverse_node *ptr = rbverse_get_node( self );
+	struct rbverse_geometry_layer *layer = rbverse_geometrynode_layer( ptr, (VLayerID)NUM2UINT(layer_id) );
+
+	if ( !layer ) return Qnil;
+
+	if ( NIL_P(layer->data_string) ) {
+		layer->data_string = rb_str_new( layer->data, 
+			(long)( layer->count * rbverse_geometry_layer_stride(layer) ) );
+		rb_obj_freeze( layer->data_string );
+	}
+
+	return layer->data_string;
+}
+
+
+#ifdef HAVE_RUBY_IO_BUFFER_H
+/*
+ * call-seq:
+ *    geometrynode.layer_buffer( layer_id )   -> io_buffer or nil
+ *
+ * Returns a read-only IO::Buffer over the values of the layer with the given +layer_id+
+ * (or +nil+ if the node doesn't have the layer), laid out like #layer_data. Nothing is
+ * copied: the buffer sees values as the server sets them, and the same one is returned
+ * until the layer grows. Then it's freed, and reading it raises, so fetch a new one 
+ * after each update.
+ *
+ * @example
+ *    buffer = node.layer_buffer( 0 )
+ *    buffer.get_value( :F64, 8 * 3 )  # => the x coordinate of vertex 1
+ */
+static VALUE
+rbverse_verse_geometrynode_layer_buffer( VALUE self, VALUE layer_id ) {
+	const struct rbverse_node *ptr = rbverse_get_node( self );
+	struct rbverse_geometry_layer *layer = rbverse_geometrynode_layer( ptr, (VLayerID)NUM2UINT(layer_id) );
+
+	if ( !layer ) return Qnil;
+
+	if ( NIL_P(layer->buffer) ) {
+		layer->buffer = rb_io_buffer_new( layer->data, 
+			layer->count * rbverse_geometry_layer_stride(layer),
+			RB_IO_BUFFER_EXTERNAL|RB_IO_BUFFER_READONLY );
+		rb_io_buffer_lock( layer->buffer );
+		rb_ivar_set( layer->buffer, rbverse_id_node, self );
+	}
+
+	return layer->buffer;
+}
+#endif
+
+
+/*
+ * call-seq:
+ *    geometrynode.vertex_count   -> integer
+ *
+ * Returns the number of vertices the node's base vertex layer has room for, including
+ * any unused ones.
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_vertex_count( VALUE self ) {
+	const struct rbverse_geometry_layer *layer = 
+		rbverse_geometrynode_layer( rbverse_get_node(self), RBVERSE_GEOMETRY_VERTEX_LAYER );
+	return UINT2NUM( layer ? layer->count : 0 );
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.polygon_count   -> integer
+ *
+ * Returns the number of polygons the node's base polygon layer has room for, including
+ * any unused ones.
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_polygon_count( VALUE self ) {
+	const struct rbverse_geometry_layer *layer = 
+		rbverse_geometrynode_layer( rbverse_get_node(self), RBVERSE_GEOMETRY_POLYGON_LAYER );
+	return UINT2NUM( layer ? layer->count : 0 );
+}
+
+
+
+/*
+ * call-seq:
+ *    geometrynode.bounds   -> hash or nil
+ *
+ * Returns the axis-aligned bounding box of the node's used vertices as a frozen Hash of 
+ * its +:min+ and +:max+ corners, its +:center+ and +:size+ (each an Array of x, y, and z),
+ * and the number of +:vertices+ in it, or +nil+ if the node doesn't have any vertices. 
+ * The box is kept up to date as the server sets and deletes vertices, so it's cheap to 
+ * ask for; it's only recomputed from all of the vertices after one on its edge has 
+ * moved inwards or been deleted.
+ *
+ * @example
+ *    node.bounds
+ *    # => {:min=>[-1.0, 0.0, -1.0], :max=>[1.0, 2.0, 1.0], :center=>[0.0, 1.0, 0.0], 
+ *    #     :size=>[2.0, 2.0, 2.0], :vertices=>20480}
+ */
+static VALUE
+rbverse_verse_geometrynode_bounds( VALUE self ) {
+	struct rbverse_geometry_layer *layer = 
+		rbverse_geometrynode_layer( rbverse_get_node(self), RBVERSE_GEOMETRY_VERTEX_LAYER );
+	VALUE bounds, min, max, center, size;
+	uint8 i;
+
+	if ( !layer || layer->type != VN_G_LAYER_VERTEX_XYZ ) return Qnil;
+	if ( layer->bounds_dirty ) rbverse_geometry_bounds_recompute( layer );
+	if ( !layer->used ) return Qnil;
+
+	min    = rb_ary_new2( 3 );
+	max    = rb_ary_new2( 3 );
+	center = rb_ary_new2( 3 );
+	size   = rb_ary_new2( 3 );
+
+	for ( i = 0; i < 3; i++ ) {
+		rb_ary_push( min, rb_float_new(layer->min[i]) );
+		rb_ary_push( max, rb_float_new(layer->max[i]) );
+		rb_ary_push( center, rb_float_new((layer->min[i] + layer->max[i]) / 2.0) );
+		rb_ary_push( size, rb_float_new(layer->max[i] - layer->min[i]) );
+	}
+
+	bounds = rb_hash_new();
+	rb_hash_aset( bounds, ID2SYM(rb_intern("min")), rb_obj_freeze(min) );
+	rb_hash_aset( bounds, ID2SYM(rb_intern("max")), rb_obj_freeze(max) );
+	rb_hash_aset( bounds, ID2SYM(rb_intern("center")), rb_obj_freeze(center) );
+	rb_hash_aset( bounds, ID2SYM(rb_intern("size")), rb_obj_freeze(size) );
+	rb_hash_aset( bounds, ID2SYM(rb_intern("vertices")), UINT2NUM(layer->used) );
+
+	return rb_obj_freeze( bounds );
+}
+
+
+
+/*
+ * call-seq:
+ *    geometrynode.bones   -> hash
+ *
+ * Returns a frozen Hash of the node's bones, keyed by bone ID in ascending order. Each 
+ * one is a frozen Hash of the bone's +:parent+ (a bone ID, or +nil+ if it's a root), its
+ * +:weight+ and +:reference+ layer names, its +:position+ relative to its parent as an 
+ * Array of x, y, and z, its +:rotation+ as an Array of the x, y, z, and w of a 
+ * quaternion, and the +:position_label+ and +:rotation_label+ of the curves that 
+ * animate them.
+ *
+ * @example
+ *    node.bones[1]
+ *    # => {:parent=>0, :weight=>"weight_1", :reference=>"", :position=>[0.0, 1.5, 0.0], 
+ *    #     :rotation=>[0.0, 0.0, 0.0, 1.0], :position_label=>"", :rotation_label=>""}
+ */
+static VALUE
+rbverse_verse_geometrynode_bones( VALUE self ) {
+	const struct rbverse_node *ptr = rbverse_get_node( self );
+	const struct rbverse_geometry_bone *bone;
+	VALUE bones = rb_hash_new(), info;
+	uint32 i;
+
+	for ( i = 0; i < ptr->geometry.bone_slots; i++ ) {
+		if ( !(bone = ptr->geometry.bones[i]) ) continue;
+
+		info = rb_hash_new();
+		rb_hash_aset( info, ID2SYM(rb_intern("parent")), 
+		              bone->parent == RBVERSE_GEOMETRY_NO_BONE ? Qnil : INT2FIX(bone->parent) );
+		rb_hash_aset( info, ID2SYM(rb_intern("weight")), rb_str_new2(bone->weight) );
+		rb_hash_aset( info, ID2SYM(rb_intern("reference")), rb_str_new2(bone->reference) );
+		rb_hash_aset( info, ID2SYM(rb_intern("position")), rb_obj_freeze(rb_ary_new3(3, 
+			rb_float_new(bone->position[0]), rb_float_new(bone->position[1]), 
+			rb_float_new(bone->position[2]))) );
+		rb_hash_aset( info, ID2SYM(rb_intern("rotation")), rb_obj_freeze(rb_ary_new3(4, 
+			rb_float_new(bone->rotation.x), rb_float_new(bone->rotation.y), 
+			rb_float_new(bone->rotation.z), rb_float_new(bone->rotation.w))) );
+		rb_hash_aset( info, ID2SYM(rb_intern("position_label")), rb_str_new2(bone->position_label) );
+		rb_hash_aset( info, ID2SYM(rb_intern("rotation_label")), rb_str_new2(bone->rotation_label) );
+
+		rb_hash_aset( bones, INT2FIX(bone->id), rb_obj_freeze(info) );
+	}
+
+	return rb_obj_freeze( bones );
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.bone_world_matrix( bone_id )   -> array or nil
+ *
+ * Returns the world transform of the bone with the given +bone_id+ (or +nil+ if the 
+ * node doesn't have the bone) as a frozen Array of the 16 Floats of a column-major 4x4 
+ * matrix. World matrices are cached, and only the ones under a bone that's changed 
+ * since they were last asked for are recomputed.
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_bone_world_matrix( VALUE self, VALUE bone_id ) {
+	struct rbverse_node *ptr = rbverse_get_node( self );
+	const struct rbverse_geometry_bone *bone;
+	VALUE matrix;
+	uint8 i;
+
+	if ( !(bone = rbverse_geometrynode_bone(ptr, (uint16)NUM2UINT(bone_id))) ) return Qnil;
+	rbverse_geometrynode_bones_update( ptr );
+
+	matrix = rb_ary_new2( 16 );
+	for ( i = 0; i < 16; i++ )
+		rb_ary_push( matrix, rb_float_new(bone->world[i]) );
+
+	return rb_obj_freeze( matrix );
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.bone_world_matrices   -> string
+ *
+ * Returns the world transforms of all of the node's bones as a frozen binary String of 
+ * 16 native doubles per bone (see #bone_world_matrix), in the same order as the keys of 
+ * #bones. Like #layer_data, the same String is returned until one of the bones changes, 
+ * so skinning many rigs per tick doesn't create a Float per matrix element.
+ *
+ * @example
+ *    matrices = node.bone_world_matrices.unpack( 'd*' ).each_slice( 16 ).to_a
+ *    world = Hash[ node.bones.keys.zip(matrices) ]
+ */
+static VALUE
+rbverse_verse_geometrynode_bone_world_matrices( VALUE self ) {
+	struct rbverse_node *ptr = rbverse_get_node( self );
+	const struct rbverse_geometry_bone *bone;
+	VALUE matrices;
+	char *dest;
+	uint32 i;
+
+	if ( RTEST(ptr->geometry.bone_matrices) ) return ptr->geometry.bone_matrices;
+
+	rbverse_geometrynode_bones_update( ptr );
+
+	matrices = rb_str_new( NULL, (long)(ptr->geometry.bone_count * sizeof(bone->world)) );
+	dest = RSTRING_PTR( matrices );
+
+	for ( i = 0; i < ptr->geometry.bone_slots; i++ ) {
+		if ( !(bone = ptr->geometry.bones[i]) ) continue;
+		memcpy( dest, bone->world, sizeof(bone->world) );
+		dest += sizeof( bone->world );
+	}
+
+	ptr->geometry.bone_matrices = rb_obj_freeze( matrices );
+	return matrices;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Bulk uploads
+ * -------------------------------------------------------------- */
+
+/*
+ * Set up the +args+ for uploading the values packed in +data+ to the layer of the 
+ * geometry node +self+ with the given +layer_id+, +args->components+ values of 
+ * +args->format+ for each vertex or polygon, starting at the one given by the +:offset+
+ * option. Returns the frozen copy of +data+ the args point into, which the caller has 
+ * to keep alive until they're sent.
+ */
+static VALUE
+rbverse_g_upload_args_init( struct rbverse_g_upload_args *args, VALUE self, VALUE layer_id,
+                            VALUE data, VALUE options )
+{
+	struct rbverse_node *ptr = rbverse_get_node( self );
+	const size_t per_element = args->components * rbverse_geometry_format_sizes[ args->format ];
+	VALUE offset = Qnil, epsilon = Qnil;
+	long length;
+
+	rbverse_ensure_node_is_alive( ptr );
+
+	/* A frozen copy shares the string's buffer, but can't be changed by another thread 
+	 * while this one is waiting for the session's mutex */
+	data = rb_str_new_frozen( StringValue(data) );
+	length = RSTRING_LEN( data );
+
+	if ( !NIL_P(options) ) {
+		Check_Type( options, T_HASH );
+		offset = rb_hash_aref( options, ID2SYM(rb_intern("offset")) );
+		epsilon = rb_hash_aref( options, ID2SYM(rb_intern("epsilon")) );
+	}
+
+	args->node_id  = ptr->id;
+	args->layer_id = (VLayerID)NUM2UINT( layer_id );
+	args->offset   = NIL_P( offset ) ? 0 : NUM2UINT( offset );
+	args->count    = length / (long)per_element;
+	args->data     = RSTRING_PTR( data );
+	args->node     = ptr;
+	args->session  = NULL;
+	args->epsilon  = NIL_P( epsilon ) ? 0.0 : NUM2DBL( epsilon );
+	args->skipped  = 0;
+
+	if ( length % (long)per_element )
+		rb_raise( rb_eArgError, "packed data is %ld bytes, which isn't a multiple of %lu", 
+		          length, (unsigned long)per_element );
+	if ( (uint64_t)args->offset + args->count > RBVERSE_GEOMETRY_MAX_ELEMENTS )
+		rb_raise( rb_eRangeError, "can't upload past element %u", RBVERSE_GEOMETRY_MAX_ELEMENTS );
+	if ( !(args->epsilon >= 0.0) )
+		rb_raise( rb_eArgError, "epsilon can't be negative" );
+
+	return data;
+}
+
+
+/*
+ * Return the format of the vertices being uploaded, from the +:format+ in the given 
+ * +options+ hash (if it's not nil).
+ */
+static uint8
+rbverse_g_vertex_format( VALUE options ) {
+	VALUE format = Qnil;
+	ID format_id;
+
+	if ( !NIL_P(options) ) {
+		Check_Type( options, T_HASH );
+		format = rb_hash_aref( options, ID2SYM(rb_intern("format")) );
+	}
+	if ( NIL_P(format) ) return RBVERSE_GEOMETRY_REAL64;
+
+	format_id = SYM2ID( rb_convert_type(format, T_SYMBOL, "Symbol", "to_sym") );
+	if ( format_id == rb_intern("real32") )
+		return RBVERSE_GEOMETRY_REAL32;
+	else if ( format_id != rb_intern("real64") )
+		rb_raise( rb_eArgError, "invalid vertex format %s (expected :real32 or :real64)",
+		          RSTRING_PTR(rb_inspect(format)) );
+
+	return RBVERSE_GEOMETRY_REAL64;
+}
+
+
+/*
+ * Send the values of the vertex or polygon with the given +id+ packed at +data+.
+ */
+static void
+rbverse_g_upload_send( const struct rbverse_g_upload_args *args, uint32 id, const char *data ) {
+	real32 xyz32[ 3 ];
+	real64 xyz64[ 3 ];
+	uint32 corners[ 4 ];
+
+	/* The packed values mightn't be aligned, so they're copied out first */
+	switch ( args->format ) {
+	  case RBVERSE_GEOMETRY_REAL32:
+		memcpy( xyz32, data, sizeof(xyz32) );
+		verse_send_g_vertex_set_xyz_real32( args->node_id, args->layer_id, id,
+		                                    xyz32[0], xyz32[1], xyz32[2] );
+		break;
+
+	  case RBVERSE_GEOMETRY_REAL64:
+		memcpy( xyz64, data, sizeof(xyz64) );
+		verse_send_g_vertex_set_xyz_real64( args->node_id, args->layer_id, id,
+		                                    xyz64[0], xyz64[1], xyz64[2] );
+		break;
+
+	  case RBVERSE_GEOMETRY_UINT32:
+		memcpy( corners, data, sizeof(corners) );
+		verse_send_g_polygon_set_corner_uint32( args->node_id, args->layer_id, id,
+		                                        corners[0], corners[1], corners[2], corners[3] );
+		break;
+	}
+}
 
 
 /*
- * Mark the geometry part of a node.
+ * Session-locked section of #set_vertices and #set_polygons.
  */
-static void
-rbverse_geometrynode_gc_mark( struct rbverse_node *ptr ) {
-	if ( ptr ) {
-		/* TODO: Mark child-specific data */
-	}
+static VALUE
+rbverse_verse_geometrynode_upload_l( VALUE argsptr ) {
+	const struct rbverse_g_upload_args *args = (const struct rbverse_g_upload_args *)argsptr;
+	const size_t stride = args->components * rbverse_geometry_format_sizes[ args->format ];
+	const char *data = args->data;
+	long i;
+
+	for ( i = 0; i < args->count; i++, data += stride )
+		rbverse_g_upload_send( args, args->offset + (uint32)i, data );
+
+	return Qtrue;
 }
 
 
 /*
- * Free the geometry part of a node.
+ * call-seq:
+ *    geometrynode.set_vertices( layer_id, packed_xyz, options={} )   -> integer
+ *
+ * Set the positions of a run of vertices in the XYZ layer with the given +layer_id+ 
+ * from +packed_xyz+, a binary String of x, y, z triples in native byte order. All of 
+ * the commands are sent in one go, under a single lock of the node's session, so 
+ * uploading a big mesh doesn't cost a method call per vertex. Returns the number of 
+ * vertices that were sent. The node's own layer is updated when the server sends the
+ * values back.
+ * 
+ * Options:
+ * 
+ * [:offset]  the ID of the first vertex to set (default: 0)
+ * [:format]  +:real64+ (the default) if the values are doubles, or +:real32+ if 
+ *            they're floats
+ *
+ * @example
+ *    positions = vertices.flatten.pack( 'e*' )
+ *    node.set_vertices( 0, positions, :format => :real32 )
  */
-static void
-rbverse_geometrynode_gc_free( struct rbverse_node *ptr ) {
-	if ( ptr ) {
-		/* TODO: Free child-specific data */
-	}
+static VALUE
+rbverse_verse_geometrynode_set_vertices( int argc, VALUE *argv, VALUE self ) {
+	struct rbverse_g_upload_args args;
+	VALUE layer_id, packed, options;
+
+	rb_scan_args( argc, argv, "21", &layer_id, &packed, &options );
+
+	args.format     = rbverse_g_vertex_format( options );
+	args.components = 3;
+	packed = rbverse_g_upload_args_init( &args, self, layer_id, packed, options );
+
+	rbverse_with_session_lock_n( rbverse_get_node(self)->session, 
+	                             rbverse_verse_geometrynode_upload_l, (VALUE)&args, 
+	                             (unsigned long)args.count );
+	RB_GC_GUARD( packed );
+
+	return LONG2NUM( args.count );
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.set_polygons( layer_id, packed_indices, options={} )   -> integer
+ *
+ * Set the corners of a run of polygons in the corner layer with the given +layer_id+ 
+ * from +packed_indices+, a binary String of four native uint32 vertex indices per 
+ * polygon (triangles have 0xFFFFFFFF as their fourth). Like #set_vertices, the commands
+ * are all sent under a single lock of the node's session. Returns the number of 
+ * polygons that were sent.
+ * 
+ * Options:
+ * 
+ * [:offset]  the ID of the first polygon to set (default: 0)
+ *
+ * @example
+ *    indices = triangles.collect {|a, b, c| [a, b, c, 0xFFFFFFFF] }.flatten.pack( 'L*' )
+ *    node.set_polygons( 1, indices )
+ */
+static VALUE
+rbverse_verse_geometrynode_set_polygons( int argc, VALUE *argv, VALUE self ) {
+	struct rbverse_g_upload_args args;
+	VALUE layer_id, packed, options;
+
+	rb_scan_args( argc, argv, "21", &layer_id, &packed, &options );
+
+	args.format     = RBVERSE_GEOMETRY_UINT32;
+	args.components = 4;
+	packed = rbverse_g_upload_args_init( &args, self, layer_id, packed, options );
+
+	rbverse_with_session_lock_n( rbverse_get_node(self)->session, 
+	                             rbverse_verse_geometrynode_upload_l, (VALUE)&args, 
+	                             (unsigned long)args.count );
+	RB_GC_GUARD( packed );
+
+	return LONG2NUM( args.count );
 }
 
 
+
 /* --------------------------------------------------------------
- * Instance Methods
+ * Delta syncs
  * -------------------------------------------------------------- */
 
+/*
+ * Session-locked section of #sync_vertices and #sync_polygons. The upload is compared 
+ * with the layer's shadow a block at a time, and only the blocks that differ are 
+ * searched for the vertices or polygons to send. Each one is counted in the session's
+ * stats as it's sent.
+ */
+static VALUE
+rbverse_verse_geometrynode_sync_l( VALUE argsptr ) {
+	struct rbverse_g_upload_args *args = (struct rbverse_g_upload_args *)argsptr;
+	struct rbverse_geometry_shadow *shadow = rbverse_geometrynode_shadow( args->node, args->layer_id );
+	const size_t values = args->components;
+	const size_t stride = values * rbverse_geometry_format_sizes[ args->format ];
+	const char *data;
+	char *last;
+	long first, end, i;
+
+	/* The shadow was reset by another thread while this one was waiting for the lock, 
+	 * so there's nothing to compare against */
+	if ( !shadow || shadow->format != args->format || 
+	     shadow->count < args->offset + (uint32)args->count ) {
+		if ( rbverse_stats_enabled ) args->session->commands_sent += (unsigned long)args->count;
+		return rbverse_verse_geometrynode_upload_l( argsptr );
+	}
+
+	for ( first = 0; first < args->count; first = end ) {
+		end  = first + RBVERSE_GEOMETRY_SYNC_BLOCK < args->count ? 
+			first + RBVERSE_GEOMETRY_SYNC_BLOCK : args->count;
+		data = args->data + first * stride;
+		last = (char *)shadow->data + ( args->offset + first ) * stride;
+
+		if ( !rbverse_geometry_values_differ(data, last, (end - first) * values, args->format,
+		                                     args->epsilon) ) {
+			args->skipped += end - first;
+			continue;
+		}
+
+		for ( i = first; i < end; i++, data += stride, last += stride ) {
+			if ( !rbverse_geometry_values_differ(data, last, values, args->format, args->epsilon) ) {
+				args->skipped++;
+				continue;
+			}
+
+			rbverse_g_upload_send( args, args->offset + (uint32)i, data );
+			memcpy( last, data, stride );
+			if ( rbverse_stats_enabled ) args->session->commands_sent++;
+		}
+	}
+
+	return Qtrue;
+}
+
+
+/*
+ * Send the vertices or polygons described by the +args+ for the geometry node +self+ that
+ * differ from its shadow of the layer, and return a Hash of how many were +:sent+ and 
+ * +:skipped+.
+ */
+static VALUE
+rbverse_g_sync( struct rbverse_g_upload_args *args, VALUE self ) {
+	VALUE result = rb_hash_new();
+
+	rbverse_geometrynode_shadow_reserve( args->node, args->layer_id, args->format, args->components,
+	                                     args->offset + (uint32)args->count );
+	args->session = rbverse_get_session( args->node->session );
+	rbverse_with_session_lock_n( args->node->session, rbverse_verse_geometrynode_sync_l, 
+	                             (VALUE)args, 0 );
+
+	rb_hash_aset( result, ID2SYM(rb_intern("sent")), LONG2NUM(args->count - args->skipped) );
+	rb_hash_aset( result, ID2SYM(rb_intern("skipped")), LONG2NUM(args->skipped) );
+
+	return result;
+}
+
+
 /*
  * call-seq:
- *    Verse::GeometryNode.initialize
+ *    geometrynode.sync_vertices( layer_id, packed_xyz, options={} )   -> hash
  *
- * Set up a new Verse::GeometryNode.
+ * Like #set_vertices, but only sends the vertices that have moved since they were last 
+ * synced. The node keeps a shadow copy of the values it's synced to each layer, and 
+ * compares the upload with it (using SIMD instructions where the platform has them), so
+ * re-uploading a mostly-static mesh every frame only costs the bandwidth of the parts 
+ * that changed. Returns a Hash of how many vertices were +:sent+, and how many were 
+ * +:skipped+ because they hadn't changed.
+ * 
+ * The shadow only knows about values sent with #sync_vertices; call #reset_shadow after
+ * changing the layer some other way to have everything sent again.
+ * 
+ * Options:
+ * 
+ * [:offset]   the ID of the first vertex to set (default: 0)
+ * [:format]   +:real64+ (the default) if the values are doubles, or +:real32+ if 
+ *             they're floats
+ * [:epsilon]  how far a coordinate has to move before the vertex is sent again 
+ *             (default: 0.0, i.e., any change)
+ *
+ * @example
+ *    node.sync_vertices( 0, positions, :epsilon => 0.0001 )
+ *    # => {:sent=>212, :skipped=>20268}
  */
 static VALUE
-rbverse_verse_geometrynode_initialize( VALUE self ) {
-	struct rbverse_node *ptr;
+rbverse_verse_geometrynode_sync_vertices( int argc, VALUE *argv, VALUE self ) {
+	struct rbverse_g_upload_args args;
+	VALUE layer_id, packed, options, result;
 
-	rb_call_super( 0, NULL );
+	rb_scan_args( argc, argv, "21", &layer_id, &packed, &options );
 
-	ptr = rbverse_get_node( self );
-	ptr->type = V_NT_GEOMETRY;
+	args.format     = rbverse_g_vertex_format( options );
+	args.components = 3;
+	packed = rbverse_g_upload_args_init( &args, self, layer_id, packed, options );
 
-	/* TODO: Initialize geometry-specific instance data. */
+	result = rbverse_g_sync( &args, self );
+	RB_GC_GUARD( packed );
 
-	return self;
+	return result;
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.sync_polygons( layer_id, packed_indices, options={} )   -> hash
+ *
+ * Like #set_polygons, but only sends the polygons whose corners have changed since they
+ * were last synced (see #sync_vertices). Returns a Hash of how many polygons were 
+ * +:sent+ and +:skipped+.
+ * 
+ * Options:
+ * 
+ * [:offset]  the ID of the first polygon to set (default: 0)
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_sync_polygons( int argc, VALUE *argv, VALUE self ) {
+	struct rbverse_g_upload_args args;
+	VALUE layer_id, packed, options, result;
+
+	rb_scan_args( argc, argv, "21", &layer_id, &packed, &options );
+
+	args.format     = RBVERSE_GEOMETRY_UINT32;
+	args.components = 4;
+	packed = rbverse_g_upload_args_init( &args, self, layer_id, packed, options );
+	args.epsilon = 0.0;
+
+	result = rbverse_g_sync( &args, self );
+	RB_GC_GUARD( packed );
+
+	return result;
+}
+
+
+/*
+ * call-seq:
+ *    geometrynode.reset_shadow( layer_id=nil )
+ *
+ * Forget the values synced to the layer with the given +layer_id+ (or to every layer, 
+ * if it's +nil+), so the next #sync_vertices or #sync_polygons sends all of them.
+ *
+ */
+static VALUE
+rbverse_verse_geometrynode_reset_shadow( int argc, VALUE *argv, VALUE self ) {
+	struct rbverse_node *ptr = rbverse_get_node( self );
+	VALUE layer_id;
+	uint32 i;
+
+	rb_scan_args( argc, argv, "01", &layer_id );
+
+	if ( NIL_P(layer_id) ) {
+		for ( i = 0; i < ptr->geometry.shadow_slots; i++ )
+			rbverse_geometrynode_shadow_destroy( ptr, (VLayerID)i );
+	} else {
+		rbverse_geometrynode_shadow_destroy( ptr, (VLayerID)NUM2UINT(layer_id) );
+	}
+
+	return Qnil;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+/*
+ * Create the layer described by the g_layer_create event and notify the node's 
+ * observers.
+ */
+static void *
+rbverse_cb_g_layer_create_body( void *ptr ) {
+	const struct rbverse_g_layer_create_event *event = ptr;
+	struct rbverse_node *geometry;
+	VALUE node, argv[6];
+
+	if ( !(geometry = rbverse_lookup_geometry_node( event->node_id, &node )) ) return NULL;
+	rbverse_geometrynode_layer_create( geometry, event->layer_id, event->name, event->type,
+	                                   event->def_uint, event->def_real );
+
+	if ( !rbverse_has_observers(node, RBVERSE_ON_LAYER_CREATE) ) return NULL;
+
+	argv[0] = node;
+	argv[1] = INT2FIX( event->layer_id );
+	argv[2] = event->name ? rb_str_new2( event->name ) : Qnil;
+	argv[3] = INT2FIX( event->type );
+	argv[4] = UINT2NUM( event->def_uint );
+	argv[5] = rb_float_new( event->def_real );
+
+	rbverse_notify_observers( node, RBVERSE_ON_LAYER_CREATE, 6, argv );
+
+	return NULL;
+}
+
+
+/*
+ * Callback for the 'g_layer_create' command.
+ */
+static void
+rbverse_cb_g_layer_create( void *unused, VNodeID node_id, VLayerID layer_id, const char *name,
+                           VNGLayerType type, uint32 def_uint, real64 def_real )
+{
+	struct rbverse_g_layer_create_event *event =
+		rbverse_event_new( rbverse_cb_g_layer_create_body, RBVERSE_ON_LAYER_CREATE, 
+		                   sizeof(*event), RBVERSE_EVENT_STRSIZE(name) );
+
+	event->node_id  = node_id;
+	event->layer_id = layer_id;
+	event->name     = rbverse_event_strdup( event, name );
+	event->type     = type;
+	event->def_uint = def_uint;
+	event->def_real = def_real;
+}
+
+
+/*
+ * Destroy the layer from the g_layer_destroy event and notify the node's observers.
+ */
+static void *
+rbverse_cb_g_layer_destroy_body( void *ptr ) {
+	const struct rbverse_g_layer_destroy_event *event = ptr;
+	struct rbverse_node *geometry;
+	VALUE node, argv[2];
+
+	if ( !(geometry = rbverse_lookup_geometry_node( event->node_id, &node )) ) return NULL;
+	rbverse_geometrynode_layer_destroy( geometry, event->layer_id );
+	rbverse_geometrynode_shadow_destroy( geometry, event->layer_id );
+
+	if ( !rbverse_has_observers(node, RBVERSE_ON_LAYER_DESTROY) ) return NULL;
+
+	argv[0] = node;
+	argv[1] = INT2FIX( event->layer_id );
+
+	rbverse_notify_observers( node, RBVERSE_ON_LAYER_DESTROY, 2, argv );
+
+	return NULL;
+}
+
+
+/*
+ * Callback for the 'g_layer_destroy' command.
+ */
+static void
+rbverse_cb_g_layer_destroy( void *unused, VNodeID node_id, VLayerID layer_id ) {
+	struct rbverse_g_layer_destroy_event *event =
+		rbverse_event_new( rbverse_cb_g_layer_destroy_body, RBVERSE_ON_LAYER_DESTROY, 
+		                   sizeof(*event), 0 );
+
+	event->node_id  = node_id;
+	event->layer_id = layer_id;
+}
+
+
+/*
+ * Create the bone described by the g_bone_create event and notify the node's observers.
+ */
+static void *
+rbverse_cb_g_bone_create_body( void *ptr ) {
+	const struct rbverse_g_bone_create_event *event = ptr;
+	struct rbverse_node *geometry;
+	VALUE node, argv[2];
+
+	if ( !(geometry = rbverse_lookup_geometry_node( event->node_id, &node )) ) return NULL;
+	rbverse_geometrynode_bone_create( geometry, event );
+
+	if ( !rbverse_has_observers(node, RBVERSE_ON_BONE_CREATE) ) return NULL;
+
+	argv[0] = node;
+	argv[1] = INT2FIX( event->bone_id );
+
+	rbverse_notify_observers( node, RBVERSE_ON_BONE_CREATE, 2, argv );
+
+	return NULL;
+}
+
+
+/*
+ * Callback for the 'g_bone_create' command.
+ */
+static void
+rbverse_cb_g_bone_create( void *unused, VNodeID node_id, uint16 bone_id, const char *weight,
+                          const char *reference, uint16 parent, real64 pos_x, real64 pos_y, 
+                          real64 pos_z, const char *position_label, const VNQuat64 *rotation, 
+                          const char *rotation_label )
+{
+	static const VNQuat64 identity = { 0.0, 0.0, 0.0, 1.0 };
+	struct rbverse_g_bone_create_event *event =
+		rbverse_event_new( rbverse_cb_g_bone_create_body, RBVERSE_ON_BONE_CREATE, sizeof(*event),
+		                   RBVERSE_EVENT_STRSIZE(weight) + RBVERSE_EVENT_STRSIZE(reference) +
+		                   RBVERSE_EVENT_STRSIZE(position_label) + 
+		                   RBVERSE_EVENT_STRSIZE(rotation_label) );
+
+	event->node_id        = node_id;
+	event->bone_id        = bone_id;
+	event->parent         = parent;
+	event->weight         = rbverse_event_strdup( event, weight );
+	event->reference      = rbverse_event_strdup( event, reference );
+	event->position_label = rbverse_event_strdup( event, position_label );
+	event->rotation_label = rbverse_event_strdup( event, rotation_label );
+	event->position[0]    = pos_x;
+	event->position[1]    = pos_y;
+	event->position[2]    = pos_z;
+	event->rotation       = rotation ? *rotation : identity;
+}
+
+
+/*
+ * Destroy the bone from the g_bone_destroy event and notify the node's observers.
+ */
+static void *
+rbverse_cb_g_bone_destroy_body( void *ptr ) {
+	const struct rbverse_g_bone_destroy_event *event = ptr;
+	struct rbverse_node *geometry;
+	VALUE node, argv[2];
+
+	if ( !(geometry = rbverse_lookup_geometry_node( event->node_id, &node )) ) return NULL;
+	rbverse_geometrynode_bone_destroy( geometry, event->bone_id );
+
+	if ( !rbverse_has_observers(node, RBVERSE_ON_BONE_DESTROY) ) return NULL;
+
+	argv[0] = node;
+	argv[1] = INT2FIX( event->bone_id );
+
+	rbverse_notify_observers( node, RBVERSE_ON_BONE_DESTROY, 2, argv );
+
+	return NULL;
+}
+
+
+/*
+ * Callback for the 'g_bone_destroy' command.
+ */
+static void
+rbverse_cb_g_bone_destroy( void *unused, VNodeID node_id, uint16 bone_id ) {
+	struct rbverse_g_bone_destroy_event *event =
+		rbverse_event_new( rbverse_cb_g_bone_destroy_body, RBVERSE_ON_BONE_DESTROY, 
+		                   sizeof(*event), 0 );
+
+	event->node_id = node_id;
+	event->bone_id = bone_id;
+}
+
+
+/*
+ * Store the values from a vertex or polygon set event in the node's layer.
+ */
+static void *
+rbverse_cb_g_set_body( void *ptr ) {
+	const struct rbverse_g_set_event *event = ptr;
+	struct rbverse_node *geometry;
+	struct rbverse_geometry_layer *layer;
+
+	if ( !(geometry = rbverse_lookup_geometry_node( event->node_id, NULL )) ) return NULL;
+	if ( !(layer = rbverse_geometrynode_layer( geometry, event->layer_id )) ) return NULL;
+
+	rbverse_geometry_layer_set( layer, event );
+
+	return NULL;
+}
+
+
+/*
+ * Queue an event that sets +count+ values of the given +format+ for the vertex or 
+ * polygon at +index+ in a layer. The caller fills in the values.
+ */
+static struct rbverse_g_set_event *
+rbverse_g_set_event_new( VNodeID node_id, VLayerID layer_id, uint32 index, uint8 format, 
+                         uint8 count )
+{
+	struct rbverse_g_set_event *event =
+		rbverse_event_new( rbverse_cb_g_set_body, RBVERSE_EVENT_GEOMETRY_SET, sizeof(*event), 0 );
+
+	event->node_id  = node_id;
+	event->layer_id = layer_id;
+	event->index    = index;
+	event->format   = format;
+	event->count    = count;
+
+	return event;
 }
 
 
+/* Callbacks for the 'g_vertex_*' commands */
+static void
+rbverse_cb_g_vertex_set_xyz_real32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                    uint32 vertex_id, real32 x, real32 y, real32 z )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, vertex_id, RBVERSE_GEOMETRY_REAL32, 3 );
+
+	event->values.real[0] = x;
+	event->values.real[1] = y;
+	event->values.real[2] = z;
+}
+
+static void
+rbverse_cb_g_vertex_set_xyz_real64( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                    uint32 vertex_id, real64 x, real64 y, real64 z )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, vertex_id, RBVERSE_GEOMETRY_REAL64, 3 );
+
+	event->values.real[0] = x;
+	event->values.real[1] = y;
+	event->values.real[2] = z;
+}
+
+static void
+rbverse_cb_g_vertex_delete( void *unused, VNodeID node_id, uint32 vertex_id ) {
+	rbverse_g_set_event_new( node_id, RBVERSE_GEOMETRY_VERTEX_LAYER, vertex_id, 
+	                         RBVERSE_GEOMETRY_DELETE, 0 );
+}
+
+static void
+rbverse_cb_g_vertex_set_uint32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                uint32 vertex_id, uint32 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, vertex_id, RBVERSE_GEOMETRY_UINT32, 1 );
+
+	event->values.uint[0] = value;
+}
+
+static void
+rbverse_cb_g_vertex_set_real64( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                uint32 vertex_id, real64 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, vertex_id, RBVERSE_GEOMETRY_REAL64, 1 );
+
+	event->values.real[0] = value;
+}
+
+static void
+rbverse_cb_g_vertex_set_real32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                uint32 vertex_id, real32 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, vertex_id, RBVERSE_GEOMETRY_REAL32, 1 );
+
+	event->values.real[0] = value;
+}
+
+
+/* Callbacks for the 'g_polygon_*' commands */
+static void
+rbverse_cb_g_polygon_set_corner_uint32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                        uint32 polygon_id, uint32 v0, uint32 v1, uint32 v2, 
+                                        uint32 v3 )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_UINT32, 4 );
+
+	event->values.uint[0] = v0;
+	event->values.uint[1] = v1;
+	event->values.uint[2] = v2;
+	event->values.uint[3] = v3;
+}
+
+static void
+rbverse_cb_g_polygon_set_corner_real64( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                        uint32 polygon_id, real64 v0, real64 v1, real64 v2, 
+                                        real64 v3 )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_REAL64, 4 );
+
+	event->values.real[0] = v0;
+	event->values.real[1] = v1;
+	event->values.real[2] = v2;
+	event->values.real[3] = v3;
+}
+
+static void
+rbverse_cb_g_polygon_set_corner_real32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                        uint32 polygon_id, real32 v0, real32 v1, real32 v2, 
+                                        real32 v3 )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_REAL32, 4 );
+
+	event->values.real[0] = v0;
+	event->values.real[1] = v1;
+	event->values.real[2] = v2;
+	event->values.real[3] = v3;
+}
+
+static void
+rbverse_cb_g_polygon_delete( void *unused, VNodeID node_id, uint32 polygon_id ) {
+	rbverse_g_set_event_new( node_id, RBVERSE_GEOMETRY_POLYGON_LAYER, polygon_id, 
+	                         RBVERSE_GEOMETRY_DELETE, 0 );
+}
+
+static void
+rbverse_cb_g_polygon_set_face_uint8( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                     uint32 polygon_id, uint8 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_UINT32, 1 );
+
+	event->values.uint[0] = value;
+}
+
+static void
+rbverse_cb_g_polygon_set_face_uint32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                      uint32 polygon_id, uint32 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_UINT32, 1 );
+
+	event->values.uint[0] = value;
+}
+
+static void
+rbverse_cb_g_polygon_set_face_real64( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                      uint32 polygon_id, real64 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_REAL64, 1 );
+
+	event->values.real[0] = value;
+}
+
+static void
+rbverse_cb_g_polygon_set_face_real32( void *unused, VNodeID node_id, VLayerID layer_id, 
+                                      uint32 polygon_id, real32 value )
+{
+	struct rbverse_g_set_event *event = 
+		rbverse_g_set_event_new( node_id, layer_id, polygon_id, RBVERSE_GEOMETRY_REAL32, 1 );
+
+	event->values.real[0] = value;
+}
+
+
+
 /*
  * Verse::GeometryNode class
  */
@@ -96,18 +2262,87 @@ void
 rbverse_init_verse_geometrynode( void ) {
 	rbverse_log( "debug", "Initializing Verse::GeometryNode" );
 
+	rbverse_id_node = rb_intern( "node" );
+
+	/* Related modules */
+	rbverse_mVerseGeometryNodeObserver = 
+		rb_define_module_under( rbverse_mVerse, "GeometryNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseGeometryNode = rb_define_class_under( rbverse_mVerse, "GeometryNode", rbverse_cVerseNode );
 
     /* Constants */
 	rb_define_const( rbverse_cVerseGeometryNode, "TYPE_NUMBER", rb_uint2inum(V_NT_GEOMETRY) );
 
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_VERTEX_XYZ", INT2FIX(VN_G_LAYER_VERTEX_XYZ) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_VERTEX_UINT32", INT2FIX(VN_G_LAYER_VERTEX_UINT32) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_VERTEX_REAL", INT2FIX(VN_G_LAYER_VERTEX_REAL) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_POLYGON_CORNER_UINT32",
+	                 INT2FIX(VN_G_LAYER_POLYGON_CORNER_UINT32) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_POLYGON_CORNER_REAL",
+	                 INT2FIX(VN_G_LAYER_POLYGON_CORNER_REAL) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_POLYGON_FACE_UINT8",
+	                 INT2FIX(VN_G_LAYER_POLYGON_FACE_UINT8) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_POLYGON_FACE_UINT32",
+	                 INT2FIX(VN_G_LAYER_POLYGON_FACE_UINT32) );
+	rb_define_const( rbverse_cVerseGeometryNode, "LAYER_POLYGON_FACE_REAL",
+	                 INT2FIX(VN_G_LAYER_POLYGON_FACE_REAL) );
+
 	/* Initializer */
+	rb_define_singleton_method( rbverse_cVerseGeometryNode, "max_elements", 
+	                            rbverse_verse_geometrynode_s_max_elements, 0 );
+	rb_define_singleton_method( rbverse_cVerseGeometryNode, "max_elements=", 
+	                            rbverse_verse_geometrynode_s_max_elements_eq, 1 );
+
 	rb_define_method( rbverse_cVerseGeometryNode, "initialize", rbverse_verse_geometrynode_initialize, 0 );
 
+	/* Public instance methods */
+	rb_define_method( rbverse_cVerseGeometryNode, "layers", rbverse_verse_geometrynode_layers, 0 );
+	rb_define_method( rbverse_cVerseGeometryNode, "layer_data", rbverse_verse_geometrynode_layer_data, 1 );
+#ifdef HAVE_RUBY_IO_BUFFER_H
+	rb_define_method( rbverse_cVerseGeometryNode, "layer_buffer", rbverse_verse_geometrynode_layer_buffer, 1 );
+#endif
+	rb_define_method( rbverse_cVerseGeometryNode, "vertex_count", rbverse_verse_geometrynode_vertex_count, 0 );
+	rb_define_method( rbverse_cVerseGeometryNode, "polygon_count", 
+	                  rbverse_verse_geometrynode_polygon_count, 0 );
+	rb_define_method( rbverse_cVerseGeometryNode, "bounds", rbverse_verse_geometrynode_bounds, 0 );
+	rb_define_method( rbverse_cVerseGeometryNode, "bones", rbverse_verse_geometrynode_bones, 0 );
+	rb_define_method( rbverse_cVerseGeometryNode, "bone_world_matrix", 
+	                  rbverse_verse_geometrynode_bone_world_matrix, 1 );
+	rb_define_method( rbverse_cVerseGeometryNode, "bone_world_matrices", 
+	                  rbverse_verse_geometrynode_bone_world_matrices, 0 );
+
+	rb_define_method( rbverse_cVerseGeometryNode, "set_vertices", rbverse_verse_geometrynode_set_vertices, -1 );
+	rb_define_method( rbverse_cVerseGeometryNode, "set_polygons", rbverse_verse_geometrynode_set_polygons, -1 );
+	rb_define_method( rbverse_cVerseGeometryNode, "sync_vertices", rbverse_verse_geometrynode_sync_vertices, -1 );
+	rb_define_method( rbverse_cVerseGeometryNode, "sync_polygons", rbverse_verse_geometrynode_sync_polygons, -1 );
+	rb_define_method( rbverse_cVerseGeometryNode, "reset_shadow", rbverse_verse_geometrynode_reset_shadow, -1 );
+
 	/* Tell Verse::Node about this subclass */
 	rbverse_nodetype_to_nodeclass[ V_NT_GEOMETRY ] = rbverse_cVerseGeometryNode;
 	node_mark_funcs[ V_NT_GEOMETRY ] = &rbverse_geometrynode_gc_mark;
 	node_free_funcs[ V_NT_GEOMETRY ] = &rbverse_geometrynode_gc_free;
+	node_compact_funcs[ V_NT_GEOMETRY ] = &rbverse_geometrynode_gc_compact;
+	node_memsize_funcs[ V_NT_GEOMETRY ] = &rbverse_geometrynode_gc_memsize;
+
+	RBVERSE_CALLBACK_SET( g_layer_create, rbverse_cb_g_layer_create );
+	RBVERSE_CALLBACK_SET( g_layer_destroy, rbverse_cb_g_layer_destroy );
+	RBVERSE_CALLBACK_SET( g_bone_create, rbverse_cb_g_bone_create );
+	RBVERSE_CALLBACK_SET( g_bone_destroy, rbverse_cb_g_bone_destroy );
+	RBVERSE_CALLBACK_SET( g_vertex_set_xyz_real32, rbverse_cb_g_vertex_set_xyz_real32 );
+	RBVERSE_CALLBACK_SET( g_vertex_set_xyz_real64, rbverse_cb_g_vertex_set_xyz_real64 );
+	RBVERSE_CALLBACK_SET( g_vertex_delete_real32, rbverse_cb_g_vertex_delete );
+	RBVERSE_CALLBACK_SET( g_vertex_delete_real64, rbverse_cb_g_vertex_delete );
+	RBVERSE_CALLBACK_SET( g_vertex_set_uint32, rbverse_cb_g_vertex_set_uint32 );
+	RBVERSE_CALLBACK_SET( g_vertex_set_real64, rbverse_cb_g_vertex_set_real64 );
+	RBVERSE_CALLBACK_SET( g_vertex_set_real32, rbverse_cb_g_vertex_set_real32 );
+	RBVERSE_CALLBACK_SET( g_polygon_set_corner_uint32, rbverse_cb_g_polygon_set_corner_uint32 );
+	RBVERSE_CALLBACK_SET( g_polygon_set_corner_real64, rbverse_cb_g_polygon_set_corner_real64 );
+	RBVERSE_CALLBACK_SET( g_polygon_set_corner_real32, rbverse_cb_g_polygon_set_corner_real32 );
+	RBVERSE_CALLBACK_SET( g_polygon_delete, rbverse_cb_g_polygon_delete );
+	RBVERSE_CALLBACK_SET( g_polygon_set_face_uint8, rbverse_cb_g_polygon_set_face_uint8 );
+	RBVERSE_CALLBACK_SET( g_polygon_set_face_uint32, rbverse_cb_g_polygon_set_face_uint32 );
+	RBVERSE_CALLBACK_SET( g_polygon_set_face_real64, rbverse_cb_g_polygon_set_face_real64 );
+	RBVERSE_CALLBACK_SET( g_polygon_set_face_real32, rbverse_cb_g_polygon_set_face_real32 );
 }
 
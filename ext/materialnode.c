@@ -40,6 +40,7 @@
 #include "verse_ext.h"
 
 VALUE rbverse_cVerseMaterialNode;
+VALUE rbverse_mVerseMaterialNodeObserver;
 
 
 /*
@@ -89,6 +90,17 @@ rbverse_verse_materialnode_initialize( VALUE self ) {
 }
 
 
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+RBVERSE_NODE_TRAMPOLINE( 1, m_fragment_destroy, RBVERSE_ON_FRAGMENT_DESTROY, UINT16 )
+
+/* m_fragment_create passes a VMatFrag union that needs a hand-written callback, so it
+ * isn't set yet. */
+
+
 /*
  * Verse::MaterialNode class
  */
@@ -96,6 +108,9 @@ void
 rbverse_init_verse_materialnode( void ) {
 	rbverse_log( "debug", "Initializing Verse::MaterialNode" );
 
+	/* Related modules */
+	rbverse_mVerseMaterialNodeObserver = rb_define_module_under( rbverse_mVerse, "MaterialNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseMaterialNode = rb_define_class_under( rbverse_mVerse, "MaterialNode", rbverse_cVerseNode );
 
@@ -109,5 +124,7 @@ rbverse_init_verse_materialnode( void ) {
 	rbverse_nodetype_to_nodeclass[ V_NT_MATERIAL ] = rbverse_cVerseMaterialNode;
 	node_mark_funcs[ V_NT_MATERIAL ] = &rbverse_materialnode_gc_mark;
 	node_free_funcs[ V_NT_MATERIAL ] = &rbverse_materialnode_gc_free;
+
+	RBVERSE_CALLBACK_SET( m_fragment_destroy, rbverse_cb_m_fragment_destroy );
 }
 
@@ -39,12 +39,291 @@
 
 #include "verse_ext.h"
 
+/* 
+ * Verse::Observable objects keep a dispatch table that has, for each observer
+ * callback, the list of observers that implement it. The table is rebuilt whenever
+ * an observer is added or removed, so notifying observers is just a loop over
+ * the list for the event, with no type-checks or Ruby iteration.
+ */
+
+/* The callbacks that have dispatch tables, the method that's called for each one, and
+ * the mixin an observer must include to be called. */
+static struct {
+	const char *method;
+	VALUE      *mixin;
+	ID         id;
+} rbverse_observer_events[ RBVERSE_OBSERVER_EVENT_COUNT ] = {
+	{ "on_ping",              &rbverse_mVersePingObserver },
+	{ "on_connect_accept",    &rbverse_mVerseSessionObserver },
+	{ "on_connect_terminate", &rbverse_mVerseSessionObserver },
+	{ "on_create_node",       &rbverse_mVerseSessionObserver },
+	{ "on_node_created",      &rbverse_mVerseSessionObserver },
+	{ "on_node_destroy",      &rbverse_mVerseSessionObserver },
+	{ "on_node_name_set",     &rbverse_mVerseNodeObserver },
+	{ "on_tag_group_create",  &rbverse_mVerseNodeObserver },
+	{ "on_tag_group_destroy", &rbverse_mVerseNodeObserver },
+	{ "on_tag_group_subscribe", &rbverse_mVerseNodeObserver },
+	{ "on_tag_group_unsubscribe", &rbverse_mVerseNodeObserver },
+	{ "on_tag_create",        &rbverse_mVerseNodeObserver },
+	{ "on_tag_destroy",       &rbverse_mVerseNodeObserver },
+	{ "on_buffer_create",     &rbverse_mVerseAudioNodeObserver },
+	{ "on_buffer_destroy",    &rbverse_mVerseAudioNodeObserver },
+	{ "on_buffer_subscribe",  &rbverse_mVerseAudioNodeObserver },
+	{ "on_buffer_unsubscribe", &rbverse_mVerseAudioNodeObserver },
+	{ "on_block_clear",       &rbverse_mVerseAudioNodeObserver },
+	{ "on_stream_create",     &rbverse_mVerseAudioNodeObserver },
+	{ "on_stream_destroy",    &rbverse_mVerseAudioNodeObserver },
+	{ "on_stream_subscribe",  &rbverse_mVerseAudioNodeObserver },
+	{ "on_stream_unsubscribe", &rbverse_mVerseAudioNodeObserver },
+	{ "on_layer_create",      &rbverse_mVerseGeometryNodeObserver },
+	{ "on_layer_destroy",     &rbverse_mVerseGeometryNodeObserver },
+	{ "on_bone_create",       &rbverse_mVerseGeometryNodeObserver },
+	{ "on_bone_destroy",      &rbverse_mVerseGeometryNodeObserver },
+	{ "on_transform_subscribe", &rbverse_mVerseObjectNodeObserver },
+	{ "on_transform_unsubscribe", &rbverse_mVerseObjectNodeObserver },
+	{ "on_transform_scale",   &rbverse_mVerseObjectNodeObserver },
+	{ "on_light_set",         &rbverse_mVerseObjectNodeObserver },
+	{ "on_link_set",          &rbverse_mVerseObjectNodeObserver },
+	{ "on_link_destroy",      &rbverse_mVerseObjectNodeObserver },
+	{ "on_method_group_create", &rbverse_mVerseObjectNodeObserver },
+	{ "on_method_group_destroy", &rbverse_mVerseObjectNodeObserver },
+	{ "on_method_group_subscribe", &rbverse_mVerseObjectNodeObserver },
+	{ "on_method_group_unsubscribe", &rbverse_mVerseObjectNodeObserver },
+	{ "on_method_destroy",    &rbverse_mVerseObjectNodeObserver },
+	{ "on_hide",              &rbverse_mVerseObjectNodeObserver },
+	{ "on_fragment_destroy",  &rbverse_mVerseMaterialNodeObserver },
+	{ "on_dimensions_set",    &rbverse_mVerseBitmapNodeObserver },
+	{ "on_bitmap_layer_create", &rbverse_mVerseBitmapNodeObserver },
+	{ "on_bitmap_layer_destroy", &rbverse_mVerseBitmapNodeObserver },
+	{ "on_bitmap_layer_subscribe", &rbverse_mVerseBitmapNodeObserver },
+	{ "on_bitmap_layer_unsubscribe", &rbverse_mVerseBitmapNodeObserver },
+	{ "on_language_set",      &rbverse_mVerseTextNodeObserver },
+	{ "on_text_buffer_create", &rbverse_mVerseTextNodeObserver },
+	{ "on_text_buffer_destroy", &rbverse_mVerseTextNodeObserver },
+	{ "on_text_buffer_subscribe", &rbverse_mVerseTextNodeObserver },
+	{ "on_text_buffer_unsubscribe", &rbverse_mVerseTextNodeObserver },
+	{ "on_text_set",          &rbverse_mVerseTextNodeObserver },
+	{ "on_curve_create",      &rbverse_mVerseCurveNodeObserver },
+	{ "on_curve_destroy",     &rbverse_mVerseCurveNodeObserver },
+	{ "on_curve_subscribe",   &rbverse_mVerseCurveNodeObserver },
+	{ "on_curve_unsubscribe", &rbverse_mVerseCurveNodeObserver },
+	{ "on_key_destroy",       &rbverse_mVerseCurveNodeObserver },
+};
+
+/* The table, one frozen Array (or nil if there are none) of observers per callback. */
+struct rbverse_observer_table {
+	VALUE observers[ RBVERSE_OBSERVER_EVENT_COUNT ];
+};
+
+/* The (hidden) instance variable the table is stored in */
+static ID rbverse_id_observer_table;
+static ID rbverse_id_atobservers;
+
+
+/*
+ * GC Mark function
+ */
+static void
+rbverse_observer_table_gc_mark( void *data ) {
+	struct rbverse_observer_table *ptr = data;
+	int i;
+
+	if ( ptr ) {
+		for ( i = 0; i < RBVERSE_OBSERVER_EVENT_COUNT; i++ )
+			rbverse_gc_mark_movable( ptr->observers[i] );
+	}
+}
+
+
+#ifdef HAVE_RB_GC_LOCATION
+/*
+ * GC Compaction function
+ */
+static void
+rbverse_observer_table_gc_compact( void *data ) {
+	struct rbverse_observer_table *ptr = data;
+	int i;
+
+	for ( i = 0; i < RBVERSE_OBSERVER_EVENT_COUNT; i++ )
+		rbverse_gc_update( ptr->observers[i] );
+}
+#endif
+
+
+/*
+ * GC Free function
+ */
+static void
+rbverse_observer_table_gc_free( void *data ) {
+	struct rbverse_observer_table *ptr = data;
+
+	if ( ptr ) {
+		xfree( ptr );
+		ptr = NULL;
+	}
+}
+
+
+/*
+ * GC Memsize function
+ */
+static size_t
+rbverse_observer_table_gc_memsize( const void *data ) {
+	return data ? sizeof( struct rbverse_observer_table ) : 0;
+}
+
+
+/* Typed data type of observer tables */
+static const rb_data_type_t rbverse_observer_table_data_type = {
+	.wrap_struct_name = "Verse::Observable observer table",
+	.function = {
+		.dmark    = rbverse_observer_table_gc_mark,
+		.dfree    = rbverse_observer_table_gc_free,
+		.dsize    = rbverse_observer_table_gc_memsize,
+#ifdef HAVE_RB_GC_LOCATION
+		.dcompact = rbverse_observer_table_gc_compact,
+#endif
+	},
+};
+
+
+/*
+ * Return the list of observers of +observable+ that implement the callback for +event+,
+ * or Qnil if there aren't any.
+ */
+static VALUE
+rbverse_observer_list( VALUE observable, enum rbverse_observer_event event ) {
+	struct rbverse_observer_table *table;
+	VALUE tableobj;
+
+	if ( NIL_P(observable) ) return Qnil;
+	if ( NIL_P(tableobj = rb_attr_get( observable, rbverse_id_observer_table )) ) return Qnil;
+
+	TypedData_Get_Struct( tableobj, struct rbverse_observer_table,
+	                      &rbverse_observer_table_data_type, table );
+	return table->observers[ event ];
+}
+
+
+/*
+ * Returns non-zero if +observable+ has any observers that implement the callback for 
+ * +event+.
+ */
+int
+rbverse_has_observers( VALUE observable, enum rbverse_observer_event event ) {
+	return !NIL_P( rbverse_observer_list(observable, event) );
+}
+
+
+/*
+ * Notify the observers of +observable+ that implement the callback for +event+, calling
+ * it with the given arguments.
+ */
+void
+rbverse_notify_observers( VALUE observable, enum rbverse_observer_event event, int argc, VALUE *argv ) {
+	VALUE observers;
+	long i;
+
+	/* The list is frozen, and rebuilding the table replaces it rather than modifying it, 
+	 * so it's safe for an observer to add or remove observers while it's being walked. */
+	if ( NIL_P(observers = rbverse_observer_list(observable, event)) ) return;
+
+	rbverse_log( "debug", "Notifying %ld observers via #%s.", RARRAY_LEN(observers),
+	             rbverse_observer_events[event].method );
+
+	if ( RBVERSE_TIMING_ENABLED() ) {
+		for ( i = 0; i < RARRAY_LEN(observers); i++ ) {
+			const VALUE observer = RARRAY_PTR(observers)[i];
+			const uint64_t start = rbverse_usec_now();
+			uint64_t end;
+
+			rb_funcall2( observer, rbverse_observer_events[event].id, argc, argv );
+			end = rbverse_usec_now();
+
+			rbverse_observer_call_record( observer, event, end - start );
+			RBVERSE_TRACE_SPAN( "observer", rbverse_observer_events[event].method, start, end );
+		}
+	} else {
+		for ( i = 0; i < RARRAY_LEN(observers); i++ )
+			rb_funcall2( RARRAY_PTR(observers)[i], rbverse_observer_events[event].id, argc, argv );
+	}
+}
+
+
+/*
+ * Return the name of the observer method that's called for +event+.
+ */
+const char *
+rbverse_observer_event_method( enum rbverse_observer_event event ) {
+	return rbverse_observer_events[ event ].method;
+}
+
+
+/*
+ * call-seq:
+ *    observable.rebuild_observer_table
+ *
+ * Rebuild the table of which observers are interested in which callbacks. This is
+ * called for you when an observer is added or removed.
+ *
+ */
+static VALUE
+rbverse_observable_rebuild_observer_table( VALUE self ) {
+	struct rbverse_observer_table *table = ALLOC( struct rbverse_observer_table );
+	VALUE tableobj = TypedData_Wrap_Struct( 0, &rbverse_observer_table_data_type, table );
+	VALUE observers = rb_attr_get( self, rbverse_id_atobservers );
+	VALUE observer, list;
+	long i;
+	int event;
+
+	for ( event = 0; event < RBVERSE_OBSERVER_EVENT_COUNT; event++ )
+		table->observers[ event ] = Qnil;
+
+	if ( !NIL_P(observers) ) {
+		for ( event = 0; event < RBVERSE_OBSERVER_EVENT_COUNT; event++ ) {
+			list = Qnil;
+
+			for ( i = 0; i < RARRAY_LEN(observers); i++ ) {
+				observer = RARRAY_PTR(observers)[i];
+				if ( !rb_obj_is_kind_of(observer, *rbverse_observer_events[event].mixin) )
+					continue;
+
+				if ( NIL_P(list) ) list = rb_ary_new();
+				rb_ary_push( list, observer );
+			}
+
+			if ( !NIL_P(list) ) table->observers[ event ] = rb_obj_freeze( list );
+		}
+	}
+
+	rb_ivar_set( self, rbverse_id_observer_table, tableobj );
+
+	return self;
+}
+
 
 
 /*
  * Mixins for Verse
  */
 void
-rbverse_init_verse_mixins( void ) {}
+rbverse_init_verse_mixins( void ) {
+	int event;
+
+	rbverse_log( "debug", "Initializing the mixins" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+	rbverse_mVerseObservable = rb_define_module_under( rbverse_mVerse, "Observable" );
+#endif
+
+	rbverse_id_observer_table = rb_intern( "observer_table" );
+	rbverse_id_atobservers = rb_intern( "@observers" );
+
+	for ( event = 0; event < RBVERSE_OBSERVER_EVENT_COUNT; event++ )
+		rbverse_observer_events[ event ].id = rb_intern( rbverse_observer_events[event].method );
 
+	rb_define_protected_method( rbverse_mVerseObservable, "rebuild_observer_table",
+	                            rbverse_observable_rebuild_observer_table, 0 );
+}
 
@@ -0,0 +1,392 @@
+/*
+ * Verse network thread -- servicing the network without the GVL
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+
+#include "verse_ext.h"
+
+/*
+ * Normally the network is only serviced while Ruby is in Verse.update, so anything that
+ * keeps Ruby from calling it (a GC pause, a slow observer) also keeps ACKs and resends
+ * from being sent. When the network thread is running, it calls verse_callback_update() 
+ * continuously for every session without ever touching the GVL, and publishes the events
+ * the callbacks queue for Ruby to dispatch whenever it next calls Verse.update.
+ * 
+ * Since the thread can't look at the Ruby session table, the sessions it updates are
+ * kept in a native registry. Sessions are only removed from it while the session switch 
+ * lock is held, so the thread can safely switch to any session it finds there as long 
+ * as it checks again under that lock whenever the registry has changed.
+ */
+
+/* The registry of connected sessions */
+static VSession *registry_sessions = NULL;
+static long registry_count = 0;
+static long registry_capacity = 0;
+static unsigned long registry_generation = 0;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+#	define RBVERSE_REGISTRY_LOCK()		pthread_mutex_lock( &registry_lock )
+#	define RBVERSE_REGISTRY_UNLOCK()	pthread_mutex_unlock( &registry_lock )
+
+static pthread_t network_thread;
+static volatile int network_thread_running = 0;
+static uint32 network_interval = DEFAULT_NETWORK_INTERVAL;
+#else
+#	define RBVERSE_REGISTRY_LOCK()
+#	define RBVERSE_REGISTRY_UNLOCK()
+#endif
+
+
+/* --------------------------------------------------------------
+ * Session registry
+ * -------------------------------------------------------------- */
+
+/*
+ * Add the session with the given +id+ to the registry of sessions the network thread 
+ * updates.
+ */
+void
+rbverse_network_add_session( VSession id ) {
+	RBVERSE_REGISTRY_LOCK();
+
+	if ( registry_count == registry_capacity ) {
+		registry_capacity = registry_capacity ? registry_capacity * 2 : 16;
+		registry_sessions = realloc( registry_sessions, registry_capacity * sizeof(VSession) );
+		if ( !registry_sessions ) {
+			fprintf( stderr, "Ruby-Verse: out of memory registering a session.\n" );
+			abort();
+		}
+	}
+
+	registry_sessions[ registry_count++ ] = id;
+
+	RBVERSE_REGISTRY_UNLOCK();
+}
+
+
+/*
+ * Remove the session with the given +id+ from the registry. This must be called with the
+ * session switch lock held, and before the session is destroyed.
+ */
+void
+rbverse_network_remove_session( VSession id ) {
+	long i;
+
+	RBVERSE_REGISTRY_LOCK();
+
+	for ( i = 0; i < registry_count; i++ ) {
+		if ( registry_sessions[i] == id ) {
+			registry_sessions[i] = registry_sessions[ --registry_count ];
+			registry_generation++;
+			break;
+		}
+	}
+
+	RBVERSE_REGISTRY_UNLOCK();
+}
+
+
+/*
+ * Returns non-zero if the session with the given +id+ is still in the registry.
+ */
+static int
+rbverse_network_session_registered( VSession id ) {
+	int found = 0;
+	long i;
+
+	RBVERSE_REGISTRY_LOCK();
+	for ( i = 0; i < registry_count && !found; i++ )
+		found = ( registry_sessions[i] == id );
+	RBVERSE_REGISTRY_UNLOCK();
+
+	return found;
+}
+
+
+/*
+ * Returns the registry's generation, which changes whenever a session is removed from 
+ * it. Code that gives up the GVL holding on to session IDs should fetch this first, 
+ * and check them with rbverse_network_session_valid() before switching to them.
+ */
+unsigned long
+rbverse_network_generation( void ) {
+	unsigned long generation;
+
+	RBVERSE_REGISTRY_LOCK();
+	generation = registry_generation;
+	RBVERSE_REGISTRY_UNLOCK();
+
+	return generation;
+}
+
+
+/*
+ * Returns non-zero if it's safe to switch to the session with the given +id+, which 
+ * was fetched when the registry was at the given +generation+, i.e., it's the global 
+ * session or it hasn't been destroyed since. This must be called with the session 
+ * switch lock held, and the session is only guaranteed to stay valid until it's 
+ * released.
+ */
+int
+rbverse_network_session_valid( VSession id, unsigned long generation ) {
+	if ( !id || generation == rbverse_network_generation() ) return 1;
+	return rbverse_network_session_registered( id );
+}
+
+
+#ifdef HAVE_PTHREAD_H
+
+/* --------------------------------------------------------------
+ * The network thread
+ * -------------------------------------------------------------- */
+
+/*
+ * Update the global session and every registered session once, splitting the
+ * network interval between them. +snapshot+ is a buffer for the thread's copy of the 
+ * registry, which is grown as necessary.
+ */
+static void
+rbverse_network_update( VSession **snapshot, long *snapshot_capacity ) {
+	unsigned long generation;
+	long count, i;
+	uint32 slice;
+	uint64_t start;
+	VSession id;
+
+	RBVERSE_REGISTRY_LOCK();
+	if ( registry_count > *snapshot_capacity ) {
+		*snapshot_capacity = registry_capacity;
+		*snapshot = realloc( *snapshot, *snapshot_capacity * sizeof(VSession) );
+		if ( !*snapshot ) {
+			fprintf( stderr, "Ruby-Verse: out of memory in the network thread.\n" );
+			abort();
+		}
+	}
+	count = registry_count;
+	memcpy( *snapshot, registry_sessions, count * sizeof(VSession) );
+	generation = registry_generation;
+	RBVERSE_REGISTRY_UNLOCK();
+
+	slice = network_interval / ( count + 1 );
+
+	for ( i = -1; i < count; i++ ) {
+		id = ( i < 0 ? NULL : (*snapshot)[i] );
+
+		rbverse_session_switch_lock_nogvl();
+
+		/* Skip sessions that were removed since the snapshot was taken */
+		if ( !rbverse_network_session_valid(id, generation) ) {
+			rbverse_session_switch_unlock();
+			rbverse_session_switch_yield( RBVERSE_SWITCH_YIELD_TIMEOUT );
+			continue;
+		}
+
+		verse_session_set( id );
+		if ( rbverse_trace_enabled ) {
+			start = rbverse_usec_now();
+			verse_callback_update( slice );
+			RBVERSE_TRACE_SPAN( "network", "verse_callback_update", start, rbverse_usec_now() );
+		} else {
+			verse_callback_update( slice );
+		}
+		rbverse_event_publish();
+		rbverse_session_switch_unlock();
+		rbverse_session_switch_yield( RBVERSE_SWITCH_YIELD_TIMEOUT );
+	}
+}
+
+
+/*
+ * The network thread's main loop.
+ */
+static void *
+rbverse_network_thread_main( void *unused ) {
+	VSession *snapshot = NULL;
+	long snapshot_capacity = 0;
+
+	rbverse_trace_set_thread_name( "Verse network thread" );
+
+	while ( network_thread_running )
+		rbverse_network_update( &snapshot, &snapshot_capacity );
+
+	free( snapshot );
+	return NULL;
+}
+
+
+/*
+ * Wait for the network thread to finish without the GVL.
+ */
+static VALUE
+rbverse_network_thread_join( void *unused ) {
+	pthread_join( network_thread, NULL );
+	return Qnil;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * Returns non-zero if the network thread is running.
+ */
+int
+rbverse_network_thread_running( void ) {
+#ifdef HAVE_PTHREAD_H
+	return network_thread_running;
+#else
+	return 0;
+#endif
+}
+
+
+
+/* --------------------------------------------------------------
+ * Module methods
+ * -------------------------------------------------------------- */
+
+/*
+ * call-seq:
+ *    Verse.start_network_thread( interval=0.01 )   -> true
+ *
+ * Start a native thread that services the network continuously, without needing
+ * the GVL, so packets keep flowing even while Ruby is busy. The thread spends about 
+ * +interval+ seconds on each pass over the sessions, split between them. Commands 
+ * that are sent while it's waiting on a session wait for that session's share of the
+ * interval to finish; the thread then lets them go ahead before it moves on to the 
+ * next session.
+ * 
+ * While the thread is running, Verse.update doesn't read the network itself; it
+ * waits for up to its +timeout+ for the thread to receive something, then dispatches
+ * everything that's been received to the observers.
+ * 
+ * @param [Float] interval  the time (in decimal seconds) per pass over the sessions;
+ *                          must be greater than 0 and no more than 10 seconds
+ * @raise [ArgumentError]  if the +interval+ is out of range
+ * @raise [Verse::Error]  if the thread is already running
+ * @raise [NotImplementedError]  if the extension was built without pthreads
+ */
+static VALUE
+rbverse_verse_s_start_network_thread( int argc, VALUE *argv, VALUE module ) {
+#ifdef HAVE_PTHREAD_H
+	VALUE interval = Qnil;
+	double seconds;
+	int err;
+
+	if ( network_thread_running )
+		rb_raise( rbverse_eVerseError, "the network thread is already running" );
+
+	if ( rb_scan_args(argc, argv, "01", &interval) == 1 ) {
+		seconds = NUM2DBL( interval );
+		if ( !(seconds * 1000000 >= 1) || seconds > MAX_NETWORK_INTERVAL )
+			rb_raise( rb_eArgError, "network thread interval must be between 1 µs and %d seconds",
+			          MAX_NETWORK_INTERVAL );
+		network_interval = floor( seconds * 1000000 );
+	} else {
+		network_interval = DEFAULT_NETWORK_INTERVAL;
+	}
+
+	rbverse_log( "info", "Starting the network thread (%u µs interval).", network_interval );
+	network_thread_running = 1;
+	if ( (err = pthread_create(&network_thread, NULL, rbverse_network_thread_main, NULL)) ) {
+		network_thread_running = 0;
+		rb_raise( rbverse_eVerseError, "couldn't start the network thread: %s", strerror(err) );
+	}
+
+	return Qtrue;
+#else
+	rb_notimplement();
+	return Qnil;
+#endif
+}
+
+
+/*
+ * call-seq:
+ *    Verse.stop_network_thread   -> true or false
+ *
+ * Stop the network thread, waiting for it to finish its current pass. Returns +false+
+ * if it wasn't running.
+ */
+static VALUE
+rbverse_verse_s_stop_network_thread( VALUE module ) {
+#ifdef HAVE_PTHREAD_H
+	if ( !network_thread_running ) return Qfalse;
+
+	rbverse_log( "info", "Stopping the network thread." );
+	network_thread_running = 0;
+	rb_thread_blocking_region( rbverse_network_thread_join, NULL, RUBY_UBF_IO, NULL );
+
+	return Qtrue;
+#else
+	return Qfalse;
+#endif
+}
+
+
+/*
+ * call-seq:
+ *    Verse.network_thread_running?   -> true or false
+ *
+ * Returns +true+ if the network thread is running.
+ */
+static VALUE
+rbverse_verse_s_network_thread_running_p( VALUE module ) {
+	return rbverse_network_thread_running() ? Qtrue : Qfalse;
+}
+
+
+/*
+ * Verse network thread
+ */
+void
+rbverse_init_verse_network( void ) {
+	rbverse_log( "debug", "Initializing the network thread" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+#endif
+
+	rb_define_singleton_method( rbverse_mVerse, "start_network_thread",
+	                            rbverse_verse_s_start_network_thread, -1 );
+	rb_define_singleton_method( rbverse_mVerse, "stop_network_thread",
+	                            rbverse_verse_s_stop_network_thread, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "network_thread_running?",
+	                            rbverse_verse_s_network_thread_running_p, 0 );
+}
+
@@ -45,19 +45,35 @@ VALUE rbverse_mVerseNodeObserver;
 /* Mapping of V_NT_* enum to the equivalent Verse::Node subclass */
 VALUE rbverse_nodetype_to_nodeclass[ V_NT_NUM_TYPES ];
 
-/* Mapping of VNodeID -> Verse::Node VALUE */
-static st_table *node_map;
-
-/* Vtables for mark and free functions for child types. These are
+/* Vtables for mark, free, compact, and memsize functions for child types. These are
  * populated by the initializers for each of the child types. */
 void ( *node_mark_funcs[V_NT_NUM_TYPES] )(struct rbverse_node *) = {};
 void ( *node_free_funcs[V_NT_NUM_TYPES] )(struct rbverse_node *) = {};
+void ( *node_compact_funcs[V_NT_NUM_TYPES] )(struct rbverse_node *) = {};
+size_t ( *node_memsize_funcs[V_NT_NUM_TYPES] )(const struct rbverse_node *) = {};
+
+/* Pools that node structs are allocated from, one per node type with room for just 
+ * that type's payload, plus one for nodes of any other type. */
+static struct rbverse_pool rbverse_node_pools[ V_NT_NUM_TYPES + 1 ];
 
 /* Structs for passing callback data back into Ruby */
 struct rbverse_node_name_set_event {
 	VNodeID node_id;
 	const char *name;
 };
+struct rbverse_tag_group_create_event {
+	VNodeID    node_id;
+	uint16     group_id;
+	const char *name;
+};
+struct rbverse_tag_create_event {
+	VNodeID    node_id;
+	uint16     group_id;
+	uint16     tag_id;
+	const char *name;
+	VNTagType  type;
+	VNTag      tag;
+};
 
 
 /* --------------------------------------------------
@@ -65,20 +81,37 @@ struct rbverse_node_name_set_event {
  * -------------------------------------------------- */
 
 /*
- * Allocation function
+ * Return the pool that nodes of the given +type+ are allocated from.
+ */
+static inline struct rbverse_pool *
+rbverse_node_pool( VNodeType type ) {
+	return &rbverse_node_pools[ type < V_NT_NUM_TYPES ? type : V_NT_NUM_TYPES ];
+}
+
+
+/*
+ * Allocation function. The struct is allocated from the pool for the +type+ of node 
+ * it'll be used for.
  */
 static struct rbverse_node *
-rbverse_node_alloc( void ) {
-	struct rbverse_node *ptr = ALLOC( struct rbverse_node );
+rbverse_node_alloc( VNodeType type ) {
+	struct rbverse_pool *pool = rbverse_node_pool( type );
+	struct rbverse_node *ptr = rbverse_pool_alloc( pool );
+
+	/* Clear the payload so it's safe to mark before the subclass has initialized it */
+	memset( ptr, 0, pool->size );
 
 	ptr->id         = ~0;
-	ptr->type       = V_NT_SYSTEM;
+	ptr->type       = type;
 	ptr->owner      = VN_OWNER_OTHER;
 	ptr->name       = Qnil;
-	ptr->tag_groups = rb_ary_new();
+	ptr->tag_groups = Qnil;
 	ptr->session    = Qnil;
+	ptr->destroyed  = FALSE;
+	ptr->wrapper    = Qnil;
+	ptr->record     = NULL;
 
-	DEBUGMSG( "allocated a rbverse_SESSION <%p>", ptr );
+	DEBUGMSG( "allocated a rbverse_NODE <%p>", ptr );
 	return ptr;
 }
 
@@ -87,14 +120,16 @@ rbverse_node_alloc( void ) {
  * GC Mark function
  */
 static void
-rbverse_node_gc_mark( struct rbverse_node *ptr ) {
+rbverse_node_gc_mark( void *data ) {
+	struct rbverse_node *ptr = data;
+
 	if ( ptr ) {
-		rb_gc_mark( ptr->name );
-		rb_gc_mark( ptr->tag_groups );
-		rb_gc_mark( ptr->session );
+		rbverse_gc_mark_movable( ptr->name );
+		rbverse_gc_mark_movable( ptr->tag_groups );
+		rbverse_gc_mark_movable( ptr->session );
 
 		/* Call the node-specific mark function if there is one */
-		if ( node_mark_funcs[ptr->type] ) {
+		if ( ptr->type < V_NT_NUM_TYPES && node_mark_funcs[ptr->type] ) {
 			DEBUGMSG( "  mark function 0x%p for node type %d",
 			        node_mark_funcs[ptr->type], ptr->type );
 			node_mark_funcs[ptr->type]( ptr );
@@ -103,28 +138,54 @@ rbverse_node_gc_mark( struct rbverse_node *ptr ) {
 }
 
 
+#ifdef HAVE_RB_GC_LOCATION
+/*
+ * GC Compaction function. The wrapper isn't marked by the node, but it's the node's
+ * own object, so it has to be updated if that moves.
+ */
+static void
+rbverse_node_gc_compact( void *data ) {
+	struct rbverse_node *ptr = data;
+
+	rbverse_gc_update( ptr->name );
+	rbverse_gc_update( ptr->tag_groups );
+	rbverse_gc_update( ptr->session );
+	rbverse_gc_update( ptr->wrapper );
+
+	/* Call the node-specific compaction function if there is one */
+	if ( ptr->type < V_NT_NUM_TYPES && node_compact_funcs[ptr->type] )
+		node_compact_funcs[ptr->type]( ptr );
+}
+#endif
+
 
 /*
  * GC Free function
  */
 static void
-rbverse_node_gc_free( struct rbverse_node *ptr ) {
+rbverse_node_gc_free( void *data ) {
+	struct rbverse_node *ptr = data;
+	struct rbverse_pool *pool;
+
 	if ( ptr ) {
 		DEBUGMSG( "Freeing node 0x%p", ptr );
+		if ( rbverse_stats_enabled ) rbverse_stats.nodes_freed++;
+		RBVERSE_PROBE_NODE_FREE( ptr->id, ptr->type, ptr );
 
-		if ( ptr->id != ~0 ) {
-			DEBUGMSG( "  removing node ID %d from node map", ptr->id );
-			st_delete_safe( node_map, (st_data_t*)&ptr->id, 0, Qundef );
-			/* TODO: Do I need to do st_cleanup or anything after deletion? */
+		if ( ptr->record ) {
+			DEBUGMSG( "  detaching node ID %d from its record", ptr->id );
+			rbverse_node_record_detach( ptr->record );
 		}
 
 		/* Call the node-specific free function if there is one */
-		if ( ptr->type < V_NT_NUM_TYPES ) {
+		if ( ptr->type < V_NT_NUM_TYPES && node_free_funcs[ptr->type] ) {
 			DEBUGMSG( "  free function %p for node type %d",
 			        node_free_funcs[ptr->type], ptr->type );
 			node_free_funcs[ptr->type]( ptr );
 		}
 
+		pool = rbverse_node_pool( ptr->type );
+
 		DEBUGMSG( "  clearing struct." );
 		ptr->id         = ~0;
 		ptr->type       = V_NT_SYSTEM;
@@ -132,8 +193,9 @@ rbverse_node_gc_free( struct rbverse_node *ptr ) {
 		ptr->name       = Qnil;
 		ptr->tag_groups = Qnil;
 		ptr->session    = Qnil;
+		ptr->wrapper    = Qnil;
 
-		xfree( ptr );
+		rbverse_pool_free( pool, ptr );
 		ptr = NULL;
 
 		DEBUGMSG( "  done." );
@@ -141,19 +203,70 @@ rbverse_node_gc_free( struct rbverse_node *ptr ) {
 }
 
 
+/*
+ * GC Memsize function
+ */
+static size_t
+rbverse_node_gc_memsize( const void *data ) {
+	const struct rbverse_node *ptr = data;
+	size_t size;
+
+	if ( !ptr ) return 0;
+	size = rbverse_node_pool( ptr->type )->size;
+
+	/* Add the node-specific size if there is one */
+	if ( ptr->type < V_NT_NUM_TYPES && node_memsize_funcs[ptr->type] )
+		size += node_memsize_funcs[ptr->type]( ptr );
+
+	return size;
+}
+
+
+#ifdef HAVE_RB_GC_LOCATION
+#	define RBVERSE_NODE_DATA_FUNCTIONS { \
+		.dmark    = rbverse_node_gc_mark, \
+		.dfree    = rbverse_node_gc_free, \
+		.dsize    = rbverse_node_gc_memsize, \
+		.dcompact = rbverse_node_gc_compact, \
+	}
+#else
+#	define RBVERSE_NODE_DATA_FUNCTIONS { \
+		.dmark    = rbverse_node_gc_mark, \
+		.dfree    = rbverse_node_gc_free, \
+		.dsize    = rbverse_node_gc_memsize, \
+	}
+#endif
+
+#define RBVERSE_NODE_DATA_TYPE( name ) { \
+		.wrap_struct_name = (name), \
+		.function = RBVERSE_NODE_DATA_FUNCTIONS, \
+		.parent = &rbverse_node_data_type, \
+	}
+
+/* Typed data type of Verse::Node objects whose type isn't known */
+const rb_data_type_t rbverse_node_data_type = {
+	.wrap_struct_name = "Verse::Node",
+	.function = RBVERSE_NODE_DATA_FUNCTIONS,
+};
+
+/* Typed data types of each type of node, indexed by V_NT_* */
+const rb_data_type_t rbverse_node_data_types[ V_NT_NUM_TYPES ] = {
+	[V_NT_OBJECT]   = RBVERSE_NODE_DATA_TYPE( "Verse::ObjectNode" ),
+	[V_NT_GEOMETRY] = RBVERSE_NODE_DATA_TYPE( "Verse::GeometryNode" ),
+	[V_NT_MATERIAL] = RBVERSE_NODE_DATA_TYPE( "Verse::MaterialNode" ),
+	[V_NT_BITMAP]   = RBVERSE_NODE_DATA_TYPE( "Verse::BitmapNode" ),
+	[V_NT_TEXT]     = RBVERSE_NODE_DATA_TYPE( "Verse::TextNode" ),
+	[V_NT_CURVE]    = RBVERSE_NODE_DATA_TYPE( "Verse::CurveNode" ),
+	[V_NT_AUDIO]    = RBVERSE_NODE_DATA_TYPE( "Verse::AudioNode" ),
+};
+
+
 /*
  * Object validity checker. Returns the data pointer.
  */
 static struct rbverse_node *
 rbverse_check_node( VALUE self ) {
-	Check_Type( self, T_DATA );
-
-    if ( !IsNode(self) ) {
-		rb_raise( rb_eTypeError, "wrong argument type %s (expected Verse::Node)",
-				  rb_obj_classname(self) );
-    }
-
-	return DATA_PTR( self );
+	return rb_check_typeddata( self, &rbverse_node_data_type );
 }
 
 
@@ -184,44 +297,75 @@ rbverse_node_class_from_node_type( VNodeType node_type ) {
 
 
 /*
- * Create a Verse::Node subclass from a VNodeID and a VNodeType.
+ * Return the Verse::Node object for the node described by the given +record+ from the
+ * specified +session+'s node table, creating it if it hasn't been already.
  */
 VALUE
-rbverse_wrap_verse_node( VNodeID node_id, VNodeType node_type, VNodeOwner owner ) {
-	VALUE node_class = rbverse_nodetype_to_nodeclass[ node_type ];
+rbverse_wrap_verse_node( VALUE session, struct rbverse_node_record *record ) {
+	VALUE node_class = rbverse_node_class_from_node_type( record->type );
 	VALUE node = Qnil;
 	struct rbverse_node *ptr = NULL;
 
+	if ( record->node ) return record->node->wrapper;
+	if ( NIL_P(node_class) )
+		rb_raise( rbverse_eVerseNodeError, "unknown node type %d", record->type );
+
 	rbverse_log( "debug", "Wrapping a %s object around node %x",
-	             rb_class2name(node_class), node_id );
+	             rb_class2name(node_class), record->id );
 	node = rb_class_new_instance( 0, NULL, node_class );
 	ptr = rbverse_get_node( node );
 
-	if ( ptr->type != node_type )
+	if ( ptr->type != record->type )
 		rb_fatal( "Ack! Expected a type %d node, but got a %d node instead!",
-		          node_type, ptr->type );
+		          record->type, ptr->type );
 
-	ptr->id    = node_id;
-	ptr->owner = owner;
+	ptr->id      = record->id;
+	ptr->owner   = record->owner;
+	ptr->session = session;
+	if ( record->name ) ptr->name = rb_str_new2( record->name );
 
-	/* TODO: This should maybe be factored up into Verse::Node#id= or something. */
-	st_insert( node_map, (st_data_t)node_id, (st_data_t)node );
+	rbverse_node_record_attach( record, ptr );
+	if ( rbverse_stats_enabled ) rbverse_stats.nodes_wrapped++;
+	RBVERSE_PROBE_NODE_WRAP( ptr->id, ptr->type, ptr );
 
 	return node;
 }
 
 
 /*
- * Look up an already-wrapped Verse::Node object by its VNodeID.
+ * Look up the Verse::Node object for the node with the given VNodeID that the given 
+ * +session+ knows about, creating it if necessary. Returns Qnil if the session doesn't 
+ * know about the node.
  */
 VALUE
-rbverse_lookup_verse_node( VNodeID node_id ) {
-	VALUE node = Qnil;
+rbverse_lookup_verse_node( VALUE session, VNodeID node_id ) {
+	struct rbverse_node_record *record;
 
-	if ( !st_lookup(node_map, (st_data_t)node_id, (st_data_t *)&node) )
+	if ( NIL_P(session) ) return Qnil;
+	if ( !(record = rbverse_node_table_lookup(&rbverse_get_session(session)->nodes, node_id)) )
 		return Qnil;
 
-	return node;
+	return rbverse_wrap_verse_node( session, record );
+}
+
+
+/*
+ * Return the Verse::Node object for the node with the given +node_id+ in the current 
+ * session if one has been created, or Qnil if it hasn't. Unlike 
+ * rbverse_lookup_verse_node(), this never creates the object, so it's used by callbacks 
+ * that only need to notify a node's observers (a node that hasn't been wrapped can't 
+ * have any).
+ */
+VALUE
+rbverse_lookup_wrapped_node( VNodeID node_id ) {
+	const VALUE session = rbverse_get_current_session();
+	struct rbverse_node_record *record;
+
+	if ( NIL_P(session) ) return Qnil;
+	if ( !(record = rbverse_node_table_lookup(&rbverse_get_session(session)->nodes, node_id)) )
+		return Qnil;
+
+	return record->node ? record->node->wrapper : Qnil;
 }
 
 
@@ -246,11 +390,21 @@ rbverse_mark_node_destroyed( VALUE nodeobj ) {
  * call-seq:
  *    Verse::Node.allocate   -> node
  * 
- * Allocate a new Verse::Node object.
+ * Allocate a new Verse::Node object. The object is given the typed data type of the 
+ * type of node its class is for, so the node's type can be checked without searching 
+ * its ancestors.
  */
 static VALUE
 rbverse_verse_node_s_allocate( VALUE klass ) {
-	return Data_Wrap_Struct( klass, rbverse_node_gc_mark, rbverse_node_gc_free, 0 );
+	VNodeType type;
+
+	for ( type = 0; type < V_NT_NUM_TYPES; type++ ) {
+		if ( RTEST(rbverse_nodetype_to_nodeclass[type]) &&
+		     RTEST(rb_class_inherited_p(klass, rbverse_nodetype_to_nodeclass[type])) )
+			return TypedData_Wrap_Struct( klass, &rbverse_node_data_types[type], 0 );
+	}
+
+	return TypedData_Wrap_Struct( klass, &rbverse_node_data_type, 0 );
 }
 
 
@@ -272,8 +426,17 @@ rbverse_verse_node_initialize( VALUE self ) {
 		rb_raise( rb_eTypeError, "can't instantiate %s directly", rb_obj_classname(self) );
 
 	if ( !rbverse_check_node(self) ) {
+		const rb_data_type_t *datatype = RTYPEDDATA_TYPE( self );
 		struct rbverse_node *node;
-		DATA_PTR( self ) = node = rbverse_node_alloc();
+		VNodeType type = V_NT_SYSTEM;
+
+		/* The object's data type says which type of node it is, so it's allocated at the 
+		 * right size */
+		if ( datatype != &rbverse_node_data_type )
+			type = (VNodeType)( datatype - rbverse_node_data_types );
+
+		RTYPEDDATA_DATA( self ) = node = rbverse_node_alloc( type );
+		node->wrapper = self;
 		rb_call_super( 0, NULL );
 	} else {
 		rb_raise( rb_eRuntimeError,
@@ -284,6 +447,16 @@ rbverse_verse_node_initialize( VALUE self ) {
 }
 
 
+/*
+ * Session-locked section of rbverse_verse_node_add_observer().
+ */
+static VALUE
+rbverse_verse_node_add_observer_l( VALUE nodeid ) {
+	verse_send_node_subscribe( (VNodeID)nodeid );
+	return Qtrue;
+}
+
+
 /*
  * call-seq:
  *    node.add_observer( observer )
@@ -295,7 +468,8 @@ static VALUE
 rbverse_verse_node_add_observer( VALUE self, VALUE observer ) {
 	struct rbverse_node *node = rbverse_get_node( self );
 
-	verse_send_node_subscribe( node->id );
+	if ( RTEST(node->session) )
+		rbverse_with_session_lock( node->session, rbverse_verse_node_add_observer_l, (VALUE)node->id );
 
 	return rb_call_super( 1, &observer );
 }
@@ -435,37 +609,36 @@ rbverse_verse_node_session_eq( VALUE self, VALUE session ) {
  * Callbacks
  * -------------------------------------------------------------- */
 
-/*
- * Iterator body for node_name_set observers.
- */
-static VALUE
-rbverse_node_cb_name_set_i( VALUE observer, VALUE cb_args, int argc, VALUE *argv ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVerseNodeObserver) )
-		return Qnil;
-
-	rbverse_log( "debug", "Node_name_set callback: notifying observer: %s.",
-	             RSTRING_PTR(rb_inspect( observer )) );
-	return rb_funcall2( observer, rb_intern("on_node_name_set"), RARRAY_LEN(cb_args),
-	                    RARRAY_PTR(cb_args) );
-}
-
-
 /*
  * Call the node_name_set handler after aqcuiring the GVL.
  */
 static void *
 rbverse_node_cb_name_set_body( void *ptr ) {
 	struct rbverse_node_name_set_event *event = (struct rbverse_node_name_set_event *)ptr;
-	const VALUE node = rbverse_lookup_verse_node( event->node_id );
-	VALUE name = rb_str_new2( event->name );
-	VALUE observers, cb_args;
+	const VALUE session = rbverse_get_current_session();
+	struct rbverse_node_record *record = NULL;
+	VALUE cb_args[2];
+
+	if ( !NIL_P(session) )
+		record = rbverse_node_table_lookup( &rbverse_get_session(session)->nodes, event->node_id );
+
+	if ( record ) {
+		rbverse_node_record_set_name( record, event->name );
+
+		/* Nodes held by the session's node filter have been waiting for their name. Only
+		 * nodes that have been wrapped can have observers. */
+		if ( record->flags & RBVERSE_NODE_RECORD_PENDING ) {
+			rbverse_session_filter_node_name( session, record );
+		} else if ( record->node ) {
+			const VALUE node = record->node->wrapper;
 
-	if ( RTEST(node) ) {
-		cb_args = rb_ary_new3( 2, node, name );
-		rbverse_log_with_context( node, "info", "Got node name '%s'.", event->name );
+			record->node->name = rb_str_new2( event->name );
+			cb_args[0] = node;
+			cb_args[1] = rb_str_new2( event->name );
+			rbverse_log_with_context( node, "info", "Got node name '%s'.", event->name );
 
-		observers = rb_funcall( node, rb_intern("observers"), 0 );
-		rb_block_call( observers, rb_intern("each"), 0, 0, rbverse_node_cb_name_set_i, cb_args );
+			rbverse_notify_observers( node, RBVERSE_ON_NODE_NAME_SET, 2, cb_args );
+		}
 
 	} else {
 		rbverse_log( "info", "Got node name for a node we haven't loaded (%d)", event->node_id );
@@ -480,35 +653,182 @@ rbverse_node_cb_name_set_body( void *ptr ) {
  */
 static void
 rbverse_node_cb_name_set( void *unused, VNodeID node_id, const char *name ) {
-	struct rbverse_node_name_set_event event;
+	struct rbverse_node_name_set_event *event;
+
+	DEBUGMSG( " Queueing 'node_name_set' event.\n" );
+	event = rbverse_event_new( rbverse_node_cb_name_set_body, RBVERSE_ON_NODE_NAME_SET,
+		sizeof(struct rbverse_node_name_set_event), RBVERSE_EVENT_STRSIZE(name) );
+
+	event->node_id = node_id;
+	event->name    = rbverse_event_strdup( event, name );
+}
 
-	event.node_id = node_id;
-	event.name = name;
 
-	DEBUGMSG( " Acquiring GVL for 'node_name_set' event.\n" );
-	fflush( stdout );
+/*
+ * Return the record of the node with the specified +node_id+ in the current session if 
+ * it's being held by the session's node filter, or NULL if it isn't.
+ */
+static struct rbverse_node_record *
+rbverse_lookup_pending_node( VNodeID node_id ) {
+	const VALUE session = rbverse_get_current_session();
+	struct rbverse_node_record *record;
+
+	if ( NIL_P(session) ) return NULL;
+	if ( !(record = rbverse_node_table_lookup(&rbverse_get_session(session)->nodes, node_id)) )
+		return NULL;
 
-	rb_thread_call_with_gvl( rbverse_node_cb_name_set_body, (void *)&event );
+	return ( record->flags & RBVERSE_NODE_RECORD_PENDING ) ? record : NULL;
 }
 
 
-// static void
-// rbverse_node_cb_tag_group_create( void *unused ) {}
-// 
-// static void
-// rbverse_node_cb_tag_group_destroy( void *unused ) {}
-// 
-// static void
-// rbverse_node_cb_tag_group_subscribe( void *unused ) {}
-// 
-// static void
-// rbverse_node_cb_tag_group_unsubscribe( void *unused ) {}
-// 
-// static void
-// rbverse_node_cb_tag_create( void *unused ) {}
-// 
-// static void
-// rbverse_node_cb_tag_destroy( void *unused ) {}
+/*
+ * Call the tag_group_create handler after acquiring the GVL. This can't use a trampoline,
+ * as the session's node filter may be waiting on the group.
+ */
+static void *
+rbverse_cb_tag_group_create_body( void *ptr ) {
+	struct rbverse_tag_group_create_event *event = (struct rbverse_tag_group_create_event *)ptr;
+	struct rbverse_node_record *record = rbverse_lookup_pending_node( event->node_id );
+	VALUE node, cb_args[3];
+
+	if ( record ) {
+		rbverse_session_filter_tag_group( rbverse_get_current_session(), record,
+		                                  event->group_id, event->name );
+		return NULL;
+	}
+
+	node = rbverse_lookup_wrapped_node( event->node_id );
+	if ( !rbverse_has_observers(node, RBVERSE_ON_TAG_GROUP_CREATE) ) return NULL;
+
+	cb_args[0] = node;
+	cb_args[1] = INT2FIX( event->group_id );
+	cb_args[2] = event->name ? rb_str_new2( event->name ) : Qnil;
+
+	rbverse_notify_observers( node, RBVERSE_ON_TAG_GROUP_CREATE, 3, cb_args );
+
+	return NULL;
+}
+
+
+/*
+ * Callback for the 'tag_group_create' command.
+ */
+static void
+rbverse_cb_tag_group_create( void *unused, VNodeID node_id, uint16 group_id, const char *name ) {
+	struct rbverse_tag_group_create_event *event;
+
+	event = rbverse_event_new( rbverse_cb_tag_group_create_body, RBVERSE_ON_TAG_GROUP_CREATE,
+		sizeof(struct rbverse_tag_group_create_event), RBVERSE_EVENT_STRSIZE(name) );
+
+	event->node_id  = node_id;
+	event->group_id = group_id;
+	event->name     = rbverse_event_strdup( event, name );
+}
+
+
+/* Callbacks for the other tag group commands, and for 'tag_destroy' */
+RBVERSE_NODE_TRAMPOLINE( 1, tag_group_destroy, RBVERSE_ON_TAG_GROUP_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, tag_group_subscribe, RBVERSE_ON_TAG_GROUP_SUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, tag_group_unsubscribe, RBVERSE_ON_TAG_GROUP_UNSUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 2, tag_destroy, RBVERSE_ON_TAG_DESTROY, UINT16, UINT16 )
+
+
+/*
+ * Return the Ruby equivalent of the given +tag+ value of the specified +type+.
+ */
+static VALUE
+rbverse_tag2value( VNTagType type, const VNTag *tag ) {
+	switch ( type ) {
+	  case VN_TAG_BOOLEAN:
+		return tag->vboolean ? Qtrue : Qfalse;
+	  case VN_TAG_UINT32:
+		return UINT2NUM( tag->vuint32 );
+	  case VN_TAG_REAL64:
+		return rb_float_new( tag->vreal64 );
+	  case VN_TAG_STRING:
+		return tag->vstring ? rb_str_new2( tag->vstring ) : Qnil;
+	  case VN_TAG_REAL64_VEC3:
+		return rb_ary_new3( 3, rb_float_new(tag->vreal64_vec3[0]),
+		                    rb_float_new(tag->vreal64_vec3[1]),
+		                    rb_float_new(tag->vreal64_vec3[2]) );
+	  case VN_TAG_LINK:
+		return UINT2NUM( tag->vlink );
+	  case VN_TAG_ANIMATION:
+		return rb_ary_new3( 3, UINT2NUM(tag->vanimation.curve), UINT2NUM(tag->vanimation.start),
+		                    UINT2NUM(tag->vanimation.end) );
+	  case VN_TAG_BLOB:
+		return rb_str_new( tag->vblob.blob, tag->vblob.size );
+	  default:
+		return Qnil;
+	}
+}
+
+
+/*
+ * Call the tag_create handler after acquiring the GVL.
+ */
+static void *
+rbverse_cb_tag_create_body( void *ptr ) {
+	struct rbverse_tag_create_event *event = (struct rbverse_tag_create_event *)ptr;
+	struct rbverse_node_record *record = rbverse_lookup_pending_node( event->node_id );
+	VALUE node, cb_args[6];
+
+	if ( record ) {
+		rbverse_session_filter_tag( rbverse_get_current_session(), record, event->name,
+		                            event->type, &event->tag );
+		return NULL;
+	}
+
+	node = rbverse_lookup_wrapped_node( event->node_id );
+	if ( !rbverse_has_observers(node, RBVERSE_ON_TAG_CREATE) ) return NULL;
+
+	cb_args[0] = node;
+	cb_args[1] = INT2FIX( event->group_id );
+	cb_args[2] = INT2FIX( event->tag_id );
+	cb_args[3] = event->name ? rb_str_new2( event->name ) : Qnil;
+	cb_args[4] = INT2FIX( event->type );
+	cb_args[5] = rbverse_tag2value( event->type, &event->tag );
+
+	rbverse_notify_observers( node, RBVERSE_ON_TAG_CREATE, 6, cb_args );
+
+	return NULL;
+}
+
+
+/*
+ * Callback for the 'tag_create' command. Strings and blobs in the tag value are copied
+ * into the event along with the name.
+ */
+static void
+rbverse_cb_tag_create( void *unused, VNodeID node_id, uint16 group_id, uint16 tag_id, 
+                       const char *name, VNTagType type, const VNTag *tag )
+{
+	struct rbverse_tag_create_event *event;
+	size_t valsize = 0;
+
+	if ( type == VN_TAG_STRING )
+		valsize = RBVERSE_EVENT_STRSIZE( tag->vstring );
+	else if ( type == VN_TAG_BLOB && tag->vblob.blob )
+		valsize = tag->vblob.size;
+
+	event = rbverse_event_new( rbverse_cb_tag_create_body, RBVERSE_ON_TAG_CREATE,
+	                           sizeof(struct rbverse_tag_create_event),
+	                           RBVERSE_EVENT_STRSIZE(name) + valsize );
+
+	event->node_id  = node_id;
+	event->group_id = group_id;
+	event->tag_id   = tag_id;
+	event->name     = rbverse_event_strdup( event, name );
+	event->type     = type;
+	event->tag      = *tag;
+
+	if ( type == VN_TAG_STRING ) {
+		event->tag.vstring = (char *)rbverse_event_strdup( event, tag->vstring );
+	} else if ( type == VN_TAG_BLOB ) {
+		event->tag.vblob.blob = (void *)rbverse_event_memdup( event, tag->vblob.blob,
+		                                                      valsize );
+	}
+}
 
 
 
@@ -526,8 +846,15 @@ rbverse_init_verse_node( void ) {
 	/* Related modules */
 	rbverse_mVerseNodeObserver = rb_define_module_under( rbverse_mVerse, "NodeObserver" );
 
-	/* VNodeID -> Ruby object lookup table */
-	node_map = st_init_numtable();
+	/* Allocation pools, sized for each type's payload */
+	rbverse_pool_init( &rbverse_node_pools[V_NT_OBJECT], "object_node", RBVERSE_NODE_SIZE(object) );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_GEOMETRY], "geometry_node", RBVERSE_NODE_SIZE(geometry) );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_MATERIAL], "material_node", RBVERSE_NODE_BASE_SIZE );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_BITMAP], "bitmap_node", RBVERSE_NODE_BASE_SIZE );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_TEXT], "text_node", RBVERSE_NODE_BASE_SIZE );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_CURVE], "curve_node", RBVERSE_NODE_BASE_SIZE );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_AUDIO], "audio_node", RBVERSE_NODE_SIZE(audio) );
+	rbverse_pool_init( &rbverse_node_pools[V_NT_NUM_TYPES], "node", sizeof(struct rbverse_node) );
 
 	rbverse_cVerseNode = rb_define_class_under( rbverse_mVerse, "Node", rb_cObject );
 	rb_include_module( rbverse_cVerseNode, rbverse_mVerseLoggable );
@@ -571,12 +898,12 @@ rbverse_init_verse_node( void ) {
 	// DEBUGMSG( "Free function for CurveNode (%d) is: %p\n", V_NT_CURVE, node_free_funcs[V_NT_CURVE] );
 	// DEBUGMSG( "Free function for AudioNode (%d) is: %p\n", V_NT_AUDIO, node_free_funcs[V_NT_AUDIO] );
 
-	verse_callback_set( verse_send_node_name_set, rbverse_node_cb_name_set, NULL );
-	// verse_callback_set( verse_send_tag_group_create, rbverse_node_cb_tag_group_create, NULL );
-	// verse_callback_set( verse_send_tag_group_destroy, rbverse_node_cb_tag_group_destroy, NULL );
-	// verse_callback_set( verse_send_tag_group_subscribe, rbverse_node_cb_tag_group_subscribe, NULL );
-	// verse_callback_set( verse_send_tag_group_unsubscribe, rbverse_node_cb_tag_group_unsubscribe, NULL );
-	// verse_callback_set( verse_send_tag_create, rbverse_node_cb_tag_create, NULL );
-	// verse_callback_set( verse_send_tag_destroy, rbverse_node_cb_tag_destroy, NULL );
+	RBVERSE_CALLBACK_SET( node_name_set, rbverse_node_cb_name_set );
+	RBVERSE_CALLBACK_SET( tag_group_create, rbverse_cb_tag_group_create );
+	RBVERSE_CALLBACK_SET( tag_group_destroy, rbverse_cb_tag_group_destroy );
+	RBVERSE_CALLBACK_SET( tag_group_subscribe, rbverse_cb_tag_group_subscribe );
+	RBVERSE_CALLBACK_SET( tag_group_unsubscribe, rbverse_cb_tag_group_unsubscribe );
+	RBVERSE_CALLBACK_SET( tag_create, rbverse_cb_tag_create );
+	RBVERSE_CALLBACK_SET( tag_destroy, rbverse_cb_tag_destroy );
 }
 
@@ -0,0 +1,496 @@
+/*
+ * Verse node filters -- client-side filtering of the nodes a session announces
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+
+#include "verse_ext.h"
+#include "ruby/util.h"
+
+#include <fnmatch.h>
+
+/*
+ * A session that's subscribed to the node index of a big scene hears about every node 
+ * of the subscribed types, but an application often only cares about a few of them. A
+ * node filter decides which nodes are announced to the session's observers (and wrapped
+ * in a Verse::Node) before any Ruby object is created for them; a rejected node costs 
+ * only its record in the session's node table.
+ * 
+ * The node type and owner are known when a node is created, but its name and tags 
+ * aren't, so a filter that looks at those holds the node as pending, subscribes to it, 
+ * and decides once the name arrives (and then the matching tag, subscribing to the 
+ * tag group that has it). A node that's waiting on a tag is never rejected, as there's 
+ * no telling when it has sent all of its tags.
+ * 
+ * Nodes that are created by the session itself for a #create_node callback are never 
+ * filtered.
+ */
+
+struct rbverse_tag_group_subscribe_args {
+	VNodeID node_id;
+	uint16  group_id;
+};
+
+
+/* --------------------------------------------------------------
+ * Building filters
+ * -------------------------------------------------------------- */
+
+/* Iterator for rbverse_node_filter_check_keys(); rejects any keys it doesn't know about. */
+static int
+rbverse_node_filter_check_key_i( VALUE key, VALUE value, VALUE valid_keys ) {
+	if ( !RTEST(rb_ary_includes(valid_keys, key)) )
+		rb_raise( rb_eArgError, "unknown node filter option %s", RSTRING_PTR(rb_inspect(key)) );
+	return ST_CONTINUE;
+}
+
+
+/* Check the keys of the given +hash+ against the NULL-terminated list of +keys+. */
+static void
+rbverse_node_filter_check_keys( VALUE hash, const char **keys ) {
+	VALUE valid_keys = rb_ary_new();
+
+	while ( *keys ) rb_ary_push( valid_keys, ID2SYM(rb_intern( *keys++ )) );
+	rb_hash_foreach( hash, rbverse_node_filter_check_key_i, valid_keys );
+}
+
+
+/* Return the value of the +key+ option from the +spec+ Hash. */
+static VALUE
+rbverse_node_filter_option( VALUE spec, const char *key ) {
+	return rb_hash_aref( spec, ID2SYM(rb_intern(key)) );
+}
+
+
+/* Return the +key+ option from the +spec+ Hash if it's a String, raising if it's 
+ * something else, or Qnil if it isn't set. */
+static VALUE
+rbverse_node_filter_string_option( VALUE spec, const char *key ) {
+	VALUE str = rbverse_node_filter_option( spec, key );
+
+	if ( !NIL_P(str) ) StringValueCStr( str );
+	return str;
+}
+
+
+/* Return a copy of +str+ that belongs to a filter, or NULL if +str+ is nil. */
+static char *
+rbverse_node_filter_strdup( VALUE str ) {
+	return NIL_P( str ) ? NULL : ruby_strdup( RSTRING_PTR(str) );
+}
+
+
+/* Build the typemask for the node classes in +types+ (either one class or an Array of 
+ * them). Including Verse::Node itself matches every type. */
+static uint32
+rbverse_node_filter_typemask( VALUE types ) {
+	VALUE classes = rb_Array( types ), nodeclass;
+	uint32 typemask = 0;
+	long i;
+
+	for ( i = 0; i < RARRAY_LEN(classes); i++ ) {
+		nodeclass = RARRAY_PTR( classes )[ i ];
+		Check_Type( nodeclass, T_CLASS );
+
+		if ( nodeclass == rbverse_cVerseNode ) return ~0;
+		if ( !RTEST(rb_class_inherited_p(nodeclass, rbverse_cVerseNode)) )
+			rb_raise( rb_eTypeError, "%s isn't a kind of node", rb_class2name(nodeclass) );
+
+		typemask |= 1 << FIX2UINT( rb_const_get(nodeclass, rb_intern("TYPE_NUMBER")) );
+	}
+
+	return typemask;
+}
+
+
+/*
+ * Build a new filter from the +spec+ Hash (see Verse::Session#node_filter= for the 
+ * options it understands). The options are all checked before anything is allocated, 
+ * so an invalid one doesn't leak a half-built filter.
+ */
+struct rbverse_node_filter *
+rbverse_node_filter_new( VALUE spec ) {
+	static const char *filter_keys[] = { "types", "owner", "name_prefix", "name", "tag", NULL };
+	static const char *tag_keys[] = { "group", "name", "value", NULL };
+	struct rbverse_node_filter *filter;
+	VALUE types, owner, name_prefix, name, tag, tag_group = Qnil, tag_name = Qnil;
+	VALUE tag_value = Qundef;
+	uint32 typemask = ~0;
+	int owner_type = -1;
+
+	Check_Type( spec, T_HASH );
+	rbverse_node_filter_check_keys( spec, filter_keys );
+
+	if ( !NIL_P(types = rbverse_node_filter_option(spec, "types")) )
+		typemask = rbverse_node_filter_typemask( types );
+
+	if ( !NIL_P(owner = rbverse_node_filter_option(spec, "owner")) ) {
+		if ( rb_to_id(owner) == rb_intern("mine") )
+			owner_type = VN_OWNER_MINE;
+		else if ( rb_to_id(owner) == rb_intern("other") )
+			owner_type = VN_OWNER_OTHER;
+		else
+			rb_raise( rb_eArgError, "invalid owner %s (expected :mine or :other)",
+			          RSTRING_PTR(rb_inspect(owner)) );
+	}
+
+	name_prefix = rbverse_node_filter_string_option( spec, "name_prefix" );
+	name        = rbverse_node_filter_string_option( spec, "name" );
+
+	if ( !NIL_P(tag = rbverse_node_filter_option(spec, "tag")) ) {
+		Check_Type( tag, T_HASH );
+		rbverse_node_filter_check_keys( tag, tag_keys );
+
+		tag_group = rbverse_node_filter_string_option( tag, "group" );
+		tag_name  = rbverse_node_filter_string_option( tag, "name" );
+		if ( NIL_P(tag_group) || NIL_P(tag_name) )
+			rb_raise( rb_eArgError, "a tag filter needs both a :group and a :name" );
+
+		if ( RTEST(rb_funcall(tag, rb_intern("key?"), 1, ID2SYM(rb_intern("value")))) ) {
+			tag_value = rbverse_node_filter_option( tag, "value" );
+			if ( tag_value != Qtrue && tag_value != Qfalse && TYPE(tag_value) != T_STRING &&
+			     !RTEST(rb_obj_is_kind_of(tag_value, rb_cNumeric)) )
+				rb_raise( rb_eTypeError, "can't match a tag against %s",
+				          rb_obj_classname(tag_value) );
+			if ( TYPE(tag_value) == T_STRING )
+				tag_value = rb_obj_freeze( rb_str_dup(tag_value) );
+		}
+	}
+
+	filter = ALLOC( struct rbverse_node_filter );
+	MEMZERO( filter, struct rbverse_node_filter, 1 );
+
+	filter->typemask     = typemask;
+	filter->owner        = owner_type;
+	filter->name_prefix  = rbverse_node_filter_strdup( name_prefix );
+	filter->name_pattern = rbverse_node_filter_strdup( name );
+	filter->tag_group    = rbverse_node_filter_strdup( tag_group );
+	filter->tag_name     = rbverse_node_filter_strdup( tag_name );
+	filter->tag_value    = tag_value;
+	filter->spec         = rb_obj_freeze( rb_hash_dup(spec) );
+
+	return filter;
+}
+
+
+/*
+ * Free the given +filter+.
+ */
+void
+rbverse_node_filter_free( struct rbverse_node_filter *filter ) {
+	if ( !filter ) return;
+
+	if ( filter->name_prefix )  xfree( filter->name_prefix );
+	if ( filter->name_pattern ) xfree( filter->name_pattern );
+	if ( filter->tag_group )    xfree( filter->tag_group );
+	if ( filter->tag_name )     xfree( filter->tag_name );
+
+	xfree( filter );
+}
+
+
+/*
+ * Mark the objects the given +filter+ holds on to.
+ */
+void
+rbverse_node_filter_mark( struct rbverse_node_filter *filter ) {
+	if ( !filter ) return;
+
+	rbverse_gc_mark_movable( filter->spec );
+	if ( filter->tag_value != Qundef ) rbverse_gc_mark_movable( filter->tag_value );
+}
+
+
+/*
+ * Update the objects the given +filter+ holds on to after a compaction.
+ */
+void
+rbverse_node_filter_compact( struct rbverse_node_filter *filter ) {
+	if ( !filter ) return;
+
+	rbverse_gc_update( filter->spec );
+	if ( filter->tag_value != Qundef ) rbverse_gc_update( filter->tag_value );
+}
+
+
+/* Return the size of +str+ including its NUL, or 0 if it's NULL */
+#define RBVERSE_FILTER_STRSIZE( str )	( (str) ? strlen(str) + 1 : 0 )
+
+/*
+ * Return the amount of memory used by the given +filter+.
+ */
+size_t
+rbverse_node_filter_memsize( const struct rbverse_node_filter *filter ) {
+	if ( !filter ) return 0;
+
+	return sizeof( struct rbverse_node_filter ) +
+		RBVERSE_FILTER_STRSIZE( filter->name_prefix ) + 
+		RBVERSE_FILTER_STRSIZE( filter->name_pattern ) + 
+		RBVERSE_FILTER_STRSIZE( filter->tag_group ) + 
+		RBVERSE_FILTER_STRSIZE( filter->tag_name );
+}
+
+
+
+/* --------------------------------------------------------------
+ * Matching
+ * -------------------------------------------------------------- */
+
+/* Returns true if the +filter+ looks at nodes' names. */
+static inline int
+rbverse_node_filter_wants_name( const struct rbverse_node_filter *filter ) {
+	return filter->name_prefix || filter->name_pattern;
+}
+
+
+/* Returns true if the given node +name+ matches the +filter+. */
+static int
+rbverse_node_filter_match_name( const struct rbverse_node_filter *filter, const char *name ) {
+	if ( !rbverse_node_filter_wants_name(filter) ) return TRUE;
+	if ( !name ) return FALSE;
+
+	if ( filter->name_prefix &&
+	     strncmp(name, filter->name_prefix, strlen(filter->name_prefix)) != 0 )
+		return FALSE;
+	if ( filter->name_pattern && fnmatch(filter->name_pattern, name, 0) != 0 )
+		return FALSE;
+
+	return TRUE;
+}
+
+
+/* Returns true if the +tag+ of the specified +type+ has the filter's tag +value+. */
+static int
+rbverse_node_filter_match_tag_value( VALUE value, VNTagType type, const VNTag *tag ) {
+	if ( value == Qundef ) return TRUE;
+
+	switch ( type ) {
+	  case VN_TAG_BOOLEAN:
+		return ( value == Qtrue || value == Qfalse ) && RTEST( value ) == ( tag->vboolean != 0 );
+	  case VN_TAG_UINT32:
+		return rb_obj_is_kind_of( value, rb_cInteger ) && NUM2DBL( value ) == tag->vuint32;
+	  case VN_TAG_LINK:
+		return rb_obj_is_kind_of( value, rb_cInteger ) && NUM2DBL( value ) == tag->vlink;
+	  case VN_TAG_REAL64:
+		return rb_obj_is_kind_of( value, rb_cNumeric ) && NUM2DBL( value ) == tag->vreal64;
+	  case VN_TAG_STRING:
+		return TYPE( value ) == T_STRING && tag->vstring && 
+			(size_t)RSTRING_LEN( value ) == strlen( tag->vstring ) &&
+			memcmp( RSTRING_PTR(value), tag->vstring, RSTRING_LEN(value) ) == 0;
+	  default:
+		return FALSE;
+	}
+}
+
+
+
+/* --------------------------------------------------------------
+ * Filtering a session's nodes
+ * -------------------------------------------------------------- */
+
+/* Synchronized portion of rbverse_node_filter_subscribe() */
+static VALUE
+rbverse_node_filter_subscribe_l( VALUE node_id ) {
+	verse_send_node_subscribe( (VNodeID)node_id );
+	return Qtrue;
+}
+
+/* Synchronized portion of rbverse_node_filter_unsubscribe() */
+static VALUE
+rbverse_node_filter_unsubscribe_l( VALUE node_id ) {
+	verse_send_node_unsubscribe( (VNodeID)node_id );
+	return Qtrue;
+}
+
+/* Synchronized portion of rbverse_session_filter_tag_group() */
+static VALUE
+rbverse_node_filter_tag_group_subscribe_l( VALUE ptr ) {
+	struct rbverse_tag_group_subscribe_args *args = (struct rbverse_tag_group_subscribe_args *)ptr;
+	verse_send_tag_group_subscribe( args->node_id, args->group_id );
+	return Qtrue;
+}
+
+
+/* Hold the node described by +record+ until the +session+'s filter can decide on it. */
+static void
+rbverse_node_filter_hold( VALUE session, struct rbverse_node_record *record ) {
+	record->flags |= RBVERSE_NODE_RECORD_PENDING;
+	rbverse_get_session( session )->pending_nodes++;
+
+	/* Cast: VNodeID -> VALUE */
+	rbverse_with_session_lock( session, rbverse_node_filter_subscribe_l, (VALUE)record->id );
+}
+
+
+/*
+ * Stop holding the node described by +record+ in the specified +session+, if it's being 
+ * held. This is also called when a held node is destroyed.
+ */
+void
+rbverse_session_filter_release( VALUE session, struct rbverse_node_record *record ) {
+	if ( !(record->flags & RBVERSE_NODE_RECORD_PENDING) ) return;
+
+	record->flags &= ~RBVERSE_NODE_RECORD_PENDING;
+	rbverse_get_session( session )->pending_nodes--;
+}
+
+
+/* Reject the node described by +record+, unsubscribing from it if it was being held. */
+static void
+rbverse_node_filter_reject( VALUE session, struct rbverse_node_filter *filter,
+                            struct rbverse_node_record *record )
+{
+	const int subscribed = ( record->flags & RBVERSE_NODE_RECORD_PENDING );
+
+	DEBUGMSG( "  node filter rejected node %u", record->id );
+	rbverse_session_filter_release( session, record );
+	record->flags |= RBVERSE_NODE_RECORD_REJECTED;
+	filter->rejected++;
+
+	/* Cast: VNodeID -> VALUE */
+	if ( subscribed )
+		rbverse_with_session_lock( session, rbverse_node_filter_unsubscribe_l, (VALUE)record->id );
+}
+
+
+/* Accept the held node described by +record+, and announce it to the +session+'s observers. */
+static void
+rbverse_node_filter_accept( VALUE session, struct rbverse_node_filter *filter,
+                            struct rbverse_node_record *record )
+{
+	DEBUGMSG( "  node filter accepted node %u", record->id );
+	rbverse_session_filter_release( session, record );
+	if ( filter ) filter->accepted++;
+
+	rbverse_session_announce_node( session, record, Qnil );
+}
+
+
+/*
+ * Decide what to do with the newly-created node described by +record+ in the given 
+ * +session+. Returns true if it should be announced right away. If it shouldn't, it's
+ * either been rejected, or is being held until its name or tags arrive.
+ */
+int
+rbverse_session_filter_node( VALUE session, struct rbverse_node_record *record ) {
+	struct rbverse_node_filter *filter = rbverse_get_session( session )->filter;
+
+	if ( !filter ) return TRUE;
+
+	if ( !(filter->typemask & (1 << record->type)) ||
+	     (filter->owner >= 0 && filter->owner != record->owner) )
+	{
+		rbverse_node_filter_reject( session, filter, record );
+		return FALSE;
+	}
+
+	if ( rbverse_node_filter_wants_name(filter) || filter->tag_group ) {
+		rbverse_node_filter_hold( session, record );
+		return FALSE;
+	}
+
+	filter->accepted++;
+	return TRUE;
+}
+
+
+/*
+ * Continue filtering the held node described by +record+ in the specified +session+ now
+ * that its name has been set.
+ */
+void
+rbverse_session_filter_node_name( VALUE session, struct rbverse_node_record *record ) {
+	struct rbverse_node_filter *filter = rbverse_get_session( session )->filter;
+
+	/* The filter was removed while the node was held */
+	if ( !filter ) {
+		rbverse_node_filter_accept( session, NULL, record );
+	} else if ( !rbverse_node_filter_match_name(filter, record->name) ) {
+		rbverse_node_filter_reject( session, filter, record );
+	} else if ( !filter->tag_group ) {
+		rbverse_node_filter_accept( session, filter, record );
+	}
+}
+
+
+/*
+ * Subscribe to the tag group with the given +group_id+ and +name+ of the held node 
+ * described by +record+ if it's the one the +session+'s filter looks for a tag in.
+ */
+void
+rbverse_session_filter_tag_group( VALUE session, struct rbverse_node_record *record, 
+                                  uint16 group_id, const char *name )
+{
+	struct rbverse_node_filter *filter = rbverse_get_session( session )->filter;
+	struct rbverse_tag_group_subscribe_args args;
+
+	if ( !filter ) {
+		rbverse_node_filter_accept( session, NULL, record );
+		return;
+	}
+
+	if ( !filter->tag_group || !name || strcmp(name, filter->tag_group) != 0 ) return;
+
+	args.node_id  = record->id;
+	args.group_id = group_id;
+	rbverse_with_session_lock( session, rbverse_node_filter_tag_group_subscribe_l, (VALUE)&args );
+}
+
+
+/*
+ * Accept the held node described by +record+ if the tag with the given +name+, +type+,
+ * and value (+tag+) is the one the +session+'s filter is looking for, and the node's 
+ * name matches. Only the filter's tag group is subscribed to, so the tag is in the
+ * right group.
+ */
+void
+rbverse_session_filter_tag( VALUE session, struct rbverse_node_record *record, const char *name,
+                            VNTagType type, const VNTag *tag )
+{
+	struct rbverse_node_filter *filter = rbverse_get_session( session )->filter;
+
+	if ( !filter ) {
+		rbverse_node_filter_accept( session, NULL, record );
+		return;
+	}
+
+	if ( !filter->tag_name || !name || strcmp(name, filter->tag_name) != 0 ) return;
+	if ( !rbverse_node_filter_match_tag_value(filter->tag_value, type, tag) ) return;
+	if ( !rbverse_node_filter_match_name(filter, record->name) ) return;
+
+	rbverse_node_filter_accept( session, filter, record );
+}
@@ -0,0 +1,296 @@
+/*
+ * Verse node table -- per-session index of wrapped nodes
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include "verse_ext.h"
+#include "ruby/util.h"
+
+/*
+ * Each session keeps a compact record of every node it knows about in one of these
+ * tables, so node IDs from different sessions can't collide. Records are cheap 
+ * enough to keep for every node in a large index subscription; the Verse::Node
+ * object for a node is only created when something needs it (see 
+ * rbverse_wrap_verse_node()).
+ * 
+ * The table doesn't mark the nodes' objects. A node that's freed detaches itself 
+ * from its record, and a record that's deleted (or a table that's cleared) detaches
+ * its node.
+ */
+
+
+/*
+ * Initialize an empty node +table+.
+ */
+void
+rbverse_node_table_init( struct rbverse_node_table *table ) {
+	table->pages      = NULL;
+	table->page_count = 0;
+	table->overflow   = NULL;
+	table->count      = 0;
+}
+
+
+/*
+ * Look up the record for a node whose ID is too big for the dense part of the +table+.
+ */
+struct rbverse_node_record *
+rbverse_node_table_lookup_overflow( struct rbverse_node_table *table, VNodeID id ) {
+	struct rbverse_node_record *record = NULL;
+
+	if ( !table->overflow || !st_lookup(table->overflow, (st_data_t)id, (st_data_t *)&record) )
+		return NULL;
+
+	return record;
+}
+
+
+/*
+ * Return the record slot for the given +id+ in the dense part of the +table+, growing
+ * the page directory and allocating the page if necessary.
+ */
+static struct rbverse_node_record *
+rbverse_node_table_slot( struct rbverse_node_table *table, VNodeID id ) {
+	const uint32 page = id >> RBVERSE_NODE_PAGE_BITS;
+	uint32 page_count = table->page_count;
+
+	if ( page >= page_count ) {
+		if ( !page_count ) page_count = 4;
+		while ( page_count <= page ) page_count *= 2;
+		if ( page_count > RBVERSE_NODE_TABLE_MAX_PAGES ) page_count = RBVERSE_NODE_TABLE_MAX_PAGES;
+
+		REALLOC_N( table->pages, struct rbverse_node_record *, page_count );
+		MEMZERO( table->pages + table->page_count, struct rbverse_node_record *,
+		         page_count - table->page_count );
+		table->page_count = page_count;
+	}
+
+	if ( !table->pages[page] ) {
+		table->pages[ page ] = ALLOC_N( struct rbverse_node_record, RBVERSE_NODE_PAGE_SIZE );
+		MEMZERO( table->pages[page], struct rbverse_node_record, RBVERSE_NODE_PAGE_SIZE );
+	}
+
+	return &table->pages[ page ][ id & RBVERSE_NODE_PAGE_MASK ];
+}
+
+
+/*
+ * Release what a +record+ holds and mark it unused.
+ */
+static void
+rbverse_node_record_clear( struct rbverse_node_record *record ) {
+	rbverse_node_record_detach( record );
+	if ( record->name ) xfree( record->name );
+
+	record->name  = NULL;
+	record->flags = 0;
+}
+
+
+/*
+ * Add a record for the node with the specified +id+, +type+, and +owner+ to the +table+,
+ * and return it. If there's already a record with that ID (e.g., for a node that's been
+ * destroyed and its ID re-used), it's reset, and any node object it had is detached.
+ */
+struct rbverse_node_record *
+rbverse_node_table_insert( struct rbverse_node_table *table, VNodeID id, VNodeType type,
+                           VNodeOwner owner )
+{
+	struct rbverse_node_record *record = NULL;
+
+	if ( (id >> RBVERSE_NODE_PAGE_BITS) < RBVERSE_NODE_TABLE_MAX_PAGES ) {
+		record = rbverse_node_table_slot( table, id );
+	} else {
+		if ( !table->overflow ) table->overflow = st_init_numtable();
+		if ( !st_lookup(table->overflow, (st_data_t)id, (st_data_t *)&record) ) {
+			record = ALLOC( struct rbverse_node_record );
+			MEMZERO( record, struct rbverse_node_record, 1 );
+			st_insert( table->overflow, (st_data_t)id, (st_data_t)record );
+		}
+	}
+
+	if ( record->flags & RBVERSE_NODE_RECORD_USED ) {
+		DEBUGMSG( "  replacing the stale record for node ID %u", id );
+		rbverse_node_record_clear( record );
+	} else {
+		table->count++;
+	}
+
+	record->id      = id;
+	record->type    = (uint8)type;
+	record->owner   = (uint8)owner;
+	record->flags   = RBVERSE_NODE_RECORD_USED;
+	record->version = 0;
+	record->name    = NULL;
+	record->node    = NULL;
+
+	return record;
+}
+
+
+/*
+ * Remove the specified +record+ from the +table+, detaching its node object if it has
+ * one.
+ */
+void
+rbverse_node_table_delete( struct rbverse_node_table *table, struct rbverse_node_record *record ) {
+	st_data_t key = (st_data_t)record->id;
+
+	if ( !(record->flags & RBVERSE_NODE_RECORD_USED) ) return;
+
+	rbverse_node_record_clear( record );
+	table->count--;
+
+	if ( (record->id >> RBVERSE_NODE_PAGE_BITS) >= RBVERSE_NODE_TABLE_MAX_PAGES ) {
+		st_delete( table->overflow, &key, 0 );
+		xfree( record );
+	}
+}
+
+
+/*
+ * Iterator for rbverse_node_table_clear(); clears and frees one overflow record.
+ */
+static int
+rbverse_node_table_clear_i( st_data_t id, st_data_t record, st_data_t unused ) {
+	rbverse_node_record_clear( (struct rbverse_node_record *)record );
+	xfree( (void *)record );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Clear all the records in the +table+ and free the memory it uses. The table is left
+ * empty, and can be re-used.
+ */
+void
+rbverse_node_table_clear( struct rbverse_node_table *table ) {
+	uint32 page, i;
+
+	for ( page = 0; page < table->page_count; page++ ) {
+		if ( !table->pages[page] ) continue;
+		for ( i = 0; i < RBVERSE_NODE_PAGE_SIZE; i++ ) {
+			if ( table->pages[page][i].flags & RBVERSE_NODE_RECORD_USED )
+				rbverse_node_record_clear( &table->pages[page][i] );
+		}
+		xfree( table->pages[page] );
+	}
+
+	if ( table->overflow ) {
+		st_foreach( table->overflow, rbverse_node_table_clear_i, 0 );
+		st_free_table( table->overflow );
+	}
+
+	if ( table->pages ) xfree( table->pages );
+	rbverse_node_table_init( table );
+}
+
+
+/*
+ * Iterator for rbverse_node_table_memsize(); adds up the size of one overflow record.
+ */
+static int
+rbverse_node_table_memsize_i( st_data_t id, st_data_t recordptr, st_data_t sizeptr ) {
+	struct rbverse_node_record *record = (struct rbverse_node_record *)recordptr;
+	size_t *size = (size_t *)sizeptr;
+
+	*size += sizeof( struct rbverse_node_record );
+	if ( record->name ) *size += strlen( record->name ) + 1;
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Return the number of bytes of memory the +table+ is using, not counting the node
+ * objects attached to its records.
+ */
+size_t
+rbverse_node_table_memsize( const struct rbverse_node_table *table ) {
+	size_t size = table->page_count * sizeof( struct rbverse_node_record * );
+	uint32 page, i;
+
+	for ( page = 0; page < table->page_count; page++ ) {
+		if ( !table->pages[page] ) continue;
+		size += RBVERSE_NODE_PAGE_SIZE * sizeof( struct rbverse_node_record );
+		for ( i = 0; i < RBVERSE_NODE_PAGE_SIZE; i++ ) {
+			if ( table->pages[page][i].name )
+				size += strlen( table->pages[page][i].name ) + 1;
+		}
+	}
+
+	if ( table->overflow ) {
+		size += st_memsize( table->overflow );
+		st_foreach( table->overflow, rbverse_node_table_memsize_i, (st_data_t)&size );
+	}
+
+	return size;
+}
+
+
+/*
+ * Attach the given +node+ object to the +record+ it was created for.
+ */
+void
+rbverse_node_record_attach( struct rbverse_node_record *record, struct rbverse_node *node ) {
+	record->node = node;
+	node->record = record;
+}
+
+
+/*
+ * Detach the node object from the +record+, if it has one.
+ */
+void
+rbverse_node_record_detach( struct rbverse_node_record *record ) {
+	if ( record->node ) {
+		record->node->record = NULL;
+		record->node = NULL;
+	}
+}
+
+
+/*
+ * Set the +name+ of the node described by +record+, bumping its version.
+ */
+void
+rbverse_node_record_set_name( struct rbverse_node_record *record, const char *name ) {
+	if ( record->name ) xfree( record->name );
+	record->name = name ? ruby_strdup( name ) : NULL;
+	record->version++;
+}
+
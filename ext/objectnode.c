@@ -40,6 +40,7 @@
 #include "verse_ext.h"
 
 VALUE rbverse_cVerseObjectNode;
+VALUE rbverse_mVerseObjectNodeObserver;
 
 
 /*
@@ -48,16 +49,28 @@ VALUE rbverse_cVerseObjectNode;
 static void
 rbverse_objectnode_gc_mark( struct rbverse_node *ptr ) {
 	if ( ptr ) {
-		rb_gc_mark( ptr->object.links );
-		rb_gc_mark( ptr->object.links );
-		rb_gc_mark( ptr->object.transform );
-		rb_gc_mark( ptr->object.light );
-		rb_gc_mark( ptr->object.method_groups );
-		rb_gc_mark( ptr->object.animations );
+		rbverse_gc_mark_movable( ptr->object.links );
+		rbverse_gc_mark_movable( ptr->object.transform );
+		rbverse_gc_mark_movable( ptr->object.light );
+		rbverse_gc_mark_movable( ptr->object.method_groups );
+		rbverse_gc_mark_movable( ptr->object.animations );
 	}
 }
 
 
+/*
+ * Update references in the object part of a node to objects moved by GC compaction.
+ */
+static void
+rbverse_objectnode_gc_compact( struct rbverse_node *ptr ) {
+	rbverse_gc_update( ptr->object.links );
+	rbverse_gc_update( ptr->object.transform );
+	rbverse_gc_update( ptr->object.light );
+	rbverse_gc_update( ptr->object.method_groups );
+	rbverse_gc_update( ptr->object.animations );
+}
+
+
 /*
  * Free the object part of a node.
  */
@@ -102,6 +115,31 @@ rbverse_verse_objectnode_initialize( VALUE self ) {
 }
 
 
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+RBVERSE_NODE_TRAMPOLINE( 1, o_transform_subscribe, RBVERSE_ON_TRANSFORM_SUBSCRIBE, UINT32 )
+RBVERSE_NODE_TRAMPOLINE( 1, o_transform_unsubscribe, RBVERSE_ON_TRANSFORM_UNSUBSCRIBE, UINT32 )
+RBVERSE_NODE_TRAMPOLINE( 3, o_transform_scale_real32, RBVERSE_ON_TRANSFORM_SCALE, REAL32, REAL32, REAL32 )
+RBVERSE_NODE_TRAMPOLINE( 3, o_transform_scale_real64, RBVERSE_ON_TRANSFORM_SCALE, REAL64, REAL64, REAL64 )
+RBVERSE_NODE_TRAMPOLINE( 3, o_light_set, RBVERSE_ON_LIGHT_SET, REAL64, REAL64, REAL64 )
+RBVERSE_NODE_TRAMPOLINE( 4, o_link_set, RBVERSE_ON_LINK_SET, UINT16, UINT32, STRING, UINT32 )
+RBVERSE_NODE_TRAMPOLINE( 1, o_link_destroy, RBVERSE_ON_LINK_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 2, o_method_group_create, RBVERSE_ON_METHOD_GROUP_CREATE, UINT16, STRING )
+RBVERSE_NODE_TRAMPOLINE( 1, o_method_group_destroy, RBVERSE_ON_METHOD_GROUP_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, o_method_group_subscribe, RBVERSE_ON_METHOD_GROUP_SUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, o_method_group_unsubscribe, RBVERSE_ON_METHOD_GROUP_UNSUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 2, o_method_destroy, RBVERSE_ON_METHOD_DESTROY, UINT16, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, o_hide, RBVERSE_ON_HIDE, UINT8 )
+
+/* Commands whose arguments are arrays or packed structures still need hand-written
+ * callbacks, so these aren't set yet:
+ *   o_transform_pos_real32/real64, o_transform_rot_real32/real64, o_method_create, 
+ *   o_method_call, o_anim_run */
+
+
 /*
  * Verse::ObjectNode class
  */
@@ -109,6 +147,9 @@ void
 rbverse_init_verse_objectnode( void ) {
 	rbverse_log( "debug", "Initializing Verse::ObjectNode" );
 
+	/* Related modules */
+	rbverse_mVerseObjectNodeObserver = rb_define_module_under( rbverse_mVerse, "ObjectNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseObjectNode = rb_define_class_under( rbverse_mVerse, "ObjectNode", rbverse_cVerseNode );
 
@@ -122,5 +163,20 @@ rbverse_init_verse_objectnode( void ) {
 	rbverse_nodetype_to_nodeclass[ V_NT_OBJECT ] = rbverse_cVerseObjectNode;
 	node_mark_funcs[ V_NT_OBJECT ] = &rbverse_objectnode_gc_mark;
 	node_free_funcs[ V_NT_OBJECT ] = &rbverse_objectnode_gc_free;
+	node_compact_funcs[ V_NT_OBJECT ] = &rbverse_objectnode_gc_compact;
+
+	RBVERSE_CALLBACK_SET( o_transform_subscribe, rbverse_cb_o_transform_subscribe );
+	RBVERSE_CALLBACK_SET( o_transform_unsubscribe, rbverse_cb_o_transform_unsubscribe );
+	RBVERSE_CALLBACK_SET( o_transform_scale_real32, rbverse_cb_o_transform_scale_real32 );
+	RBVERSE_CALLBACK_SET( o_transform_scale_real64, rbverse_cb_o_transform_scale_real64 );
+	RBVERSE_CALLBACK_SET( o_light_set, rbverse_cb_o_light_set );
+	RBVERSE_CALLBACK_SET( o_link_set, rbverse_cb_o_link_set );
+	RBVERSE_CALLBACK_SET( o_link_destroy, rbverse_cb_o_link_destroy );
+	RBVERSE_CALLBACK_SET( o_method_group_create, rbverse_cb_o_method_group_create );
+	RBVERSE_CALLBACK_SET( o_method_group_destroy, rbverse_cb_o_method_group_destroy );
+	RBVERSE_CALLBACK_SET( o_method_group_subscribe, rbverse_cb_o_method_group_subscribe );
+	RBVERSE_CALLBACK_SET( o_method_group_unsubscribe, rbverse_cb_o_method_group_unsubscribe );
+	RBVERSE_CALLBACK_SET( o_method_destroy, rbverse_cb_o_method_destroy );
+	RBVERSE_CALLBACK_SET( o_hide, rbverse_cb_o_hide );
 }
 
@@ -0,0 +1,215 @@
+/*
+ * Verse pools -- slab allocation for the extension's structs
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include "verse_ext.h"
+
+/*
+ * Sessions and nodes are allocated from slab pools instead of one ALLOC() per object. 
+ * Each pool hands out objects of one size, carved out of large slabs; freed objects
+ * go onto the pool's free list and are re-used by the next allocation, so churning
+ * through lots of nodes doesn't keep going back to malloc(). Slabs are never given
+ * back, so a pool stays as big as its peak use.
+ * 
+ * Pools are only used with the GVL held.
+ */
+
+/* Free objects are linked together through their first word */
+struct rbverse_pool_free_item {
+	struct rbverse_pool_free_item *next;
+};
+
+/* Header of a slab of objects */
+struct rbverse_pool_slab {
+	struct rbverse_pool_slab *next;
+};
+
+#define RBVERSE_POOL_SLAB_SIZE	16384
+#define RBVERSE_POOL_ALIGN(size) ( ((size) + 15) & ~((size_t)15) )
+#define RBVERSE_POOL_SLAB_HEADER_SIZE RBVERSE_POOL_ALIGN( sizeof(struct rbverse_pool_slab) )
+
+/* All the pools that have been initialized, for Verse.pool_stats */
+static struct rbverse_pool *rbverse_pools = NULL;
+
+
+/*
+ * Initialize the given +pool+ to hand out objects of +size+ bytes, and register it 
+ * under +name+ for statistics reporting.
+ */
+void
+rbverse_pool_init( struct rbverse_pool *pool, const char *name, size_t size ) {
+	if ( size < sizeof(struct rbverse_pool_free_item) )
+		size = sizeof( struct rbverse_pool_free_item );
+
+	pool->name        = name;
+	pool->size        = RBVERSE_POOL_ALIGN( size );
+	pool->per_slab    = ( RBVERSE_POOL_SLAB_SIZE - RBVERSE_POOL_SLAB_HEADER_SIZE ) / pool->size;
+	if ( !pool->per_slab ) pool->per_slab = 1;
+
+	pool->free_list   = NULL;
+	pool->slabs       = NULL;
+	pool->slab_count  = 0;
+	pool->in_use      = 0;
+	pool->peak        = 0;
+	pool->allocations = 0;
+	pool->frees       = 0;
+
+	pool->next = rbverse_pools;
+	rbverse_pools = pool;
+}
+
+
+/*
+ * Add a new slab to the +pool+, and put all of its objects on the free list.
+ */
+static void
+rbverse_pool_grow( struct rbverse_pool *pool ) {
+	const size_t slab_size = RBVERSE_POOL_SLAB_HEADER_SIZE + pool->size * pool->per_slab;
+	struct rbverse_pool_slab *slab = (struct rbverse_pool_slab *)ALLOC_N( char, slab_size );
+	char *objects = (char *)slab + RBVERSE_POOL_SLAB_HEADER_SIZE;
+	struct rbverse_pool_free_item *item;
+	unsigned long i;
+
+	DEBUGMSG( "Adding a slab of %lu %s objects.", pool->per_slab, pool->name );
+
+	slab->next = (struct rbverse_pool_slab *)pool->slabs;
+	pool->slabs = slab;
+	pool->slab_count++;
+
+	/* Push them in reverse so they're handed out in address order */
+	for ( i = pool->per_slab; i > 0; i-- ) {
+		item = (struct rbverse_pool_free_item *)( objects + (i - 1) * pool->size );
+		item->next = pool->free_list;
+		pool->free_list = item;
+	}
+}
+
+
+/*
+ * Allocate an (uninitialized) object from the specified +pool+.
+ */
+void *
+rbverse_pool_alloc( struct rbverse_pool *pool ) {
+	struct rbverse_pool_free_item *item;
+
+	if ( !pool->free_list ) rbverse_pool_grow( pool );
+
+	item = pool->free_list;
+	pool->free_list = item->next;
+
+	pool->allocations++;
+	if ( ++pool->in_use > pool->peak ) pool->peak = pool->in_use;
+
+	return item;
+}
+
+
+/*
+ * Return the object at +ptr+ to the +pool+ it was allocated from.
+ */
+void
+rbverse_pool_free( struct rbverse_pool *pool, void *ptr ) {
+	struct rbverse_pool_free_item *item = (struct rbverse_pool_free_item *)ptr;
+
+	item->next = pool->free_list;
+	pool->free_list = item;
+
+	pool->frees++;
+	pool->in_use--;
+}
+
+
+
+/*
+ * call-seq:
+ *    Verse.pool_stats   -> hash
+ *
+ * Returns a Hash of allocation statistics for the pools that sessions and nodes are
+ * allocated from, keyed by pool name. Each pool's statistics are a Hash with the
+ * following keys:
+ * 
+ * [:object_size]  the size of each object in the pool, in bytes
+ * [:slabs]        the number of slabs that have been allocated
+ * [:capacity]     the number of objects the pool's slabs can hold
+ * [:in_use]       the number of objects that are currently allocated
+ * [:peak]         the largest number of objects that have been allocated at once
+ * [:allocations]  the total number of allocations
+ * [:frees]        the total number of frees
+ * 
+ * @example
+ *    Verse.pool_stats[:object_node][:in_use]  # => 2048
+ */
+static VALUE
+rbverse_verse_s_pool_stats( VALUE module ) {
+	VALUE stats = rb_hash_new();
+	VALUE poolstats;
+	struct rbverse_pool *pool;
+
+	for ( pool = rbverse_pools; pool; pool = pool->next ) {
+		poolstats = rb_hash_new();
+
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("object_size")), ULONG2NUM(pool->size) );
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("slabs")), ULONG2NUM(pool->slab_count) );
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("capacity")),
+		              ULONG2NUM(pool->slab_count * pool->per_slab) );
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("in_use")), ULONG2NUM(pool->in_use) );
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("peak")), ULONG2NUM(pool->peak) );
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("allocations")), ULONG2NUM(pool->allocations) );
+		rb_hash_aset( poolstats, ID2SYM(rb_intern("frees")), ULONG2NUM(pool->frees) );
+
+		rb_hash_aset( stats, ID2SYM(rb_intern(pool->name)), poolstats );
+	}
+
+	return stats;
+}
+
+
+/*
+ * Verse allocation pools
+ */
+void
+rbverse_init_verse_pool( void ) {
+	rbverse_log( "debug", "Initializing the allocation pools" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+#endif
+
+	rb_define_singleton_method( rbverse_mVerse, "pool_stats", rbverse_verse_s_pool_stats, 0 );
+}
+
@@ -0,0 +1,86 @@
+/*
+ * Ruby Verse static tracepoints
+ * $Id$
+ *
+ * USDT probes on the extension's hot paths, for attaching bpftrace, SystemTap, or
+ * DTrace to a running process. They're built from <sys/sdt.h> when extconf.rb finds
+ * it, and compile to nothing otherwise. An unattached probe is just a nop, so unlike
+ * the Ruby-level logging they cost nothing until something is listening, e.g.:
+ *
+ *   bpftrace -e 'usdt:./verse_ext.so:ruby_verse:update__done { @[arg1] = count(); }'
+ *
+ * Probes (provider 'ruby_verse'):
+ *
+ *   update__start( session, microseconds )
+ *   update__done( session, microseconds )
+ *       Around each verse_callback_update() call made for Verse.update, without the
+ *       GVL. +session+ is the VSession (NULL for the global session).
+ *
+ *   callback__queued( kind, size )
+ *       A Verse callback queued an event of +kind+ taking up +size+ bytes. Fired
+ *       before the GVL is acquired, from whichever thread ran the callback.
+ *   callback__dispatch__start( kind, session )
+ *   callback__dispatch__done( kind, session )
+ *       Around the handler for a queued event once it is dispatched with the GVL held.
+ *
+ *   node__wrap( id, type, node )
+ *   node__free( id, type, node )
+ *       A Verse::Node object was created for node +id+ of +type+, or freed by the GC.
+ *
+ *   session__lock__acquire( session )
+ *   session__lock__acquired( session )
+ *   session__lock__release( session )
+ *       Around waiting for and holding a session's mutex to send commands.
+ *
+ */
+
+#ifndef __VERSE_PROBES_H__
+#define __VERSE_PROBES_H__
+
+#ifdef HAVE_SYS_SDT_H
+#	include <sys/sdt.h>
+
+#	define RBVERSE_PROBE_UPDATE_START(session, usec) \
+		DTRACE_PROBE2( ruby_verse, update__start, (session), (usec) )
+#	define RBVERSE_PROBE_UPDATE_DONE(session, usec) \
+		DTRACE_PROBE2( ruby_verse, update__done, (session), (usec) )
+
+#	define RBVERSE_PROBE_CALLBACK_QUEUED(kind, size) \
+		DTRACE_PROBE2( ruby_verse, callback__queued, (kind), (size) )
+#	define RBVERSE_PROBE_CALLBACK_DISPATCH_START(kind, session) \
+		DTRACE_PROBE2( ruby_verse, callback__dispatch__start, (kind), (session) )
+#	define RBVERSE_PROBE_CALLBACK_DISPATCH_DONE(kind, session) \
+		DTRACE_PROBE2( ruby_verse, callback__dispatch__done, (kind), (session) )
+
+#	define RBVERSE_PROBE_NODE_WRAP(id, type, node) \
+		DTRACE_PROBE3( ruby_verse, node__wrap, (id), (type), (node) )
+#	define RBVERSE_PROBE_NODE_FREE(id, type, node) \
+		DTRACE_PROBE3( ruby_verse, node__free, (id), (type), (node) )
+
+#	define RBVERSE_PROBE_SESSION_LOCK_ACQUIRE(session) \
+		DTRACE_PROBE1( ruby_verse, session__lock__acquire, (session) )
+#	define RBVERSE_PROBE_SESSION_LOCK_ACQUIRED(session) \
+		DTRACE_PROBE1( ruby_verse, session__lock__acquired, (session) )
+#	define RBVERSE_PROBE_SESSION_LOCK_RELEASE(session) \
+		DTRACE_PROBE1( ruby_verse, session__lock__release, (session) )
+
+#else
+
+#	define RBVERSE_PROBE_UPDATE_START(session, usec)
+#	define RBVERSE_PROBE_UPDATE_DONE(session, usec)
+
+#	define RBVERSE_PROBE_CALLBACK_QUEUED(kind, size)
+#	define RBVERSE_PROBE_CALLBACK_DISPATCH_START(kind, session)
+#	define RBVERSE_PROBE_CALLBACK_DISPATCH_DONE(kind, session)
+
+#	define RBVERSE_PROBE_NODE_WRAP(id, type, node)
+#	define RBVERSE_PROBE_NODE_FREE(id, type, node)
+
+#	define RBVERSE_PROBE_SESSION_LOCK_ACQUIRE(session)
+#	define RBVERSE_PROBE_SESSION_LOCK_ACQUIRED(session)
+#	define RBVERSE_PROBE_SESSION_LOCK_RELEASE(session)
+
+#endif /* HAVE_SYS_SDT_H */
+
+#endif /* __VERSE_PROBES_H__ */
+
@@ -42,9 +42,21 @@
 VALUE rbverse_cVerseServer;
 static VALUE rbverse_verse_running_server;
 
+/* The server's callback methods */
+static ID rbverse_id_on_connect;
+static ID rbverse_id_on_node_index_subscribe;
+
 static void rbverse_server_cb_connect( void *, const char *, const char *, const char *, const uint8 * );
 static void rbverse_server_cb_index_subscribe( void *, uint32 );
 
+/* Structs for passing callback data back into Ruby */
+struct rbverse_connect_event {
+	const char *name;
+	const char *pass;
+	const char *address;
+	uint8      expected_host_id[ V_HOST_ID_SIZE ];
+};
+
 
 /* --------------------------------------------------------------
  * Class methods
@@ -84,9 +96,8 @@ rbverse_verse_server_run( VALUE self ) {
 	rbverse_verse_running_server = self;
 
 	rbverse_log_with_context( self, "info", "Starting up." );
-	verse_callback_set( verse_send_connect, rbverse_server_cb_connect, NULL );
-	verse_callback_set( verse_send_node_index_subscribe, rbverse_server_cb_index_subscribe,
-	                    NULL );
+	RBVERSE_CALLBACK_SET( connect, rbverse_server_cb_connect );
+	RBVERSE_CALLBACK_SET( node_index_subscribe, rbverse_server_cb_index_subscribe );
 
 	return Qtrue;
 }
@@ -118,8 +129,8 @@ rbverse_verse_server_shutdown( VALUE self ) {
 		rb_raise( rbverse_eVerseServerError, "server isn't running" );
 
 	rbverse_log_with_context( self, "info", "Shutting down." );
-	verse_callback_set( verse_send_connect, NULL, NULL );
-	verse_callback_set( verse_send_node_index_subscribe, NULL, NULL );
+	RBVERSE_CALLBACK_SET( connect, NULL );
+	RBVERSE_CALLBACK_SET( node_index_subscribe, NULL );
 
 	rbverse_verse_running_server = Qnil;
 
@@ -161,7 +172,9 @@ rbverse_verse_accept_connection( VALUE self, VALUE avatar, VALUE address, VALUE
 	avatar_node_id = (VNodeID)FIX2ULONG( rb_funcall(avatar, rb_intern("id"), 0) );
 
 	rbverse_log( "debug", "Accepting connection from %s with avatar %lu", addr, avatar_node_id );
+	rbverse_session_switch_lock();
 	session_id = verse_send_connect_accept( avatar_node_id, addr, id );
+	rbverse_session_switch_unlock();
 	session = rbverse_verse_session_from_vsession( session_id, address );
 
 	return session;
@@ -178,17 +191,16 @@ rbverse_verse_accept_connection( VALUE self, VALUE avatar, VALUE address, VALUE
  */
 static void *
 rbverse_server_cb_connect_body( void *ptr ) {
-	const char **args = (const char **)ptr;
-	const VALUE cb_args = rb_ary_new2( 4 );
+	struct rbverse_connect_event *event = (struct rbverse_connect_event *)ptr;
+	VALUE cb_args[4];
 
 	if ( RTEST(rbverse_verse_running_server) ) {
-		rb_ary_store( cb_args, 0, rb_str_new2(args[0]) );
-		rb_ary_store( cb_args, 1, rb_str_new2(args[1]) );
-		rb_ary_store( cb_args, 2, rb_str_new2(args[2]) );
-		rb_ary_store( cb_args, 3, rbverse_host_id2str((const uint8 *)args[3]) );
+		cb_args[0] = rb_str_new2( event->name );
+		cb_args[1] = rb_str_new2( event->pass );
+		cb_args[2] = rb_str_new2( event->address );
+		cb_args[3] = rbverse_host_id2str( event->expected_host_id );
 
-		rb_funcall2( rbverse_verse_running_server, rb_intern("on_connect"),
-		             RARRAY_LEN(cb_args), RARRAY_PTR(cb_args) );
+		rb_funcall2( rbverse_verse_running_server, rbverse_id_on_connect, 4, cb_args );
 	}
 
 	else {
@@ -205,9 +217,22 @@ static void
 rbverse_server_cb_connect( void *unused, const char *name, const char *pass, const char *address,
                     const uint8 *expected_host_id )
 {
-	const char *(args[4]) = { name, pass, address, (const char *)expected_host_id };
-	DEBUGMSG( "*** Acquiring GVL for 'connect' event. ***" );
-	rb_thread_call_with_gvl( rbverse_server_cb_connect_body, args );
+	struct rbverse_connect_event *event;
+
+	DEBUGMSG( "*** Queueing 'connect' event. ***" );
+	event = rbverse_event_new( rbverse_server_cb_connect_body, RBVERSE_EVENT_SERVER_CONNECT,
+		sizeof(struct rbverse_connect_event),
+		RBVERSE_EVENT_STRSIZE(name) + RBVERSE_EVENT_STRSIZE(pass) + RBVERSE_EVENT_STRSIZE(address) );
+
+	event->name    = rbverse_event_strdup( event, name );
+	event->pass    = rbverse_event_strdup( event, pass );
+	event->address = rbverse_event_strdup( event, address );
+
+	/* A missing host ID is the same as the wildcard (all-zeroes) one */
+	if ( expected_host_id )
+		memcpy( event->expected_host_id, expected_host_id, V_HOST_ID_SIZE );
+	else
+		memset( event->expected_host_id, 0, V_HOST_ID_SIZE );
 }
 
 
@@ -217,10 +242,12 @@ rbverse_server_cb_connect( void *unused, const char *name, const char *pass, con
 static void *
 rbverse_server_cb_index_subscribe_body( void *ptr ) {
 	const uint32 mask = *((uint32 *)ptr);
-	const VALUE session = rbverse_get_current_session();
-	const VALUE cb_args = rb_ary_new3( 1, session );
+	VALUE cb_args[ V_NT_NUM_TYPES + 1 ];
 	VALUE node_class = Qnil;
 	VNodeType node_type;
+	int argc = 0;
+
+	cb_args[ argc++ ] = rbverse_get_current_session();
 
 	if ( RTEST(rbverse_verse_running_server) ) {
 		rbverse_log( "debug", "Building the list of subscribed classes from mask: %u.", mask );
@@ -228,15 +255,15 @@ rbverse_server_cb_index_subscribe_body( void *ptr ) {
 			if ( mask & (1 << node_type) ) {
 				node_class = rbverse_node_class_from_node_type( node_type );
 				rbverse_log( "debug", "  adding %s", rb_class2name(node_class) );
-				rb_ary_push( cb_args, node_class );
+				cb_args[ argc++ ] = node_class;
 			}
 		}
 
 		rbverse_log_with_context( rbverse_verse_running_server, "debug",
 		                          "Calling on_node_index_subscribe with %d node classes.",
-		                          RARRAY_LEN(cb_args) );
-		rb_funcall( rbverse_verse_running_server, rb_intern("on_node_index_subscribe"),
-		            RARRAY_LEN(cb_args), RARRAY_PTR(cb_args) );
+		                          argc - 1 );
+		rb_funcall2( rbverse_verse_running_server, rbverse_id_on_node_index_subscribe,
+		             argc, cb_args );
 	}
 
 	else {
@@ -252,7 +279,9 @@ rbverse_server_cb_index_subscribe_body( void *ptr ) {
  */
 static void
 rbverse_server_cb_index_subscribe( void *unused, uint32 mask ) {
-	rb_thread_call_with_gvl( rbverse_server_cb_index_subscribe_body, (void *)&mask );
+	uint32 *event = rbverse_event_new( rbverse_server_cb_index_subscribe_body,
+		RBVERSE_EVENT_SERVER_INDEX_SUBSCRIBE, sizeof(uint32), 0 );
+	*event = mask;
 }
 
 
@@ -265,6 +294,9 @@ rbverse_init_verse_server( void ) {
 	rbverse_log( "debug", "Initializing Verse::Server" );
 	rbverse_verse_running_server = Qnil;
 
+	rbverse_id_on_connect = rb_intern( "on_connect" );
+	rbverse_id_on_node_index_subscribe = rb_intern( "on_node_index_subscribe" );
+
 #ifdef FOR_RDOC
 	rbverse_mVerse = rb_define_module( "Verse" );
 #endif
@@ -41,9 +41,38 @@
 
 VALUE rbverse_cVerseSession;
 VALUE rbverse_mVerseSessionObserver;
+static VALUE rbverse_cVerseNodeFuture;
 
-static VALUE rbverse_session_mutex;
 st_table *session_table;
+static VALUE rbverse_session_table_obj;
+
+/* The method called on node-creation callbacks */
+static ID rbverse_id_call;
+
+/* Pool that session structs are allocated from */
+static struct rbverse_pool rbverse_session_pool;
+
+/* Verse keeps track of the "current" session in a global, so switching to a session
+ * and sending it a command has to be atomic. That's the only thing serialized across 
+ * sessions; each session's own commands are ordered by its Ruby Mutex. */
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t rbverse_session_switch = PTHREAD_MUTEX_INITIALIZER;
+
+/* The mutex isn't fair, and the network thread releases and re-takes it between every
+ * session, so Ruby threads that are waiting for it are counted, and the network thread
+ * gives way to them (see rbverse_session_switch_yield()). */
+static int rbverse_session_switch_waiters = 0;
+static pthread_mutex_t rbverse_session_waiters_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rbverse_session_waiters_done = PTHREAD_COND_INITIALIZER;
+
+/* Verse sessions whose objects were collected while another thread held the switch 
+ * lock. The GC can't wait for the lock, so they're destroyed by whichever thread 
+ * releases it next (see rbverse_session_switch_unlock()). */
+static VSession *rbverse_session_doomed = NULL;
+static long rbverse_session_doomed_count = 0;
+static long rbverse_session_doomed_capacity = 0;
+static pthread_mutex_t rbverse_session_doomed_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 /* Structs for passing callback data back into Ruby */
 struct rbverse_node_create_event {
@@ -52,10 +81,39 @@ struct rbverse_node_create_event {
 	VNodeOwner node_owner;
 };
 
+struct rbverse_node_create_batch {
+	VNodeType  node_type;
+	long       count;
+};
+
 struct rbverse_connect_accept_event {
 	VNodeID    avatar;
 	const char *address;
-	uint8      *hostid;
+	uint8      hostid[ V_HOST_ID_SIZE ];
+};
+
+struct rbverse_connect_terminate_event {
+	const char *address;
+	const char *message;
+};
+
+/* Structs for passing arguments to the session-locked sections of commands */
+struct rbverse_connect_args {
+	const char  *name;
+	const char  *pass;
+	const char  *address;
+	const uint8 *hostid;
+};
+
+struct rbverse_terminate_args {
+	const char *address;
+	const char *message;
+};
+
+struct rbverse_node_create_args {
+	VNodeID    node_id;
+	VNodeType  node_type;
+	VNodeOwner node_owner;
 };
 
 
@@ -69,12 +127,23 @@ struct rbverse_connect_accept_event {
  */
 static struct rbverse_session *
 rbverse_session_alloc( void ) {
-	struct rbverse_session *ptr = ALLOC( struct rbverse_session );
+	struct rbverse_session *ptr = rbverse_pool_alloc( &rbverse_session_pool );
 
 	ptr->id                = NULL;
 	ptr->address           = Qnil;
 	ptr->create_callbacks  = Qnil;
 	ptr->destroy_callbacks = Qnil;
+	ptr->mutex             = Qnil;
+	ptr->batch_thread      = Qnil;
+	ptr->traffic           = 0;
+	ptr->filter            = NULL;
+	ptr->pending_nodes     = 0;
+	ptr->pinned_nodes      = Qnil;
+	ptr->commands_sent     = 0;
+	ptr->slices            = 0;
+	ptr->slice_usec        = 0;
+
+	rbverse_node_table_init( &ptr->nodes );
 
 	DEBUGMSG( "allocated a rbverse_SESSION <%p>", ptr );
 	return ptr;
@@ -85,58 +154,167 @@ rbverse_session_alloc( void ) {
  * GC Mark function
  */
 static void
-rbverse_session_gc_mark( struct rbverse_session *ptr ) {
+rbverse_session_gc_mark( void *data ) {
+	struct rbverse_session *ptr = data;
+
 	if ( ptr ) {
-		rb_gc_mark( ptr->address );
-		rb_gc_mark( ptr->create_callbacks );
-		rb_gc_mark( ptr->destroy_callbacks );
+		rbverse_gc_mark_movable( ptr->address );
+		rbverse_gc_mark_movable( ptr->create_callbacks );
+		rbverse_gc_mark_movable( ptr->destroy_callbacks );
+		rbverse_gc_mark_movable( ptr->mutex );
+		rbverse_gc_mark_movable( ptr->batch_thread );
+		rbverse_gc_mark_movable( ptr->pinned_nodes );
+		rbverse_node_filter_mark( ptr->filter );
 	}
 }
 
 
+#ifdef HAVE_RB_GC_LOCATION
+/*
+ * GC Compaction function
+ */
+static void
+rbverse_session_gc_compact( void *data ) {
+	struct rbverse_session *ptr = data;
+
+	rbverse_gc_update( ptr->address );
+	rbverse_gc_update( ptr->create_callbacks );
+	rbverse_gc_update( ptr->destroy_callbacks );
+	rbverse_gc_update( ptr->mutex );
+	rbverse_gc_update( ptr->batch_thread );
+	rbverse_gc_update( ptr->pinned_nodes );
+	rbverse_node_filter_compact( ptr->filter );
+}
+#endif
+
+
+
+/*
+ * Destroy the Verse session with the given +id+ for a session object that's being 
+ * freed. If another thread holds the switch lock, the session is queued for it to 
+ * destroy instead, as waiting for the lock would stall every thread until it's released.
+ */
+static void
+rbverse_session_destroy_vsession( VSession id ) {
+#ifdef HAVE_PTHREAD_H
+	VSession *doomed;
+	long capacity;
+
+	if ( pthread_mutex_trylock(&rbverse_session_switch) != 0 ) {
+		pthread_mutex_lock( &rbverse_session_doomed_lock );
+
+		/* Ruby's allocator can't be used while the GC is sweeping; if there's no memory
+		 * for the queue, the Verse session is leaked */
+		if ( rbverse_session_doomed_count == rbverse_session_doomed_capacity ) {
+			capacity = rbverse_session_doomed_capacity ? rbverse_session_doomed_capacity * 2 : 8;
+			if ( (doomed = realloc(rbverse_session_doomed, capacity * sizeof(VSession))) ) {
+				rbverse_session_doomed = doomed;
+				rbverse_session_doomed_capacity = capacity;
+			}
+		}
+		if ( rbverse_session_doomed_count < rbverse_session_doomed_capacity )
+			rbverse_session_doomed[ rbverse_session_doomed_count++ ] = id;
+
+		pthread_mutex_unlock( &rbverse_session_doomed_lock );
+		return;
+	}
+#endif
+
+	rbverse_network_remove_session( id );
+	verse_session_destroy( id );
+	rbverse_session_switch_unlock();
+}
+
 
 /*
  * GC Free function
  */
 static void
-rbverse_session_gc_free( struct rbverse_session *ptr ) {
+rbverse_session_gc_free( void *data ) {
+	struct rbverse_session *ptr = data;
+
 	if ( ptr ) {
-		/* TODO: terminate the session and remove it from the session table if it's connected */
-		if ( ptr->id ) {
-			verse_session_destroy( ptr->id );
-		}
+		if ( ptr->id ) rbverse_session_destroy_vsession( ptr->id );
 
 		ptr->id                = NULL;
 		ptr->address           = Qnil;
 		ptr->create_callbacks  = Qnil;
 		ptr->destroy_callbacks = Qnil;
+		ptr->mutex             = Qnil;
+		ptr->batch_thread      = Qnil;
+		ptr->pinned_nodes      = Qnil;
+
+		rbverse_node_table_clear( &ptr->nodes );
+		rbverse_node_filter_free( ptr->filter );
+		ptr->filter = NULL;
 
-		xfree( ptr );
+		rbverse_pool_free( &rbverse_session_pool, ptr );
 		ptr = NULL;
 	}
 }
 
 
 /*
- * Object validity checker. Returns the data pointer.
+ * GC Memsize function
  */
-static struct rbverse_session *
-check_session( VALUE self ) {
-	Check_Type( self, T_DATA );
+static size_t
+rbverse_session_gc_memsize( const void *data ) {
+	const struct rbverse_session *ptr = data;
 
-    if ( !IsSession(self) ) {
-		rb_raise( rb_eTypeError, "wrong argument type %s (expected Verse::Session)",
-				  rb_obj_classname(self) );
-    }
+	if ( !ptr ) return 0;
+	return rbverse_session_pool.size + rbverse_node_table_memsize( &ptr->nodes ) +
+		rbverse_node_filter_memsize( ptr->filter );
+}
 
-	return DATA_PTR( self );
+
+/* Typed data type of Verse::Session objects */
+const rb_data_type_t rbverse_session_data_type = {
+	.wrap_struct_name = "Verse::Session",
+	.function = {
+		.dmark    = rbverse_session_gc_mark,
+		.dfree    = rbverse_session_gc_free,
+		.dsize    = rbverse_session_gc_memsize,
+#ifdef HAVE_RB_GC_LOCATION
+		.dcompact = rbverse_session_gc_compact,
+#endif
+	},
+};
+
+
+/*
+ * Mark function for the table of connected sessions. Connected sessions are kept alive
+ * (and pinned, since the table can't be updated if they move) until they're terminated.
+ */
+static void
+rbverse_session_table_gc_mark( void *data ) {
+	st_table *table = data;
+	if ( table ) rb_mark_tbl( table );
 }
 
 
+/* Typed data type of the object that makes the table of connected sessions a GC root */
+static const rb_data_type_t rbverse_session_table_data_type = {
+	.wrap_struct_name = "Verse::Session table",
+	.function = {
+		.dmark = rbverse_session_table_gc_mark,
+	},
+};
+
+
 /*
- * Fetch the data pointer and check it for sanity.
+ * Object validity checker. Returns the data pointer.
  */
 static struct rbverse_session *
+check_session( VALUE self ) {
+	return rb_check_typeddata( self, &rbverse_session_data_type );
+}
+
+
+/*
+ * Fetch the data pointer and check it for sanity. Not static because other parts of
+ * the extension use it as well.
+ */
+struct rbverse_session *
 rbverse_get_session( VALUE self ) {
 	struct rbverse_session *session = check_session( self );
 
@@ -148,12 +326,13 @@ rbverse_get_session( VALUE self ) {
 
 
 /*
- * Get the Verse::Session object that corresponds to the current Verse session, or
- * Qnil if there isn't one.
+ * Get the Verse::Session object for the session of the event that's being dispatched, 
+ * or Qnil if there isn't one. This doesn't ask Verse for its current session, as the 
+ * network thread can switch it at any time.
  */
 VALUE
 rbverse_get_current_session() {
-	VSession id = verse_session_get();
+	VSession id = rbverse_dispatch_session;
 	VALUE session;
 
 	if ( st_lookup(session_table, (st_data_t)id, (st_data_t *)&session) ) {
@@ -167,20 +346,234 @@ rbverse_get_current_session() {
 }
 
 
+/*
+ * Acquire the session switch lock without the GVL. This is what Verse.update uses,
+ * as it switches sessions from inside a blocking region.
+ */
+void
+rbverse_session_switch_lock_nogvl( void ) {
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock( &rbverse_session_switch );
+#endif
+}
+
+
 /* 
- * Call the specified +func+ with the given +arg+ after setting the current 
- * verse session to +id+.
+ * Blocking-region body for waiting until the switch lock is free. It doesn't keep the
+ * lock, as an interrupt raised on the way out of the blocking region would leak it.
+ */
+static VALUE
+rbverse_session_switch_wait( void *unused ) {
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock( &rbverse_session_switch );
+	pthread_mutex_unlock( &rbverse_session_switch );
+#endif
+	return Qnil;
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * Add +delta+ to the number of threads waiting for the switch lock, waking up the 
+ * network thread if there aren't any more.
+ */
+static void
+rbverse_session_switch_waiters_add( int delta ) {
+	pthread_mutex_lock( &rbverse_session_waiters_lock );
+	rbverse_session_switch_waiters += delta;
+	if ( !rbverse_session_switch_waiters )
+		pthread_cond_broadcast( &rbverse_session_waiters_done );
+	pthread_mutex_unlock( &rbverse_session_waiters_lock );
+}
+
+
+/*
+ * Body of the contended case of rbverse_session_switch_lock().
+ */
+static VALUE
+rbverse_session_switch_lock_contended( VALUE unused ) {
+	while ( pthread_mutex_trylock(&rbverse_session_switch) != 0 )
+		rb_thread_blocking_region( rbverse_session_switch_wait, NULL, RUBY_UBF_IO, NULL );
+	return Qnil;
+}
+
+
+/*
+ * Ensure function for the contended case of rbverse_session_switch_lock(); the thread 
+ * either has the lock or was interrupted, so it's no longer waiting.
+ */
+static VALUE
+rbverse_session_switch_lock_done( VALUE unused ) {
+	rbverse_session_switch_waiters_add( -1 );
+	return Qnil;
+}
+#endif
+
+
+/*
+ * Acquire the session switch lock from a thread that holds the GVL. The uncontended
+ * case is a single trylock; if the lock is busy (usually because another thread is in
+ * Verse.update), wait for it with the GVL released so the rest of Ruby keeps running.
+ * The thread is counted as a waiter until it gets the lock, so the network thread 
+ * doesn't keep taking it first.
+ */
+void
+rbverse_session_switch_lock( void ) {
+#ifdef HAVE_PTHREAD_H
+	if ( pthread_mutex_trylock(&rbverse_session_switch) == 0 ) return;
+
+	rbverse_session_switch_waiters_add( 1 );
+	rb_ensure( rbverse_session_switch_lock_contended, Qnil, rbverse_session_switch_lock_done, Qnil );
+#endif
+}
+
+
+/*
+ * Give way to any threads holding the GVL that are waiting for the session switch lock,
+ * waiting up to +microseconds+ for them to get it. Threads that take and release the 
+ * lock in a loop without the GVL should call this each time they release it.
+ */
+void
+rbverse_session_switch_yield( uint32 microseconds ) {
+#ifdef HAVE_PTHREAD_H
+	struct timespec deadline;
+	struct timeval now;
+
+	pthread_mutex_lock( &rbverse_session_waiters_lock );
+
+	if ( rbverse_session_switch_waiters ) {
+		gettimeofday( &now, NULL );
+		deadline.tv_sec  = now.tv_sec + ( now.tv_usec + microseconds ) / 1000000;
+		deadline.tv_nsec = ( ( now.tv_usec + microseconds ) % 1000000 ) * 1000;
+
+		while ( rbverse_session_switch_waiters ) {
+			if ( pthread_cond_timedwait(&rbverse_session_waiters_done, &rbverse_session_waiters_lock,
+			                            &deadline) == ETIMEDOUT )
+				break;
+		}
+	}
+
+	pthread_mutex_unlock( &rbverse_session_waiters_lock );
+#endif
+}
+
+
+/*
+ * Release the session switch lock, first destroying any sessions whose objects were
+ * collected while it was held.
+ */
+void
+rbverse_session_switch_unlock( void ) {
+#ifdef HAVE_PTHREAD_H
+	VSession id;
+
+	/* Checked without the lock as the queue's nearly always empty; a session queued 
+	 * just after the check is destroyed the next time the lock is released */
+	if ( rbverse_session_doomed_count ) {
+		pthread_mutex_lock( &rbverse_session_doomed_lock );
+		while ( rbverse_session_doomed_count ) {
+			id = rbverse_session_doomed[ --rbverse_session_doomed_count ];
+			rbverse_network_remove_session( id );
+			verse_session_destroy( id );
+		}
+		pthread_mutex_unlock( &rbverse_session_doomed_lock );
+	}
+
+	pthread_mutex_unlock( &rbverse_session_switch );
+#endif
+}
+
+
+/* Arguments for rbverse_with_session_lock_body() */
+struct rbverse_session_call {
+	VSession id;
+	VALUE    (*func)(ANYARGS);
+	VALUE    arg;
+};
+
+
+/*
+ * Call the function in +call+ with the session switch lock held, switching to its 
+ * session first if it isn't already the current one.
+ */
+static inline VALUE
+rbverse_session_call_switched( struct rbverse_session_call *call ) {
+	VALUE rval;
+
+	rbverse_session_switch_lock();
+	if ( verse_session_get() != call->id )
+		verse_session_set( call->id );
+	rval = (*call->func)( call->arg );
+	rbverse_session_switch_unlock();
+
+	return rval;
+}
+
+
+/*
+ * Body of rbverse_with_session_lock() that's called once the session's mutex is 
+ * held.
+ */
+static VALUE
+rbverse_with_session_lock_body( VALUE ptr ) {
+	return rbverse_session_call_switched( (struct rbverse_session_call *)ptr );
+}
+
+
+/* 
+ * Call the specified +func+ with the given +arg+ while holding the session's mutex, 
+ * after setting the current verse session to the session's ID. The +func+ is called
+ * with the session switch lock held, so it should only send Verse commands; it 
+ * mustn't raise or call back into Ruby.
+ * 
+ * Inside a Verse::Session#batch block, the batching thread already holds the mutex,
+ * so the function is just called directly.
  */
 VALUE
 rbverse_with_session_lock( VALUE sessionobj, VALUE (*func)(ANYARGS), VALUE arg ) {
+	return rbverse_with_session_lock_n( sessionobj, func, arg, 1 );
+}
+
+
+/*
+ * Like rbverse_with_session_lock(), for a +func+ that sends +commands+ commands 
+ * instead of one, which are counted in the session's +:commands_sent+ stats. Functions
+ * that don't know how many they'll send until they're called pass 0 and count them 
+ * as they send them.
+ */
+VALUE
+rbverse_with_session_lock_n( VALUE sessionobj, VALUE (*func)(ANYARGS), VALUE arg, 
+                             unsigned long commands )
+{
 	struct rbverse_session *session = rbverse_get_session( sessionobj );
+	struct rbverse_session_call call;
+	uint64_t start = 0, locked = 0;
 	VALUE rval = Qnil;
 
-	rbverse_log( "debug", "About to acquire the session mutex for session %d", session->id );
-	rb_mutex_lock( rbverse_session_mutex );
-	verse_session_set( session->id );
-    rval = rb_ensure( func, arg, rb_mutex_unlock, rbverse_session_mutex );
-	rbverse_log( "debug", "  done with the session mutex for session %d.", session->id );
+	call.id   = session->id;
+	call.func = func;
+	call.arg  = arg;
+
+	if ( rbverse_stats_enabled ) session->commands_sent += commands;
+
+	if ( session->batch_thread == rb_thread_current() )
+		return rbverse_session_call_switched( &call );
+
+	rbverse_log( "debug", "About to acquire the session mutex for session %p", session->id );
+	RBVERSE_PROBE_SESSION_LOCK_ACQUIRE( session->id );
+	if ( rbverse_trace_enabled ) start = rbverse_usec_now();
+	rb_mutex_lock( session->mutex );
+	RBVERSE_PROBE_SESSION_LOCK_ACQUIRED( session->id );
+	if ( start ) {
+		locked = rbverse_usec_now();
+		RBVERSE_TRACE_SPAN( "session", "session mutex", start, locked );
+	}
+
+	rval = rb_ensure( rbverse_with_session_lock_body, (VALUE)&call, rb_mutex_unlock, session->mutex );
+	RBVERSE_PROBE_SESSION_LOCK_RELEASE( session->id );
+
+	if ( locked ) RBVERSE_TRACE_SPAN( "session", "send command", locked, rbverse_usec_now() );
+	rbverse_log( "debug", "  done with the session mutex for session %p.", session->id );
 
 	return rval;
 }
@@ -196,6 +589,7 @@ rbverse_verse_session_from_vsession( VSession id, VALUE address ) {
 	struct rbverse_session *session = check_session( session_obj );
 
 	st_insert( session_table, (st_data_t)id, (st_data_t)session_obj );
+	rbverse_network_add_session( id );
 	session->id = id;
 
 	return session_obj;
@@ -216,7 +610,7 @@ rbverse_verse_session_from_vsession( VSession id, VALUE address ) {
  */
 static VALUE
 rbverse_verse_session_s_allocate( VALUE klass ) {
-	return Data_Wrap_Struct( klass, rbverse_session_gc_mark, rbverse_session_gc_free, 0 );
+	return TypedData_Wrap_Struct( klass, &rbverse_session_data_type, 0 );
 }
 
 
@@ -266,7 +660,8 @@ rbverse_verse_session_initialize( int argc, VALUE *argv, VALUE self ) {
 		struct rbverse_session *session;
 		VALUE address = Qnil;
 
-		DATA_PTR( self ) = session = rbverse_session_alloc();
+		RTYPEDDATA_DATA( self ) = session = rbverse_session_alloc();
+		session->mutex = rb_mutex_new();
 
 		if ( rb_scan_args(argc, argv, "01", &address) ) {
 			SafeStringValue( address );
@@ -345,42 +740,152 @@ rbverse_verse_session_connected_p( VALUE self ) {
 
 
 /*
- * Do the connection once the session mutex is acquired.
+ *  call-seq:
+ *     session.mutex   -> mutex
+ *
+ *  Returns the Mutex that serializes the commands sent via the session. Each session
+ *  has its own, so threads driving different sessions don't contend with each other.
+ *
+ */
+static VALUE
+rbverse_verse_session_mutex( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	return session->mutex;
+}
+
+
+/*
+ *  call-seq:
+ *     session.traffic   -> float
+ *
+ *  Returns the recent average number of events the session has received per
+ *  call to Verse.update in +:adaptive+ mode.
+ *
  */
 static VALUE
-rbverse_verse_session_connect_body( VALUE args ) {
-	VALUE self, name, pass, expected_host_id;
-	struct rbverse_session *session;
-	VSession session_id;
-	const char *name_str, *pass_str, *addr_str;
-	const uint8 *hostid = NULL;
+rbverse_verse_session_traffic( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	return rb_float_new( session->traffic / 256.0 );
+}
 
-	self             = rb_ary_entry( args, 0 );
-	name             = rb_ary_entry( args, 1 );
-	pass             = rb_ary_entry( args, 2 );
-	expected_host_id = rb_ary_entry( args, 3 );
 
-	session = rbverse_get_session( self );
-	name_str = RSTRING_PTR( name );
-	pass_str = RSTRING_PTR( pass );
-	addr_str = RSTRING_PTR( session->address );
+/*
+ *  call-seq:
+ *     session.node( id )   -> node or nil
+ *
+ *  Return the Verse::Node with the specified +id+ if the session knows about it. The
+ *  session keeps a lightweight record of every node it's been told about, and only
+ *  creates the node object the first time it's asked for.
+ *
+ */
+static VALUE
+rbverse_verse_session_node( VALUE self, VALUE id ) {
+	return rbverse_lookup_verse_node( self, NUM2UINT(id) );
+}
 
-	if ( RTEST(expected_host_id) )
-		hostid = (uint8 *)(StringValuePtr( expected_host_id ));
 
-	rbverse_log_with_context( self, "debug", "Sending 'connect' to %s", addr_str );
-	session_id = verse_send_connect( name_str, pass_str, addr_str, hostid );
-	rbverse_log_with_context( self, "debug", "  session: %p", session_id );
+/*
+ *  call-seq:
+ *     session.node_count   -> integer
+ *
+ *  Return the number of nodes the session knows about, whether or not their node 
+ *  objects have been created.
+ *
+ */
+static VALUE
+rbverse_verse_session_node_count( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	return ULONG2NUM( session->nodes.count );
+}
 
-	if ( !session_id )
-		rb_raise( rbverse_eVerseConnectError, "Couldn't create connection to '%s'.", addr_str );
 
-	/* Add the instance to the session table, keyed by its VSession */
-	st_insert( session_table, (st_data_t)session_id, (st_data_t)self );
+/*
+ *  call-seq:
+ *     session.node_filter   -> hash or nil
+ *
+ *  Return the options of the session's node filter, or +nil+ if it doesn't have one.
+ *  See #node_filter=.
+ *
+ */
+static VALUE
+rbverse_verse_session_node_filter( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	return session->filter ? session->filter->spec : Qnil;
+}
 
-	session->id = session_id;
 
-	return Qtrue;
+/*
+ *  call-seq:
+ *     session.node_filter = options
+ *
+ *  Set a filter on which of the nodes the session hears about are announced to its 
+ *  observers. Nodes that don't match it are never wrapped in a Verse::Node, so they 
+ *  only cost the session a small record each. The filter's +options+ are:
+ *
+ *  [+:types+]        a node class or an Array of them
+ *  [+:owner+]        +:mine+ or +:other+
+ *  [+:name_prefix+]  a String the node's name has to start with
+ *  [+:name+]         a glob pattern (see File.fnmatch) the node's name has to match
+ *  [+:tag+]          a Hash with the +:group+ and +:name+ of a tag the node has to have,
+ *                    and optionally the +:value+ it has to have
+ *
+ *  Filtering on a node's name or tags means subscribing to the node until they arrive,
+ *  so the node is announced (via #on_node_created) once they have. Setting the filter 
+ *  to +nil+ removes it. Nodes that have already been announced or rejected aren't 
+ *  affected by changing the filter.
+ *
+ *  @example Only hear about other clients' ObjectNodes that are tagged as trees
+ *     session.node_filter = {
+ *         :types => Verse::ObjectNode,
+ *         :owner => :other,
+ *         :tag   => { :group => 'scene', :name => 'kind', :value => 'tree' },
+ *     }
+ *     session.subscribe_to_node_index( Verse::ObjectNode )
+ */
+static VALUE
+rbverse_verse_session_node_filter_eq( VALUE self, VALUE options ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	struct rbverse_node_filter *filter = NIL_P( options ) ? NULL : rbverse_node_filter_new( options );
+
+	rbverse_node_filter_free( session->filter );
+	session->filter = filter;
+
+	return options;
+}
+
+
+/*
+ *  call-seq:
+ *     session.node_filter_stats   -> hash
+ *
+ *  Return a Hash of counts of the nodes the session's node filter has 
+ *  +:accepted+ and +:rejected+, and how many it's holding (+:pending+) until their 
+ *  names or tags arrive.
+ *
+ */
+static VALUE
+rbverse_verse_session_node_filter_stats( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	const struct rbverse_node_filter *filter = session->filter;
+	VALUE stats = rb_hash_new();
+
+	rb_hash_aset( stats, ID2SYM(rb_intern("accepted")), ULONG2NUM(filter ? filter->accepted : 0) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("rejected")), ULONG2NUM(filter ? filter->rejected : 0) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("pending")), ULONG2NUM(session->pending_nodes) );
+
+	return stats;
+}
+
+
+/*
+ * Send the 'connect' command once the session mutex is acquired. Returns the
+ * new VSession.
+ */
+static VALUE
+rbverse_verse_session_connect_l( VALUE ptr ) {
+	struct rbverse_connect_args *args = (struct rbverse_connect_args *)ptr;
+	/* Cast: VSession -> VALUE */
+	return (VALUE)verse_send_connect( args->name, args->pass, args->address, args->hostid );
 }
 
 
@@ -394,8 +899,9 @@ rbverse_verse_session_connect_body( VALUE args ) {
 static VALUE
 rbverse_verse_session_connect( int argc, VALUE *argv, VALUE self ) {
 	struct rbverse_session *session = rbverse_get_session( self );
-	VALUE args, name, pass, expected_host_id = Qnil;
-	VALUE rval = Qnil;
+	struct rbverse_connect_args args;
+	VALUE name, pass, expected_host_id = Qnil;
+	VSession session_id;
 
 	if ( !RTEST(session->address) )
 		rb_raise( rbverse_eVerseSessionError, "No address set." );
@@ -404,12 +910,42 @@ rbverse_verse_session_connect( int argc, VALUE *argv, VALUE self ) {
 
 	rb_scan_args( argc, argv, "21", &name, &pass, &expected_host_id );
 
-	rbverse_log_with_context( self, "debug", "Acquiring session lock for new session." );
-	args = rb_ary_new3( 4, self, name, pass, expected_host_id );
-	rval = rbverse_with_session_lock( self, rbverse_verse_session_connect_body, args );
-	rbverse_log_with_context( self, "debug", "  releasing session lock." );
+	args.name    = StringValueCStr( name );
+	args.pass    = StringValueCStr( pass );
+	args.address = RSTRING_PTR( session->address );
+	args.hostid  = NULL;
+	if ( RTEST(expected_host_id) )
+		args.hostid = (uint8 *)(StringValuePtr( expected_host_id ));
 
-	return rval;
+	rbverse_log_with_context( self, "debug", "Sending 'connect' to %s", args.address );
+	session_id = (VSession)rbverse_with_session_lock( self, rbverse_verse_session_connect_l,
+	                                                  (VALUE)&args );
+	rbverse_log_with_context( self, "debug", "  session: %p", session_id );
+
+	if ( !session_id )
+		rb_raise( rbverse_eVerseConnectError, "Couldn't create connection to '%s'.", args.address );
+
+	/* Add the instance to the session table, keyed by its VSession */
+	st_insert( session_table, (st_data_t)session_id, (st_data_t)self );
+	rbverse_network_add_session( session_id );
+	session->id = session_id;
+
+	return Qtrue;
+}
+
+
+/*
+ * Synchronized portion of rbverse_verse_session_terminate()
+ */
+static VALUE
+rbverse_verse_session_terminate_l( VALUE ptr ) {
+	struct rbverse_terminate_args *args = (struct rbverse_terminate_args *)ptr;
+	verse_send_connect_terminate( args->address, args->message );
+
+	/* Stop the network thread from updating it, while the switch lock is still held */
+	rbverse_network_remove_session( verse_session_get() );
+
+	return Qtrue;
 }
 
 
@@ -432,12 +968,12 @@ rbverse_verse_session_connect( int argc, VALUE *argv, VALUE self ) {
 static VALUE
 rbverse_verse_session_terminate( VALUE self, VALUE message ) {
 	struct rbverse_session *session = rbverse_get_session( self );
-	const char *msg;
+	struct rbverse_terminate_args args;
 
 	SafeStringValue( message );
-	msg = RSTRING_PTR( message );
-
-	verse_send_connect_terminate( RSTRING_PTR(session->address), msg );
+	args.address = RSTRING_PTR( session->address );
+	args.message = RSTRING_PTR( message );
+	rbverse_with_session_lock( self, rbverse_verse_session_terminate_l, (VALUE)&args );
 
 	rbverse_log( "debug", "Removing terminated session %p from session table (%p, %d entries)",
 	             session->id, session_table, session_table->num_entries );
@@ -465,7 +1001,8 @@ rbverse_verse_session_subscribe_to_node_index_l( VALUE typemask ) {
  *
  * Subscribe to creation and destruction events for the specified +node_classes+. Node 
  * creation will be sent to the Verse::SessionObservers via their #on_node_created method,
- * and when nodes are deleted, #on_node_destroy is called.
+ * and when nodes are deleted, #on_node_destroy is called. Use #node_filter= to narrow
+ * down which nodes of those types are announced.
  *
  * @param [Array<Class>] node_classes  one or more subclasses of Verse::Node that indicate
  *                                     which types of nodes to subscribe to. If you include
@@ -505,13 +1042,38 @@ rbverse_verse_session_subscribe_to_node_index( int argc, VALUE *argv, VALUE self
 }
 
 
+/*
+ * Look up the queue of creation callbacks for nodes of the specified +nodeclass+ in the
+ * given +session+, and set +nodetype+ to its type number.
+ */
+static VALUE
+rbverse_session_create_callback_queue( struct rbverse_session *session, VALUE nodeclass,
+                                       VNodeType *nodetype ) {
+	VALUE callback_queue;
+
+	if ( !session->id )
+		rb_raise( rbverse_eVerseSessionError, "can't create a node via an unconnected session" );
+
+	callback_queue = rb_hash_aref( session->create_callbacks, nodeclass );
+
+	Check_Type( nodeclass, T_CLASS );
+	*nodetype = FIX2UINT( rb_const_get(nodeclass, rb_intern( "TYPE_NUMBER" )) );
+
+	if ( !RTEST(callback_queue) )
+		rb_raise( rbverse_eVerseSessionError,
+		          "don't know how to create %s objects (no callback queue)",
+		          rb_class2name(nodeclass) );
+
+	return callback_queue;
+}
+
+
 /*
  * Synchronized portion of rbverse_verse_session_create_node() 
  */
 static VALUE
-rbverse_verse_session_create_node_l( VALUE nodeclass ) {
-	const VNodeType nodetype = FIX2UINT( rb_const_get(nodeclass, rb_intern( "TYPE_NUMBER" )) );
-	verse_send_node_create( ~0, nodetype, 0 );
+rbverse_verse_session_create_node_l( VALUE nodetype ) {
+	verse_send_node_create( ~0, (VNodeType)nodetype, 0 );
 	return Qtrue;
 }
 
@@ -537,44 +1099,92 @@ static VALUE
 rbverse_verse_session_create_node( int argc, VALUE *argv, VALUE self ) {
 	struct rbverse_session *session = rbverse_get_session( self );
 	VALUE nodeclass, callback, callback_queue;
-
-	if ( !session->id )
-		rb_raise( rbverse_eVerseSessionError, "can't create a node via an unconnected session" );
+	VNodeType nodetype;
 
 	rb_scan_args( argc, argv, "1&", &nodeclass, &callback );
-	callback_queue = rb_hash_aref( session->create_callbacks, nodeclass );
-
-	Check_Type( nodeclass, T_CLASS );
+	callback_queue = rbverse_session_create_callback_queue( session, nodeclass, &nodetype );
 
 	if ( !RTEST(callback) )
 		callback = rb_block_proc();
-	if ( !RTEST(callback_queue) )
-		rb_raise( rbverse_eVerseSessionError,
-		          "don't know how to create %s objects (no callback queue)",
-		          rb_class2name(nodeclass) );
 
 	/* Add the callback to the queue. This isn't done inside the lock as
 	 * we don't really care if the node callbacks are called strictly in the order
 	 * in which they're created. */
 	rb_ary_push( callback_queue, callback );
-	return rbverse_with_session_lock( self, rbverse_verse_session_create_node_l, nodeclass );
+
+	/* Cast: VNodeType -> VALUE */
+	return rbverse_with_session_lock( self, rbverse_verse_session_create_node_l, (VALUE)nodetype );
 }
 
 
-/* Synchronized portion of rbverse_verse_session_node_created() */
+/* Synchronized portion of rbverse_verse_session_create_nodes() */
 static VALUE
-rbverse_verse_session_node_created_l( VALUE args ) {
-	VALUE nodeobj = RARRAY_PTR(args)[0];
-	VALUE session = RARRAY_PTR(args)[1];
-	struct rbverse_node *node = rbverse_get_node( nodeobj );
-	VNodeOwner owner = (node->session == session ? VN_OWNER_MINE : VN_OWNER_OTHER);
+rbverse_verse_session_create_nodes_l( VALUE ptr ) {
+	struct rbverse_node_create_batch *batch = (struct rbverse_node_create_batch *)ptr;
+	long i;
 
-	verse_send_node_create( node->id, node->type, owner );
+	for ( i = 0; i < batch->count; i++ )
+		verse_send_node_create( ~0, batch->node_type, 0 );
 
 	return Qtrue;
 }
 
 
+/*
+ * call-seq:
+ *    session.create_nodes( nodeclass, count )   -> array
+ *
+ * Ask the server end of the session to create +count+ new nodes of the specified 
+ * +nodeclass+, returning a Verse::NodeFuture for each one. All of the requests are sent 
+ * while holding the session's lock once, so they're all in flight together instead of 
+ * each waiting on the last one's callback. 
+ * 
+ * Verse doesn't tag creation requests, so the futures are resolved in the order that
+ * the server reports new nodes of +nodeclass+ owned by this session.
+ * 
+ * @param [Class<Verse::Node>] nodeclass   the class of node that is to be created.
+ * @param [Integer] count                  the number of nodes to create
+ * @return [Array<Verse::NodeFuture>]  the futures for the new nodes
+ * @example Creating a scene's worth of ObjectNodes
+ *     futures = session.create_nodes( Verse::ObjectNode, 1000 )
+ *     nodes = Verse::NodeFuture.wait_all( futures, 5.0 )
+ */
+static VALUE
+rbverse_verse_session_create_nodes( VALUE self, VALUE nodeclass, VALUE count ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	struct rbverse_node_create_batch batch;
+	VALUE callback_queue, futures, future;
+	long i;
+
+	callback_queue = rbverse_session_create_callback_queue( session, nodeclass, &batch.node_type );
+	batch.count = NUM2LONG( count );
+	if ( batch.count < 0 )
+		rb_raise( rb_eArgError, "negative node count %ld", batch.count );
+
+	futures = rb_ary_new2( batch.count );
+	for ( i = 0; i < batch.count; i++ ) {
+		future = rb_class_new_instance( 1, &nodeclass, rbverse_cVerseNodeFuture );
+		rb_ary_push( futures, future );
+		rb_ary_push( callback_queue, future );
+	}
+
+	if ( batch.count )
+		rbverse_with_session_lock_n( self, rbverse_verse_session_create_nodes_l, (VALUE)&batch,
+		                             (unsigned long)batch.count );
+
+	return futures;
+}
+
+
+/* Synchronized portion of rbverse_verse_session_node_created() */
+static VALUE
+rbverse_verse_session_node_created_l( VALUE ptr ) {
+	struct rbverse_node_create_args *args = (struct rbverse_node_create_args *)ptr;
+	verse_send_node_create( args->node_id, args->node_type, args->node_owner );
+	return Qtrue;
+}
+
+
 /*
  * call-seq:
  *    session.node_created( node )
@@ -584,9 +1194,15 @@ rbverse_verse_session_node_created_l( VALUE args ) {
  * @param [Verse::Node] node  the new node object
  */
 static VALUE
-rbverse_verse_session_node_created( VALUE self, VALUE node ) {
-	VALUE args = rb_ary_new3( 2, node, self );
-	return rbverse_with_session_lock( self, rbverse_verse_session_node_created_l, args );
+rbverse_verse_session_node_created( VALUE self, VALUE nodeobj ) {
+	struct rbverse_node *node = rbverse_get_node( nodeobj );
+	struct rbverse_node_create_args args;
+
+	args.node_id    = node->id;
+	args.node_type  = node->type;
+	args.node_owner = ( node->session == self ? VN_OWNER_MINE : VN_OWNER_OTHER );
+
+	return rbverse_with_session_lock( self, rbverse_verse_session_node_created_l, (VALUE)&args );
 }
 
 
@@ -642,9 +1258,8 @@ rbverse_verse_session_destroy_node( int argc, VALUE *argv, VALUE self ) {
 
 /* Synchronized portion of rbverse_verse_session_node_destroyed() */
 static VALUE
-rbverse_verse_session_node_destroyed_l( VALUE nodeobj ) {
-	struct rbverse_node *node = rbverse_get_node( nodeobj );
-	verse_send_node_destroy( node->id );
+rbverse_verse_session_node_destroyed_l( VALUE node_id ) {
+	verse_send_node_destroy( (VNodeID)node_id );
 	return Qtrue;
 }
 
@@ -658,32 +1273,69 @@ rbverse_verse_session_node_destroyed_l( VALUE nodeobj ) {
  * @param [Verse::Node] node  the new node object
  */
 static VALUE
-rbverse_verse_session_node_destroyed( VALUE self, VALUE node ) {
-	return rbverse_with_session_lock( self, rbverse_verse_session_node_destroyed_l, node );
+rbverse_verse_session_node_destroyed( VALUE self, VALUE nodeobj ) {
+	struct rbverse_node *node = rbverse_get_node( nodeobj );
+
+	/* Cast: VNodeID -> VALUE */
+	return rbverse_with_session_lock( self, rbverse_verse_session_node_destroyed_l, (VALUE)node->id );
 }
 
 
+/*
+ * Ensure function for rbverse_verse_session_batch()
+ */
+static VALUE
+rbverse_verse_session_batch_ensure( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
 
+	session->batch_thread = Qnil;
+	rb_mutex_unlock( session->mutex );
+
+	return Qnil;
+}
 
-/* --------------------------------------------------------------
- * Callbacks
- * -------------------------------------------------------------- */
 
 /*
- * Iterator body for connect_accept observers.
+ * call-seq:
+ *    session.batch {|session| ... }   -> obj
+ *
+ * Hold the session's mutex for the duration of the block, so that any commands the
+ * current thread sends via the session inside it skip the per-command locking (and
+ * switching to the session, unless some other session was switched to in the 
+ * meantime). Other threads sending commands via the same session will wait until the
+ * block is finished. Batches can be nested. Returns the value of the block.
+ * 
+ * @yield [session]  the receiver
+ * @example Creating a bunch of nodes
+ *     session.batch do |s|
+ *         1000.times { s.create_node(Verse::ObjectNode) {|node| nodes << node } }
+ *     end
  */
 static VALUE
-rbverse_session_cb_connect_accept_i( VALUE observer, VALUE cb_args ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVerseSessionObserver) )
-		return Qnil;
+rbverse_verse_session_batch( VALUE self ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+	const VALUE thread = rb_thread_current();
+
+	if ( !rb_block_given_p() )
+		rb_raise( rb_eLocalJumpError, "no block given" );
 
-	rbverse_log( "debug", "Connect_accept callback: notifying observer: %s with args: %s.",
-	             RSTRING_PTR(rb_inspect( observer )), RSTRING_PTR(rb_inspect(cb_args)) );
-	return rb_funcall2( observer, rb_intern("on_connect_accept"),
-	                    RARRAY_LEN(cb_args), RARRAY_PTR(cb_args) );
+	/* Nested batches just run as part of the outer one */
+	if ( session->batch_thread == thread )
+		return rb_yield( self );
+
+	rb_mutex_lock( session->mutex );
+	session->batch_thread = thread;
+
+	return rb_ensure( rb_yield, self, rbverse_verse_session_batch_ensure, self );
 }
 
 
+
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
 /*
  * Ruby handler for the 'connect_accept' message; called after re-establishing the GVL
  * from rbverse_session_cb_connect_accept().
@@ -691,15 +1343,14 @@ rbverse_session_cb_connect_accept_i( VALUE observer, VALUE cb_args ) {
 static void *
 rbverse_session_cb_connect_accept_body( void *ptr ) {
 	struct rbverse_connect_accept_event *event = (struct rbverse_connect_accept_event *)ptr;
-	VALUE cb_args = rb_ary_new();
 	VALUE session = rbverse_get_current_session();
-	VALUE observers = rb_funcall( session, rb_intern("observers"), 0 );
+	VALUE cb_args[3];
 
-	rb_ary_push( cb_args, INT2FIX(event->avatar) );
-	rb_ary_push( cb_args, rb_str_new2(event->address) );
-	rb_ary_push( cb_args, rbverse_host_id2str(event->hostid) );
+	cb_args[0] = INT2FIX( event->avatar );
+	cb_args[1] = rb_str_new2( event->address );
+	cb_args[2] = rbverse_host_id2str( event->hostid );
 
-	rb_block_call( observers, rb_intern("each"), 0, 0, rbverse_session_cb_connect_accept_i, cb_args );
+	rbverse_notify_observers( session, RBVERSE_ON_CONNECT_ACCEPT, 3, cb_args );
 
 	return NULL;
 }
@@ -710,28 +1361,17 @@ rbverse_session_cb_connect_accept_body( void *ptr ) {
  */
 static void
 rbverse_session_cb_connect_accept( void *unused, VNodeID avatar, const char *address, uint8 *host_id ) {
-	struct rbverse_connect_accept_event event;
+	struct rbverse_connect_accept_event *event;
 
-	event.avatar  = avatar;
-	event.address = address;
-	event.hostid  = host_id;
+	event = rbverse_event_new( rbverse_session_cb_connect_accept_body, RBVERSE_ON_CONNECT_ACCEPT,
+		sizeof(struct rbverse_connect_accept_event), RBVERSE_EVENT_STRSIZE(address) );
 
-	rb_thread_call_with_gvl( rbverse_session_cb_connect_accept_body, (void *)&event );
-}
-
-
-/*
- * Iterator body for connect_terminate observers.
- */
-static VALUE
-rbverse_session_cb_connect_terminate_i( VALUE observer, VALUE cb_args ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVerseSessionObserver) )
-		return Qnil;
-
-	rbverse_log( "debug", "Connect_terminate callback: notifying observer: %s.",
-	             RSTRING_PTR(rb_inspect( observer )) );
-	return rb_funcall2( observer, rb_intern("on_connect_terminate"),
-	                    RARRAY_LEN(cb_args), RARRAY_PTR(cb_args) );
+	event->avatar  = avatar;
+	event->address = rbverse_event_strdup( event, address );
+	if ( host_id )
+		memcpy( event->hostid, host_id, V_HOST_ID_SIZE );
+	else
+		memset( event->hostid, 0, V_HOST_ID_SIZE );
 }
 
 
@@ -740,18 +1380,14 @@ rbverse_session_cb_connect_terminate_i( VALUE observer, VALUE cb_args ) {
  */
 static void *
 rbverse_session_cb_connect_terminate_body( void *ptr ) {
-	const char **args = (const char **)ptr;
-	const VALUE cb_args = rb_ary_new();
-	VALUE session, observers;
-
-	session = rbverse_get_current_session();
-	observers = rb_funcall( session, rb_intern("observers"), 0 );
+	struct rbverse_connect_terminate_event *event = (struct rbverse_connect_terminate_event *)ptr;
+	VALUE session = rbverse_get_current_session();
+	VALUE cb_args[2];
 
-	rb_ary_push( cb_args, rb_str_new2(args[0]) );
-	rb_ary_push( cb_args, rb_str_new2(args[1]) );
+	cb_args[0] = rb_str_new2( event->address );
+	cb_args[1] = rb_str_new2( event->message );
 
-	rb_block_call( observers, rb_intern("each"), 0, 0,
-	               rbverse_session_cb_connect_terminate_i, cb_args );
+	rbverse_notify_observers( session, RBVERSE_ON_CONNECT_TERMINATE, 2, cb_args );
 
 	return NULL;
 }
@@ -762,24 +1398,15 @@ rbverse_session_cb_connect_terminate_body( void *ptr ) {
  */
 static void
 rbverse_session_cb_connect_terminate( void *unused, const char *address, const char *msg ) {
-	const char *(args[2]) = { address, msg };
-	DEBUGMSG( " Acquiring GVL for 'connect_terminate' event.\n" );
-	fflush( stdout );
-	rb_thread_call_with_gvl( rbverse_session_cb_connect_terminate_body, args );
-}
+	struct rbverse_connect_terminate_event *event;
 
+	DEBUGMSG( " Queueing 'connect_terminate' event.\n" );
+	event = rbverse_event_new( rbverse_session_cb_connect_terminate_body, RBVERSE_ON_CONNECT_TERMINATE,
+		sizeof(struct rbverse_connect_terminate_event),
+		RBVERSE_EVENT_STRSIZE(address) + RBVERSE_EVENT_STRSIZE(msg) );
 
-/*
- * Iterator body for on_create_node observers.
- */
-static VALUE
-rbverse_session_on_create_node_i( VALUE observer, VALUE node_class ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVerseSessionObserver) )
-		return Qnil;
-
-	rbverse_log( "debug", "on_create_node callback: notifying observer: %s.",
-	             RSTRING_PTR(rb_inspect( observer )) );
-	return rb_funcall2( observer, rb_intern("on_create_node"), 1, &node_class );
+	event->address = rbverse_event_strdup( event, address );
+	event->message = rbverse_event_strdup( event, msg );
 }
 
 
@@ -787,61 +1414,102 @@ rbverse_session_on_create_node_i( VALUE observer, VALUE node_class ) {
 static void
 rbverse_session_call_on_create_node( struct rbverse_node_create_event *event ) {
 	const VALUE self = rbverse_get_current_session();
-	const VALUE observers = rb_funcall( self, rb_intern("observers"), 0 );
 	VALUE node_class = rbverse_node_class_from_node_type( event->node_type );
 
-	rb_block_call( observers, rb_intern("each"), 0, 0,
-	               rbverse_session_on_create_node_i, node_class );
+	rbverse_notify_observers( self, RBVERSE_ON_CREATE_NODE, 1, &node_class );
 }
 
 
 /*
- * Iterator body for node_create observers.
+ * Announce the node described by +record+ to the given +session+'s observers with 
+ * #on_node_created, calling the creation +callback+ with it first if there is one. The 
+ * node's Verse::Node object is only created if there's someone to pass it to.
  */
-static VALUE
-rbverse_session_on_node_created_i( VALUE observer, VALUE node ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVerseSessionObserver) )
-		return Qnil;
+void
+rbverse_session_announce_node( VALUE self, struct rbverse_node_record *record, VALUE callback ) {
+	VALUE node = Qnil;
+
+	if ( !RTEST(callback) && !rbverse_has_observers(self, RBVERSE_ON_NODE_CREATED) ) {
+		DEBUGMSG( "  not wrapping node %u: nothing's interested in it yet", record->id );
+		return;
+	}
+
+	node = rbverse_wrap_verse_node( self, record );
+
+	if ( RTEST(callback) ) {
+		rbverse_log_with_context( self, "debug", "calling create callback %s for node %s",
+		                          RSTRING_PTR(rb_inspect( callback )),
+		                          RSTRING_PTR(rb_inspect( node )) );
+		rb_funcall3( callback, rbverse_id_call, 1, &node );
+	} else {
+		rbverse_log_with_context( self, "debug", "no creation callback for node %s",
+		                          RSTRING_PTR(rb_inspect( node )) );
+	}
+
+	/* Now notify the session's observers that a node was created */
+	rbverse_notify_observers( self, RBVERSE_ON_NODE_CREATED, 1, &node );
+}
+
+
+/*
+ * Keep the Verse::Node object for +node+ alive while it's in the node table of the 
+ * session +self+, even if the application drops every reference to it. The node table
+ * only holds nodes weakly, so this is for nodes that keep state on their object which 
+ * the server won't send again, like a geometry node's layers and bones.
+ */
+void
+rbverse_session_pin_node( VALUE self, struct rbverse_node *node ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+
+	if ( NIL_P(session->pinned_nodes) ) session->pinned_nodes = rb_hash_new();
+	rb_hash_aset( session->pinned_nodes, UINT2NUM(node->id), node->wrapper );
+}
 
-	rbverse_log( "debug", "on_node_created callback: notifying observer: %s.",
-	             RSTRING_PTR(rb_inspect( observer )) );
-	return rb_funcall2( observer, rb_intern("on_node_created"), 1, &node );
+
+/*
+ * Let the object for the node with the given +id+ be collected again once nothing else
+ * refers to it.
+ */
+void
+rbverse_session_unpin_node( VALUE self, VNodeID id ) {
+	struct rbverse_session *session = rbverse_get_session( self );
+
+	if ( NIL_P(session->pinned_nodes) ) return;
+	rb_hash_delete( session->pinned_nodes, UINT2NUM(id) );
 }
 
 
-/* Build a call to #on_node_created for the session's observers and call them. */
+/* 
+ * Record the node in the session's node table, then announce it unless the session's
+ * node filter rejects it or wants to wait for its name or tags.
+ */
 static void
 rbverse_session_call_on_node_created( struct rbverse_node_create_event *event ) {
 	const VALUE self = rbverse_get_current_session();
 	struct rbverse_session *session = rbverse_get_session( self );
-	const VALUE observers = rb_funcall( self, rb_intern("observers"), 0 );
-	const VALUE node =
-		rbverse_wrap_verse_node( event->node_id, event->node_type, event->node_owner );
-	const VALUE cb_queue = rb_hash_aref( session->create_callbacks, CLASS_OF(node) );
-	VALUE callback = Qnil;
+	struct rbverse_node_record *record = rbverse_node_table_lookup( &session->nodes, event->node_id );
+	VALUE node_class = rbverse_node_class_from_node_type( event->node_type );
+	VALUE cb_queue = Qnil, callback = Qnil;
 
-	/* Set the node's session */
-	rb_funcall2( node, rb_intern("session="), 1, &self );
+	/* A stale record for a re-used ID might still be held by the filter */
+	if ( record ) {
+		rbverse_session_filter_release( self, record );
+		rbverse_session_unpin_node( self, event->node_id );
+	}
+	record = rbverse_node_table_insert( &session->nodes, event->node_id, event->node_type, 
+	                                    event->node_owner );
 
 	/* If this session was the node's creator, and there's a creation
 	 * callback queue for the class of node that was created, and there's a callback in
-	 * the queue, shift it off and call it with the node object. */
-	if ( event->node_owner == VN_OWNER_MINE &&
-	     RTEST(cb_queue) &&
-	     RTEST(callback = rb_ary_shift(cb_queue)) )
-	{
-		rbverse_log_with_context( self, "debug", "calling create callback %p for node %p",
-		                          RSTRING_PTR(rb_inspect( callback )),
-		                          RSTRING_PTR(rb_inspect( node )) );
-		rb_funcall3( callback, rb_intern("call"), 1, &node );
-	} else {
-		rbverse_log_with_context( self, "debug", "no creation callback for node %p",
-		                          RSTRING_PTR(rb_inspect( node )) );
-	}
+	 * the queue, shift it off to call it with the node object. */
+	if ( event->node_owner == VN_OWNER_MINE && RTEST(node_class) &&
+	     RTEST(cb_queue = rb_hash_aref(session->create_callbacks, node_class)) )
+		callback = rb_ary_shift( cb_queue );
 
-	/* Now notify the session's observers that a node was created */
-	rb_block_call( observers, rb_intern("each"), 0, 0,
-	               rbverse_session_on_node_created_i, node );
+	/* Nodes that were asked for are always announced */
+	if ( !RTEST(callback) && !rbverse_session_filter_node(self, record) ) return;
+
+	rbverse_session_announce_node( self, record, callback );
 }
 
 
@@ -875,49 +1543,56 @@ rbverse_session_cb_node_create_body( void *ptr ) {
  */
 static void
 rbverse_session_cb_node_create( void *unused, VNodeID node_id, VNodeType type, VNodeOwner owner ) {
-	struct rbverse_node_create_event event;
+	struct rbverse_node_create_event *event;
 
-	event.node_id    = node_id;
-	event.node_type  = type;
-	event.node_owner = owner;
+	DEBUGMSG( " Queueing 'node_create' event.\n" );
+	event = rbverse_event_new( rbverse_session_cb_node_create_body,
+		node_id == ~0 ? RBVERSE_ON_CREATE_NODE : RBVERSE_ON_NODE_CREATED,
+		sizeof(struct rbverse_node_create_event), 0 );
 
-	DEBUGMSG( " Acquiring GVL for 'node_create' event.\n" );
-	fflush( stdout );
-
-	rb_thread_call_with_gvl( rbverse_session_cb_node_create_body, (void *)&event );
+	event->node_id    = node_id;
+	event->node_type  = type;
+	event->node_owner = owner;
 }
 
 
 
-/*
- * Iterator body for node_destroy observers.
- */
-static VALUE
-rbverse_session_cb_node_destroy_i( VALUE observer, VALUE node ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVerseSessionObserver) )
-		return Qnil;
-
-	rbverse_log( "debug", "Node_destroy callback: notifying observer: %s.",
-	             RSTRING_PTR(rb_inspect( observer )) );
-	return rb_funcall2( observer, rb_intern("on_node_destroy"), 1, &node );
-}
-
-
 /*
  * Call the node_destroy handler after aqcuiring the GVL.
  */
 static void *
 rbverse_session_cb_node_destroy_body( void *ptr ) {
 	VNodeID *node_id = (VNodeID *)ptr;
-	VALUE node;
+	VALUE session = rbverse_get_current_session();
+	struct rbverse_node_table *table = NULL;
+	struct rbverse_node_record *record = NULL;
+	VALUE node = Qnil;
+
+	if ( !NIL_P(session) ) {
+		table = &rbverse_get_session( session )->nodes;
+		record = rbverse_node_table_lookup( table, *node_id );
+	}
+
+	if ( !record ) {
+		rbverse_log( "info", "destroy event received for unknown node %x", *node_id );
+		return NULL;
+	}
+
+	/* Only wrap the node if it has been already, or if there's someone to tell. Nodes that
+	 * the node filter held back or rejected were never announced, so aren't either. */
+	if ( record->node || 
+	     (!(record->flags & (RBVERSE_NODE_RECORD_PENDING|RBVERSE_NODE_RECORD_REJECTED)) &&
+	      rbverse_has_observers(session, RBVERSE_ON_NODE_DESTROY)) )
+		node = rbverse_wrap_verse_node( session, record );
 
-	if ( RTEST(node = rbverse_lookup_verse_node( *node_id )) ) {
-		VALUE session = rb_funcall( node, rb_intern("session"), 0 );
-		VALUE observers = rb_funcall( session, rb_intern("observers"), 0 );
+	rbverse_session_filter_release( session, record );
+	rbverse_session_unpin_node( session, *node_id );
+
+	rbverse_node_table_delete( table, record );
+
+	if ( !NIL_P(node) ) {
 		rbverse_mark_node_destroyed( node );
-		rb_block_call( observers, rb_intern("each"), 0, 0, rbverse_session_cb_node_destroy_i, node );
-	} else {
-		rbverse_log( "info", "destroy event received for unwrapped node %x", node_id );
+		rbverse_notify_observers( session, RBVERSE_ON_NODE_DESTROY, 1, &node );
 	}
 
 	return NULL;
@@ -928,10 +1603,12 @@ rbverse_session_cb_node_destroy_body( void *ptr ) {
  */
 static void
 rbverse_session_cb_node_destroy( void *unused, VNodeID node_id ) {
-	DEBUGMSG( " Acquiring GVL for 'node_destroy' event.\n" );
-	fflush( stdout );
+	VNodeID *event;
 
-	rb_thread_call_with_gvl( rbverse_session_cb_node_destroy_body, (void *)&node_id );
+	DEBUGMSG( " Queueing 'node_destroy' event.\n" );
+	event = rbverse_event_new( rbverse_session_cb_node_destroy_body, RBVERSE_ON_NODE_DESTROY,
+		sizeof(VNodeID), 0 );
+	*event = node_id;
 }
 
 
@@ -943,8 +1620,13 @@ void
 rbverse_init_verse_session( void ) {
 	rbverse_log( "debug", "Initializing Verse::Session" );
 
+	rbverse_id_call = rb_intern( "call" );
+
 	session_table = st_init_numtable();
-	rbverse_session_mutex = rb_mutex_new();
+	rbverse_session_table_obj = TypedData_Wrap_Struct( 0, &rbverse_session_table_data_type,
+	                                                   session_table );
+	rb_gc_register_address( &rbverse_session_table_obj );
+	rbverse_pool_init( &rbverse_session_pool, "session", sizeof(struct rbverse_session) );
 
 #ifdef FOR_RDOC
 	rbverse_mVerse = rb_define_module( "Verse" );
@@ -953,6 +1635,8 @@ rbverse_init_verse_session( void ) {
 	/* Related modules */
 	rbverse_mVerseSessionObserver =
 		rb_define_module_under( rbverse_mVerse, "SessionObserver" );
+	rbverse_cVerseNodeFuture =
+		rb_define_class_under( rbverse_mVerse, "NodeFuture", rb_cObject );
 
 	/* Class methods */
 	rbverse_cVerseSession = rb_define_class_under( rbverse_mVerse, "Session", rb_cObject );
@@ -961,8 +1645,6 @@ rbverse_init_verse_session( void ) {
 
 	rb_define_alloc_func( rbverse_cVerseSession, rbverse_verse_session_s_allocate );
 
-	rb_attr( rb_singleton_class(rbverse_cVerseSession), rb_intern("mutex"), Qtrue, Qfalse, Qtrue );
-	rb_iv_set( rbverse_cVerseSession, "@mutex", rbverse_session_mutex );
 	rb_define_singleton_method( rbverse_cVerseSession, "all_connected",
 	                            rbverse_verse_session_s_all_connected, 0 );
 
@@ -974,20 +1656,33 @@ rbverse_init_verse_session( void ) {
 	rb_define_method( rbverse_cVerseSession, "address=", rbverse_verse_session_address_eq, 1 );
 
 	rb_define_method( rbverse_cVerseSession, "connected?", rbverse_verse_session_connected_p, 0 );
+	rb_define_method( rbverse_cVerseSession, "mutex", rbverse_verse_session_mutex, 0 );
+	rb_define_method( rbverse_cVerseSession, "traffic", rbverse_verse_session_traffic, 0 );
+
+	rb_define_method( rbverse_cVerseSession, "node", rbverse_verse_session_node, 1 );
+	rb_define_method( rbverse_cVerseSession, "node_count", rbverse_verse_session_node_count, 0 );
+	rb_define_method( rbverse_cVerseSession, "node_filter", rbverse_verse_session_node_filter, 0 );
+	rb_define_method( rbverse_cVerseSession, "node_filter=", rbverse_verse_session_node_filter_eq, 1 );
+	rb_define_method( rbverse_cVerseSession, "node_filter_stats",
+	                  rbverse_verse_session_node_filter_stats, 0 );
 
 	rb_define_method( rbverse_cVerseSession, "connect", rbverse_verse_session_connect, -1 );
 	rb_define_method( rbverse_cVerseSession, "terminate", rbverse_verse_session_terminate, 1 );
 
+	rb_define_method( rbverse_cVerseSession, "batch", rbverse_verse_session_batch, 0 );
+
 	rb_define_method( rbverse_cVerseSession, "subscribe_to_node_index",
 	                  rbverse_verse_session_subscribe_to_node_index, -1 );
 
 	rb_define_method( rbverse_cVerseSession, "create_node",
 	                  rbverse_verse_session_create_node, -1 );
+	rb_define_method( rbverse_cVerseSession, "create_nodes",
+	                  rbverse_verse_session_create_nodes, 2 );
 	rb_define_method( rbverse_cVerseSession, "destroy_node",
 	                  rbverse_verse_session_destroy_node, -1 );
 
 	rb_define_method( rbverse_cVerseSession, "node_created",
-	                  rbverse_verse_session_node_created, 2 );
+	                  rbverse_verse_session_node_created, 1 );
 	rb_define_method( rbverse_cVerseSession, "node_destroyed",
 	                  rbverse_verse_session_node_destroyed, 1 );
 
@@ -1001,9 +1696,9 @@ rbverse_init_verse_session( void ) {
 
 	// node_name_set(VNodeID node_id, const char *name);
 
-	verse_callback_set( verse_send_connect_accept, rbverse_session_cb_connect_accept, NULL );
-	verse_callback_set( verse_send_connect_terminate, rbverse_session_cb_connect_terminate, NULL );
-	verse_callback_set( verse_send_node_create, rbverse_session_cb_node_create, NULL );
-	verse_callback_set( verse_send_node_destroy, rbverse_session_cb_node_destroy, NULL );
+	RBVERSE_CALLBACK_SET( connect_accept, rbverse_session_cb_connect_accept );
+	RBVERSE_CALLBACK_SET( connect_terminate, rbverse_session_cb_connect_terminate );
+	RBVERSE_CALLBACK_SET( node_create, rbverse_session_cb_node_create );
+	RBVERSE_CALLBACK_SET( node_destroy, rbverse_session_cb_node_destroy );
 }
 
@@ -0,0 +1,622 @@
+/*
+ * Verse stats -- counters and latency histograms for Verse.stats
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+
+#include "verse_ext.h"
+
+/*
+ * The extension keeps counters of the events it receives and dispatches, and 
+ * histograms of how long updates, observer calls, and getting the GVL back take, but 
+ * only while Verse.stats_enabled is set. When it isn't, each instrumentation point is
+ * a single test of rbverse_stats_enabled.
+ * 
+ * The histograms are log-linear, like HdrHistogram: each power of two is split into
+ * RBVERSE_HISTOGRAM_SUB_COUNT buckets, so recording a value is a couple of shifts, and
+ * the percentiles they report are within 12.5% of the real value.
+ */
+
+int rbverse_stats_enabled = 0;
+struct rbverse_stats rbverse_stats;
+
+/* Observer calls that take longer than this many µs are logged; 0 means no budget */
+uint64_t rbverse_observer_budget = 0;
+
+/* Time spent in each of one observer's callbacks, for Verse.slowest_observers */
+struct rbverse_observer_profile {
+	VALUE observer;
+	struct {
+		unsigned long calls;
+		unsigned long over_budget;
+		uint64_t      usec;
+		uint64_t      max_usec;
+	} events[ RBVERSE_OBSERVER_EVENT_COUNT ];
+};
+
+/* The profiles of every observer that's been called while stats were enabled, keyed by
+ * observer, and the object that makes the table a GC root */
+static st_table *observer_profiles;
+static VALUE observer_profiles_obj;
+
+/* Names of the event kinds that aren't observer callbacks */
+static const char *rbverse_server_event_methods[] = {
+	"on_connect",
+	"on_node_index_subscribe",
+	"geometry_set",
+};
+
+/* Percentiles reported for each histogram */
+static const struct {
+	const char *name;
+	double     percentile;
+} rbverse_histogram_percentiles[] = {
+	{ "p50",  50.0 },
+	{ "p90",  90.0 },
+	{ "p99",  99.0 },
+	{ "p999", 99.9 },
+};
+
+
+/*
+ * Return the name of the observer method for the given +kind+ of event.
+ */
+const char *
+rbverse_event_kind_name( int kind ) {
+	if ( kind < RBVERSE_OBSERVER_EVENT_COUNT )
+		return rbverse_observer_event_method( kind );
+	else
+		return rbverse_server_event_methods[ kind - RBVERSE_OBSERVER_EVENT_COUNT ];
+}
+
+
+
+/* --------------------------------------------------------------
+ * Histograms
+ * -------------------------------------------------------------- */
+
+/* Return the position of the highest bit set in +value+, which must be non-zero. */
+static inline int
+rbverse_histogram_msb( uint64_t value ) {
+#ifdef __GNUC__
+	return 63 - __builtin_clzll( value );
+#else
+	int msb = 0;
+	while ( value >>= 1 ) msb++;
+	return msb;
+#endif
+}
+
+
+/* Return the index of the bucket +value+ falls in. */
+static inline int
+rbverse_histogram_index( uint64_t value ) {
+	int msb;
+
+	if ( value < RBVERSE_HISTOGRAM_SUB_COUNT ) return (int)value;
+	if ( value >> RBVERSE_HISTOGRAM_MAX_BITS ) 
+		value = ( (uint64_t)1 << RBVERSE_HISTOGRAM_MAX_BITS ) - 1;
+
+	msb = rbverse_histogram_msb( value );
+	return RBVERSE_HISTOGRAM_SUB_COUNT * ( msb - RBVERSE_HISTOGRAM_SUB_BITS + 1 ) +
+		(int)( (value >> (msb - RBVERSE_HISTOGRAM_SUB_BITS)) & (RBVERSE_HISTOGRAM_SUB_COUNT - 1) );
+}
+
+
+/* Return the highest value that falls in the bucket with the given +index+. */
+static uint64_t
+rbverse_histogram_bucket_max( int index ) {
+	int shift;
+
+	if ( index < RBVERSE_HISTOGRAM_SUB_COUNT ) return (uint64_t)index;
+
+	shift = index / RBVERSE_HISTOGRAM_SUB_COUNT - 1;
+	return ( (uint64_t)(RBVERSE_HISTOGRAM_SUB_COUNT + index % RBVERSE_HISTOGRAM_SUB_COUNT + 1)
+		<< shift ) - 1;
+}
+
+
+/*
+ * Add a +value+ (in µs) to the given +histogram+. This must be called with the GVL held.
+ */
+void
+rbverse_histogram_record( struct rbverse_histogram *histogram, uint64_t value ) {
+	if ( !histogram->count || value < histogram->min ) histogram->min = value;
+	if ( value > histogram->max ) histogram->max = value;
+
+	histogram->count++;
+	histogram->total += value;
+	histogram->buckets[ rbverse_histogram_index(value) ]++;
+}
+
+
+/*
+ * Return the value below which +percentile+ percent of the values in the +histogram+ 
+ * fall.
+ */
+static uint64_t
+rbverse_histogram_percentile( const struct rbverse_histogram *histogram, double percentile ) {
+	const uint64_t wanted = (uint64_t)ceil( histogram->count * percentile / 100.0 );
+	uint64_t seen = 0, value;
+	int i;
+
+	for ( i = 0; i < RBVERSE_HISTOGRAM_BUCKETS; i++ ) {
+		if ( (seen += histogram->buckets[i]) >= wanted ) {
+			value = rbverse_histogram_bucket_max( i );
+			return value > histogram->max ? histogram->max : value;
+		}
+	}
+
+	return histogram->max;
+}
+
+
+/*
+ * Return a frozen Hash describing the given +histogram+.
+ */
+static VALUE
+rbverse_histogram_to_hash( const struct rbverse_histogram *histogram ) {
+	VALUE hash = rb_hash_new();
+	size_t i;
+
+	rb_hash_aset( hash, ID2SYM(rb_intern("count")), ULL2NUM(histogram->count) );
+	rb_hash_aset( hash, ID2SYM(rb_intern("min")), ULL2NUM(histogram->min) );
+	rb_hash_aset( hash, ID2SYM(rb_intern("max")), ULL2NUM(histogram->max) );
+	rb_hash_aset( hash, ID2SYM(rb_intern("mean")),
+	              rb_float_new(histogram->count ? (double)histogram->total / histogram->count : 0.0) );
+
+	for ( i = 0; i < sizeof(rbverse_histogram_percentiles) / sizeof(rbverse_histogram_percentiles[0]); i++ ) {
+		rb_hash_aset( hash, ID2SYM(rb_intern(rbverse_histogram_percentiles[i].name)), 
+		              ULL2NUM(histogram->count ? 
+		                      rbverse_histogram_percentile(histogram, rbverse_histogram_percentiles[i].percentile) :
+		                      0) );
+	}
+
+	return rb_obj_freeze( hash );
+}
+
+
+
+/* --------------------------------------------------------------
+ * Observer profiles
+ * -------------------------------------------------------------- */
+
+/* Iterator for rbverse_observer_profiles_gc_mark() */
+static int
+rbverse_observer_profiles_gc_mark_i( st_data_t key, st_data_t value, st_data_t unused ) {
+	struct rbverse_observer_profile *profile = (struct rbverse_observer_profile *)value;
+	rb_gc_mark( profile->observer );
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Mark function for the table of observer profiles. Profiled observers are kept alive 
+ * (and pinned, since they're the table's keys) until the stats are reset.
+ */
+static void
+rbverse_observer_profiles_gc_mark( void *data ) {
+	st_table *table = data;
+	if ( table ) st_foreach( table, rbverse_observer_profiles_gc_mark_i, 0 );
+}
+
+
+/* Typed data type of the object that makes the table of observer profiles a GC root */
+static const rb_data_type_t rbverse_observer_profiles_data_type = {
+	.wrap_struct_name = "Verse::ObserverProfiles",
+	.function = {
+		.dmark = rbverse_observer_profiles_gc_mark,
+	},
+};
+
+
+/* Iterator for rbverse_observer_profiles_clear() */
+static int
+rbverse_observer_profiles_clear_i( st_data_t key, st_data_t value, st_data_t unused ) {
+	xfree( (void *)value );
+	return ST_DELETE;
+}
+
+
+/* Discard all of the observer profiles. */
+static void
+rbverse_observer_profiles_clear( void ) {
+	st_foreach( observer_profiles, rbverse_observer_profiles_clear_i, 0 );
+}
+
+
+/*
+ * Record a call to the +event+ callback of +observer+ that took +usec+ µs, and warn 
+ * about it if it went over the Verse.observer_budget. This must be called with the GVL
+ * held.
+ */
+void
+rbverse_observer_call_record( VALUE observer, enum rbverse_observer_event event, uint64_t usec ) {
+	struct rbverse_observer_profile *profile = NULL;
+	const int over_budget = ( rbverse_observer_budget && usec > rbverse_observer_budget );
+
+	if ( rbverse_stats_enabled ) {
+		rbverse_histogram_record( &rbverse_stats.observer_call, usec );
+		rbverse_stats.events[ event ].notified++;
+
+		if ( !st_lookup(observer_profiles, (st_data_t)observer, (st_data_t *)&profile) ) {
+			profile = ALLOC( struct rbverse_observer_profile );
+			MEMZERO( profile, struct rbverse_observer_profile, 1 );
+			profile->observer = observer;
+			st_insert( observer_profiles, (st_data_t)observer, (st_data_t)profile );
+		}
+
+		profile->events[ event ].calls++;
+		profile->events[ event ].usec += usec;
+		if ( usec > profile->events[ event ].max_usec ) profile->events[ event ].max_usec = usec;
+		if ( over_budget ) profile->events[ event ].over_budget++;
+	}
+
+	if ( over_budget )
+		rbverse_log( "warn", "%s#%s took %.3fms, over the %.3fms observer budget",
+		             rb_obj_classname(observer), rbverse_observer_event_method(event),
+		             usec / 1000.0, rbverse_observer_budget / 1000.0 );
+}
+
+
+/* One observer callback's entry in Verse.slowest_observers */
+struct rbverse_observer_entry {
+	struct rbverse_observer_profile *profile;
+	int event;
+};
+
+/* Iterator for rbverse_verse_s_slowest_observers(); collects the entries of one profile. */
+static int
+rbverse_verse_s_slowest_observers_i( st_data_t key, st_data_t value, st_data_t data ) {
+	struct rbverse_observer_profile *profile = (struct rbverse_observer_profile *)value;
+	struct rbverse_observer_entry **entry = (struct rbverse_observer_entry **)data;
+	int event;
+
+	for ( event = 0; event < RBVERSE_OBSERVER_EVENT_COUNT; event++ ) {
+		if ( !profile->events[ event ].calls ) continue;
+		(*entry)->profile = profile;
+		(*entry)->event   = event;
+		(*entry)++;
+	}
+
+	return ST_CONTINUE;
+}
+
+
+/* qsort() comparison function that orders entries by descending total time */
+static int
+rbverse_observer_entry_cmp( const void *a, const void *b ) {
+	const struct rbverse_observer_entry *entry_a = a, *entry_b = b;
+	const uint64_t usec_a = entry_a->profile->events[ entry_a->event ].usec;
+	const uint64_t usec_b = entry_b->profile->events[ entry_b->event ].usec;
+
+	return ( usec_a < usec_b ) - ( usec_a > usec_b );
+}
+
+
+/*
+ * call-seq:
+ *    Verse.slowest_observers( limit=10 )   -> array
+ *
+ * Returns an Array of up to +limit+ frozen Hashes describing the observer callbacks 
+ * that have taken the most time in total since the stats were enabled or last reset, 
+ * slowest first. Each one has the +:observer+, the callback +:method+, the number of
+ * +:calls+, their +:total+, +:mean+, and +:max+ time in µs, and how many of them were 
+ * +:over_budget+ (see Verse.observer_budget=).
+ * 
+ * Profiled observers are kept alive until Verse.reset_stats is called.
+ *
+ * @example
+ *    Verse.stats_enabled = true
+ *    Verse.update until done
+ *    Verse.slowest_observers( 1 )
+ *    # => [{:observer=>#<IndexWatcher...>, :method=>:on_node_created, :calls=>2000, 
+ *    #      :total=>1848310, :mean=>924.155, :max=>10221, :over_budget=>0}]
+ */
+static VALUE
+rbverse_verse_s_slowest_observers( int argc, VALUE *argv, VALUE module ) {
+	struct rbverse_observer_entry *entries, *entry;
+	VALUE limitobj, rval = rb_ary_new(), hash, buffer;
+	long limit = 10, count, i;
+
+	if ( rb_scan_args(argc, argv, "01", &limitobj) ) limit = NUM2LONG( limitobj );
+
+	entries = entry = ALLOCV_N( struct rbverse_observer_entry, buffer,
+		observer_profiles->num_entries * RBVERSE_OBSERVER_EVENT_COUNT + 1 );
+	st_foreach( observer_profiles, rbverse_verse_s_slowest_observers_i, (st_data_t)&entry );
+
+	count = entry - entries;
+	qsort( entries, count, sizeof(struct rbverse_observer_entry), rbverse_observer_entry_cmp );
+
+	for ( i = 0; i < count && i < limit; i++ ) {
+		struct rbverse_observer_profile *profile = entries[i].profile;
+		const int event = entries[i].event;
+
+		hash = rb_hash_new();
+		rb_hash_aset( hash, ID2SYM(rb_intern("observer")), profile->observer );
+		rb_hash_aset( hash, ID2SYM(rb_intern("method")),
+		              ID2SYM(rb_intern(rbverse_observer_event_method(event))) );
+		rb_hash_aset( hash, ID2SYM(rb_intern("calls")), ULONG2NUM(profile->events[event].calls) );
+		rb_hash_aset( hash, ID2SYM(rb_intern("total")), ULL2NUM(profile->events[event].usec) );
+		rb_hash_aset( hash, ID2SYM(rb_intern("mean")),
+		              rb_float_new((double)profile->events[event].usec / profile->events[event].calls) );
+		rb_hash_aset( hash, ID2SYM(rb_intern("max")), ULL2NUM(profile->events[event].max_usec) );
+		rb_hash_aset( hash, ID2SYM(rb_intern("over_budget")),
+		              ULONG2NUM(profile->events[event].over_budget) );
+
+		rb_ary_push( rval, rb_obj_freeze(hash) );
+	}
+
+	ALLOCV_END( buffer );
+	return rval;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.observer_budget   -> float or nil
+ *
+ * Returns the number of seconds an observer callback can take before a warning is 
+ * logged about it, or +nil+ if there's no budget.
+ *
+ */
+static VALUE
+rbverse_verse_s_observer_budget( VALUE module ) {
+	if ( !rbverse_observer_budget ) return Qnil;
+	return rb_float_new( rbverse_observer_budget / 1000000.0 );
+}
+
+
+/*
+ * call-seq:
+ *    Verse.observer_budget = seconds or nil
+ *
+ * Set the number of +seconds+ an observer callback can take before a warning is logged
+ * about it. Since observers are called while the network is being serviced, one that
+ * takes too long delays updates for every session. Setting it to +nil+ (the default)
+ * turns the warnings off. The calls that go over are also counted in 
+ * Verse.slowest_observers while stats are enabled.
+ *
+ * @example
+ *    Verse.observer_budget = 0.005
+ *    # Logs: "IndexWatcher#on_node_created took 12.408ms, over the 5.000ms observer budget"
+ */
+static VALUE
+rbverse_verse_s_observer_budget_eq( VALUE module, VALUE seconds ) {
+	double budget;
+
+	if ( NIL_P(seconds) ) {
+		rbverse_observer_budget = 0;
+	} else {
+		if ( (budget = NUM2DBL( seconds )) <= 0.0 )
+			rb_raise( rb_eArgError, "budget must be positive" );
+		rbverse_observer_budget = (uint64_t)( budget * 1000000.0 );
+		if ( !rbverse_observer_budget ) rbverse_observer_budget = 1;
+	}
+
+	return seconds;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Ruby API
+ * -------------------------------------------------------------- */
+
+/* Iterator for rbverse_verse_s_stats(); adds the stats for one session. */
+static int
+rbverse_verse_s_stats_session_i( VSession id, VALUE sessionobj, st_data_t data ) {
+	struct rbverse_session *session = rbverse_get_session( sessionobj );
+	VALUE sessions = (VALUE)data;
+	VALUE stats = rb_hash_new();
+
+	rb_hash_aset( stats, ID2SYM(rb_intern("commands_sent")), ULONG2NUM(session->commands_sent) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("slices")), ULONG2NUM(session->slices) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("slice_usec")), ULL2NUM(session->slice_usec) );
+
+	rb_hash_aset( sessions, sessionobj, rb_obj_freeze(stats) );
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.stats   -> hash
+ *
+ * Returns a frozen Hash of what the extension has done since the stats were enabled or
+ * last reset (see Verse.stats_enabled= and Verse.reset_stats). Its keys are:
+ * 
+ * [:enabled]        whether stats are being collected
+ * [:events]         a Hash, keyed by observer callback name, of Hashes with the number 
+ *                   of events of that kind that were +:received+ from Verse and 
+ *                   +:dispatched+, the +:dispatch_usec+ spent dispatching them, and 
+ *                   the number of observers +:notified+
+ * [:nodes_wrapped]  the number of Verse::Node objects created for known nodes
+ * [:nodes_freed]    the number of Verse::Node objects freed
+ * [:update]         a histogram of the time spent in each Verse.update call
+ * [:slice]          a histogram of the time spent reading each session in an update
+ * [:gvl_wait]       a histogram of how long it took to get the GVL back after reading 
+ *                   the network
+ * [:observer_call]  a histogram of the time spent in each observer callback
+ * [:sessions]       a Hash, keyed by connected Verse::Session, of Hashes with the number 
+ *                   of +:commands_sent+ via the session, and the number of update 
+ *                   +:slices+ it's had and the +:slice_usec+ they took
+ * 
+ * Each histogram is a Hash of its +:count+, and the +:min+, +:max+, +:mean+, +:p50+,
+ * +:p90+, +:p99+ and +:p999+ of its values, in µs. 
+ * 
+ * Verse doesn't report how many bytes it sends, so there's no count of those.
+ *
+ * @example
+ *    Verse.stats_enabled = true
+ *    Verse.update
+ *    Verse.stats[:update][:p99]  # => 1480
+ */
+static VALUE
+rbverse_verse_s_stats( VALUE module ) {
+	unsigned long received[ RBVERSE_EVENT_KIND_COUNT ];
+	VALUE stats = rb_hash_new();
+	VALUE events = rb_hash_new(), sessions = rb_hash_new();
+	VALUE eventstats;
+	const char *method;
+	int kind;
+
+	rbverse_event_received_counts( received, FALSE );
+
+	for ( kind = 0; kind < RBVERSE_EVENT_KIND_COUNT; kind++ ) {
+		method = rbverse_event_kind_name( kind );
+		eventstats = rb_hash_new();
+		rb_hash_aset( eventstats, ID2SYM(rb_intern("received")), ULONG2NUM(received[kind]) );
+		rb_hash_aset( eventstats, ID2SYM(rb_intern("dispatched")),
+		              ULONG2NUM(rbverse_stats.events[kind].dispatched) );
+		rb_hash_aset( eventstats, ID2SYM(rb_intern("dispatch_usec")),
+		              ULL2NUM(rbverse_stats.events[kind].dispatch_usec) );
+		rb_hash_aset( eventstats, ID2SYM(rb_intern("notified")),
+		              ULONG2NUM(rbverse_stats.events[kind].notified) );
+
+		rb_hash_aset( events, ID2SYM(rb_intern(method)), rb_obj_freeze(eventstats) );
+	}
+
+	st_foreach( session_table, rbverse_verse_s_stats_session_i, (st_data_t)sessions );
+
+	rb_hash_aset( stats, ID2SYM(rb_intern("enabled")), rbverse_stats_enabled ? Qtrue : Qfalse );
+	rb_hash_aset( stats, ID2SYM(rb_intern("events")), rb_obj_freeze(events) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("nodes_wrapped")), ULONG2NUM(rbverse_stats.nodes_wrapped) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("nodes_freed")), ULONG2NUM(rbverse_stats.nodes_freed) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("update")), rbverse_histogram_to_hash(&rbverse_stats.update) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("slice")), rbverse_histogram_to_hash(&rbverse_stats.slice) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("gvl_wait")), rbverse_histogram_to_hash(&rbverse_stats.gvl_wait) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("observer_call")),
+	              rbverse_histogram_to_hash(&rbverse_stats.observer_call) );
+	rb_hash_aset( stats, ID2SYM(rb_intern("sessions")), rb_obj_freeze(sessions) );
+
+	return rb_obj_freeze( stats );
+}
+
+
+/* Iterator for rbverse_verse_s_reset_stats(); resets the stats for one session. */
+static int
+rbverse_verse_s_reset_stats_session_i( VSession id, VALUE sessionobj, st_data_t unused ) {
+	struct rbverse_session *session = rbverse_get_session( sessionobj );
+
+	session->commands_sent = 0;
+	session->slices        = 0;
+	session->slice_usec    = 0;
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.reset_stats
+ *
+ * Reset all of the counters and histograms in Verse.stats, and the observer timings in
+ * Verse.slowest_observers.
+ *
+ */
+static VALUE
+rbverse_verse_s_reset_stats( VALUE module ) {
+	unsigned long received[ RBVERSE_EVENT_KIND_COUNT ];
+
+	rbverse_event_received_counts( received, TRUE );
+	MEMZERO( &rbverse_stats, struct rbverse_stats, 1 );
+	st_foreach( session_table, rbverse_verse_s_reset_stats_session_i, 0 );
+	rbverse_observer_profiles_clear();
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.stats_enabled?   -> true or false
+ *
+ * Returns +true+ if Verse.stats are being collected.
+ *
+ */
+static VALUE
+rbverse_verse_s_stats_enabled_p( VALUE module ) {
+	return rbverse_stats_enabled ? Qtrue : Qfalse;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.stats_enabled = boolean
+ *
+ * Turn collection of Verse.stats on or off. It's off by default. Turning it off leaves
+ * the stats collected so far alone.
+ *
+ */
+static VALUE
+rbverse_verse_s_stats_enabled_eq( VALUE module, VALUE enabled ) {
+	rbverse_stats_enabled = RTEST( enabled ) ? 1 : 0;
+	return enabled;
+}
+
+
+/*
+ * Verse stats
+ */
+void
+rbverse_init_verse_stats( void ) {
+	rbverse_log( "debug", "Initializing stats" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+#endif
+
+	MEMZERO( &rbverse_stats, struct rbverse_stats, 1 );
+
+	observer_profiles = st_init_numtable();
+	observer_profiles_obj = TypedData_Wrap_Struct( 0, &rbverse_observer_profiles_data_type,
+	                                               observer_profiles );
+	rb_gc_register_address( &observer_profiles_obj );
+
+	rb_define_singleton_method( rbverse_mVerse, "stats", rbverse_verse_s_stats, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "reset_stats", rbverse_verse_s_reset_stats, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "stats_enabled?", rbverse_verse_s_stats_enabled_p, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "stats_enabled=", rbverse_verse_s_stats_enabled_eq, 1 );
+
+	rb_define_singleton_method( rbverse_mVerse, "slowest_observers",
+	                            rbverse_verse_s_slowest_observers, -1 );
+	rb_define_singleton_method( rbverse_mVerse, "observer_budget", rbverse_verse_s_observer_budget, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "observer_budget=",
+	                            rbverse_verse_s_observer_budget_eq, 1 );
+}
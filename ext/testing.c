@@ -0,0 +1,337 @@
+/*
+ * Verse testing -- feeding Verse callbacks from specs
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include "verse_ext.h"
+
+/*
+ * Specs can't easily make a Verse server send a particular sequence of commands, so
+ * the callbacks that are set with RBVERSE_CALLBACK_SET() are also recorded here, and 
+ * Verse::Testing can call them directly, exactly as verse_callback_update() would. 
+ * The events they queue are dispatched the same way as ones that came from the 
+ * network.
+ * 
+ * Anything that can call Verse::Testing can forge commands from the server, so it's 
+ * only built into the extension when it's configured with --enable-testing (see 
+ * extconf.rb), which the Rakefile does for development builds.
+ */
+
+#ifdef RBVERSE_TESTING
+
+static VALUE rbverse_mVerseTesting;
+
+/* The callbacks that have been set, keyed by command ID */
+static st_table *callback_table = NULL;
+
+/* The maximum number of arguments a testable command takes */
+#define RBVERSE_TESTING_MAX_ARGS 11
+
+/* A converted callback argument */
+union rbverse_testing_arg {
+	uint32      u;
+	real32      f;
+	real64      d;
+	const char *s;
+	VNQuat64    q;
+};
+
+/* The commands Verse::Testing.callback can call, and the kinds of their arguments: 
+ * 'u' is an unsigned integer, 'f' a real32, 'd' a real64, 's' a String (or nil), and 
+ * 'q' a quaternion given as an Array of [x, y, z, w]. */
+static const struct rbverse_testing_command {
+	const char *name;
+	const char *kinds;
+} rbverse_testing_commands[] = {
+	{ "ping",                        "ss"          },
+	{ "node_create",                 "uuu"         },
+	{ "node_destroy",                "u"           },
+	{ "g_layer_create",              "uusuud"      },
+	{ "g_layer_destroy",             "uu"          },
+	{ "g_vertex_set_xyz_real32",     "uuufff"      },
+	{ "g_vertex_set_xyz_real64",     "uuuddd"      },
+	{ "g_vertex_delete_real32",      "uu"          },
+	{ "g_vertex_delete_real64",      "uu"          },
+	{ "g_polygon_set_corner_uint32", "uuuuuuu"     },
+	{ "g_polygon_delete",            "uu"          },
+	{ "g_bone_create",               "uussudddsqs" },
+	{ "g_bone_destroy",              "uu"          },
+	{ "o_light_set",                 "uddd"        },
+	{ "t_text_set",                  "uuuus"       },
+	{ NULL, NULL }
+};
+
+
+/*
+ * Set the +callback+ Verse should call for the specified +command+, remembering it for
+ * Verse::Testing. The +send_func+ is the verse_send_* function for the +command+. This
+ * is what RBVERSE_CALLBACK_SET() calls.
+ */
+void
+rbverse_callback_set( const char *command, void *send_func, void *callback ) {
+	verse_callback_set( send_func, callback, NULL );
+
+	if ( !callback_table ) callback_table = st_init_numtable();
+	st_insert( callback_table, (st_data_t)rb_intern(command), (st_data_t)callback );
+}
+
+
+/*
+ * Convert the Ruby +value+ to a callback argument of the specified +kind+.
+ */
+static void
+rbverse_testing_convert_arg( char kind, VALUE value, union rbverse_testing_arg *arg ) {
+	VALUE quat;
+
+	switch ( kind ) {
+		case 'u':
+		arg->u = NUM2UINT( value );
+		break;
+
+		case 'f':
+		arg->f = (real32)NUM2DBL( value );
+		break;
+
+		case 'd':
+		arg->d = NUM2DBL( value );
+		break;
+
+		case 's':
+		arg->s = NIL_P( value ) ? NULL : StringValueCStr( value );
+		break;
+
+		case 'q':
+		quat = rb_Array( value );
+		if ( RARRAY_LEN(quat) != 4 )
+			rb_raise( rb_eArgError, "expected a quaternion as [x, y, z, w]" );
+		arg->q.x = NUM2DBL( rb_ary_entry(quat, 0) );
+		arg->q.y = NUM2DBL( rb_ary_entry(quat, 1) );
+		arg->q.z = NUM2DBL( rb_ary_entry(quat, 2) );
+		arg->q.w = NUM2DBL( rb_ary_entry(quat, 3) );
+		break;
+	}
+}
+
+
+/*
+ * Call the +callback+ for the command at +index+ in rbverse_testing_commands with the 
+ * converted +args+. This must be called with the session switch lock held.
+ */
+static void
+rbverse_testing_call( long index, void *callback, union rbverse_testing_arg *args ) {
+	const char *name = rbverse_testing_commands[ index ].name;
+
+	if ( strcmp(name, "ping") == 0 ) {
+		((void (*)(void *, const char *, const char *))callback)( NULL, args[0].s, args[1].s );
+	}
+	else if ( strcmp(name, "node_create") == 0 ) {
+		((void (*)(void *, VNodeID, VNodeType, VNodeOwner))callback)
+			( NULL, args[0].u, (VNodeType)args[1].u, (VNodeOwner)args[2].u );
+	}
+	else if ( strcmp(name, "node_destroy") == 0 ) {
+		((void (*)(void *, VNodeID))callback)( NULL, args[0].u );
+	}
+	else if ( strcmp(name, "g_layer_create") == 0 ) {
+		((void (*)(void *, VNodeID, VLayerID, const char *, VNGLayerType, uint32, real64))callback)
+			( NULL, args[0].u, (VLayerID)args[1].u, args[2].s, (VNGLayerType)args[3].u, 
+			  args[4].u, args[5].d );
+	}
+	else if ( strcmp(name, "g_layer_destroy") == 0 ) {
+		((void (*)(void *, VNodeID, VLayerID))callback)( NULL, args[0].u, (VLayerID)args[1].u );
+	}
+	else if ( strcmp(name, "g_vertex_set_xyz_real32") == 0 ) {
+		((void (*)(void *, VNodeID, VLayerID, uint32, real32, real32, real32))callback)
+			( NULL, args[0].u, (VLayerID)args[1].u, args[2].u, args[3].f, args[4].f, args[5].f );
+	}
+	else if ( strcmp(name, "g_vertex_set_xyz_real64") == 0 ) {
+		((void (*)(void *, VNodeID, VLayerID, uint32, real64, real64, real64))callback)
+			( NULL, args[0].u, (VLayerID)args[1].u, args[2].u, args[3].d, args[4].d, args[5].d );
+	}
+	else if ( strcmp(name, "g_polygon_set_corner_uint32") == 0 ) {
+		((void (*)(void *, VNodeID, VLayerID, uint32, uint32, uint32, uint32, uint32))callback)
+			( NULL, args[0].u, (VLayerID)args[1].u, args[2].u, args[3].u, args[4].u, 
+			  args[5].u, args[6].u );
+	}
+	else if ( strcmp(name, "g_bone_create") == 0 ) {
+		((void (*)(void *, VNodeID, uint16, const char *, const char *, uint16, real64, real64,
+		           real64, const char *, const VNQuat64 *, const char *))callback)
+			( NULL, args[0].u, (uint16)args[1].u, args[2].s, args[3].s, (uint16)args[4].u,
+			  args[5].d, args[6].d, args[7].d, args[8].s, &args[9].q, args[10].s );
+	}
+	else if ( strcmp(name, "g_bone_destroy") == 0 ) {
+		((void (*)(void *, VNodeID, uint16))callback)( NULL, args[0].u, (uint16)args[1].u );
+	}
+	else if ( strcmp(name, "o_light_set") == 0 ) {
+		((void (*)(void *, VNodeID, real64, real64, real64))callback)
+			( NULL, args[0].u, args[1].d, args[2].d, args[3].d );
+	}
+	else if ( strcmp(name, "t_text_set") == 0 ) {
+		((void (*)(void *, VNodeID, uint16, uint32, uint32, const char *))callback)
+			( NULL, args[0].u, (uint16)args[1].u, args[2].u, args[3].u, args[4].s );
+	}
+
+	/* The vertex and polygon deletes all take ( node_id, id ) */
+	else {
+		((void (*)(void *, VNodeID, uint32))callback)( NULL, args[0].u, args[1].u );
+	}
+}
+
+
+/*
+ * call-seq:
+ *    Verse::Testing.callback( session, command, *args )   -> nil
+ *
+ * Call the extension's callback for the Verse +command+ with the specified +args+ as if 
+ * +session+ had just received it from the network; if +session+ is nil, the callback is
+ * called as if the command had arrived on the global session (e.g., a ping). The +args+ 
+ * are the callback's arguments, less the leading user-data pointer. The events the 
+ * callback queues aren't dispatched until they're published (see 
+ * Verse::Testing.publish).
+ * 
+ * @example
+ *    Verse::Testing.callback( session, :node_create, 12, Verse::V_NT_GEOMETRY, 0 )
+ *    Verse::Testing.publish
+ *    Verse.process_pending
+ */
+static VALUE
+rbverse_verse_testing_s_callback( int argc, VALUE *argv, VALUE module ) {
+	union rbverse_testing_arg args[ RBVERSE_TESTING_MAX_ARGS ];
+	VALUE sessionobj, command, rest;
+	const char *name;
+	const char *kinds;
+	st_data_t callback = 0;
+	VSession session_id = NULL;
+	long index, i;
+
+	rb_scan_args( argc, argv, "2*", &sessionobj, &command, &rest );
+
+	name = rb_id2name( rb_to_id(command) );
+	for ( index = 0; rbverse_testing_commands[index].name; index++ )
+		if ( strcmp(rbverse_testing_commands[index].name, name) == 0 ) break;
+	if ( !rbverse_testing_commands[index].name )
+		rb_raise( rb_eArgError, "can't call the %s callback from Ruby", name );
+
+	if ( !callback_table || !st_lookup(callback_table, (st_data_t)rb_intern(name), &callback) || 
+	     !callback )
+		rb_raise( rb_eRuntimeError, "no callback is set for %s", name );
+
+	kinds = rbverse_testing_commands[ index ].kinds;
+	if ( RARRAY_LEN(rest) != (long)strlen(kinds) )
+		rb_raise( rb_eArgError, "wrong number of arguments for %s (%ld for %ld)", name,
+		          RARRAY_LEN(rest), (long)strlen(kinds) );
+
+	/* Convert everything before locking, as conversion can raise */
+	for ( i = 0; kinds[i]; i++ )
+		rbverse_testing_convert_arg( kinds[i], RARRAY_PTR(rest)[i], &args[i] );
+	if ( !NIL_P(sessionobj) )
+		session_id = rbverse_get_session( sessionobj )->id;
+
+	rbverse_session_switch_lock();
+	verse_session_set( session_id );
+	rbverse_testing_call( index, (void *)callback, args );
+	rbverse_session_switch_unlock();
+
+	RB_GC_GUARD( rest );
+
+	return Qnil;
+}
+
+
+/*
+ * call-seq:
+ *    Verse::Testing.publish   -> nil
+ *
+ * Publish the events queued by Verse::Testing.callback so the next Verse.update or
+ * Verse.process_pending dispatches them.
+ */
+static VALUE
+rbverse_verse_testing_s_publish( VALUE module ) {
+	rbverse_session_switch_lock();
+	rbverse_event_publish();
+	rbverse_session_switch_unlock();
+	return Qnil;
+}
+
+
+/*
+ * call-seq:
+ *    Verse::Testing.event_blocks   -> integer
+ *
+ * Returns the number of blocks the event queue has allocated, including the ones on
+ * its free list.
+ */
+static VALUE
+rbverse_verse_testing_s_event_blocks( VALUE module ) {
+	return ULONG2NUM( rbverse_event_block_count() );
+}
+
+
+/*
+ * call-seq:
+ *    Verse::Testing.log_level   -> integer
+ *
+ * Returns the extension's cached copy of the level of Verse.logger without updating
+ * it, i.e., the level the extension is currently skipping messages below.
+ */
+static VALUE
+rbverse_verse_testing_s_log_level( VALUE module ) {
+	return INT2FIX( rbverse_log_level );
+}
+
+
+/*
+ * Verse::Testing -- hooks for specs
+ */
+void
+rbverse_init_verse_testing( void ) {
+	rbverse_log( "debug", "Initializing Verse::Testing" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+#endif
+
+	rbverse_mVerseTesting = rb_define_module_under( rbverse_mVerse, "Testing" );
+
+	rb_define_singleton_method( rbverse_mVerseTesting, "callback", rbverse_verse_testing_s_callback, -1 );
+	rb_define_singleton_method( rbverse_mVerseTesting, "publish", rbverse_verse_testing_s_publish, 0 );
+	rb_define_singleton_method( rbverse_mVerseTesting, "event_blocks",
+	                            rbverse_verse_testing_s_event_blocks, 0 );
+	rb_define_singleton_method( rbverse_mVerseTesting, "log_level", rbverse_verse_testing_s_log_level, 0 );
+}
+
+#endif /* RBVERSE_TESTING */
+
@@ -40,6 +40,7 @@
 #include "verse_ext.h"
 
 VALUE rbverse_cVerseTextNode;
+VALUE rbverse_mVerseTextNodeObserver;
 
 
 /*
@@ -89,6 +90,19 @@ rbverse_verse_textnode_initialize( VALUE self ) {
 }
 
 
+
+/* --------------------------------------------------------------
+ * Callbacks
+ * -------------------------------------------------------------- */
+
+RBVERSE_NODE_TRAMPOLINE( 1, t_language_set, RBVERSE_ON_LANGUAGE_SET, STRING )
+RBVERSE_NODE_TRAMPOLINE( 2, t_buffer_create, RBVERSE_ON_TEXT_BUFFER_CREATE, UINT16, STRING )
+RBVERSE_NODE_TRAMPOLINE( 1, t_buffer_destroy, RBVERSE_ON_TEXT_BUFFER_DESTROY, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, t_buffer_subscribe, RBVERSE_ON_TEXT_BUFFER_SUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 1, t_buffer_unsubscribe, RBVERSE_ON_TEXT_BUFFER_UNSUBSCRIBE, UINT16 )
+RBVERSE_NODE_TRAMPOLINE( 4, t_text_set, RBVERSE_ON_TEXT_SET, UINT16, UINT32, UINT32, STRING )
+
+
 /*
  * Verse::TextNode class
  */
@@ -96,6 +110,9 @@ void
 rbverse_init_verse_textnode( void ) {
 	rbverse_log( "debug", "Initializing Verse::TextNode" );
 
+	/* Related modules */
+	rbverse_mVerseTextNodeObserver = rb_define_module_under( rbverse_mVerse, "TextNodeObserver" );
+
 	/* Class methods */
 	rbverse_cVerseTextNode = rb_define_class_under( rbverse_mVerse, "TextNode", rbverse_cVerseNode );
 
@@ -109,5 +126,12 @@ rbverse_init_verse_textnode( void ) {
 	rbverse_nodetype_to_nodeclass[ V_NT_TEXT ] = rbverse_cVerseTextNode;
 	node_mark_funcs[ V_NT_TEXT ] = &rbverse_textnode_gc_mark;
 	node_free_funcs[ V_NT_TEXT ] = &rbverse_textnode_gc_free;
+
+	RBVERSE_CALLBACK_SET( t_language_set, rbverse_cb_t_language_set );
+	RBVERSE_CALLBACK_SET( t_buffer_create, rbverse_cb_t_buffer_create );
+	RBVERSE_CALLBACK_SET( t_buffer_destroy, rbverse_cb_t_buffer_destroy );
+	RBVERSE_CALLBACK_SET( t_buffer_subscribe, rbverse_cb_t_buffer_subscribe );
+	RBVERSE_CALLBACK_SET( t_buffer_unsubscribe, rbverse_cb_t_buffer_unsubscribe );
+	RBVERSE_CALLBACK_SET( t_text_set, rbverse_cb_t_text_set );
 }
 
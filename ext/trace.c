@@ -0,0 +1,426 @@
+/*
+ * Verse tracing -- timeline of update and callback activity as Chrome trace JSON
+ * $Id$
+ *
+ * @author Michael Granger <ged@FaerieMUD.org>
+ *
+ * Copyright (c) 2010 The FaerieMUD Consortium
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice, this
+ *    list of conditions and the following disclaimer in the documentation and/or
+ *    other materials provided with the distribution.
+ *
+ *  * Neither the name of the authors, nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+
+#include "verse_ext.h"
+
+#include <unistd.h>
+
+/*
+ * While tracing is on, the update loop, the network thread, event dispatch, and 
+ * observer calls record timestamped spans into a ring buffer that belongs to the thread
+ * doing the work, so recording a span never takes a lock or needs the GVL. Each ring is
+ * allocated the first time its thread records a span, and holds the most recent 
+ * spans that fit in it; Verse.trace_json turns what's in the rings into the Chrome 
+ * trace format, which chrome://tracing and Perfetto can load.
+ * 
+ * Rings are never freed, as a dump might be reading one while its thread exits. The 
+ * ring of a thread that has exited is reused by a new thread once a new trace is 
+ * started.
+ * 
+ * Span names and categories must be string constants (or strings that live as long as
+ * the extension, like the observer method names), as only the pointers are recorded.
+ */
+
+struct rbverse_trace_span {
+	const char *category;
+	const char *name;
+	uint64_t   start;
+	uint64_t   duration;
+};
+
+struct rbverse_trace_ring {
+	struct rbverse_trace_ring *next;
+	unsigned long             tid;
+	const char                *thread_name;
+	unsigned long             generation;
+	int                       in_use;
+	size_t                    capacity;
+	volatile size_t           head;
+	struct rbverse_trace_span spans[1];
+};
+
+/* A snapshot of a ring's position, for dumping it without holding the lock */
+struct rbverse_trace_ring_snapshot {
+	const struct rbverse_trace_ring *ring;
+	unsigned long                   tid;
+	const char                      *thread_name;
+	size_t                          head;
+};
+
+#define RBVERSE_TRACE_DEFAULT_CAPACITY 65536
+
+/* The largest capacity a trace can be started with: 128MB of spans per thread */
+#define RBVERSE_TRACE_MAX_CAPACITY     (1UL << 22)
+
+volatile int rbverse_trace_enabled = 0;
+
+/* Every ring that's been allocated, the number of spans new rings have room for, and 
+ * the current trace's generation */
+static struct rbverse_trace_ring *trace_rings = NULL;
+static size_t trace_capacity = RBVERSE_TRACE_DEFAULT_CAPACITY;
+static unsigned long trace_generation = 0;
+static unsigned long trace_next_tid = 1;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t trace_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t trace_ring_key;
+static pthread_key_t trace_thread_name_key;
+#	define RBVERSE_TRACE_LOCK()		pthread_mutex_lock( &trace_rings_lock )
+#	define RBVERSE_TRACE_UNLOCK()	pthread_mutex_unlock( &trace_rings_lock )
+#	define RBVERSE_TRACE_RING()		((struct rbverse_trace_ring *)pthread_getspecific( trace_ring_key ))
+#else
+static struct rbverse_trace_ring *trace_ring = NULL;
+#	define RBVERSE_TRACE_LOCK()
+#	define RBVERSE_TRACE_UNLOCK()
+#	define RBVERSE_TRACE_RING()		trace_ring
+#endif
+
+
+/* --------------------------------------------------------------
+ * Recording
+ * -------------------------------------------------------------- */
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * Destructor for the thread-specific ring pointer; lets another thread take the ring
+ * over once a new trace starts.
+ */
+static void
+rbverse_trace_ring_release( void *ptr ) {
+	struct rbverse_trace_ring *ring = ptr;
+
+	RBVERSE_TRACE_LOCK();
+	ring->in_use = 0;
+	RBVERSE_TRACE_UNLOCK();
+}
+#endif
+
+
+/*
+ * Return a ring for the calling thread, either one that was left behind by a thread 
+ * that has exited since the last trace, or a new one. Returns NULL if there's no 
+ * memory for one. This is safe to call without the GVL.
+ */
+static struct rbverse_trace_ring *
+rbverse_trace_ring_acquire( void ) {
+	struct rbverse_trace_ring *ring;
+	const char *thread_name = NULL;
+
+#ifdef HAVE_PTHREAD_H
+	thread_name = pthread_getspecific( trace_thread_name_key );
+#endif
+
+	RBVERSE_TRACE_LOCK();
+
+	for ( ring = trace_rings; ring; ring = ring->next )
+		if ( !ring->in_use && ring->generation != trace_generation ) break;
+
+	if ( !ring ) {
+		ring = malloc( sizeof(struct rbverse_trace_ring) +
+		               (trace_capacity - 1) * sizeof(struct rbverse_trace_span) );
+		if ( !ring ) {
+			RBVERSE_TRACE_UNLOCK();
+			return NULL;
+		}
+
+		ring->capacity = trace_capacity;
+		ring->next = trace_rings;
+		trace_rings = ring;
+	}
+
+	ring->tid         = trace_next_tid++;
+	ring->thread_name = thread_name;
+	ring->generation  = trace_generation;
+	ring->in_use      = 1;
+	ring->head        = 0;
+
+	RBVERSE_TRACE_UNLOCK();
+
+#ifdef HAVE_PTHREAD_H
+	pthread_setspecific( trace_ring_key, ring );
+#else
+	trace_ring = ring;
+#endif
+
+	return ring;
+}
+
+
+/*
+ * Record a span of the given +category+ and +name+ that ran from +start+ to +end+ (both
+ * from rbverse_usec_now()) in the calling thread's ring. Use the RBVERSE_TRACE_SPAN() 
+ * macro instead of calling this directly. This is safe to call without the GVL.
+ */
+void
+rbverse_trace_span( const char *category, const char *name, uint64_t start, uint64_t end ) {
+	struct rbverse_trace_ring *ring = RBVERSE_TRACE_RING();
+	struct rbverse_trace_span *span;
+
+	if ( !ring && !(ring = rbverse_trace_ring_acquire()) ) return;
+
+	/* A ring that's left over from an earlier trace starts over */
+	if ( ring->generation != trace_generation ) {
+		ring->generation = trace_generation;
+		ring->head = 0;
+	}
+
+	span = &ring->spans[ ring->head % ring->capacity ];
+	span->category = category;
+	span->name     = name;
+	span->start    = start;
+	span->duration = end > start ? end - start : 0;
+
+	/* Make sure the span is written before it's counted */
+#ifdef __GNUC__
+	__sync_synchronize();
+#endif
+	ring->head++;
+}
+
+
+/*
+ * Set the +name+ the calling thread is given in traces. The +name+ must be a string 
+ * constant. This is safe to call without the GVL.
+ */
+void
+rbverse_trace_set_thread_name( const char *name ) {
+	struct rbverse_trace_ring *ring;
+
+#ifdef HAVE_PTHREAD_H
+	pthread_setspecific( trace_thread_name_key, name );
+#endif
+	if ( (ring = RBVERSE_TRACE_RING()) ) ring->thread_name = name;
+}
+
+
+
+/* --------------------------------------------------------------
+ * Ruby API
+ * -------------------------------------------------------------- */
+
+/*
+ * call-seq:
+ *    Verse.start_trace( capacity=65536 )
+ *
+ * Start recording a timeline of what the extension does: each Verse.update and the
+ * time it spent reading the network for each session, getting the GVL back, dispatching
+ * each event, and calling each observer, plus what the network thread (see 
+ * Verse.start_network_thread) is doing. Any trace that was already recorded is 
+ * discarded.
+ * 
+ * Each thread records into its own ring buffer, which keeps only its most recent 
+ * +capacity+ spans (32 bytes each). The +capacity+ only applies to threads that haven't 
+ * recorded a trace before. Use Verse.trace_json to get the trace.
+ * 
+ * @param [Integer] capacity  the number of spans each thread keeps, up to 4194304
+ * @raise [ArgumentError]  if the +capacity+ is out of range
+ */
+static VALUE
+rbverse_verse_s_start_trace( int argc, VALUE *argv, VALUE module ) {
+	VALUE capacity = Qnil;
+	long spans = 0;
+
+	if ( rb_scan_args(argc, argv, "01", &capacity) ) {
+		spans = NUM2LONG( capacity );
+		if ( spans < 1 || (unsigned long)spans > RBVERSE_TRACE_MAX_CAPACITY )
+			rb_raise( rb_eArgError, "trace capacity must be between 1 and %lu", 
+			          RBVERSE_TRACE_MAX_CAPACITY );
+	}
+
+	RBVERSE_TRACE_LOCK();
+	if ( spans ) trace_capacity = (size_t)spans;
+	trace_generation++;
+	RBVERSE_TRACE_UNLOCK();
+
+	rbverse_trace_enabled = 1;
+
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.stop_trace
+ *
+ * Stop recording the timeline started by Verse.start_trace. What was recorded is kept
+ * until the next trace is started.
+ *
+ */
+static VALUE
+rbverse_verse_s_stop_trace( VALUE module ) {
+	rbverse_trace_enabled = 0;
+	return Qtrue;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.tracing?   -> true or false
+ *
+ * Returns +true+ if a trace is being recorded.
+ *
+ */
+static VALUE
+rbverse_verse_s_tracing_p( VALUE module ) {
+	return rbverse_trace_enabled ? Qtrue : Qfalse;
+}
+
+
+/*
+ * Append a JSON trace event to +json+, preceded by a comma unless it's the +first+ 
+ * one.
+ */
+static void
+rbverse_trace_append_event( VALUE json, int *first, const char *fmt, ... ) {
+	char buf[ 512 ];
+	va_list args;
+
+	va_start( args, fmt );
+	vsnprintf( buf, sizeof(buf), fmt, args );
+	va_end( args );
+
+	if ( !*first ) rb_str_cat2( json, "," );
+	rb_str_cat2( json, "\n" );
+	rb_str_cat2( json, buf );
+	*first = 0;
+}
+
+
+/*
+ * call-seq:
+ *    Verse.trace_json   -> string
+ *
+ * Return the spans recorded since the last Verse.start_trace in the Chrome trace 
+ * format, for loading into chrome://tracing or Perfetto. Stop the trace first if you 
+ * want a consistent snapshot; spans that are being recorded while the trace is dumped
+ * can be garbled.
+ * 
+ * Building the String can raise, so the rings' positions are copied with the lock
+ * held, and the spans are read after it's released. Rings are never freed, and only
+ * start over when a new trace is started, which can't happen while this holds the GVL.
+ *
+ * @example
+ *    Verse.start_trace
+ *    200.times { Verse.update }
+ *    Verse.stop_trace
+ *    File.open( "verse.json", "w" ) {|io| io.write(Verse.trace_json) }
+ */
+static VALUE
+rbverse_verse_s_trace_json( VALUE module ) {
+	VALUE json = rb_str_buf_new( 4096 );
+	const int pid = (int)getpid();
+	struct rbverse_trace_ring *ring, *rings;
+	struct rbverse_trace_ring_snapshot *snapshots, *snapshot;
+	const struct rbverse_trace_span *span;
+	long ring_count = 0, snapshot_count = 0, r;
+	size_t count, i;
+	int first = 1;
+
+	/* Rings are only ever added to the front of the list, so count them first to size
+	 * the snapshot, then take it from the same place in the list. */
+	RBVERSE_TRACE_LOCK();
+	rings = trace_rings;
+	for ( ring = rings; ring; ring = ring->next ) ring_count++;
+	RBVERSE_TRACE_UNLOCK();
+
+	snapshots = ALLOCA_N( struct rbverse_trace_ring_snapshot, ring_count + 1 );
+
+	RBVERSE_TRACE_LOCK();
+	for ( ring = rings; ring; ring = ring->next ) {
+		if ( ring->generation != trace_generation ) continue;
+
+		snapshot = &snapshots[ snapshot_count++ ];
+		snapshot->ring        = ring;
+		snapshot->tid         = ring->tid;
+		snapshot->thread_name = ring->thread_name;
+		snapshot->head        = ring->head;
+	}
+	RBVERSE_TRACE_UNLOCK();
+
+	rb_str_cat2( json, "{\"traceEvents\":[" );
+
+	for ( r = 0; r < snapshot_count; r++ ) {
+		snapshot = &snapshots[ r ];
+		ring = (struct rbverse_trace_ring *)snapshot->ring;
+		count = snapshot->head < ring->capacity ? snapshot->head : ring->capacity;
+
+		if ( snapshot->thread_name ) {
+			rbverse_trace_append_event( json, &first,
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,"
+				"\"args\":{\"name\":\"%s\"}}", pid, snapshot->tid, snapshot->thread_name );
+		}
+
+		for ( i = snapshot->head - count; i < snapshot->head; i++ ) {
+			span = &ring->spans[ i % ring->capacity ];
+			rbverse_trace_append_event( json, &first,
+				"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+				"\"pid\":%d,\"tid\":%lu}", span->name, span->category, 
+				(unsigned long long)span->start, (unsigned long long)span->duration,
+				pid, snapshot->tid );
+		}
+	}
+
+	rb_str_cat2( json, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+
+	return json;
+}
+
+
+/*
+ * Verse tracing
+ */
+void
+rbverse_init_verse_trace( void ) {
+	rbverse_log( "debug", "Initializing tracing" );
+
+#ifdef FOR_RDOC
+	rbverse_mVerse = rb_define_module( "Verse" );
+#endif
+
+#ifdef HAVE_PTHREAD_H
+	pthread_key_create( &trace_ring_key, rbverse_trace_ring_release );
+	pthread_key_create( &trace_thread_name_key, NULL );
+#endif
+
+	rb_define_singleton_method( rbverse_mVerse, "start_trace", rbverse_verse_s_start_trace, -1 );
+	rb_define_singleton_method( rbverse_mVerse, "stop_trace", rbverse_verse_s_stop_trace, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "tracing?", rbverse_verse_s_tracing_p, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "trace_json", rbverse_verse_s_trace_json, 0 );
+}
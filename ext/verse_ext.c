@@ -56,15 +56,67 @@ VALUE rbverse_eVerseConnectError;
 VALUE rbverse_eVerseSessionError;
 VALUE rbverse_eVerseNodeError;
 
+/* The scheduling mode used by Verse.update */
+static enum {
+	RBVERSE_UPDATE_TIMESLICE,
+	RBVERSE_UPDATE_ADAPTIVE
+} rbverse_update_mode = RBVERSE_UPDATE_TIMESLICE;
+
+/* Recent traffic of the global session, for the adaptive scheduler */
+static uint32 rbverse_global_traffic = 0;
+
+/* A session's entry in an adaptive update */
+struct rbverse_update_slot {
+	VSession      id;
+	uint32        traffic;
+	unsigned long events;
+	uint64_t      usec;
+};
+
+/* An update of one session, or a wait for the network thread. The times the update 
+ * started and finished are only filled in if timing is enabled, and are 0 otherwise. 
+ * The +generation+ is the session registry generation the +id+ is valid for. */
+struct rbverse_update_call {
+	VSession      id;
+	unsigned long generation;
+	uint32        microseconds;
+	uint64_t      started;
+	uint64_t      finished;
+};
+
+/* An adaptive update. Sessions can be destroyed while the GVL is released, so the 
+ * +generation+ is the session registry generation (see network.c) its slots' IDs are 
+ * valid for. */
+struct rbverse_update_plan {
+	struct rbverse_update_slot *slots;
+	long                       count;
+	unsigned long              generation;
+	uint32                     timeout;
+	uint64_t                   finished;
+};
+
+
+/* The level of Verse.logger, cached so the rbverse_log macros can skip disabled
+ * messages without calling into Ruby. Starts out logging everything until the 
+ * real level is known. */
+int rbverse_log_level = 0;
+
+/* Cached method IDs for logging */
+static ID rbverse_id_log;
+static ID rbverse_id_logger;
+static ID rbverse_id_level;
+static ID rbverse_log_level_ids[5];
+
 
 /*
- * Log a message to the given +context+ object's logger.
+ * Log a message to the given +context+ object's logger. Use the rbverse_log_with_context()
+ * macro instead of calling this directly.
  */
 void
 #ifdef HAVE_STDARG_PROTOTYPES
-rbverse_log_with_context( VALUE context, const char *level, const char *fmt, ... ) 
+rbverse_log_message_with_context( VALUE context, const char *level, const char *fmt, ... ) 
 #else
-rbverse_log_with_context( VALUE context, const char *level, const char *fmt, va_dcl ) 
+rbverse_log_message_with_context( VALUE context, const char *level, const char *fmt, va_dcl ) 
 #endif
 {
 	char buf[BUFSIZ];
@@ -76,21 +128,22 @@ rbverse_log_with_context( VALUE context, const char *level, const char *fmt, va_
 	vsnprintf( buf, BUFSIZ, fmt, args );
 	message = rb_str_new2( buf );
 
-	logger = rb_funcall( context, rb_intern("log"), 0, 0 );
-	rb_funcall( logger, rb_intern(level), 1, message );
+	logger = rb_funcall( context, rbverse_id_log, 0 );
+	rb_funcall( logger, rbverse_log_level_ids[RBVERSE_LOG_LEVEL_NUM(level)], 1, message );
 
 	va_end( args );
 }
 
 
 /* 
- * Log a message to the global logger.
+ * Log a message to the global logger. Use the rbverse_log() macro instead of calling
+ * this directly.
  */
 void
 #ifdef HAVE_STDARG_PROTOTYPES
-rbverse_log( const char *level, const char *fmt, ... ) 
+rbverse_log_message( const char *level, const char *fmt, ... ) 
 #else
-rbverse_log( const char *level, const char *fmt, va_dcl ) 
+rbverse_log_message( const char *level, const char *fmt, va_dcl ) 
 #endif
 {
 	char buf[BUFSIZ];
@@ -102,8 +155,8 @@ rbverse_log( const char *level, const char *fmt, va_dcl )
 	vsnprintf( buf, BUFSIZ, fmt, args );
 	message = rb_str_new2( buf );
 
-	logger = rb_funcall( rbverse_mVerse, rb_intern("logger"), 0, 0 );
-	rb_funcall( logger, rb_intern(level), 1, message );
+	logger = rb_funcall( rbverse_mVerse, rbverse_id_logger, 0 );
+	rb_funcall( logger, rbverse_log_level_ids[RBVERSE_LOG_LEVEL_NUM(level)], 1, message );
 
 	va_end( args );
 }
@@ -188,12 +241,38 @@ rbverse_verse_ping( VALUE module, VALUE address, VALUE message ) {
 	const char *msg  = RSTRING_PTR( message );
 
 	rbverse_log_with_context( module, "debug", "Pinging '%s' with message '%s'", addr, msg );
+	rbverse_session_switch_lock();
 	verse_send_ping( addr, msg );
+	rbverse_session_switch_unlock();
 
 	return Qtrue;
 }
 
 
+/*
+ * call-seq:
+ *    Verse.cache_log_level   -> integer
+ *
+ * Copy the current level of Verse.logger into the extension, which uses it to skip
+ * building messages that would just be thrown away. This is called for you whenever
+ * Verse.logger or its level is changed.
+ *
+ */
+static VALUE
+rbverse_verse_cache_log_level( VALUE module ) {
+	VALUE logger = rb_funcall( module, rbverse_id_logger, 0 );
+	VALUE level = rb_funcall( logger, rbverse_id_level, 0 );
+
+	/* Log everything if the logger doesn't have a sensible level */
+	if ( FIXNUM_P(level) )
+		rbverse_log_level = FIX2INT( level );
+	else
+		rbverse_log_level = 0;
+
+	return INT2FIX( rbverse_log_level );
+}
+
+
 /*
  *  call-seq:
  *     Verse.create_host_id   -> string
@@ -228,28 +307,355 @@ rbverse_verse_host_id_eq( VALUE module, VALUE id ) {
 /* Body of rbverse_verse_update after GVL is given up. */
 static VALUE
 rbverse_verse_update_body( void *ptr ) {
-	uint32 *microseconds = (uint32 *)ptr;
-	DEBUGMSG( "  calling verse_callback_update( %d ).", *microseconds );
-	verse_callback_update( *microseconds );
+	struct rbverse_update_call *call = (struct rbverse_update_call *)ptr;
+	DEBUGMSG( "  calling verse_callback_update( %d ).", call->microseconds );
+
+	if ( RBVERSE_TIMING_ENABLED() ) call->started = rbverse_usec_now();
+
+	RBVERSE_PROBE_UPDATE_START( call->id, call->microseconds );
+
+	/* Skip the session if another thread destroyed it after the GVL was released */
+	rbverse_session_switch_lock_nogvl();
+	if ( rbverse_network_session_valid(call->id, call->generation) ) {
+		verse_session_set( call->id );
+		verse_callback_update( call->microseconds );
+		rbverse_event_publish();
+	}
+	rbverse_session_switch_unlock();
+
+	RBVERSE_PROBE_UPDATE_DONE( call->id, call->microseconds );
+
+	if ( RBVERSE_TIMING_ENABLED() ) {
+		call->finished = rbverse_usec_now();
+		RBVERSE_TRACE_SPAN( "network", "verse_callback_update", call->started, call->finished );
+	}
+
 	return Qtrue;
 }
 
 
+/*
+ * Record how long it took to get the GVL back after a blocking region that ended at
+ * +finished+ (or not, if it wasn't timed).
+ */
+static void
+rbverse_verse_update_record_gvl_wait( uint64_t finished ) {
+	uint64_t now;
+
+	if ( !finished ) return;
+
+	now = rbverse_usec_now();
+	if ( rbverse_stats_enabled )
+		rbverse_histogram_record( &rbverse_stats.gvl_wait, now - finished );
+	RBVERSE_TRACE_SPAN( "gvl", "GVL reacquire", finished, now );
+}
+
+
+/*
+ * Record the timing of the update +call+ of the given +session+ (NULL for the global
+ * session) now that the GVL is held again. Timing might have been switched on or off
+ * while the GVL was released, so calls that weren't timed at both ends are skipped.
+ */
+static void
+rbverse_verse_update_record_timing( struct rbverse_session *session, 
+                                    const struct rbverse_update_call *call )
+{
+	uint64_t slice;
+
+	if ( !call->started || !call->finished ) return;
+	slice = call->finished - call->started;
+
+	rbverse_verse_update_record_gvl_wait( call->finished );
+	if ( !rbverse_stats_enabled ) return;
+
+	rbverse_histogram_record( &rbverse_stats.slice, slice );
+	if ( session ) {
+		session->slices++;
+		session->slice_usec += slice;
+	}
+}
+
+
 /* 
  * Iterator for rbverse_verse_session_update 
  */
 static int
 rbverse_verse_update_i( VSession id, VALUE session, st_data_t timeout ) {
+	struct rbverse_update_call call;
 	DEBUGMSG( "Callback update for session %p (timeout=%u µs).", id, (uint32)timeout );
 
-	verse_session_set( id );
-	rb_thread_blocking_region( rbverse_verse_update_body, (uint32 *)&timeout,
+	call.id           = id;
+	call.generation   = rbverse_network_generation();
+	call.microseconds = (uint32)timeout;
+	call.started      = 0;
+	call.finished     = 0;
+	rb_thread_blocking_region( rbverse_verse_update_body, (void *)&call,
+		RUBY_UBF_IO, NULL );
+	rbverse_verse_update_record_timing( rbverse_get_session(session), &call );
+
+	return ST_CONTINUE;
+}
+
+
+/*
+ * Update every session in turn, giving each one an equal slice of the +microseconds+
+ * timeout.
+ */
+static void
+rbverse_verse_update_timeslice( uint32 microseconds ) {
+	uint32 slice = microseconds / ( session_table->num_entries + 1 );
+	struct rbverse_update_call call;
+	DEBUGMSG( "Update timeslice is %d µs", slice );
+
+	DEBUGMSG( "  updating the global session" );
+	call.id           = 0;
+	call.generation   = 0;
+	call.microseconds = slice;
+	call.started      = 0;
+	call.finished     = 0;
+	rb_thread_blocking_region( rbverse_verse_update_body, (void *)&call,
 		RUBY_UBF_IO, NULL );
+	rbverse_verse_update_record_timing( NULL, &call );
+
+	if ( session_table->num_entries ) {
+		DEBUGMSG( "  updating %lu client sessions", (long unsigned int)session_table->num_entries );
+		st_foreach( session_table, rbverse_verse_update_i, (st_data_t)slice );
+	} else {
+		DEBUGMSG( "  no client sessions to update" );
+	}
+}
+
+
+/*
+ * Iterator for rbverse_verse_update_adaptive(); adds a slot for each session to the 
+ * update plan.
+ */
+static int
+rbverse_verse_update_plan_i( VSession id, VALUE sessionobj, st_data_t data ) {
+	struct rbverse_update_plan *plan = (struct rbverse_update_plan *)data;
+	struct rbverse_session *session = rbverse_get_session( sessionobj );
+
+	plan->slots[ plan->count ].id      = id;
+	plan->slots[ plan->count ].traffic = session->traffic;
+	plan->slots[ plan->count ].events  = 0;
+	plan->slots[ plan->count ].usec    = 0;
+	plan->count++;
 
 	return ST_CONTINUE;
 }
 
 
+/*
+ * qsort() comparison function for ordering update slots busiest-first.
+ */
+static int
+rbverse_update_slot_cmp( const void *a, const void *b ) {
+	const uint32 traffic_a = ((const struct rbverse_update_slot *)a)->traffic;
+	const uint32 traffic_b = ((const struct rbverse_update_slot *)b)->traffic;
+
+	if ( traffic_a == traffic_b ) return 0;
+	return traffic_a > traffic_b ? -1 : 1;
+}
+
+
+/*
+ * Update the given +slot+ of an update plan for registry +generation+ without blocking 
+ * longer than +microseconds+, returning the number of events it produced. Slots for
+ * sessions that have been destroyed since the plan was made are skipped.
+ */
+static unsigned long
+rbverse_update_slot( struct rbverse_update_slot *slot, unsigned long generation, 
+                     uint32 microseconds )
+{
+	const uint64_t start = RBVERSE_TIMING_ENABLED() ? rbverse_usec_now() : 0;
+	uint64_t finished;
+	unsigned long events;
+
+	rbverse_session_switch_lock_nogvl();
+	if ( !rbverse_network_session_valid(slot->id, generation) ) {
+		rbverse_session_switch_unlock();
+		return 0;
+	}
+
+	/* Events are only queued by callbacks, which run with the switch lock held, so the
+	 * ones counted while it's held all came from this session */
+	events = rbverse_event_count;
+	verse_session_set( slot->id );
+	verse_callback_update( microseconds );
+	events = rbverse_event_count - events;
+	rbverse_event_publish();
+	rbverse_session_switch_unlock();
+	rbverse_session_switch_yield( RBVERSE_SWITCH_YIELD_TIMEOUT );
+
+	slot->events += events;
+
+	if ( start ) {
+		finished = rbverse_usec_now();
+		slot->usec += finished - start;
+		RBVERSE_TRACE_SPAN( "network", "verse_callback_update", start, finished );
+	}
+
+	return events;
+}
+
+
+/* Sweep the sessions in the +plan+ until one of them does some work or it times out. */
+static void
+rbverse_verse_update_adaptive_sweep( struct rbverse_update_plan *plan ) {
+	const uint64_t start = rbverse_usec_now();
+	uint64_t elapsed, total_traffic = 0;
+	unsigned long work;
+	uint32 wait;
+	long i;
+
+	for ( i = 0; i < plan->count; i++ )
+		total_traffic += plan->slots[i].traffic + 1;
+
+	for ( ;; ) {
+		/* Service any session that already has something waiting, busiest first */
+		work = 0;
+		for ( i = 0; i < plan->count; i++ )
+			work += rbverse_update_slot( &plan->slots[i], plan->generation, 0 );
+
+		DEBUGMSG( "  sweep of %ld sessions produced %lu events", plan->count, work );
+		if ( work ) break;
+
+		/* Nothing pending anywhere, so wait on each session in turn for a share of the 
+		 * remaining time that's weighted by its recent traffic, stopping as soon as
+		 * something arrives. */
+		for ( i = 0; i < plan->count; i++ ) {
+			elapsed = rbverse_usec_now() - start;
+			if ( elapsed >= plan->timeout ) return;
+
+			wait = ( plan->timeout - elapsed ) * ( plan->slots[i].traffic + 1 ) / total_traffic;
+			if ( wait < RBVERSE_MIN_UPDATE_WAIT ) wait = RBVERSE_MIN_UPDATE_WAIT;
+			if ( wait > plan->timeout - elapsed ) wait = plan->timeout - elapsed;
+
+			if ( rbverse_update_slot(&plan->slots[i], plan->generation, wait) ) return;
+		}
+	}
+}
+
+
+/* Body of rbverse_verse_update_adaptive() after the GVL is given up. */
+static VALUE
+rbverse_verse_update_adaptive_body( void *ptr ) {
+	struct rbverse_update_plan *plan = (struct rbverse_update_plan *)ptr;
+
+	rbverse_verse_update_adaptive_sweep( plan );
+	if ( RBVERSE_TIMING_ENABLED() ) plan->finished = rbverse_usec_now();
+
+	return Qtrue;
+}
+
+
+/*
+ * Update the sessions in order of how busy they've been recently, returning as soon as
+ * any of them has done some work, or when +microseconds+ has elapsed.
+ */
+static void
+rbverse_verse_update_adaptive( uint32 microseconds ) {
+	struct rbverse_update_plan plan;
+	struct rbverse_session *session;
+	VALUE sessionobj;
+	long i;
+
+	plan.timeout = microseconds;
+	plan.count = 0;
+	plan.slots = ALLOCA_N( struct rbverse_update_slot, session_table->num_entries + 1 );
+
+	/* The global session (servers and pings) */
+	plan.slots[0].id      = 0;
+	plan.slots[0].traffic = rbverse_global_traffic;
+	plan.slots[0].events  = 0;
+	plan.slots[0].usec    = 0;
+	plan.count = 1;
+	plan.finished = 0;
+	plan.generation = rbverse_network_generation();
+
+	st_foreach( session_table, rbverse_verse_update_plan_i, (st_data_t)&plan );
+	qsort( plan.slots, plan.count, sizeof(struct rbverse_update_slot), rbverse_update_slot_cmp );
+
+	rb_thread_blocking_region( rbverse_verse_update_adaptive_body, (void *)&plan,
+		RUBY_UBF_IO, NULL );
+
+	rbverse_verse_update_record_gvl_wait( plan.finished );
+
+	/* Fold what each session did this time into its traffic average. Sessions might
+	 * have gone away while the GVL was released, so look each one up again. */
+	for ( i = 0; i < plan.count; i++ ) {
+		session = NULL;
+
+		if ( !plan.slots[i].id ) {
+			rbverse_global_traffic = RBVERSE_TRAFFIC_AVERAGE( plan.slots[i].traffic, plan.slots[i].events );
+		} else if ( st_lookup(session_table, (st_data_t)plan.slots[i].id, (st_data_t *)&sessionobj) ) {
+			session = rbverse_get_session( sessionobj );
+			session->traffic = RBVERSE_TRAFFIC_AVERAGE( plan.slots[i].traffic, plan.slots[i].events );
+		}
+
+		if ( rbverse_stats_enabled && plan.finished ) {
+			rbverse_histogram_record( &rbverse_stats.slice, plan.slots[i].usec );
+			if ( session ) {
+				session->slices++;
+				session->slice_usec += plan.slots[i].usec;
+			}
+		}
+	}
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/* Body of rbverse_verse_update_wait() after the GVL is given up. */
+static VALUE
+rbverse_verse_update_wait_body( void *ptr ) {
+	struct rbverse_update_call *call = (struct rbverse_update_call *)ptr;
+	const uint64_t start = RBVERSE_TIMING_ENABLED() ? rbverse_usec_now() : 0;
+	const int pending = rbverse_event_wait( call->microseconds );
+
+	if ( start ) {
+		call->finished = rbverse_usec_now();
+		RBVERSE_TRACE_SPAN( "network", "wait for network thread", start, call->finished );
+	}
+
+	return pending ? Qtrue : Qfalse;
+}
+#endif
+
+
+/*
+ * Record the timing of a whole update that was done by the method with the given 
+ * +name+, and that started at +start+.
+ */
+static void
+rbverse_verse_update_record_update( const char *name, uint64_t start ) {
+	const uint64_t now = rbverse_usec_now();
+
+	if ( rbverse_stats_enabled ) rbverse_histogram_record( &rbverse_stats.update, now - start );
+	RBVERSE_TRACE_SPAN( "update", name, start, now );
+}
+
+
+/*
+ * Wait for up to +microseconds+ for the network thread to publish some events.
+ */
+static void
+rbverse_verse_update_wait( uint32 microseconds ) {
+#ifdef HAVE_PTHREAD_H
+	struct rbverse_update_call call;
+
+	call.id           = 0;
+	call.generation   = 0;
+	call.microseconds = microseconds;
+	call.started      = 0;
+	call.finished     = 0;
+	rb_thread_blocking_region( rbverse_verse_update_wait_body, (void *)&call,
+		rbverse_event_wait_interrupt, NULL );
+
+	rbverse_verse_update_record_gvl_wait( call.finished );
+#endif
+}
+
+
 /*
  * call-seq:
  *     Verse.update( timeout=0.1 )
@@ -259,6 +665,21 @@ rbverse_verse_update_i( VSession id, VALUE session, st_data_t timeout ) {
  * registered for the found commands. It will block for at most
  * +timeout+ microseconds while waiting for something to arrive.
  * 
+ * Commands that arrive are queued while the network is being read, and
+ * the observers for all of them are notified together once reading
+ * is finished.
+ * 
+ * How the +timeout+ is spent depends on Verse.update_mode. In +:timeslice+ 
+ * mode (the default), every session is updated in turn for an equal share
+ * of it. In +:adaptive+ mode, sessions that have data waiting are serviced 
+ * first, busiest first, and the update returns as soon as there's been some 
+ * work done; the time spent waiting on each idle session is weighted by its 
+ * recent traffic.
+ * 
+ * If the network thread is running (see Verse.start_network_thread), the network
+ * has already been read, so this just waits for up to +timeout+ for something to 
+ * arrive, and then dispatches everything that has.
+ * 
  * An application must call this function periodically in order to
  * service the connection with the other end of the Verse link; failure
  * to do so will cause the other end's packet buffer to grow monotonically,
@@ -276,79 +697,119 @@ rbverse_verse_update_i( VSession id, VALUE session, st_data_t timeout ) {
  */
 static VALUE
 rbverse_verse_update( int argc, VALUE *argv, VALUE module ) {
+	const uint64_t start = RBVERSE_TIMING_ENABLED() ? rbverse_usec_now() : 0;
 	VALUE seconds = Qnil;
-	uint32 microseconds, slice;
+	uint32 microseconds;
 
 	if ( rb_scan_args(argc, argv, "01", &seconds) == 1 )
 		microseconds = floor( NUM2DBL(seconds) * 1000000 );
 	else
 		microseconds = DEFAULT_UPDATE_TIMEOUT;
 
-	slice = microseconds / ( session_table->num_entries + 1 );
-	DEBUGMSG( "Update timeslice is %d µs", slice );
+	if ( rbverse_network_thread_running() )
+		rbverse_verse_update_wait( microseconds );
+	else if ( rbverse_update_mode == RBVERSE_UPDATE_ADAPTIVE )
+		rbverse_verse_update_adaptive( microseconds );
+	else
+		rbverse_verse_update_timeslice( microseconds );
 
-	DEBUGMSG( "  updating the global session" );
-	verse_session_set( 0 );
-	rb_thread_blocking_region( rbverse_verse_update_body, (uint32 *)&slice,
-		RUBY_UBF_IO, NULL );
+	/* Now that the GVL is held again, dispatch everything the callbacks queued up. */
+	rbverse_drain_events();
 
-	if ( session_table->num_entries ) {
-		DEBUGMSG( "  updating %lu client sessions", (long unsigned int)session_table->num_entries );
-		st_foreach( session_table, rbverse_verse_update_i, (st_data_t)slice );
-	} else {
-		DEBUGMSG( "  no client sessions to update" );
-	}
+	if ( start ) rbverse_verse_update_record_update( "Verse.update", start );
 
 	return Qtrue;
 }
 
 
-/* --------------------------------------------------------------
- * Observable Support
- * -------------------------------------------------------------- */
-
 /*
- * Iterator for ping callback.
+ * call-seq:
+ *     Verse.update_nonblock   -> integer
+ * 
+ * Read whatever has already arrived from the network without waiting for anything
+ * more, and dispatch it to the observers. Returns the number of events that were
+ * dispatched. If the network thread is running, this is the same as 
+ * Verse.process_pending.
+ * 
+ * This is meant for applications that do their waiting somewhere else, e.g., in an
+ * event loop or Fiber scheduler that's waiting on Verse.event_io.
  */
 static VALUE
-rbverse_cb_ping_i( VALUE observer, VALUE cb_args ) {
-	if ( !rb_obj_is_kind_of(observer, rbverse_mVersePingObserver) )
-		return Qnil;
+rbverse_verse_update_nonblock( VALUE module ) {
+	const uint64_t start = RBVERSE_TIMING_ENABLED() ? rbverse_usec_now() : 0;
+	unsigned long count;
+
+	if ( !rbverse_network_thread_running() )
+		rbverse_verse_update_timeslice( 0 );
+	count = rbverse_drain_events();
 
-	rbverse_log( "debug", "Ping callback: notifying observer: %s.",
-	             RSTRING_PTR(rb_inspect( observer )) );
-	return rb_funcall2( observer, rb_intern("on_ping"), RARRAY_LEN(cb_args), RARRAY_PTR(cb_args) );
+	if ( start ) rbverse_verse_update_record_update( "Verse.update_nonblock", start );
+
+	return ULONG2NUM( count );
 }
 
 
 /*
- * Call the ping handler after aqcuiring the GVL.
+ * call-seq:
+ *     Verse.process_pending   -> integer
+ * 
+ * Dispatch the events that have already been read from the network to their observers 
+ * without reading any more, and return how many there were. Once this returns, 
+ * Verse.event_io is no longer readable until more events arrive.
  */
-static void *
-rbverse_cb_ping_body( void *ptr ) {
-	const char **args = (const char **)ptr;
-	const VALUE cb_args = rb_ary_new();
-	const VALUE observers = rb_iv_get( rbverse_mVerse, "@observers" );
-
-	rb_ary_push( cb_args, rb_str_new2(args[0]) );
-	rb_ary_push( cb_args, rb_str_new2(args[1]) );
+static VALUE
+rbverse_verse_process_pending( VALUE module ) {
+	return ULONG2NUM( rbverse_drain_events() );
+}
 
-	rb_block_call( observers, rb_intern("each"), 0, 0, rbverse_cb_ping_i, cb_args );
 
-	return NULL;
+/*
+ * call-seq:
+ *     Verse.update_mode   -> symbol
+ *
+ * Returns the scheduling mode used by Verse.update, either +:timeslice+ or +:adaptive+.
+ *
+ */
+static VALUE
+rbverse_verse_update_mode( VALUE module ) {
+	if ( rbverse_update_mode == RBVERSE_UPDATE_ADAPTIVE )
+		return ID2SYM( rb_intern("adaptive") );
+	else
+		return ID2SYM( rb_intern("timeslice") );
 }
 
 
 /*
- * Callback for the 'ping' command.
+ * call-seq:
+ *     Verse.update_mode = symbol
+ *
+ * Set the scheduling mode used by Verse.update. See Verse.update for the details.
+ *
+ * @param [Symbol] mode  either +:timeslice+ or +:adaptive+
  */
-static void
-rbverse_cb_ping( void *unused, const char *addr, const char *msg ) {
-	const char *(args[2]) = { addr, msg };
-	rb_thread_call_with_gvl( rbverse_cb_ping_body, args );
+static VALUE
+rbverse_verse_update_mode_eq( VALUE module, VALUE mode ) {
+	ID mode_id = rb_to_id( mode );
+
+	if ( mode_id == rb_intern("adaptive") )
+		rbverse_update_mode = RBVERSE_UPDATE_ADAPTIVE;
+	else if ( mode_id == rb_intern("timeslice") )
+		rbverse_update_mode = RBVERSE_UPDATE_TIMESLICE;
+	else
+		rb_raise( rb_eArgError, "invalid update mode %s", rb_id2name(mode_id) );
+
+	return mode;
 }
 
 
+/* --------------------------------------------------------------
+ * Observable Support
+ * -------------------------------------------------------------- */
+
+/* Callback for the 'ping' command */
+RBVERSE_TRAMPOLINE( 2, ping, rbverse_mVerse, RBVERSE_ON_PING, STRING, STRING )
+
+
 /*
  * Verse namespace.
  * 
@@ -357,7 +818,17 @@ void
 Init_verse_ext( void ) {
 	rb_require( "verse" );
 
+	rbverse_id_log    = rb_intern( "log" );
+	rbverse_id_logger = rb_intern( "logger" );
+	rbverse_id_level  = rb_intern( "level" );
+	rbverse_log_level_ids[0] = rb_intern( "debug" );
+	rbverse_log_level_ids[1] = rb_intern( "info" );
+	rbverse_log_level_ids[2] = rb_intern( "warn" );
+	rbverse_log_level_ids[3] = rb_intern( "error" );
+	rbverse_log_level_ids[4] = rb_intern( "fatal" );
+
 	rbverse_mVerse = rb_define_module( "Verse" );
+	rbverse_verse_cache_log_level( rbverse_mVerse );
 
 	rbverse_mVerseLoggable = rb_define_module_under( rbverse_mVerse, "Loggable" );
 	rbverse_mVerseVersionUtilities = rb_define_module_under( rbverse_mVerse, "VersionUtilities" );
@@ -391,8 +862,13 @@ Init_verse_ext( void ) {
 	rb_define_alias( CLASS_OF(rbverse_mVerse),  "make_host_id", "create_host_id" );
 	rb_define_singleton_method( rbverse_mVerse, "host_id=", rbverse_verse_host_id_eq, 1 );
 	rb_define_singleton_method( rbverse_mVerse, "ping", rbverse_verse_ping, 2 );
+	rb_define_singleton_method( rbverse_mVerse, "cache_log_level", rbverse_verse_cache_log_level, 0 );
 	rb_define_singleton_method( rbverse_mVerse, "update", rbverse_verse_update, -1 );
+	rb_define_singleton_method( rbverse_mVerse, "update_nonblock", rbverse_verse_update_nonblock, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "process_pending", rbverse_verse_process_pending, 0 );
 	rb_define_alias( CLASS_OF(rbverse_mVerse),  "callback_update", "update" );
+	rb_define_singleton_method( rbverse_mVerse, "update_mode", rbverse_verse_update_mode, 0 );
+	rb_define_singleton_method( rbverse_mVerse, "update_mode=", rbverse_verse_update_mode_eq, 1 );
 
 	/*
 	 * Constants
@@ -414,13 +890,21 @@ Init_verse_ext( void ) {
 	                 rb_uint2inum(V_NT_NUM_TYPES_NETPACK) );
 
 	/* Init the subordinate classes */
+	rbverse_init_verse_pool();
 	rbverse_init_verse_session();
 	rbverse_init_verse_server();
 	rbverse_init_verse_node();
 	rbverse_init_verse_mixins();
+	rbverse_init_verse_eventqueue();
+	rbverse_init_verse_network();
+	rbverse_init_verse_stats();
+	rbverse_init_verse_trace();
+#ifdef RBVERSE_TESTING
+	rbverse_init_verse_testing();
+#endif
 
 	/* Set up calbacks */
-	verse_callback_set( verse_send_ping, rbverse_cb_ping, NULL );
+	RBVERSE_CALLBACK_SET( ping, rbverse_cb_ping );
 
 	rbverse_log( "debug", "Initialized the extension." );
 }
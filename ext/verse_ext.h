@@ -7,9 +7,12 @@
 #define __VERSE_EXT_H__
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <inttypes.h>
 #include <math.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include "verse.h"
 
@@ -21,16 +24,22 @@
 #	include "ruby/st.h"
 #endif /* !RUBY_VM */
 
+#ifdef HAVE_RUBY_IO_BUFFER_H
+#	include "ruby/io/buffer.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#	include <pthread.h>
+#endif
+
+#include "probes.h"
+
 #ifdef DEBUG
 #	define DEBUGMSG(format, args...) fprintf( stderr, "\033[37mDEBUG: "format"\033[0m\n", ##args );
 #else
 #	define DEBUGMSG(format, args...)
 #endif
 
-/* Missing declarations of "experimental" thread functions from ruby/thread.c */
-void * rb_thread_call_with_gvl(void *(*)(void *), void *);
-
-
 /* --------------------------------------------------------------
  * Globals
  * -------------------------------------------------------------- */
@@ -47,6 +56,13 @@ extern VALUE rbverse_mVerseObservable;
 extern VALUE rbverse_mVersePingObserver;
 extern VALUE rbverse_mVerseSessionObserver;
 extern VALUE rbverse_mVerseNodeObserver;
+extern VALUE rbverse_mVerseAudioNodeObserver;
+extern VALUE rbverse_mVerseGeometryNodeObserver;
+extern VALUE rbverse_mVerseObjectNodeObserver;
+extern VALUE rbverse_mVerseMaterialNodeObserver;
+extern VALUE rbverse_mVerseBitmapNodeObserver;
+extern VALUE rbverse_mVerseTextNodeObserver;
+extern VALUE rbverse_mVerseCurveNodeObserver;
 
 extern VALUE rbverse_cVerseServer;
 extern VALUE rbverse_cVerseSession;
@@ -73,12 +89,142 @@ extern st_table *session_table;
  * Typedefs
  * -------------------------------------------------------------- */
 
+/* Per-session table of the nodes the session knows about, indexed by VNodeID (see 
+ * nodetable.c). Verse hands out small, sequential node IDs, so the records are kept 
+ * in pages of a dense array, with a hash for any IDs above RBVERSE_NODE_TABLE_MAX_PAGES 
+ * pages. */
+#define RBVERSE_NODE_PAGE_BITS			8
+#define RBVERSE_NODE_PAGE_SIZE			(1 << RBVERSE_NODE_PAGE_BITS)
+#define RBVERSE_NODE_PAGE_MASK			(RBVERSE_NODE_PAGE_SIZE - 1)
+#define RBVERSE_NODE_TABLE_MAX_PAGES	4096
+
+#define RBVERSE_NODE_RECORD_USED		0x01
+#define RBVERSE_NODE_RECORD_PENDING		0x02	/* held by the session's node filter */
+#define RBVERSE_NODE_RECORD_REJECTED	0x04	/* rejected by the session's node filter */
+
+/* A known node. Its Verse::Node object is only created when something asks for it. */
+struct rbverse_node_record {
+	VNodeID             id;
+	uint8               type;
+	uint8               owner;
+	uint8               flags;
+	uint32              version;
+	char                *name;
+	struct rbverse_node *node;
+};
+
+struct rbverse_node_table {
+	struct rbverse_node_record **pages;
+	uint32                     page_count;
+	st_table                   *overflow;
+	unsigned long              count;
+};
+
+/* A session's client-side filter on the nodes it announces (see nodefilter.c). Strings
+ * are NULL and the tag value Qundef when they aren't part of the filter. */
+struct rbverse_node_filter {
+	uint32        typemask;
+	int           owner;
+	char          *name_prefix;
+	char          *name_pattern;
+	char          *tag_group;
+	char          *tag_name;
+	VALUE         tag_value;
+	VALUE         spec;
+
+	unsigned long accepted;
+	unsigned long rejected;
+};
+
 /* Class structures */
 struct rbverse_session {
 	VSession id;
 	VALUE    address;
 	VALUE    create_callbacks;
 	VALUE    destroy_callbacks;
+	VALUE    mutex;
+	VALUE    batch_thread;
+	uint32   traffic;
+
+	struct rbverse_node_table nodes;
+	struct rbverse_node_filter *filter;
+	unsigned long pending_nodes;
+	VALUE         pinned_nodes;
+
+	unsigned long commands_sent;
+	unsigned long slices;
+	uint64_t      slice_usec;
+};
+
+/* Formats of the values packed into a geometry layer */
+enum rbverse_geometry_format {
+	RBVERSE_GEOMETRY_UINT8,
+	RBVERSE_GEOMETRY_UINT32,
+	RBVERSE_GEOMETRY_REAL32,
+	RBVERSE_GEOMETRY_REAL64,
+};
+
+/* A layer of a geometry node. Its values are kept packed in one native buffer, 
+ * +components+ values of +format+ for each vertex or polygon, so millions of them don't
+ * need millions of Ruby objects. */
+struct rbverse_geometry_layer {
+	VLayerID        id;
+	VNGLayerType    type;
+	char            name[ 16 ];
+	uint32          def_uint;
+	real64          def_real;
+
+	uint8           format;
+	uint8           components;
+	uint32          count;
+	uint32          capacity;
+	void            *data;
+	VALUE           data_string;
+
+	/* A read-only IO::Buffer over +data+ (see GeometryNode#layer_buffer), which is 
+	 * freed when +data+ moves or the layer grows */
+	VALUE           buffer;
+
+	/* The number of used vertices and their bounds, kept for the base vertex layer.
+	 * The bounds are recomputed when they're next needed if +bounds_dirty+ is set. */
+	uint32          used;
+	boolean         bounds_dirty;
+	real64          min[ 3 ];
+	real64          max[ 3 ];
+
+	/* Set once a warning's been logged about values past GeometryNode.max_elements */
+	boolean         over_limit;
+};
+
+/* The values last sent to one of a geometry node's layers, for sending only the
+ * vertices or polygons that have changed since (see GeometryNode#sync_vertices). */
+struct rbverse_geometry_shadow {
+	uint8           format;
+	uint8           components;
+	uint32          count;
+	uint32          capacity;
+	void            *data;
+};
+
+/* A bone of a geometry node. Bones are kept in topological order (see 
+ * GeometryNode#bones), and each one's world matrix is cached until it or one of its 
+ * ancestors changes. */
+struct rbverse_geometry_bone {
+	uint16          id;
+	uint16          parent;
+	char            weight[ 16 ];
+	char            reference[ 16 ];
+	char            position_label[ 16 ];
+	char            rotation_label[ 16 ];
+	real64          position[ 3 ];
+	VNQuat64        rotation;
+
+	real64          world[ 16 ];
+	struct rbverse_geometry_bone *up;
+	uint32          rank;
+	boolean         placed;
+	boolean         dirty;
+	boolean         moved;
 };
 
 struct rbverse_node {
@@ -89,6 +235,10 @@ struct rbverse_node {
 	VALUE		tag_groups;
 	VALUE		session;
 	boolean     destroyed;
+
+	VALUE		wrapper;
+	struct rbverse_node_record *record;
+
 	union {
 		struct {
 			VALUE links;
@@ -102,23 +252,419 @@ struct rbverse_node {
 			VALUE buffers;
 			VALUE streams;
 		} audio;
+		struct {
+			struct rbverse_geometry_layer **layers;
+			struct rbverse_geometry_shadow **shadows;
+			uint32 layer_slots;
+			uint32 shadow_slots;
+
+			struct rbverse_geometry_bone **bones;
+			struct rbverse_geometry_bone **bone_order;
+			uint32 bone_slots;
+			uint32 bone_count;
+			boolean bones_unordered;
+			boolean bones_dirty;
+			VALUE bone_matrices;
+		} geometry;
 	};
 };
 
 
+/* The size of a node struct with no type-specific payload, and with the given member
+ * of the payload union. Nodes are allocated at the size for their type. */
+#define RBVERSE_NODE_BASE_SIZE			offsetof( struct rbverse_node, object )
+#define RBVERSE_NODE_SIZE(payload)		( RBVERSE_NODE_BASE_SIZE + \
+                                		  sizeof(((struct rbverse_node *)0)->payload) )
+
+/* Slab pool of fixed-size objects (see pool.c) */
+struct rbverse_pool {
+	const char          *name;
+	size_t              size;
+	unsigned long       per_slab;
+	void                *free_list;
+	void                *slabs;
+	unsigned long       slab_count;
+	unsigned long       in_use;
+	unsigned long       peak;
+	unsigned long       allocations;
+	unsigned long       frees;
+	struct rbverse_pool *next;
+};
+
+/* Observer callbacks that Verse::Observable keeps dispatch tables for */
+enum rbverse_observer_event {
+	RBVERSE_ON_PING,
+	RBVERSE_ON_CONNECT_ACCEPT,
+	RBVERSE_ON_CONNECT_TERMINATE,
+	RBVERSE_ON_CREATE_NODE,
+	RBVERSE_ON_NODE_CREATED,
+	RBVERSE_ON_NODE_DESTROY,
+	RBVERSE_ON_NODE_NAME_SET,
+	RBVERSE_ON_TAG_GROUP_CREATE,
+	RBVERSE_ON_TAG_GROUP_DESTROY,
+	RBVERSE_ON_TAG_GROUP_SUBSCRIBE,
+	RBVERSE_ON_TAG_GROUP_UNSUBSCRIBE,
+	RBVERSE_ON_TAG_CREATE,
+	RBVERSE_ON_TAG_DESTROY,
+	RBVERSE_ON_BUFFER_CREATE,
+	RBVERSE_ON_BUFFER_DESTROY,
+	RBVERSE_ON_BUFFER_SUBSCRIBE,
+	RBVERSE_ON_BUFFER_UNSUBSCRIBE,
+	RBVERSE_ON_BLOCK_CLEAR,
+	RBVERSE_ON_STREAM_CREATE,
+	RBVERSE_ON_STREAM_DESTROY,
+	RBVERSE_ON_STREAM_SUBSCRIBE,
+	RBVERSE_ON_STREAM_UNSUBSCRIBE,
+	RBVERSE_ON_LAYER_CREATE,
+	RBVERSE_ON_LAYER_DESTROY,
+	RBVERSE_ON_BONE_CREATE,
+	RBVERSE_ON_BONE_DESTROY,
+
+	RBVERSE_ON_TRANSFORM_SUBSCRIBE,
+	RBVERSE_ON_TRANSFORM_UNSUBSCRIBE,
+	RBVERSE_ON_TRANSFORM_SCALE,
+	RBVERSE_ON_LIGHT_SET,
+	RBVERSE_ON_LINK_SET,
+	RBVERSE_ON_LINK_DESTROY,
+	RBVERSE_ON_METHOD_GROUP_CREATE,
+	RBVERSE_ON_METHOD_GROUP_DESTROY,
+	RBVERSE_ON_METHOD_GROUP_SUBSCRIBE,
+	RBVERSE_ON_METHOD_GROUP_UNSUBSCRIBE,
+	RBVERSE_ON_METHOD_DESTROY,
+	RBVERSE_ON_HIDE,
+	RBVERSE_ON_FRAGMENT_DESTROY,
+	RBVERSE_ON_DIMENSIONS_SET,
+	RBVERSE_ON_BITMAP_LAYER_CREATE,
+	RBVERSE_ON_BITMAP_LAYER_DESTROY,
+	RBVERSE_ON_BITMAP_LAYER_SUBSCRIBE,
+	RBVERSE_ON_BITMAP_LAYER_UNSUBSCRIBE,
+	RBVERSE_ON_LANGUAGE_SET,
+	RBVERSE_ON_TEXT_BUFFER_CREATE,
+	RBVERSE_ON_TEXT_BUFFER_DESTROY,
+	RBVERSE_ON_TEXT_BUFFER_SUBSCRIBE,
+	RBVERSE_ON_TEXT_BUFFER_UNSUBSCRIBE,
+	RBVERSE_ON_TEXT_SET,
+	RBVERSE_ON_CURVE_CREATE,
+	RBVERSE_ON_CURVE_DESTROY,
+	RBVERSE_ON_CURVE_SUBSCRIBE,
+	RBVERSE_ON_CURVE_UNSUBSCRIBE,
+	RBVERSE_ON_KEY_DESTROY,
+	RBVERSE_OBSERVER_EVENT_COUNT
+};
+
+/* The kinds of event the queue counts for Verse.stats: one for each observer callback, 
+ * plus the callbacks that Verse::Server handles itself, and the geometry values that 
+ * are stored without notifying anyone */
+#define RBVERSE_EVENT_SERVER_CONNECT			RBVERSE_OBSERVER_EVENT_COUNT
+#define RBVERSE_EVENT_SERVER_INDEX_SUBSCRIBE	(RBVERSE_OBSERVER_EVENT_COUNT + 1)
+#define RBVERSE_EVENT_GEOMETRY_SET				(RBVERSE_OBSERVER_EVENT_COUNT + 2)
+#define RBVERSE_EVENT_KIND_COUNT				(RBVERSE_OBSERVER_EVENT_COUNT + 3)
+
+/* Handler for a Verse event that's been queued for dispatch once the GVL is held */
+typedef void * (*rbverse_event_handler)( void * );
+
+/* Log-linear histogram of durations in µs for Verse.stats (see stats.c). Values below
+ * RBVERSE_HISTOGRAM_SUB_COUNT get a bucket each; above that, each power of two is split
+ * into RBVERSE_HISTOGRAM_SUB_COUNT buckets, so a value's bucket is within 12.5% of it. */
+#define RBVERSE_HISTOGRAM_SUB_BITS	3
+#define RBVERSE_HISTOGRAM_SUB_COUNT	(1 << RBVERSE_HISTOGRAM_SUB_BITS)
+#define RBVERSE_HISTOGRAM_MAX_BITS	36
+#define RBVERSE_HISTOGRAM_BUCKETS \
+	( RBVERSE_HISTOGRAM_SUB_COUNT * (RBVERSE_HISTOGRAM_MAX_BITS - RBVERSE_HISTOGRAM_SUB_BITS + 1) )
+
+struct rbverse_histogram {
+	uint64_t count;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[ RBVERSE_HISTOGRAM_BUCKETS ];
+};
+
+/* Counters kept for Verse.stats. They're only updated while the GVL is held; counts of 
+ * events received are kept by the event queue, as those are queued without it. */
+struct rbverse_stats {
+	struct {
+		unsigned long dispatched;
+		unsigned long notified;
+		uint64_t      dispatch_usec;
+	} events[ RBVERSE_EVENT_KIND_COUNT ];
+
+	unsigned long nodes_wrapped;
+	unsigned long nodes_freed;
+
+	struct rbverse_histogram update;
+	struct rbverse_histogram slice;
+	struct rbverse_histogram gvl_wait;
+	struct rbverse_histogram observer_call;
+};
+
+
 /* Verse::Node globals. These are used to hook up child classes into
  * Verse::Node's memory-management and node-creation functions. */
 extern VALUE rbverse_nodetype_to_nodeclass[];
 extern void ( *node_mark_funcs[] )(struct rbverse_node *);
 extern void ( *node_free_funcs[] )(struct rbverse_node *);
+extern void ( *node_compact_funcs[] )(struct rbverse_node *);
+extern size_t ( *node_memsize_funcs[] )(const struct rbverse_node *);
+
+/* Typed data types of the wrapped structs. Each node type has its own, with the
+ * Verse::Node type as its parent. */
+extern const rb_data_type_t rbverse_session_data_type;
+extern const rb_data_type_t rbverse_node_data_type;
+extern const rb_data_type_t rbverse_node_data_types[];
 
 
 /* --------------------------------------------------------------
  * Macros
  * -------------------------------------------------------------- */
+
+/* Mark a VALUE without pinning it, and update it after compaction, on Rubies that
+ * have a compacting GC. Elsewhere, marking pins and there's nothing to update. */
+#ifdef HAVE_RB_GC_LOCATION
+#	define rbverse_gc_mark_movable( value )	rb_gc_mark_movable( value )
+#	define rbverse_gc_update( value )		( (value) = rb_gc_location(value) )
+#else
+#	define rbverse_gc_mark_movable( value )	rb_gc_mark( value )
+#	define rbverse_gc_update( value )		( (void)(value) )
+#endif
+
+
+/* --------------------------------------------------------------
+ * More Macros
+ * -------------------------------------------------------------- */
 #define DEFAULT_ADDRESS "127.0.0.1"
 #define DEFAULT_UPDATE_TIMEOUT 100000
 
+/* The default time the network thread spends on each pass over the sessions, in µs */
+#define DEFAULT_NETWORK_INTERVAL 10000
+
+/* The longest time the network thread can be told to spend on each pass, in seconds */
+#define MAX_NETWORK_INTERVAL 10
+
+/* The longest the network thread will hold off taking the session switch lock while 
+ * Ruby threads are waiting for it, in µs */
+#define RBVERSE_SWITCH_YIELD_TIMEOUT 10000
+
+/* The shortest time the adaptive scheduler will wait on an idle session, in µs */
+#define RBVERSE_MIN_UPDATE_WAIT 1000
+
+/* Fold the number of +events+ from the latest update into a session's +traffic+
+ * average (fixed-point, 8 fractional bits) */
+#define RBVERSE_TRAFFIC_AVERAGE(traffic, events) \
+	( (uint32)(( (uint64_t)(traffic) * 7 + (uint64_t)(events) * 256 ) / 8) )
+
+/* Map a level name ("debug", "info", "warn", "error", "fatal") onto the equivalent Logger
+ * level. This folds down to a constant for literal level names. */
+#define RBVERSE_LOG_LEVEL_NUM(level) \
+	( (level)[0] == 'd' ? 0 : (level)[0] == 'i' ? 1 : (level)[0] == 'w' ? 2 : (level)[0] == 'e' ? 3 : 4 )
+
+/* Log a message to the global logger or to a +context+ object's logger. The level is
+ * checked against the cached level of Verse.logger first, so messages at a disabled level
+ * cost one comparison: their arguments aren't even evaluated. */
+#define rbverse_log( level, ... ) \
+	do { \
+		if ( RBVERSE_LOG_LEVEL_NUM(level) >= rbverse_log_level ) \
+			rbverse_log_message( level, __VA_ARGS__ ); \
+	} while (0)
+#define rbverse_log_with_context( context, level, ... ) \
+	do { \
+		if ( RBVERSE_LOG_LEVEL_NUM(level) >= rbverse_log_level ) \
+			rbverse_log_message_with_context( context, level, __VA_ARGS__ ); \
+	} while (0)
+
+/* Record a span of the given +category+ and +name+ from +start+ to +end+ (µs from 
+ * rbverse_usec_now()) if a trace is being recorded (see trace.c) */
+#define RBVERSE_TRACE_SPAN( category, name, start, end ) \
+	do { \
+		if ( rbverse_trace_enabled ) \
+			rbverse_trace_span( (category), (name), (start), (end) ); \
+	} while (0)
+
+/* True if anything wants the update loop to be timed */
+#define RBVERSE_TIMING_ENABLED() \
+	( rbverse_stats_enabled || rbverse_trace_enabled || rbverse_observer_budget )
+
+/* Set the +callback+ Verse calls for +command+, e.g., RBVERSE_CALLBACK_SET( ping,
+ * rbverse_cb_ping ). In builds with Verse::Testing, the callback is also recorded so 
+ * specs can call it (see testing.c). */
+#ifdef RBVERSE_TESTING
+#	define RBVERSE_CALLBACK_SET( command, callback ) \
+		rbverse_callback_set( #command, (void *)verse_send_##command, (void *)(callback) )
+#else
+#	define RBVERSE_CALLBACK_SET( command, callback ) \
+		verse_callback_set( (void *)verse_send_##command, (void *)(callback), NULL )
+#endif
+
+/* The amount of event string space needed for +str+ */
+#define RBVERSE_EVENT_STRSIZE(str) ( (str) ? strlen(str) + 1 : 0 )
+
+
+/* --------------------------------------------------------------
+ * Callback trampolines
+ * -------------------------------------------------------------- */
+
+/* 
+ * Most Verse commands just need their arguments handed to an observer callback. For
+ * those, RBVERSE_TRAMPOLINE() and RBVERSE_NODE_TRAMPOLINE() generate the Verse callback,
+ * the struct it queues its arguments in, and the handler that converts them and notifies
+ * the observers, e.g.:
+ * 
+ *   RBVERSE_NODE_TRAMPOLINE( 2, tag_group_create, RBVERSE_ON_TAG_GROUP_CREATE, UINT16, STRING )
+ * 
+ * defines rbverse_cb_tag_group_create( void *, VNodeID, uint16, const char * ) for
+ * verse_callback_set(). The arguments are passed to the observers on the C stack, and
+ * are only converted if there's an observer to receive them, so dispatching an event
+ * doesn't create any garbage other than the arguments themselves.
+ * 
+ * Each argument is one of the kinds below; the macros for a kind give its C type, how
+ * much event string space it needs, how it's copied into the event, and how it's 
+ * converted into a Ruby object.
+ */
+#define RBVERSE_CB_CTYPE_UINT8				uint8
+#define RBVERSE_CB_CTYPE_UINT16				uint16
+#define RBVERSE_CB_CTYPE_UINT32				uint32
+#define RBVERSE_CB_CTYPE_REAL32				real32
+#define RBVERSE_CB_CTYPE_REAL64				real64
+#define RBVERSE_CB_CTYPE_STRING				const char *
+
+#define RBVERSE_CB_STRSIZE_UINT8( arg )		0
+#define RBVERSE_CB_STRSIZE_UINT16( arg )	0
+#define RBVERSE_CB_STRSIZE_UINT32( arg )	0
+#define RBVERSE_CB_STRSIZE_REAL32( arg )	0
+#define RBVERSE_CB_STRSIZE_REAL64( arg )	0
+#define RBVERSE_CB_STRSIZE_STRING( arg )	RBVERSE_EVENT_STRSIZE( arg )
+
+#define RBVERSE_CB_COPY_UINT8( ev, arg )	(arg)
+#define RBVERSE_CB_COPY_UINT16( ev, arg )	(arg)
+#define RBVERSE_CB_COPY_UINT32( ev, arg )	(arg)
+#define RBVERSE_CB_COPY_REAL32( ev, arg )	(arg)
+#define RBVERSE_CB_COPY_REAL64( ev, arg )	(arg)
+#define RBVERSE_CB_COPY_STRING( ev, arg )	rbverse_event_strdup( (ev), (arg) )
+
+#define RBVERSE_CB_VALUE_UINT8( arg )		INT2FIX( arg )
+#define RBVERSE_CB_VALUE_UINT16( arg )		INT2FIX( arg )
+#define RBVERSE_CB_VALUE_UINT32( arg )		UINT2NUM( arg )
+#define RBVERSE_CB_VALUE_REAL32( arg )		rb_float_new( (double)(arg) )
+#define RBVERSE_CB_VALUE_REAL64( arg )		rb_float_new( arg )
+#define RBVERSE_CB_VALUE_STRING( arg )		( (arg) ? rb_str_new2(arg) : Qnil )
+
+/* Per-arity expansions of the argument list for each part of a trampoline */
+#define RBVERSE_CB_PARAMS_1( k1 ) \
+	, RBVERSE_CB_CTYPE_##k1 a1
+#define RBVERSE_CB_PARAMS_2( k1, k2 ) \
+	RBVERSE_CB_PARAMS_1( k1 ), RBVERSE_CB_CTYPE_##k2 a2
+#define RBVERSE_CB_PARAMS_3( k1, k2, k3 ) \
+	RBVERSE_CB_PARAMS_2( k1, k2 ), RBVERSE_CB_CTYPE_##k3 a3
+#define RBVERSE_CB_PARAMS_4( k1, k2, k3, k4 ) \
+	RBVERSE_CB_PARAMS_3( k1, k2, k3 ), RBVERSE_CB_CTYPE_##k4 a4
+#define RBVERSE_CB_PARAMS_5( k1, k2, k3, k4, k5 ) \
+	RBVERSE_CB_PARAMS_4( k1, k2, k3, k4 ), RBVERSE_CB_CTYPE_##k5 a5
+#define RBVERSE_CB_PARAMS_6( k1, k2, k3, k4, k5, k6 ) \
+	RBVERSE_CB_PARAMS_5( k1, k2, k3, k4, k5 ), RBVERSE_CB_CTYPE_##k6 a6
+
+#define RBVERSE_CB_FIELDS_1( k1 ) \
+	RBVERSE_CB_CTYPE_##k1 a1;
+#define RBVERSE_CB_FIELDS_2( k1, k2 ) \
+	RBVERSE_CB_FIELDS_1( k1 ) RBVERSE_CB_CTYPE_##k2 a2;
+#define RBVERSE_CB_FIELDS_3( k1, k2, k3 ) \
+	RBVERSE_CB_FIELDS_2( k1, k2 ) RBVERSE_CB_CTYPE_##k3 a3;
+#define RBVERSE_CB_FIELDS_4( k1, k2, k3, k4 ) \
+	RBVERSE_CB_FIELDS_3( k1, k2, k3 ) RBVERSE_CB_CTYPE_##k4 a4;
+#define RBVERSE_CB_FIELDS_5( k1, k2, k3, k4, k5 ) \
+	RBVERSE_CB_FIELDS_4( k1, k2, k3, k4 ) RBVERSE_CB_CTYPE_##k5 a5;
+#define RBVERSE_CB_FIELDS_6( k1, k2, k3, k4, k5, k6 ) \
+	RBVERSE_CB_FIELDS_5( k1, k2, k3, k4, k5 ) RBVERSE_CB_CTYPE_##k6 a6;
+
+#define RBVERSE_CB_STRSIZE_1( k1 ) \
+	RBVERSE_CB_STRSIZE_##k1( a1 )
+#define RBVERSE_CB_STRSIZE_2( k1, k2 ) \
+	RBVERSE_CB_STRSIZE_1( k1 ) + RBVERSE_CB_STRSIZE_##k2( a2 )
+#define RBVERSE_CB_STRSIZE_3( k1, k2, k3 ) \
+	RBVERSE_CB_STRSIZE_2( k1, k2 ) + RBVERSE_CB_STRSIZE_##k3( a3 )
+#define RBVERSE_CB_STRSIZE_4( k1, k2, k3, k4 ) \
+	RBVERSE_CB_STRSIZE_3( k1, k2, k3 ) + RBVERSE_CB_STRSIZE_##k4( a4 )
+#define RBVERSE_CB_STRSIZE_5( k1, k2, k3, k4, k5 ) \
+	RBVERSE_CB_STRSIZE_4( k1, k2, k3, k4 ) + RBVERSE_CB_STRSIZE_##k5( a5 )
+#define RBVERSE_CB_STRSIZE_6( k1, k2, k3, k4, k5, k6 ) \
+	RBVERSE_CB_STRSIZE_5( k1, k2, k3, k4, k5 ) + RBVERSE_CB_STRSIZE_##k6( a6 )
+
+#define RBVERSE_CB_COPY_1( k1 ) \
+	event->a1 = RBVERSE_CB_COPY_##k1( event, a1 );
+#define RBVERSE_CB_COPY_2( k1, k2 ) \
+	RBVERSE_CB_COPY_1( k1 ) event->a2 = RBVERSE_CB_COPY_##k2( event, a2 );
+#define RBVERSE_CB_COPY_3( k1, k2, k3 ) \
+	RBVERSE_CB_COPY_2( k1, k2 ) event->a3 = RBVERSE_CB_COPY_##k3( event, a3 );
+#define RBVERSE_CB_COPY_4( k1, k2, k3, k4 ) \
+	RBVERSE_CB_COPY_3( k1, k2, k3 ) event->a4 = RBVERSE_CB_COPY_##k4( event, a4 );
+#define RBVERSE_CB_COPY_5( k1, k2, k3, k4, k5 ) \
+	RBVERSE_CB_COPY_4( k1, k2, k3, k4 ) event->a5 = RBVERSE_CB_COPY_##k5( event, a5 );
+#define RBVERSE_CB_COPY_6( k1, k2, k3, k4, k5, k6 ) \
+	RBVERSE_CB_COPY_5( k1, k2, k3, k4, k5 ) event->a6 = RBVERSE_CB_COPY_##k6( event, a6 );
+
+#define RBVERSE_CB_VALUES_1( k1 ) \
+	*argp++ = RBVERSE_CB_VALUE_##k1( event->a1 );
+#define RBVERSE_CB_VALUES_2( k1, k2 ) \
+	RBVERSE_CB_VALUES_1( k1 ) *argp++ = RBVERSE_CB_VALUE_##k2( event->a2 );
+#define RBVERSE_CB_VALUES_3( k1, k2, k3 ) \
+	RBVERSE_CB_VALUES_2( k1, k2 ) *argp++ = RBVERSE_CB_VALUE_##k3( event->a3 );
+#define RBVERSE_CB_VALUES_4( k1, k2, k3, k4 ) \
+	RBVERSE_CB_VALUES_3( k1, k2, k3 ) *argp++ = RBVERSE_CB_VALUE_##k4( event->a4 );
+#define RBVERSE_CB_VALUES_5( k1, k2, k3, k4, k5 ) \
+	RBVERSE_CB_VALUES_4( k1, k2, k3, k4 ) *argp++ = RBVERSE_CB_VALUE_##k5( event->a5 );
+#define RBVERSE_CB_VALUES_6( k1, k2, k3, k4, k5, k6 ) \
+	RBVERSE_CB_VALUES_5( k1, k2, k3, k4, k5 ) *argp++ = RBVERSE_CB_VALUE_##k6( event->a6 );
+
+/* Trampoline for the +command+ with +arity+ arguments of the given kinds that notifies 
+ * the observers of +observable+ of +observer_event+. */
+#define RBVERSE_TRAMPOLINE( arity, command, observable, observer_event, ... ) \
+	struct rbverse_##command##_event { \
+		RBVERSE_CB_FIELDS_##arity( __VA_ARGS__ ) \
+	}; \
+	static void * \
+	rbverse_cb_##command##_body( void *ptr ) { \
+		const struct rbverse_##command##_event *event = ptr; \
+		VALUE argv[ arity ], *argp = argv; \
+		if ( !rbverse_has_observers((observable), (observer_event)) ) return NULL; \
+		RBVERSE_CB_VALUES_##arity( __VA_ARGS__ ) \
+		rbverse_notify_observers( (observable), (observer_event), (arity), argv ); \
+		return NULL; \
+	} \
+	static void \
+	rbverse_cb_##command( void *unused RBVERSE_CB_PARAMS_##arity(__VA_ARGS__) ) { \
+		struct rbverse_##command##_event *event = \
+			rbverse_event_new( rbverse_cb_##command##_body, (observer_event), sizeof(*event), \
+			                   RBVERSE_CB_STRSIZE_##arity(__VA_ARGS__) ); \
+		RBVERSE_CB_COPY_##arity( __VA_ARGS__ ) \
+	}
+
+/* Trampoline for the node +command+ whose first argument is a VNodeID, followed by +arity+
+ * arguments of the given kinds. The observers of the node, if it's been wrapped, are 
+ * notified of +observer_event+ with the node followed by the other arguments. */
+#define RBVERSE_NODE_TRAMPOLINE( arity, command, observer_event, ... ) \
+	struct rbverse_##command##_event { \
+		VNodeID node_id; \
+		RBVERSE_CB_FIELDS_##arity( __VA_ARGS__ ) \
+	}; \
+	static void * \
+	rbverse_cb_##command##_body( void *ptr ) { \
+		const struct rbverse_##command##_event *event = ptr; \
+		VALUE argv[ arity + 1 ], *argp = argv; \
+		const VALUE node = rbverse_lookup_wrapped_node( event->node_id ); \
+		if ( !rbverse_has_observers(node, (observer_event)) ) return NULL; \
+		*argp++ = node; \
+		RBVERSE_CB_VALUES_##arity( __VA_ARGS__ ) \
+		rbverse_notify_observers( node, (observer_event), (arity) + 1, argv ); \
+		return NULL; \
+	} \
+	static void \
+	rbverse_cb_##command( void *unused, VNodeID node_id RBVERSE_CB_PARAMS_##arity(__VA_ARGS__) ) { \
+		struct rbverse_##command##_event *event = \
+			rbverse_event_new( rbverse_cb_##command##_body, (observer_event), sizeof(*event), \
+			                   RBVERSE_CB_STRSIZE_##arity(__VA_ARGS__) ); \
+		event->node_id = node_id; \
+		RBVERSE_CB_COPY_##arity( __VA_ARGS__ ) \
+	}
+
 
 /* --------------------------------------------------------------
  * Inline functions
@@ -138,36 +684,73 @@ rbverse_ensure_node_is_alive( struct rbverse_node *node ) {
 		rb_raise( rbverse_eVerseNodeError, "node is destroyed" );
 }
 
-/* Type-check functions */
+/*
+ * Return the current value of a monotonic clock in microseconds.
+ */
+static inline uint64_t
+rbverse_usec_now( void ) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+/* Type-check functions. The wrapped types check the object's typed data type instead 
+ * of walking its class's ancestors. */
 static inline boolean IsSession( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseSession ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_session_data_type ) ? TRUE : FALSE;
 }
 static inline boolean IsServer( VALUE obj ) {
 	return rb_obj_is_kind_of( obj, rbverse_cVerseServer ) ? TRUE : FALSE;
 }
 static inline boolean IsNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_type ) ? TRUE : FALSE;
 }
 static inline boolean IsAudioNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseAudioNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_AUDIO] ) ? TRUE : FALSE;
 }
 static inline boolean IsBitmapNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseBitmapNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_BITMAP] ) ? TRUE : FALSE;
 }
 static inline boolean IsCurveNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseCurveNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_CURVE] ) ? TRUE : FALSE;
 }
 static inline boolean IsGeometryNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseGeometryNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_GEOMETRY] ) ? TRUE : FALSE;
 }
 static inline boolean IsMaterialNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseMaterialNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_MATERIAL] ) ? TRUE : FALSE;
 }
 static inline boolean IsObjectNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseObjectNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_OBJECT] ) ? TRUE : FALSE;
 }
 static inline boolean IsTextNode( VALUE obj ) {
-	return rb_obj_is_kind_of( obj, rbverse_cVerseTextNode ) ? TRUE : FALSE;
+	return rb_typeddata_is_kind_of( obj, &rbverse_node_data_types[V_NT_TEXT] ) ? TRUE : FALSE;
+}
+
+
+/*
+ * Return the record for the node with the given +id+ from the specified node +table+, 
+ * or NULL if there isn't one.
+ */
+extern struct rbverse_node_record * rbverse_node_table_lookup_overflow _(( struct rbverse_node_table *, VNodeID ));
+static inline struct rbverse_node_record *
+rbverse_node_table_lookup( struct rbverse_node_table *table, VNodeID id ) {
+	const uint32 page = id >> RBVERSE_NODE_PAGE_BITS;
+	struct rbverse_node_record *record;
+
+	if ( page >= RBVERSE_NODE_TABLE_MAX_PAGES )
+		return rbverse_node_table_lookup_overflow( table, id );
+	if ( page >= table->page_count || !table->pages[page] )
+		return NULL;
+
+	record = &table->pages[ page ][ id & RBVERSE_NODE_PAGE_MASK ];
+	return ( record->flags & RBVERSE_NODE_RECORD_USED ) ? record : NULL;
 }
 
 
@@ -179,28 +762,112 @@ static inline boolean IsTextNode( VALUE obj ) {
 #ifdef HAVE_STDARG_PROTOTYPES
 #include <stdarg.h>
 #define va_init_list(a,b) va_start(a,b)
-void rbverse_log_with_context( VALUE, const char *, const char *, ... );
-void rbverse_log( const char *, const char *, ... );
+void rbverse_log_message_with_context( VALUE, const char *, const char *, ... );
+void rbverse_log_message( const char *, const char *, ... );
 #else
 #include <varargs.h>
 #define va_init_list(a,b) va_start(a)
-void rbverse_log_with_context( VALUE, const char *, const char *, va_dcl );
-void rbverse_log( const char *, const char *, va_dcl );
+void rbverse_log_message_with_context( VALUE, const char *, const char *, va_dcl );
+void rbverse_log_message( const char *, const char *, va_dcl );
 #endif
 
+extern int rbverse_log_level;
+
 extern inline uint8 * rbverse_str2host_id			_(( VALUE ));
 extern inline VALUE rbverse_host_id2str				_(( const uint8 * ));
 
+/* eventqueue.c */
+extern unsigned long rbverse_event_count;
+extern void * rbverse_event_new						_(( rbverse_event_handler, int, size_t, size_t ));
+extern const void * rbverse_event_memdup			_(( void *, const void *, size_t ));
+extern const char * rbverse_event_strdup			_(( void *, const char * ));
+extern void rbverse_event_publish					_(( void ));
+extern unsigned long rbverse_drain_events			_(( void ));
+extern unsigned long rbverse_event_block_count		_(( void ));
+extern VSession rbverse_dispatch_session;
+extern void rbverse_event_received_counts			_(( unsigned long *, int ));
+#ifdef HAVE_PTHREAD_H
+extern int rbverse_event_wait						_(( uint32 ));
+extern void rbverse_event_wait_interrupt			_(( void * ));
+#endif
+
+/* testing.c */
+#ifdef RBVERSE_TESTING
+extern void rbverse_callback_set					_(( const char *, void *, void * ));
+#endif
+
+/* network.c */
+extern void rbverse_network_add_session				_(( VSession ));
+extern void rbverse_network_remove_session			_(( VSession ));
+extern unsigned long rbverse_network_generation		_(( void ));
+extern int rbverse_network_session_valid			_(( VSession, unsigned long ));
+extern int rbverse_network_thread_running			_(( void ));
+
+/* pool.c */
+extern void rbverse_pool_init						_(( struct rbverse_pool *, const char *, size_t ));
+extern void * rbverse_pool_alloc					_(( struct rbverse_pool * ));
+extern void rbverse_pool_free						_(( struct rbverse_pool *, void * ));
+
+/* stats.c */
+extern int rbverse_stats_enabled;
+extern struct rbverse_stats rbverse_stats;
+extern void rbverse_histogram_record				_(( struct rbverse_histogram *, uint64_t ));
+extern const char * rbverse_event_kind_name			_(( int ));
+extern uint64_t rbverse_observer_budget;
+extern void rbverse_observer_call_record			_(( VALUE, enum rbverse_observer_event, uint64_t ));
+
+/* trace.c */
+extern volatile int rbverse_trace_enabled;
+extern void rbverse_trace_span						_(( const char *, const char *, uint64_t, uint64_t ));
+extern void rbverse_trace_set_thread_name			_(( const char * ));
+
+/* mixins.c */
+extern void rbverse_notify_observers				_(( VALUE, enum rbverse_observer_event, int, VALUE * ));
+extern int rbverse_has_observers					_(( VALUE, enum rbverse_observer_event ));
+extern const char * rbverse_observer_event_method	_(( enum rbverse_observer_event ));
+
 /* session.c */
+extern struct rbverse_session * rbverse_get_session	_(( VALUE ));
 extern VALUE rbverse_get_current_session			_(( void ));
 extern VALUE rbverse_with_session_lock				_(( VALUE, VALUE (*)(ANYARGS), VALUE ));
+extern VALUE rbverse_with_session_lock_n			_(( VALUE, VALUE (*)(ANYARGS), VALUE, unsigned long ));
+extern void rbverse_session_switch_lock				_(( void ));
+extern void rbverse_session_switch_lock_nogvl		_(( void ));
+extern void rbverse_session_switch_unlock			_(( void ));
+extern void rbverse_session_switch_yield			_(( uint32 ));
 extern VALUE rbverse_verse_session_from_vsession	_(( VSession, VALUE ));
 extern VALUE rbverse_verse_session_s_all_connected  _(( VALUE ));
+extern void rbverse_session_announce_node			_(( VALUE, struct rbverse_node_record *, VALUE ));
+extern void rbverse_session_pin_node				_(( VALUE, struct rbverse_node * ));
+extern void rbverse_session_unpin_node				_(( VALUE, VNodeID ));
+
+/* nodetable.c */
+extern void rbverse_node_table_init					_(( struct rbverse_node_table * ));
+extern struct rbverse_node_record * rbverse_node_table_insert _(( struct rbverse_node_table *, VNodeID, VNodeType, VNodeOwner ));
+extern void rbverse_node_table_delete				_(( struct rbverse_node_table *, struct rbverse_node_record * ));
+extern void rbverse_node_table_clear				_(( struct rbverse_node_table * ));
+extern size_t rbverse_node_table_memsize			_(( const struct rbverse_node_table * ));
+extern void rbverse_node_record_attach				_(( struct rbverse_node_record *, struct rbverse_node * ));
+extern void rbverse_node_record_detach				_(( struct rbverse_node_record * ));
+extern void rbverse_node_record_set_name			_(( struct rbverse_node_record *, const char * ));
+
+/* nodefilter.c */
+extern struct rbverse_node_filter * rbverse_node_filter_new _(( VALUE ));
+extern void rbverse_node_filter_free				_(( struct rbverse_node_filter * ));
+extern void rbverse_node_filter_mark				_(( struct rbverse_node_filter * ));
+extern void rbverse_node_filter_compact				_(( struct rbverse_node_filter * ));
+extern size_t rbverse_node_filter_memsize			_(( const struct rbverse_node_filter * ));
+extern int rbverse_session_filter_node				_(( VALUE, struct rbverse_node_record * ));
+extern void rbverse_session_filter_node_name		_(( VALUE, struct rbverse_node_record * ));
+extern void rbverse_session_filter_tag_group		_(( VALUE, struct rbverse_node_record *, uint16, const char * ));
+extern void rbverse_session_filter_release			_(( VALUE, struct rbverse_node_record * ));
+extern void rbverse_session_filter_tag				_(( VALUE, struct rbverse_node_record *, const char *, VNTagType, const VNTag * ));
 
 /* node.c */
 extern VALUE rbverse_node_class_from_node_type		_(( VNodeType  ));
-extern VALUE rbverse_wrap_verse_node				_(( VNodeID, VNodeType, VNodeOwner ));
-extern VALUE rbverse_lookup_verse_node				_(( VNodeID ));
+extern VALUE rbverse_wrap_verse_node				_(( VALUE, struct rbverse_node_record * ));
+extern VALUE rbverse_lookup_verse_node				_(( VALUE, VNodeID ));
+extern VALUE rbverse_lookup_wrapped_node			_(( VNodeID ));
 extern void rbverse_mark_node_destroyed				_(( VALUE ));
 extern struct rbverse_node * rbverse_get_node				_(( VALUE ));
 
@@ -214,6 +881,14 @@ void Init_verse_ext( void );
 extern void rbverse_init_verse_server       _(( void ));
 extern void rbverse_init_verse_session      _(( void ));
 extern void rbverse_init_verse_mixins       _(( void ));
+extern void rbverse_init_verse_eventqueue   _(( void ));
+extern void rbverse_init_verse_network     _(( void ));
+extern void rbverse_init_verse_stats       _(( void ));
+extern void rbverse_init_verse_trace       _(( void ));
+extern void rbverse_init_verse_pool        _(( void ));
+#ifdef RBVERSE_TESTING
+extern void rbverse_init_verse_testing     _(( void ));
+#endif
 
 extern void rbverse_init_verse_node         _(( void ));
 extern void rbverse_init_verse_audionode    _(( void ));
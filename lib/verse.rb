@@ -36,7 +36,6 @@ module Verse
 	@default_log_formatter = Verse::LogFormatter.new( @default_logger )
 	@default_logger.formatter = @default_log_formatter
 
-	@logger = @default_logger
 
 
 	class << self
@@ -47,12 +46,24 @@ module Verse
 		attr_accessor :default_logger
 
 		# The logger that's currently in effect
-		attr_accessor :logger
+		attr_reader :logger
 		alias_method :log, :logger
-		alias_method :log=, :logger=
 	end
 
 
+	### Set the logger that's in effect to +newlogger+. The extension keeps a copy of the
+	### logger's level so it can skip building messages that won't be logged, so the 
+	### logger is extended to keep that copy up to date.
+	def self::logger=( newlogger )
+		newlogger.extend( Verse::LogLevelTracking ) unless newlogger.is_a?( Verse::LogLevelTracking )
+		@logger = newlogger
+		self.cache_log_level if self.respond_to?( :cache_log_level )
+	end
+	singleton_class.send( :alias_method, :log=, :logger= )
+
+	self.logger = @default_logger
+
+
 	### Reset the global logger object to the default
 	def self::reset_logger
 		self.logger = self.default_logger
@@ -84,6 +95,7 @@ module Verse
 
 
 	require 'verse/session'
+	require 'verse/nodefuture'
 
 
 	# Load the extension, prepending the version directory for Windows
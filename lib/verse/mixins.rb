@@ -61,6 +61,51 @@ module Verse
 	end # module Loggable
 
 
+	### A mixin for the Logger that's set as Verse.logger that notifies the extension
+	### when its level changes.
+	module LogLevelTracking
+
+		### Set the logger's level to +newlevel+, updating the extension's cached copy
+		### if this is the logger Verse is using.
+		def level=( newlevel )
+			super
+			self.cache_verse_log_level
+		end
+
+
+		### Set the logger's level to +newlevel+. Logger's version is an alias of the 
+		### original #level=, so it has to be overridden as well.
+		def sev_threshold=( newlevel )
+			self.level = newlevel
+		end
+
+
+		### Change the logger's level to +newlevel+ while the block runs. The extension
+		### only keeps one copy of the level, so the change applies to messages from every 
+		### Fiber, not just the current one.
+		def with_level( newlevel )
+			super( newlevel ) do
+				self.cache_verse_log_level
+				yield
+			end
+		ensure
+			self.cache_verse_log_level
+		end
+
+
+		#########
+		protected
+		#########
+
+		### Update the extension's cached copy of the log level if this is the logger Verse 
+		### is using.
+		def cache_verse_log_level
+			Verse.cache_log_level if Verse.logger.equal?( self ) && Verse.respond_to?( :cache_log_level )
+		end
+
+	end # module LogLevelTracking
+
+
 	### A collection of functions for manipulating and comparing versions.
 	module VersionUtilities
 
@@ -167,6 +212,7 @@ module Verse
 		def add_observer( observer )
 			self.log.debug "%p: adding observer %p" % [ self, observer ]
 			@observers << observer unless @observers.include?( observer )
+			self.rebuild_observer_table if self.respond_to?( :rebuild_observer_table, true )
 		end
 
 
@@ -176,7 +222,9 @@ module Verse
 		###                              notified about changes in the receiver.
 		def remove_observer( observer )
 			self.log.debug "%p: removing observer %p" % [ self, observer ]
-			@observers.delete( observer )
+			rval = @observers.delete( observer )
+			self.rebuild_observer_table if self.respond_to?( :rebuild_observer_table, true )
+			return rval
 		end
 
 
@@ -284,59 +332,494 @@ module Verse
 			self.log.debug "unhandled on_node_name_set: %p is now named %p" % [ node, name ]
 		end
 
-		### Called when a new +tag_group+ is created for the +node+.
+		### Called when a new tag group is created for the +node+.
 		### 
-		### @param [Verse::Node] node                 the node the tag group belongs to
-		### @param [Verse::Node::TagGroup] tag_group  the new tag group
-		def on_tag_group_create( node, tag_group )
-			self.log.debug "unhandled on_tag_group_create: node %p now has tag group %p" %
-			 	[ node, tag_group ]
+		### @param [Verse::Node] node  the node the tag group belongs to
+		### @param [Integer] group_id  the ID of the new tag group
+		### @param [String] name       the name of the new tag group
+		def on_tag_group_create( node, group_id, name )
+			self.log.debug "unhandled on_tag_group_create: node %p now has tag group %d (%p)" %
+			 	[ node, group_id, name ]
 		end
 
-		### Called when a +tag_group+ is destroyed.
+		### Called when a tag group is destroyed.
 		### 
-		### @param [Verse::Node] node                 the node the tag group used to belong to.
-		### @param [Verse::Node::TagGroup] tag_group  the tag group that has been destroyed.
-		def on_tag_group_destroy( node, tag_group )
-			self.log.debug "unhandled on_tag_group_destroy: node %p no longer has tag group %p" %
-			 	[ node, tag_group ]
+		### @param [Verse::Node] node  the node the tag group used to belong to.
+		### @param [Integer] group_id  the ID of the tag group that has been destroyed.
+		def on_tag_group_destroy( node, group_id )
+			self.log.debug "unhandled on_tag_group_destroy: node %p no longer has tag group %d" %
+			 	[ node, group_id ]
 		end
 
-		### Called when the verse server sets the node's name.
+		### Called when a client subscribes to one of the +node+'s tag groups.
 		### 
-		### @param [Verse::Node] node  the node that has just had its name set/changed.
-		### @param [String] name       the node's new name.
-		def on_tag_group_subscribe( node )
-			self.log.debug "unhandled on_node_destroy for %p" % [ node ]
+		### @param [Verse::Node] node  the node the tag group belongs to.
+		### @param [Integer] group_id  the ID of the tag group.
+		def on_tag_group_subscribe( node, group_id )
+			self.log.debug "unhandled on_tag_group_subscribe for %p: %d" % [ node, group_id ]
 		end
 
-		### Called when the verse server sets the node's name.
+		### Called when a client unsubscribes from one of the +node+'s tag groups.
 		### 
-		### @param [Verse::Node] node  the node that has just had its name set/changed.
-		### @param [String] name       the node's new name.
-		def on_tag_group_unsubscribe( node )
-			self.log.debug "unhandled on_node_destroy for %p" % [ node ]
+		### @param [Verse::Node] node  the node the tag group belongs to.
+		### @param [Integer] group_id  the ID of the tag group.
+		def on_tag_group_unsubscribe( node, group_id )
+			self.log.debug "unhandled on_tag_group_unsubscribe for %p: %d" % [ node, group_id ]
 		end
 
-		### Called when the verse server sets the node's name.
+		### Called when a tag is created (or its value is set) in one of the +node+'s tag
+		### groups.
 		### 
-		### @param [Verse::Node] node  the node that has just had its name set/changed.
-		### @param [String] name       the node's new name.
-		def on_tag_create( node )
-			self.log.debug "unhandled on_node_destroy for %p" % [ node ]
+		### @param [Verse::Node] node  the node the tag belongs to.
+		### @param [Integer] group_id  the ID of the tag's group.
+		### @param [Integer] tag_id    the ID of the tag.
+		### @param [String] name       the tag's name.
+		### @param [Integer] type      the tag's type (one of the VN_TAG_* constants)
+		### @param [Object] value      the tag's value
+		def on_tag_create( node, group_id, tag_id, name, type, value )
+			self.log.debug "unhandled on_tag_create for %p: %d/%d %p = %p" %
+				[ node, group_id, tag_id, name, value ]
 		end
 
-		### Called when the verse server sets the node's name.
+		### Called when a tag is destroyed.
 		### 
-		### @param [Verse::Node] node  the node that has just had its name set/changed.
-		### @param [String] name       the node's new name.
-		def on_tag_destroy( node )
-			self.log.debug "unhandled on_node_destroy for %p" % [ node ]
+		### @param [Verse::Node] node  the node the tag belonged to.
+		### @param [Integer] group_id  the ID of the tag's group.
+		### @param [Integer] tag_id    the ID of the tag.
+		def on_tag_destroy( node, group_id, tag_id )
+			self.log.debug "unhandled on_tag_destroy for %p: %d/%d" % [ node, group_id, tag_id ]
 		end
 
 	end
 
 
+	### A mixin for objects which wish to observe events on a Verse::AudioNode.
+	module AudioNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when a new audio buffer is created for the +node+.
+		### 
+		### @param [Verse::AudioNode] node  the node the buffer belongs to
+		### @param [Integer] buffer_id      the ID of the new buffer
+		### @param [String] name            the name of the buffer
+		### @param [Integer] type           the type of the buffer's sample blocks
+		### @param [Float] frequency        the buffer's sample rate
+		def on_buffer_create( node, buffer_id, name, type, frequency )
+			self.log.debug "unhandled on_buffer_create for %p: %d (%p)" % [ node, buffer_id, name ]
+		end
+
+		### Called when one of the +node+'s audio buffers is destroyed.
+		### 
+		### @param [Verse::AudioNode] node  the node the buffer belonged to
+		### @param [Integer] buffer_id      the ID of the buffer
+		def on_buffer_destroy( node, buffer_id )
+			self.log.debug "unhandled on_buffer_destroy for %p: %d" % [ node, buffer_id ]
+		end
+
+		### Called when a client subscribes to one of the +node+'s audio buffers.
+		### 
+		### @param [Verse::AudioNode] node  the node the buffer belongs to
+		### @param [Integer] buffer_id      the ID of the buffer
+		def on_buffer_subscribe( node, buffer_id )
+			self.log.debug "unhandled on_buffer_subscribe for %p: %d" % [ node, buffer_id ]
+		end
+
+		### Called when a client unsubscribes from one of the +node+'s audio buffers.
+		### 
+		### @param [Verse::AudioNode] node  the node the buffer belongs to
+		### @param [Integer] buffer_id      the ID of the buffer
+		def on_buffer_unsubscribe( node, buffer_id )
+			self.log.debug "unhandled on_buffer_unsubscribe for %p: %d" % [ node, buffer_id ]
+		end
+
+		### Called when a block of samples in one of the +node+'s buffers is cleared.
+		### 
+		### @param [Verse::AudioNode] node  the node the buffer belongs to
+		### @param [Integer] buffer_id      the ID of the buffer
+		### @param [Integer] block_index    the index of the cleared block
+		def on_block_clear( node, buffer_id, block_index )
+			self.log.debug "unhandled on_block_clear for %p: %d/%d" % [ node, buffer_id, block_index ]
+		end
+
+		### Called when a new audio stream is created for the +node+.
+		### 
+		### @param [Verse::AudioNode] node  the node the stream belongs to
+		### @param [Integer] stream_id      the ID of the new stream
+		### @param [String] name            the name of the stream
+		def on_stream_create( node, stream_id, name )
+			self.log.debug "unhandled on_stream_create for %p: %d (%p)" % [ node, stream_id, name ]
+		end
+
+		### Called when one of the +node+'s audio streams is destroyed.
+		### 
+		### @param [Verse::AudioNode] node  the node the stream belonged to
+		### @param [Integer] stream_id      the ID of the stream
+		def on_stream_destroy( node, stream_id )
+			self.log.debug "unhandled on_stream_destroy for %p: %d" % [ node, stream_id ]
+		end
+
+		### Called when a client subscribes to one of the +node+'s audio streams.
+		### 
+		### @param [Verse::AudioNode] node  the node the stream belongs to
+		### @param [Integer] stream_id      the ID of the stream
+		def on_stream_subscribe( node, stream_id )
+			self.log.debug "unhandled on_stream_subscribe for %p: %d" % [ node, stream_id ]
+		end
+
+		### Called when a client unsubscribes from one of the +node+'s audio streams.
+		### 
+		### @param [Verse::AudioNode] node  the node the stream belongs to
+		### @param [Integer] stream_id      the ID of the stream
+		def on_stream_unsubscribe( node, stream_id )
+			self.log.debug "unhandled on_stream_unsubscribe for %p: %d" % [ node, stream_id ]
+		end
+
+	end # module AudioNodeObserver
+
+
+	### A mixin for objects which wish to observe events on a Verse::GeometryNode. The 
+	### values of the node's vertices and polygons aren't passed to observers; they're 
+	### stored in the node's layers (see Verse::GeometryNode#layer_data).
+	module GeometryNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when a layer is created for the +node+, or its settings change.
+		### 
+		### @param [Verse::GeometryNode] node  the node the layer belongs to
+		### @param [Integer] layer_id          the ID of the layer
+		### @param [String] name               the name of the layer
+		### @param [Integer] type              the layer's type (one of the 
+		###                                    Verse::GeometryNode::LAYER_* constants)
+		### @param [Integer] def_uint          the default value of an integer layer
+		### @param [Float] def_real            the default value of a real layer
+		def on_layer_create( node, layer_id, name, type, def_uint, def_real )
+			self.log.debug "unhandled on_layer_create for %p: %d (%p)" % [ node, layer_id, name ]
+		end
+
+		### Called when one of the +node+'s layers is destroyed.
+		### 
+		### @param [Verse::GeometryNode] node  the node the layer belonged to
+		### @param [Integer] layer_id          the ID of the layer
+		def on_layer_destroy( node, layer_id )
+			self.log.debug "unhandled on_layer_destroy for %p: %d" % [ node, layer_id ]
+		end
+
+		### Called when a bone is created for the +node+, or its settings change. The
+		### bone's parent, position, and rotation are in +node.bones[ bone_id ]+.
+		### 
+		### @param [Verse::GeometryNode] node  the node the bone belongs to
+		### @param [Integer] bone_id           the ID of the bone
+		def on_bone_create( node, bone_id )
+			self.log.debug "unhandled on_bone_create for %p: %d" % [ node, bone_id ]
+		end
+
+		### Called when one of the +node+'s bones is destroyed.
+		### 
+		### @param [Verse::GeometryNode] node  the node the bone belonged to
+		### @param [Integer] bone_id           the ID of the bone
+		def on_bone_destroy( node, bone_id )
+			self.log.debug "unhandled on_bone_destroy for %p: %d" % [ node, bone_id ]
+		end
+
+	end # module GeometryNodeObserver
+
+
+	### A mixin for objects which wish to observe events on a Verse::ObjectNode.
+	module ObjectNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when a client subscribes to the +node+'s transform.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] type            the precision of the values it wants (0 for
+		###                                  real32, 1 for real64)
+		def on_transform_subscribe( node, type )
+			self.log.debug "unhandled on_transform_subscribe for %p: %p" % [ node, type ]
+		end
+
+		### Called when a client unsubscribes from the +node+'s transform.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] type            the precision of the values it was getting
+		def on_transform_unsubscribe( node, type )
+			self.log.debug "unhandled on_transform_unsubscribe for %p: %p" % [ node, type ]
+		end
+
+		### Called when the scale of the +node+'s transform is set.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Float] scale_x           the scale along the X axis
+		### @param [Float] scale_y           the scale along the Y axis
+		### @param [Float] scale_z           the scale along the Z axis
+		def on_transform_scale( node, scale_x, scale_y, scale_z )
+			self.log.debug "unhandled on_transform_scale for %p: %p, %p, %p" % [ node, scale_x, scale_y, scale_z ]
+		end
+
+		### Called when the color of the light the +node+ emits is set.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Float] red               the light's red component
+		### @param [Float] green             the light's green component
+		### @param [Float] blue              the light's blue component
+		def on_light_set( node, red, green, blue )
+			self.log.debug "unhandled on_light_set for %p: %p, %p, %p" % [ node, red, green, blue ]
+		end
+
+		### Called when one of the +node+'s links to another node is created or changed.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] link_id         the ID of the link
+		### @param [Integer] link            the ID of the node that's linked to
+		### @param [String] label            the link's label
+		### @param [Integer] target_id       the ID of the link's target node
+		def on_link_set( node, link_id, link, label, target_id )
+			self.log.debug "unhandled on_link_set for %p: %p, %p, %p, %p" % [ node, link_id, link, label, target_id ]
+		end
+
+		### Called when one of the +node+'s links is destroyed.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] link_id         the ID of the link
+		def on_link_destroy( node, link_id )
+			self.log.debug "unhandled on_link_destroy for %p: %p" % [ node, link_id ]
+		end
+
+		### Called when a method group is created for the +node+.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] group_id        the ID of the new group
+		### @param [String] name             the name of the group
+		def on_method_group_create( node, group_id, name )
+			self.log.debug "unhandled on_method_group_create for %p: %p, %p" % [ node, group_id, name ]
+		end
+
+		### Called when one of the +node+'s method groups is destroyed.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] group_id        the ID of the group
+		def on_method_group_destroy( node, group_id )
+			self.log.debug "unhandled on_method_group_destroy for %p: %p" % [ node, group_id ]
+		end
+
+		### Called when a client subscribes to one of the +node+'s method groups.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] group_id        the ID of the group
+		def on_method_group_subscribe( node, group_id )
+			self.log.debug "unhandled on_method_group_subscribe for %p: %p" % [ node, group_id ]
+		end
+
+		### Called when a client unsubscribes from one of the +node+'s method groups.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] group_id        the ID of the group
+		def on_method_group_unsubscribe( node, group_id )
+			self.log.debug "unhandled on_method_group_unsubscribe for %p: %p" % [ node, group_id ]
+		end
+
+		### Called when a method in one of the +node+'s method groups is destroyed.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] group_id        the ID of the method's group
+		### @param [Integer] method_id       the ID of the method
+		def on_method_destroy( node, group_id, method_id )
+			self.log.debug "unhandled on_method_destroy for %p: %p, %p" % [ node, group_id, method_id ]
+		end
+
+		### Called when the +node+ is hidden or shown.
+		### 
+		### @param [Verse::ObjectNode] node  the node
+		### @param [Integer] hidden          non-zero if the node is hidden
+		def on_hide( node, hidden )
+			self.log.debug "unhandled on_hide for %p: %p" % [ node, hidden ]
+		end
+
+	end # module ObjectNodeObserver
+
+
+	### A mixin for objects which wish to observe events on a Verse::MaterialNode.
+	module MaterialNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when one of the +node+'s fragments is destroyed.
+		### 
+		### @param [Verse::MaterialNode] node  the node
+		### @param [Integer] fragment_id       the ID of the fragment
+		def on_fragment_destroy( node, fragment_id )
+			self.log.debug "unhandled on_fragment_destroy for %p: %p" % [ node, fragment_id ]
+		end
+
+	end # module MaterialNodeObserver
+
+
+	### A mixin for objects which wish to observe events on a Verse::BitmapNode.
+	module BitmapNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when the +node+'s dimensions are set.
+		### 
+		### @param [Verse::BitmapNode] node  the node
+		### @param [Integer] width           the width of the bitmap, in pixels
+		### @param [Integer] height          the height of the bitmap, in pixels
+		### @param [Integer] depth           the depth of the bitmap, in pixels
+		def on_dimensions_set( node, width, height, depth )
+			self.log.debug "unhandled on_dimensions_set for %p: %p, %p, %p" % [ node, width, height, depth ]
+		end
+
+		### Called when a layer is created for the +node+, or its settings change.
+		### 
+		### @param [Verse::BitmapNode] node  the node
+		### @param [Integer] layer_id        the ID of the layer
+		### @param [String] name             the name of the layer
+		### @param [Integer] type            the type of the layer's pixels
+		def on_bitmap_layer_create( node, layer_id, name, type )
+			self.log.debug "unhandled on_bitmap_layer_create for %p: %p, %p, %p" % [ node, layer_id, name, type ]
+		end
+
+		### Called when one of the +node+'s layers is destroyed.
+		### 
+		### @param [Verse::BitmapNode] node  the node
+		### @param [Integer] layer_id        the ID of the layer
+		def on_bitmap_layer_destroy( node, layer_id )
+			self.log.debug "unhandled on_bitmap_layer_destroy for %p: %p" % [ node, layer_id ]
+		end
+
+		### Called when a client subscribes to one of the +node+'s layers.
+		### 
+		### @param [Verse::BitmapNode] node  the node
+		### @param [Integer] layer_id        the ID of the layer
+		### @param [Integer] level           the mipmap level it wants
+		def on_bitmap_layer_subscribe( node, layer_id, level )
+			self.log.debug "unhandled on_bitmap_layer_subscribe for %p: %p, %p" % [ node, layer_id, level ]
+		end
+
+		### Called when a client unsubscribes from one of the +node+'s layers.
+		### 
+		### @param [Verse::BitmapNode] node  the node
+		### @param [Integer] layer_id        the ID of the layer
+		def on_bitmap_layer_unsubscribe( node, layer_id )
+			self.log.debug "unhandled on_bitmap_layer_unsubscribe for %p: %p" % [ node, layer_id ]
+		end
+
+	end # module BitmapNodeObserver
+
+
+	### A mixin for objects which wish to observe events on a Verse::TextNode.
+	module TextNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when the language of the +node+'s text is set.
+		### 
+		### @param [Verse::TextNode] node  the node
+		### @param [String] language       the name of the language
+		def on_language_set( node, language )
+			self.log.debug "unhandled on_language_set for %p: %p" % [ node, language ]
+		end
+
+		### Called when a text buffer is created for the +node+.
+		### 
+		### @param [Verse::TextNode] node  the node
+		### @param [Integer] buffer_id     the ID of the new buffer
+		### @param [String] name           the name of the buffer
+		def on_text_buffer_create( node, buffer_id, name )
+			self.log.debug "unhandled on_text_buffer_create for %p: %p, %p" % [ node, buffer_id, name ]
+		end
+
+		### Called when one of the +node+'s text buffers is destroyed.
+		### 
+		### @param [Verse::TextNode] node  the node
+		### @param [Integer] buffer_id     the ID of the buffer
+		def on_text_buffer_destroy( node, buffer_id )
+			self.log.debug "unhandled on_text_buffer_destroy for %p: %p" % [ node, buffer_id ]
+		end
+
+		### Called when a client subscribes to one of the +node+'s text buffers.
+		### 
+		### @param [Verse::TextNode] node  the node
+		### @param [Integer] buffer_id     the ID of the buffer
+		def on_text_buffer_subscribe( node, buffer_id )
+			self.log.debug "unhandled on_text_buffer_subscribe for %p: %p" % [ node, buffer_id ]
+		end
+
+		### Called when a client unsubscribes from one of the +node+'s text buffers.
+		### 
+		### @param [Verse::TextNode] node  the node
+		### @param [Integer] buffer_id     the ID of the buffer
+		def on_text_buffer_unsubscribe( node, buffer_id )
+			self.log.debug "unhandled on_text_buffer_unsubscribe for %p: %p" % [ node, buffer_id ]
+		end
+
+		### Called when part of one of the +node+'s text buffers is replaced.
+		### 
+		### @param [Verse::TextNode] node  the node
+		### @param [Integer] buffer_id     the ID of the buffer
+		### @param [Integer] pos           the position of the text that was replaced
+		### @param [Integer] length        the length of the text that was replaced
+		### @param [String] text           the text that replaced it
+		def on_text_set( node, buffer_id, pos, length, text )
+			self.log.debug "unhandled on_text_set for %p: %p, %p, %p, %p" % [ node, buffer_id, pos, length, text ]
+		end
+
+	end # module TextNodeObserver
+
+
+	### A mixin for objects which wish to observe events on a Verse::CurveNode.
+	module CurveNodeObserver
+		include Verse::Loggable,
+		        Verse::Observer
+
+		### Called when a curve is created for the +node+, or its settings change.
+		### 
+		### @param [Verse::CurveNode] node  the node
+		### @param [Integer] curve_id       the ID of the curve
+		### @param [String] name            the name of the curve
+		### @param [Integer] dimensions     the number of dimensions of the curve's keys
+		def on_curve_create( node, curve_id, name, dimensions )
+			self.log.debug "unhandled on_curve_create for %p: %p, %p, %p" % [ node, curve_id, name, dimensions ]
+		end
+
+		### Called when one of the +node+'s curves is destroyed.
+		### 
+		### @param [Verse::CurveNode] node  the node
+		### @param [Integer] curve_id       the ID of the curve
+		def on_curve_destroy( node, curve_id )
+			self.log.debug "unhandled on_curve_destroy for %p: %p" % [ node, curve_id ]
+		end
+
+		### Called when a client subscribes to one of the +node+'s curves.
+		### 
+		### @param [Verse::CurveNode] node  the node
+		### @param [Integer] curve_id       the ID of the curve
+		def on_curve_subscribe( node, curve_id )
+			self.log.debug "unhandled on_curve_subscribe for %p: %p" % [ node, curve_id ]
+		end
+
+		### Called when a client unsubscribes from one of the +node+'s curves.
+		### 
+		### @param [Verse::CurveNode] node  the node
+		### @param [Integer] curve_id       the ID of the curve
+		def on_curve_unsubscribe( node, curve_id )
+			self.log.debug "unhandled on_curve_unsubscribe for %p: %p" % [ node, curve_id ]
+		end
+
+		### Called when a key of one of the +node+'s curves is destroyed.
+		### 
+		### @param [Verse::CurveNode] node  the node
+		### @param [Integer] curve_id       the ID of the curve
+		### @param [Integer] key_id         the ID of the key
+		def on_key_destroy( node, curve_id, key_id )
+			self.log.debug "unhandled on_key_destroy for %p: %p, %p" % [ node, curve_id, key_id ]
+		end
+
+	end # module CurveNodeObserver
+
+
 	### A collection of ANSI color utility functions
 	module ANSIColorUtilities
 
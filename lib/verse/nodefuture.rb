@@ -0,0 +1,122 @@
+#!/usr/bin/env ruby
+
+require 'thread'
+
+require 'verse'
+require 'verse/mixins'
+
+
+# A placeholder for a node that has been requested from the server with 
+# Verse::Session#create_node_async or Verse::Session#create_nodes, but that hasn't
+# been created yet. The session calls the future with the node once the server
+# reports that it exists.
+# 
+# Futures are only resolved while events are being dispatched, so something has to be
+# calling Verse.update (or Verse.process_pending) while you wait on one; if you're 
+# waiting in the same thread that does the updating, poll #resolved? instead.
+# 
+# @example Waiting on a node from another thread
+#   future = session.create_node_async( Verse::ObjectNode )
+#   node = future.value( 2.0 ) or raise "timed out waiting for a node"
+class Verse::NodeFuture
+	include Verse::Loggable
+
+	### Wait for up to +timeout+ seconds (forever if +timeout+ is +nil+) for all of the
+	### specified +futures+ to be resolved. Returns an Array of their nodes, or +nil+
+	### if the timeout expired first.
+	def self::wait_all( futures, timeout=nil )
+		deadline = timeout && Time.now + timeout
+
+		return futures.map do |future|
+			remaining = deadline && [ deadline - Time.now, 0 ].max
+			future.value( remaining ) or return nil
+		end
+	end
+
+
+	### Create a new future for a node of the specified +nodeclass+.
+	def initialize( nodeclass )
+		@nodeclass = nodeclass
+		@node      = nil
+		@callbacks = []
+		@mutex     = Mutex.new
+		@resolved  = ConditionVariable.new
+	end
+
+
+	######
+	public
+	######
+
+	# The class of node the future is for
+	attr_reader :nodeclass
+
+
+	### Returns +true+ if the node has been created.
+	def resolved?
+		return @mutex.synchronize { @node ? true : false }
+	end
+
+
+	### Resolve the future with the newly-created +node+, calling any callbacks that 
+	### were registered with #on_resolve. This is called by the session.
+	def call( node )
+		callbacks = @mutex.synchronize do
+			@node = node
+			@resolved.broadcast
+			@callbacks.slice!( 0..-1 )
+		end
+
+		callbacks.each {|callback| callback.call(node) }
+
+		return node
+	end
+
+
+	### Register a +callback+ to be called with the node once it's been created. If it 
+	### already has been, the callback is called immediately. Returns the receiver.
+	def on_resolve( &callback )
+		raise LocalJumpError, "no block given" unless callback
+
+		node = @mutex.synchronize do
+			@callbacks << callback unless @node
+			@node
+		end
+		callback.call( node ) if node
+
+		return self
+	end
+
+
+	### Wait for up to +timeout+ seconds (forever if +timeout+ is +nil+) for the node to
+	### be created, and return it. Returns +nil+ if the timeout expired first.
+	def value( timeout=nil )
+		deadline = timeout && Time.now + timeout
+
+		@mutex.synchronize do
+			until @node
+				if deadline
+					remaining = deadline - Time.now
+					break if remaining <= 0
+					@resolved.wait( @mutex, remaining )
+				else
+					@resolved.wait( @mutex )
+				end
+			end
+
+			return @node
+		end
+	end
+
+
+	### Return a human-readable representation of the future suitable for debugging.
+	def inspect
+		return "#<%s:0x%x %s %s>" % [
+			self.class.name,
+			self.object_id * 2,
+			self.nodeclass.name,
+			@node ? "resolved" : "pending",
+		]
+	end
+
+end # class Verse::NodeFuture
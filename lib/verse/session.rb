@@ -6,5 +6,11 @@ require 'verse'
 class Verse::Session
 	include Verse::Loggable
 
-end # class Verse::Session
+	### Ask the server end of the session to create a new node of the specified 
+	### +nodeclass+, returning a Verse::NodeFuture that will be resolved with it.
+	### See #create_nodes for creating a lot of them at once.
+	def create_node_async( nodeclass )
+		return self.create_nodes( nodeclass, 1 ).first
+	end
 
+end # class Verse::Session
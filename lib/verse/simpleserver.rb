@@ -180,8 +180,10 @@ class Verse::SimpleServer < Verse::Server
 		else
 			self.log.info "%p: subscribe to index events for: %p" % [ session, classes ]
 			newclasses = classes - conn.index_subscriptions
-			@nodes.find {|id,node| newclasses.include?(node.class) }.each do |node|
-				conn.session.node_created( )
+			conn.session.batch do |session|
+				@nodes.each_value do |node|
+					session.node_created( node ) if newclasses.include?( node.class )
+				end
 			end
 			conn.index_subscriptions += newclasses
 		end
@@ -9,6 +9,10 @@ require 'verse/constants'
 module Verse::TestConstants
 	include Verse::Constants
 
+	# Node owner values, for feeding node_create commands to Verse::Testing.callback
+	VN_OWNER_OTHER = 0
+	VN_OWNER_MINE  = 1
+
 	class SimpleTestServer < Verse::Server
 		include Verse::SessionObserver
 
@@ -0,0 +1,600 @@
+#!/usr/bin/env ruby
+
+BEGIN {
+	require 'rbconfig'
+	require 'pathname'
+	basedir = Pathname.new( __FILE__ ).dirname.parent.parent
+
+	libdir = basedir + "lib"
+	extdir = libdir + Config::CONFIG['sitearch']
+
+	$LOAD_PATH.unshift( basedir ) unless $LOAD_PATH.include?( basedir )
+	$LOAD_PATH.unshift( libdir ) unless $LOAD_PATH.include?( libdir )
+	$LOAD_PATH.unshift( extdir ) unless $LOAD_PATH.include?( extdir )
+}
+
+require 'rspec'
+
+require 'spec/lib/constants'
+require 'spec/lib/helpers'
+
+require 'verse'
+
+
+include Verse::TestConstants
+include Verse::Constants
+
+#####################################################################
+###	C O N T E X T S
+#####################################################################
+
+describe Verse::GeometryNode do
+	include Verse::SpecHelpers
+
+	before( :all ) do
+		setup_logging( :fatal )
+	end
+
+	before( :each ) do
+		@node = Verse::GeometryNode.new
+	end
+
+
+	it "starts out without any layers" do
+		@node.layers.should be_empty()
+		@node.layers.should be_frozen()
+	end
+
+	it "doesn't have data for layers it doesn't have" do
+		@node.layer_data( 0 ).should be_nil()
+	end
+
+	it "doesn't have any vertices or polygons until the server sends them" do
+		@node.vertex_count.should == 0
+		@node.polygon_count.should == 0
+	end
+
+	it "doesn't have bounds until the server sends it some vertices" do
+		@node.bounds.should be_nil()
+	end
+
+	it "starts out without any bones" do
+		@node.bones.should be_empty()
+		@node.bones.should be_frozen()
+		@node.bone_world_matrix( 0 ).should be_nil()
+		@node.bone_world_matrices.should == ''
+		@node.bone_world_matrices.should be_frozen()
+	end
+
+	it "can't upload vertices if it isn't part of a session" do
+		expect {
+			@node.set_vertices( 0, [0.0, 1.0, 2.0].pack('d*') )
+		}.to raise_exception( Verse::NodeError, /session/ )
+	end
+
+	it "rejects packed vertices that aren't whole triples" do
+		@node.session = Verse::Session.new( 'localhost' )
+		expect {
+			@node.set_vertices( 0, [0.0, 1.0].pack('d*') )
+		}.to raise_exception( ArgumentError, /multiple of 24/ )
+	end
+
+	it "rejects packed polygons that don't have four corners each" do
+		@node.session = Verse::Session.new( 'localhost' )
+		expect {
+			@node.set_polygons( 1, [0, 1, 2].pack('L*') )
+		}.to raise_exception( ArgumentError, /multiple of 16/ )
+	end
+
+	it "can't sync vertices if it isn't part of a session" do
+		expect {
+			@node.sync_vertices( 0, [0.0, 1.0, 2.0].pack('d*') )
+		}.to raise_exception( Verse::NodeError, /session/ )
+	end
+
+	it "rejects a negative epsilon for vertex syncs" do
+		@node.session = Verse::Session.new( 'localhost' )
+		expect {
+			@node.sync_vertices( 0, [0.0, 1.0, 2.0].pack('d*'), :epsilon => -0.1 )
+		}.to raise_exception( ArgumentError, /epsilon/ )
+	end
+
+	it "can reset the shadows of layers it hasn't synced" do
+		@node.reset_shadow( 0 ).should be_nil()
+		@node.reset_shadow.should be_nil()
+	end
+
+	it "has constants for the layer types" do
+		Verse::GeometryNode::LAYER_VERTEX_XYZ.should == 0
+		Verse::GeometryNode::LAYER_POLYGON_CORNER_UINT32.should == 128
+	end
+
+	it "only lets layers grow to a sane number of elements" do
+		expect {
+			Verse::GeometryNode.max_elements = 0
+		}.to raise_exception( ArgumentError, /max elements/ )
+		expect {
+			Verse::GeometryNode.max_elements = 2 ** 29
+		}.to raise_exception( ArgumentError, /max elements/ )
+	end
+
+
+	describe "in a session" do
+
+		before( :each ) do
+			@node_id = 0x40
+			@session = Verse::Session.new( 'localhost:45196' )
+			@session.connect( 'test', 'test' )
+			Verse.process_pending
+
+			receive( :node_create, @node_id, V_NT_GEOMETRY, VN_OWNER_OTHER )
+			receive( :g_layer_create, @node_id, 0, 'vertex', Verse::GeometryNode::LAYER_VERTEX_XYZ, 0, 0.0 )
+			receive( :g_layer_create, @node_id, 1, 'polygon', 
+			         Verse::GeometryNode::LAYER_POLYGON_CORNER_UINT32, 0, 0.0 )
+			@node = @session.node( @node_id )
+		end
+
+		after( :each ) do
+			Verse.process_pending
+			Verse.stats_enabled = false
+			Verse.reset_stats
+		end
+
+		### Act as if the session had just received the given +command+ from the server.
+		def receive( command, *args )
+			Verse::Testing.callback( @session, command, *args )
+			Verse::Testing.publish
+			Verse.process_pending
+		end
+
+		### Act as if the server had set the position of the vertex with the given +id+.
+		def set_vertex( id, x, y, z )
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, id, x, y, z )
+		end
+
+		### Act as if the server had created the bone with the given +id+ under the 
+		### +parent+ bone (0xffff for none), at +position+ and with the +rotation+ 
+		### quaternion relative to it.
+		def create_bone( id, parent, position, rotation=[0.0, 0.0, 0.0, 1.0] )
+			receive( :g_bone_create, @node_id, id, "weight_#{id}", '', parent, 
+			         *position, '', rotation, '' )
+		end
+
+		### Return the quaternion for a quarter turn about the z axis.
+		def quarter_turn_z
+			return [ 0.0, 0.0, Math.sqrt(0.5), Math.sqrt(0.5) ]
+		end
+
+		### Check that the 16 values of the +matrix+ are all close to the +expected+ ones.
+		def matrix_should_be( matrix, expected )
+			matrix.length.should == 16
+			matrix.zip( expected ).each do |value, expected_value|
+				value.should be_within( 1e-9 ).of( expected_value )
+			end
+		end
+
+		### Start counting the commands sent via the session.
+		def count_commands
+			Verse.stats_enabled = true
+			Verse.reset_stats
+		end
+
+		### Return the number of commands sent via the session since #count_commands.
+		def commands_sent
+			return Verse.stats[:sessions][ @session ][:commands_sent]
+		end
+
+
+		it "keeps the vertices the server sets in the base layer" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 1.0, 2.0, 3.0 )
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 2, 4.0, 5.0, 6.0 )
+
+			@node.vertex_count.should == 3
+			@node.layers[0].should == {
+				:name => 'vertex', :type => Verse::GeometryNode::LAYER_VERTEX_XYZ,
+				:format => :real64, :components => 3, :count => 3
+			}
+			@node.layer_data( 0 ).unpack( 'd*' ).should == 
+				[ 1.0, 2.0, 3.0, Float::MAX, Float::MAX, Float::MAX, 4.0, 5.0, 6.0 ]
+		end
+
+		it "keeps the vertices in single precision if the server sends them that way" do
+			receive( :g_vertex_set_xyz_real32, @node_id, 0, 0, 1.5, 2.5, 3.5 )
+
+			@node.layers[0][:format].should == :real32
+			@node.layer_data( 0 ).bytesize.should == 12
+			@node.layer_data( 0 ).unpack( 'f*' ).should == [ 1.5, 2.5, 3.5 ]
+		end
+
+		it "keeps the polygons the server sets in the base layer" do
+			receive( :g_polygon_set_corner_uint32, @node_id, 1, 1, 0, 1, 2, 3 )
+
+			@node.polygon_count.should == 2
+			@node.layers[1][:format].should == :uint32
+			@node.layer_data( 1 ).unpack( 'L*' ).should == 
+				[ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0, 1, 2, 3 ]
+		end
+
+		it "marks deleted vertices as unused" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 1.0, 2.0, 3.0 )
+			receive( :g_vertex_delete_real64, @node_id, 0 )
+
+			@node.vertex_count.should == 1
+			@node.layer_data( 0 ).unpack( 'd*' ).should == [ Float::MAX ] * 3
+		end
+
+		it "doesn't grow a layer to delete a vertex it never had" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 1.0, 2.0, 3.0 )
+			receive( :g_vertex_delete_real64, @node_id, 1_000_000 )
+			receive( :g_polygon_delete, @node_id, 1_000_000 )
+
+			@node.vertex_count.should == 1
+			@node.polygon_count.should == 0
+		end
+
+		it "reads a layer's values in place through a read-only buffer" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 1, 1.0, 2.0, 3.0 )
+			buffer = @node.layer_buffer( 0 )
+
+			buffer.size.should == 2 * 3 * 8
+			buffer.get_value( :F64, 3 * 8 ).should == 1.0
+
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 4.0, 5.0, 6.0 )
+			buffer.get_value( :F64, 0 ).should == 4.0
+			@node.layer_buffer( 0 ).should equal( buffer )
+
+			expect {
+				buffer.set_value( :F64, 0, 7.0 )
+			}.to raise_error( IO::Buffer::AccessError )
+		end
+
+		it "frees a layer's buffer once the layer grows" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 1.0, 2.0, 3.0 )
+			buffer = @node.layer_buffer( 0 )
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 1, 4.0, 5.0, 6.0 )
+
+			buffer.should be_null()
+			@node.layer_buffer( 0 ).get_value( :F64, 3 * 8 ).should == 4.0
+		end
+
+		it "keeps its layers after the application drops the node object" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 1.0, 2.0, 3.0 )
+			@node = nil
+			GC.start
+
+			node = @session.node( @node_id )
+			node.layers.keys.should == [ 0, 1 ]
+			node.vertex_count.should == 1
+		end
+
+		it "ignores vertices past the maximum number of elements" do
+			max_elements = Verse::GeometryNode.max_elements
+			begin
+				Verse::GeometryNode.max_elements = 16
+				receive( :g_vertex_set_xyz_real64, @node_id, 0, 15, 1.0, 2.0, 3.0 )
+				receive( :g_vertex_set_xyz_real64, @node_id, 0, 16, 1.0, 2.0, 3.0 )
+			ensure
+				Verse::GeometryNode.max_elements = max_elements
+			end
+
+			@node.vertex_count.should == 16
+		end
+
+		it "returns the same layer data until the layer changes" do
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 1.0, 2.0, 3.0 )
+
+			data = @node.layer_data( 0 )
+			data.should be_frozen()
+			@node.layer_data( 0 ).should equal( data )
+
+			receive( :g_vertex_set_xyz_real64, @node_id, 0, 0, 7.0, 8.0, 9.0 )
+
+			@node.layer_data( 0 ).should_not equal( data )
+			@node.layer_data( 0 ).unpack( 'd*' ).should == [ 7.0, 8.0, 9.0 ]
+			data.unpack( 'd*' ).should == [ 1.0, 2.0, 3.0 ]
+		end
+
+		it "sends a command for each vertex it uploads" do
+			positions = (0...40).collect {|i| [i, i * 2, i * 3] }.flatten
+			count_commands()
+
+			@node.set_vertices( 0, positions.pack('d*') ).should == 40
+			commands_sent.should == 40
+		end
+
+		it "sends a command for each single-precision vertex it uploads from an offset" do
+			count_commands()
+
+			@node.set_vertices( 0, ([0.5] * 27).pack('f*'), :format => :real32, :offset => 100 ).
+				should == 9
+			commands_sent.should == 9
+		end
+
+		it "sends a command for each polygon it uploads" do
+			corners = [ 0, 1, 2, 0xffffffff, 2, 3, 0, 0xffffffff, 4, 5, 6, 7 ]
+			count_commands()
+
+			@node.set_polygons( 1, corners.pack('L*') ).should == 3
+			commands_sent.should == 3
+		end
+
+		it "doesn't send any commands for an empty upload" do
+			count_commands()
+
+			@node.set_vertices( 0, '' ).should == 0
+			@node.set_polygons( 1, '' ).should == 0
+			commands_sent.should == 0
+		end
+
+		it "sends every vertex the first time it syncs them" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			count_commands()
+
+			@node.sync_vertices( 0, positions.pack('d*') ).should == { :sent => 40, :skipped => 0 }
+			commands_sent.should == 40
+		end
+
+		it "only sends the vertices that have changed since they were last synced" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			@node.sync_vertices( 0, positions.pack('d*') )
+			count_commands()
+
+			@node.sync_vertices( 0, positions.pack('d*') ).should == { :sent => 0, :skipped => 40 }
+
+			positions[ 3 * 2 + 1 ] += 0.5
+			positions[ 3 * 35 ] -= 0.5
+			@node.sync_vertices( 0, positions.pack('d*') ).should == { :sent => 2, :skipped => 38 }
+			commands_sent.should == 2
+		end
+
+		it "compares a sync from an offset with the vertices synced there" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			@node.sync_vertices( 0, positions.pack('d*') )
+
+			@node.sync_vertices( 0, positions[90, 30].pack('d*'), :offset => 30 ).
+				should == { :sent => 0, :skipped => 10 }
+			@node.sync_vertices( 0, positions[0, 30].pack('d*'), :offset => 30 ).
+				should == { :sent => 10, :skipped => 0 }
+		end
+
+		it "skips vertices that have moved less than the epsilon" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			@node.sync_vertices( 0, positions.pack('d*') )
+
+			positions[ 3 * 5 ] += 0.00001
+			positions[ 3 * 30 + 2 ] += 0.5
+			@node.sync_vertices( 0, positions.pack('d*'), :epsilon => 0.001 ).
+				should == { :sent => 1, :skipped => 39 }
+
+			# Without an epsilon, the vertex that barely moved still differs from the one 
+			# that was last sent
+			@node.sync_vertices( 0, positions.pack('d*') ).should == { :sent => 1, :skipped => 39 }
+		end
+
+		it "skips single-precision vertices that have moved less than the epsilon" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			@node.sync_vertices( 0, positions.pack('f*'), :format => :real32 )
+
+			positions[ 3 * 5 ] += 0.25
+			positions[ 3 * 30 + 2 ] += 1.0
+			@node.sync_vertices( 0, positions.pack('f*'), :format => :real32, :epsilon => 0.5 ).
+				should == { :sent => 1, :skipped => 39 }
+		end
+
+		it "starts over when vertices are synced in a different format" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			@node.sync_vertices( 0, positions.pack('d*') )
+
+			@node.sync_vertices( 0, positions.pack('f*'), :format => :real32 ).
+				should == { :sent => 40, :skipped => 0 }
+		end
+
+		it "only sends the polygons that have changed since they were last synced" do
+			corners = (0...10).collect {|i| [i, i + 1, i + 2, 0xffffffff] }.flatten
+			@node.sync_polygons( 1, corners.pack('L*') ).should == { :sent => 10, :skipped => 0 }
+			@node.sync_polygons( 1, corners.pack('L*') ).should == { :sent => 0, :skipped => 10 }
+
+			corners[ 4 * 7 + 3 ] = 9
+			@node.sync_polygons( 1, corners.pack('L*'), :epsilon => 100.0 ).
+				should == { :sent => 1, :skipped => 9 }
+		end
+
+		it "sends everything again after its shadow is reset" do
+			positions = (0...40).collect {|i| [i, i, i] }.flatten
+			@node.sync_vertices( 0, positions.pack('d*') )
+
+			@node.reset_shadow( 0 )
+			@node.sync_vertices( 0, positions.pack('d*') ).should == { :sent => 40, :skipped => 0 }
+		end
+
+		it "grows its bounds to fit the vertices the server sets" do
+			set_vertex( 0, 0.0, 0.0, 0.0 )
+			@node.bounds.should == {
+				:min => [0.0, 0.0, 0.0], :max => [0.0, 0.0, 0.0], :center => [0.0, 0.0, 0.0],
+				:size => [0.0, 0.0, 0.0], :vertices => 1
+			}
+
+			set_vertex( 3, 2.0, -4.0, 1.0 )
+			set_vertex( 1, -2.0, 4.0, 0.5 )
+			@node.bounds.should == {
+				:min => [-2.0, -4.0, 0.0], :max => [2.0, 4.0, 1.0], :center => [0.0, 0.0, 0.5],
+				:size => [4.0, 8.0, 1.0], :vertices => 3
+			}
+			@node.bounds.should be_frozen()
+		end
+
+		it "keeps its bounds when a vertex inside them moves" do
+			set_vertex( 0, -1.0, -1.0, -1.0 )
+			set_vertex( 1, 1.0, 1.0, 1.0 )
+			set_vertex( 2, 0.0, 0.0, 0.0 )
+
+			set_vertex( 2, 0.5, -0.5, 0.25 )
+			@node.bounds[:min].should == [ -1.0, -1.0, -1.0 ]
+			@node.bounds[:max].should == [ 1.0, 1.0, 1.0 ]
+			@node.bounds[:vertices].should == 3
+		end
+
+		it "shrinks its bounds when a vertex on them moves inwards" do
+			set_vertex( 0, -1.0, -1.0, -1.0 )
+			set_vertex( 1, 1.0, 1.0, 1.0 )
+			set_vertex( 2, 0.0, 3.0, 0.0 )
+
+			set_vertex( 2, 0.0, 0.5, 0.0 )
+			@node.bounds[:min].should == [ -1.0, -1.0, -1.0 ]
+			@node.bounds[:max].should == [ 1.0, 1.0, 1.0 ]
+			@node.bounds[:vertices].should == 3
+		end
+
+		it "shrinks its bounds when a vertex on them is deleted" do
+			set_vertex( 0, -1.0, -1.0, -1.0 )
+			set_vertex( 1, 1.0, 1.0, 1.0 )
+			set_vertex( 2, 5.0, 0.0, -5.0 )
+
+			receive( :g_vertex_delete_real64, @node_id, 2 )
+			@node.bounds[:min].should == [ -1.0, -1.0, -1.0 ]
+			@node.bounds[:max].should == [ 1.0, 1.0, 1.0 ]
+			@node.bounds[:vertices].should == 2
+		end
+
+		it "doesn't have bounds once all of its vertices are deleted" do
+			set_vertex( 0, -1.0, -1.0, -1.0 )
+			set_vertex( 1, 1.0, 1.0, 1.0 )
+
+			receive( :g_vertex_delete_real64, @node_id, 0 )
+			receive( :g_vertex_delete_real64, @node_id, 1 )
+			@node.bounds.should be_nil()
+
+			set_vertex( 1, 2.0, 3.0, 4.0 )
+			@node.bounds[:min].should == [ 2.0, 3.0, 4.0 ]
+			@node.bounds[:max].should == [ 2.0, 3.0, 4.0 ]
+		end
+
+		it "recomputes the same bounds from all of its vertices as it kept incrementally" do
+			positions = (0...100).collect {|i| [Math.sin(i) * i, Math.cos(i) * i, i % 7 - 3.0] }
+			positions.each_with_index {|(x, y, z), i| set_vertex(i, x, y, z) }
+			incremental = @node.bounds
+
+			xs, ys, zs = positions.transpose
+			incremental[:min].should == [ xs.min, ys.min, zs.min ]
+			incremental[:max].should == [ xs.max, ys.max, zs.max ]
+
+			# Moving the vertex with the highest x inwards makes the node recompute them
+			highest = xs.index( xs.max )
+			set_vertex( highest, 0.0, *positions[highest][1, 2] )
+			xs[ highest ] = 0.0
+
+			@node.bounds[:min].should == [ xs.min, ys.min, zs.min ]
+			@node.bounds[:max].should == [ xs.max, ys.max, zs.max ]
+			@node.bounds[:vertices].should == 100
+		end
+
+		it "recomputes its bounds from single-precision vertices" do
+			receive( :g_vertex_set_xyz_real32, @node_id, 0, 0, -1.5, 0.0, 2.0 )
+			(1...10).each do |i|
+				receive( :g_vertex_set_xyz_real32, @node_id, 0, i, i.to_f, -i.to_f, 0.5 )
+			end
+
+			receive( :g_vertex_delete_real32, @node_id, 9 )
+			@node.bounds[:min].should == [ -1.5, -8.0, 0.5 ]
+			@node.bounds[:max].should == [ 8.0, 0.0, 2.0 ]
+			@node.bounds[:vertices].should == 9
+		end
+
+		it "knows about the bones the server creates" do
+			create_bone( 1, 0xffff, [1.0, 2.0, 3.0], quarter_turn_z )
+			create_bone( 0, 1, [0.0, 1.5, 0.0] )
+
+			@node.bones.keys.should == [ 0, 1 ]
+			@node.bones[1][:parent].should be_nil()
+			@node.bones[0][:parent].should == 1
+			@node.bones[0][:weight].should == 'weight_0'
+			@node.bones[0][:position].should == [ 0.0, 1.5, 0.0 ]
+			@node.bones[0][:rotation].should == [ 0.0, 0.0, 0.0, 1.0 ]
+		end
+
+		it "computes the world matrix of a root bone from its position and rotation" do
+			create_bone( 0, 0xffff, [1.0, 2.0, 3.0], quarter_turn_z )
+
+			matrix_should_be( @node.bone_world_matrix(0), [
+				 0.0, 1.0, 0.0, 0.0,
+				-1.0, 0.0, 0.0, 0.0,
+				 0.0, 0.0, 1.0, 0.0,
+				 1.0, 2.0, 3.0, 1.0,
+			] )
+		end
+
+		it "computes a child bone's world matrix after its parent's, whatever their IDs" do
+			create_bone( 0, 5, [1.0, 0.0, 0.0] )
+			create_bone( 5, 0xffff, [1.0, 0.0, 0.0], quarter_turn_z )
+			create_bone( 1, 0, [0.0, 0.0, 2.0] )
+
+			# The parent's quarter turn swings the child's offset from +x to +y
+			matrix_should_be( @node.bone_world_matrix(0), [
+				 0.0, 1.0, 0.0, 0.0,
+				-1.0, 0.0, 0.0, 0.0,
+				 0.0, 0.0, 1.0, 0.0,
+				 1.0, 1.0, 0.0, 1.0,
+			] )
+			@node.bone_world_matrix( 1 )[ 12, 3 ].zip( [1.0, 1.0, 2.0] ).each do |value, expected|
+				value.should be_within( 1e-9 ).of( expected )
+			end
+		end
+
+		it "treats a bone whose parent doesn't exist as a root" do
+			create_bone( 2, 9, [4.0, 5.0, 6.0] )
+
+			@node.bones[2][:parent].should == 9
+			matrix_should_be( @node.bone_world_matrix(2), [
+				1.0, 0.0, 0.0, 0.0,
+				0.0, 1.0, 0.0, 0.0,
+				0.0, 0.0, 1.0, 0.0,
+				4.0, 5.0, 6.0, 1.0,
+			] )
+		end
+
+		it "breaks a cycle of parents at one of its bones" do
+			create_bone( 3, 4, [1.0, 0.0, 0.0] )
+			create_bone( 4, 3, [0.0, 2.0, 0.0] )
+
+			translations = [ 3, 4 ].collect {|id| @node.bone_world_matrix(id)[12, 3] }
+			[
+				[ [1.0, 2.0, 0.0], [0.0, 2.0, 0.0] ],
+				[ [1.0, 0.0, 0.0], [1.0, 2.0, 0.0] ],
+			].should include( translations )
+		end
+
+		it "makes the children of a destroyed bone roots" do
+			create_bone( 0, 0xffff, [1.0, 0.0, 0.0] )
+			create_bone( 1, 0, [0.0, 1.0, 0.0] )
+			@node.bone_world_matrix( 1 )[ 12, 3 ].should == [ 1.0, 1.0, 0.0 ]
+
+			receive( :g_bone_destroy, @node_id, 0 )
+			@node.bones.keys.should == [ 1 ]
+			@node.bone_world_matrix( 0 ).should be_nil()
+			@node.bone_world_matrix( 1 )[ 12, 3 ].should == [ 0.0, 1.0, 0.0 ]
+		end
+
+		it "recomputes the world matrices under a bone that moves" do
+			create_bone( 0, 0xffff, [1.0, 0.0, 0.0] )
+			create_bone( 1, 0, [0.0, 1.0, 0.0] )
+			create_bone( 2, 0xffff, [0.0, 0.0, 7.0] )
+
+			matrices = @node.bone_world_matrices
+			matrices.should be_frozen()
+			matrices.bytesize.should == 3 * 16 * 8
+			@node.bone_world_matrices.should equal( matrices )
+
+			create_bone( 0, 0xffff, [3.0, 0.0, 0.0] )
+
+			@node.bone_world_matrices.should_not equal( matrices )
+			worlds = @node.bone_world_matrices.unpack( 'd*' ).each_slice( 16 ).to_a
+			worlds[0][ 12, 3 ].should == [ 3.0, 0.0, 0.0 ]
+			worlds[1][ 12, 3 ].should == [ 3.0, 1.0, 0.0 ]
+			worlds[2][ 12, 3 ].should == [ 0.0, 0.0, 7.0 ]
+		end
+
+	end
+
+end
+
+# vim: set nosta noet ts=4 sw=4:
@@ -167,6 +167,17 @@ describe Verse, "mixins: " do
 			@observable.observers.should_not include( @object )
 		end
 
+		it "rebuild their observer dispatch table when an observer is added" do
+			@observable.should_receive( :rebuild_observer_table )
+			@observable.add_observer( @object )
+		end
+
+		it "rebuild their observer dispatch table when an observer is removed" do
+			@observable.add_observer( @object )
+			@observable.should_receive( :rebuild_observer_table )
+			@observable.remove_observer( @object )
+		end
+
 		it "removing an observer that isn't registered doesn't error" do
 			expect {
 				@observable.remove_observer( @object )
@@ -207,6 +218,84 @@ describe Verse, "mixins: " do
 	end
 
 
+	describe "observer dispatch" do
+
+		before( :each ) do
+			@session = Verse::Session.new( 'localhost:45196' )
+			@session.connect( 'test', 'test' )
+
+			@recorder = Module.new do
+				def events; @events ||= []; end
+				def on_ping( address, message ); self.events << [:on_ping, message]; end
+				def on_node_created( node ); self.events << [:on_node_created, node.id]; end
+			end
+			Verse.process_pending
+		end
+
+		after( :each ) do
+			Verse.remove_observers
+			@session.remove_observers
+			Verse.process_pending
+		end
+
+		def send_ping( message )
+			Verse::Testing.callback( nil, :ping, '127.0.0.1:45196', message )
+			Verse::Testing.publish
+			Verse.process_pending
+		end
+
+		def send_node_create( session, node_id )
+			Verse::Testing.callback( session, :node_create, node_id, V_NT_OBJECT, VN_OWNER_OTHER )
+			Verse::Testing.publish
+			Verse.process_pending
+		end
+
+
+		it "only calls #on_node_created on observers that are SessionObservers" do
+			session_observer = Class.new { include Verse::SessionObserver }.new
+			session_observer.extend( @recorder )
+			bare_observer = Class.new { include Verse::Observer }.new
+			bare_observer.extend( @recorder )
+
+			@session.add_observer( session_observer )
+			@session.add_observer( bare_observer )
+			send_node_create( @session, 0x10 )
+
+			session_observer.events.should == [ [:on_node_created, 0x10] ]
+			bare_observer.events.should be_empty()
+		end
+
+		it "doesn't call an observer again once it's been removed" do
+			observer = Class.new { include Verse::PingObserver }.new
+			observer.extend( @recorder )
+
+			Verse.add_observer( observer )
+			send_ping( 'first' )
+			Verse.remove_observer( observer )
+			send_ping( 'second' )
+
+			observer.events.should == [ [:on_ping, 'first'] ]
+		end
+
+		it "calls an observer that includes several observer mixins once per event" do
+			observer = Class.new do
+				include Verse::PingObserver,
+				        Verse::SessionObserver,
+				        Verse::NodeObserver
+			end.new
+			observer.extend( @recorder )
+
+			Verse.add_observer( observer )
+			@session.add_observer( observer )
+			send_ping( 'hello' )
+			send_node_create( @session, 0x11 )
+
+			observer.events.should == [ [:on_ping, 'hello'], [:on_node_created, 0x11] ]
+		end
+
+	end
+
+
 	describe Verse::PingObserver, "objects" do
 		before( :each ) do
 			@observer_class = Class.new do
@@ -55,6 +55,11 @@ describe Verse::Node do
 			}.to raise_exception( Verse::NodeError, /already set/ )
 		end
 
+		it "reports the size of its node struct to ObjectSpace" do
+			require 'objspace'
+			ObjectSpace.memsize_of( @node ).should > 0
+		end
+
 		it "can have a name"
 
 		it "can be subscribed to"
@@ -64,6 +69,63 @@ describe Verse::Node do
 		it "can destroy tag groups"
 
 	end
+
+
+	describe "observers" do
+
+		before( :each ) do
+			@session = Verse::Session.new( 'localhost:45196' )
+			@session.connect( 'test', 'test' )
+			Verse.process_pending
+		end
+
+		after( :each ) do
+			Verse.process_pending
+		end
+
+		def node_for( node_id, type )
+			Verse::Testing.callback( @session, :node_create, node_id, type, VN_OWNER_OTHER )
+			Verse::Testing.publish
+			Verse.process_pending
+			return @session.node( node_id )
+		end
+
+		def observer_for( mixin, *methods )
+			observer = Class.new { include mixin }.new
+			observer.instance_variable_set( :@calls, [] )
+			methods.each do |name|
+				observer.define_singleton_method( name ) {|*args| @calls << [name, *args] }
+			end
+			def observer.calls; @calls; end
+			return observer
+		end
+
+
+		it "of object nodes are notified when the node's light is set" do
+			node = node_for( 0x31, V_NT_OBJECT )
+			observer = observer_for( Verse::ObjectNodeObserver, :on_light_set )
+			node.add_observer( observer )
+
+			Verse::Testing.callback( @session, :o_light_set, 0x31, 0.25, 0.5, 1.0 )
+			Verse::Testing.publish
+			Verse.process_pending
+
+			observer.calls.should == [ [:on_light_set, node, 0.25, 0.5, 1.0] ]
+		end
+
+		it "of text nodes are notified when the node's text changes" do
+			node = node_for( 0x32, V_NT_TEXT )
+			observer = observer_for( Verse::TextNodeObserver, :on_text_set )
+			node.add_observer( observer )
+
+			Verse::Testing.callback( @session, :t_text_set, 0x32, 1, 4, 0, 'word' )
+			Verse::Testing.publish
+			Verse.process_pending
+
+			observer.calls.should == [ [:on_text_set, node, 1, 4, 0, 'word'] ]
+		end
+
+	end
 end
 
 # vim: set nosta noet ts=4 sw=4:
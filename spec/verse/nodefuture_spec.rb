@@ -0,0 +1,91 @@
+#!/usr/bin/env ruby
+
+BEGIN {
+	require 'rbconfig'
+	require 'pathname'
+	basedir = Pathname.new( __FILE__ ).dirname.parent.parent
+
+	libdir = basedir + "lib"
+	extdir = libdir + Config::CONFIG['sitearch']
+
+	$LOAD_PATH.unshift( basedir ) unless $LOAD_PATH.include?( basedir )
+	$LOAD_PATH.unshift( libdir ) unless $LOAD_PATH.include?( libdir )
+	$LOAD_PATH.unshift( extdir ) unless $LOAD_PATH.include?( extdir )
+}
+
+require 'rspec'
+
+require 'spec/lib/constants'
+require 'spec/lib/helpers'
+
+require 'verse'
+
+
+include Verse::TestConstants
+include Verse::Constants
+
+#####################################################################
+###	C O N T E X T S
+#####################################################################
+
+describe Verse::NodeFuture do
+	include Verse::SpecHelpers
+
+	before( :all ) do
+		setup_logging( :fatal )
+	end
+
+	before( :each ) do
+		@future = Verse::NodeFuture.new( Verse::ObjectNode )
+		@node = Verse::ObjectNode.new
+	end
+
+
+	it "knows what class of node it's for" do
+		@future.nodeclass.should == Verse::ObjectNode
+	end
+
+	it "isn't resolved until it's called with a node" do
+		@future.should_not be_resolved()
+		@future.call( @node )
+		@future.should be_resolved()
+		@future.value.should equal( @node )
+	end
+
+	it "returns nil if waiting for its node times out" do
+		@future.value( 0.01 ).should be_nil()
+	end
+
+	it "wakes up threads that are waiting for its node" do
+		waiter = Thread.new { @future.value( 5.0 ) }
+		@future.call( @node )
+		waiter.value.should equal( @node )
+	end
+
+	it "calls its resolution callbacks with the node" do
+		received = []
+		@future.on_resolve {|node| received << node }
+		@future.call( @node )
+		@future.on_resolve {|node| received << node }
+
+		received.should == [ @node, @node ]
+	end
+
+	it "can wait for several futures at once" do
+		other = Verse::NodeFuture.new( Verse::ObjectNode )
+		other_node = Verse::ObjectNode.new
+		@future.call( @node )
+		other.call( other_node )
+
+		Verse::NodeFuture.wait_all( [@future, other], 0.1 ).should == [ @node, other_node ]
+	end
+
+	it "returns nil if waiting for several futures times out" do
+		@future.call( @node )
+		Verse::NodeFuture.wait_all( [@future, Verse::NodeFuture.new(Verse::ObjectNode)], 0.01 ).
+			should be_nil()
+	end
+
+end
+
+# vim: set nosta noet ts=4 sw=4:
@@ -56,6 +56,14 @@ describe Verse::Session do
 		session.address.should == TEST_ADDRESS
 	end
 
+	it "has its own mutex for serializing commands" do
+		session1 = Verse::Session.new( TEST_ADDRESS )
+		session2 = Verse::Session.new( TEST_ADDRESS )
+
+		session1.mutex.should be_a( Mutex )
+		session1.mutex.should_not equal( session2.mutex )
+	end
+
 	it "knows about all of its connected instances" do
 		session1 = Verse::Session.new( "localhost:#@port" )
 		session1.connect( 'user', 'pass' )
@@ -70,6 +78,29 @@ describe Verse::Session do
 		Verse::Session.all_connected.should_not include( session2 )
 	end
 
+	it "keeps nodes with the same ID in different sessions separate" do
+		session1 = Verse::Session.new( @address )
+		session1.connect( 'user1', 'pass' )
+		session2 = Verse::Session.new( @address )
+		session2.connect( 'user2', 'pass' )
+
+		[ session1, session2 ].each do |session|
+			Verse::Testing.callback( session, :node_create, 0x22, V_NT_OBJECT, VN_OWNER_OTHER )
+		end
+		Verse::Testing.publish
+		Verse.process_pending
+
+		node1 = session1.node( 0x22 )
+		node2 = session2.node( 0x22 )
+
+		node1.should be_a( Verse::ObjectNode )
+		node2.should be_a( Verse::ObjectNode )
+		node1.should_not equal( node2 )
+		node1.session.should equal( session1 )
+		node2.session.should equal( session2 )
+		session1.node( 0x22 ).should equal( node1 )
+	end
+
 	it "doesn't block other threads when calling .update" do
 		updater = Thread.new do
 			Thread.current.abort_on_exception = true
@@ -95,6 +126,72 @@ describe Verse::Session do
 			}.to raise_exception( Verse::SessionError, /address/i )
 		end
 
+		it "don't know about any nodes" do
+			@session.node_count.should == 0
+			@session.node( 1 ).should be_nil
+		end
+
+		it "yield themselves to a batch block and return its value" do
+			@session.batch {|session| session.should equal( @session ); :result }.should == :result
+		end
+
+		it "hold their mutex for the duration of a batch" do
+			@session.batch do
+				@session.mutex.should be_locked
+				@session.batch { @session.mutex.should be_locked }
+			end
+			@session.mutex.should_not be_locked
+		end
+
+		it "don't filter nodes by default" do
+			@session.node_filter.should be_nil()
+			@session.node_filter_stats.should == { :accepted => 0, :rejected => 0, :pending => 0 }
+		end
+
+		it "can have a node filter set" do
+			filter = {
+				:types => [ Verse::ObjectNode, Verse::GeometryNode ],
+				:owner => :other,
+				:name  => 'tree_*',
+				:tag   => { :group => 'scene', :name => 'kind', :value => 'tree' },
+			}
+			@session.node_filter = filter
+			@session.node_filter.should == filter
+			@session.node_filter.should be_frozen()
+
+			@session.node_filter = nil
+			@session.node_filter.should be_nil()
+		end
+
+		it "reject invalid node filters" do
+			expect {
+				@session.node_filter = { :color => 'blue' }
+			}.to raise_exception( ArgumentError, /unknown node filter option/i )
+			expect {
+				@session.node_filter = { :owner => :nobody }
+			}.to raise_exception( ArgumentError, /invalid owner/i )
+			expect {
+				@session.node_filter = { :types => String }
+			}.to raise_exception( TypeError, /isn't a kind of node/i )
+			expect {
+				@session.node_filter = { :tag => { :name => 'kind' } }
+			}.to raise_exception( ArgumentError, /group/i )
+			@session.node_filter.should be_nil()
+		end
+
+		it "raise an exception if asked to create nodes" do
+			expect {
+				@session.create_nodes( Verse::ObjectNode, 10 )
+			}.to raise_exception( Verse::SessionError, /unconnected/i )
+		end
+
+		it "release their mutex if a batch raises" do
+			expect {
+				@session.batch { raise "oops" }
+			}.to raise_exception( RuntimeError, /oops/ )
+			@session.mutex.should_not be_locked
+		end
+
 	end
 
 
@@ -144,6 +241,27 @@ describe Verse::Session do
 			}.to raise_exception( Verse::NodeError, /active session/i )
 		end
 
+		it "can have several node creations in flight at once" do
+			futures = @session.create_nodes( Verse::ObjectNode, 5 )
+			futures.should have( 5 ).members
+			futures.each {|future| future.should be_a(Verse::NodeFuture) }
+
+			nodes = Verse::NodeFuture.wait_all( futures, 5.0 )
+			nodes.should have( 5 ).members
+			nodes.map( &:id ).uniq.should have( 5 ).members
+		end
+
+		it "counts each node creation it sends in its stats" do
+			begin
+				Verse.stats_enabled = true
+				Verse.reset_stats
+				@session.create_nodes( Verse::ObjectNode, 5 )
+				Verse.stats[:sessions][ @session ][:commands_sent].should == 5
+			ensure
+				Verse.stats_enabled = false
+			end
+		end
+
 		it "raise an exception if asked to destroy a node that belongs to another session"
 		# 	other_session = Verse::Session.new( @address )
 		# 	other_session.connect( 'test2', 'test2' )
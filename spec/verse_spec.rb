@@ -17,6 +17,7 @@ BEGIN {
 require 'rspec'
 
 require 'socket'
+require 'json'
 require 'spec/lib/constants'
 require 'spec/lib/helpers'
 
@@ -66,6 +67,234 @@ describe Verse do
 	end
 
 
+	describe "update scheduling" do
+
+		after( :each ) do
+			Verse.update_mode = :timeslice
+		end
+
+		it "gives each session an equal timeslice by default" do
+			Verse.update_mode.should == :timeslice
+		end
+
+		it "can be switched to adaptive scheduling" do
+			Verse.update_mode = :adaptive
+			Verse.update_mode.should == :adaptive
+			Verse.update( 0.01 ).should be_true()
+		end
+
+		it "rejects unknown update modes" do
+			expect {
+				Verse.update_mode = :round_robin
+			}.to raise_exception( ArgumentError, /invalid update mode/i )
+		end
+
+	end
+
+
+	describe "network thread" do
+
+		after( :each ) do
+			Verse.stop_network_thread
+		end
+
+		it "isn't running by default" do
+			Verse.should_not be_network_thread_running()
+		end
+
+		it "can be started and stopped" do
+			Verse.start_network_thread( 0.005 ).should be_true()
+			Verse.should be_network_thread_running()
+			Verse.update( 0.01 ).should be_true()
+			Verse.stop_network_thread.should be_true()
+			Verse.should_not be_network_thread_running()
+		end
+
+		it "can't be started twice" do
+			Verse.start_network_thread( 0.005 )
+			expect {
+				Verse.start_network_thread
+			}.to raise_exception( Verse::Error, /already running/i )
+		end
+
+		it "requires an interval greater than zero and no longer than ten seconds" do
+			[ 0, -0.01, 11, 1.0e12 ].each do |interval|
+				expect {
+					Verse.start_network_thread( interval )
+				}.to raise_exception( ArgumentError, /interval/i )
+			end
+			Verse.should_not be_network_thread_running()
+		end
+
+		it "doesn't mix up the sessions of events it dispatches while it's running" do
+			session1 = Verse::Session.new( "localhost:#@port" )
+			session1.connect( 'user1', 'pass' )
+			session2 = Verse::Session.new( "localhost:#@port" )
+			session2.connect( 'user2', 'pass' )
+			Verse.start_network_thread( 0.0001 )
+
+			100.times do |i|
+				Verse::Testing.callback( session1, :node_create, 0x100 + i, V_NT_OBJECT, VN_OWNER_OTHER )
+				Verse::Testing.callback( session2, :node_create, 0x200 + i, V_NT_OBJECT, VN_OWNER_OTHER )
+				Verse::Testing.publish
+				Verse.process_pending
+			end
+
+			session1.node_count.should == 100
+			session2.node_count.should == 100
+			session1.node( 0x100 ).session.should equal( session1 )
+			session1.node( 0x200 ).should be_nil()
+			session2.node( 0x200 ).session.should equal( session2 )
+			session2.node( 0x100 ).should be_nil()
+		end
+
+	end
+
+
+	describe "event loop integration" do
+
+		it "provides an IO that can be waited on for events" do
+			Verse.event_io.should be_an( IO )
+			Verse.event_io.should equal( Verse.event_io )
+		end
+
+		it "can dispatch pending events without waiting" do
+			Verse.process_pending.should == 0
+			Verse.update_nonblock.should be_a( Integer )
+			IO.select( [Verse.event_io], nil, nil, 0 ).should be_nil()
+		end
+
+		it "makes its IO readable when events are published, and clears it once they're dispatched" do
+			Verse.process_pending
+			Verse::Testing.callback( nil, :ping, "127.0.0.1:#@port", 'wake up' )
+			IO.select( [Verse.event_io], nil, nil, 0 ).should be_nil()
+
+			Verse::Testing.publish
+			IO.select( [Verse.event_io], nil, nil, 0 ).should == [ [Verse.event_io], [], [] ]
+
+			Verse.process_pending.should == 1
+			IO.select( [Verse.event_io], nil, nil, 0 ).should be_nil()
+		end
+
+	end
+
+
+	describe "stats" do
+
+		after( :each ) do
+			Verse.stats_enabled = false
+			Verse.reset_stats
+		end
+
+		it "aren't collected by default" do
+			Verse.should_not be_stats_enabled()
+			Verse.stats[:enabled].should be_false()
+		end
+
+		it "are returned as a frozen Hash" do
+			stats = Verse.stats
+			stats.should be_frozen()
+			stats[:events].should include( :on_ping, :on_node_created, :on_connect )
+			stats[:update].should include( :count, :min, :max, :mean, :p50, :p99 )
+		end
+
+		it "time updates when they're enabled" do
+			Verse.stats_enabled = true
+			3.times { Verse.update(0.001) }
+
+			Verse.stats[:update][:count].should == 3
+			Verse.stats[:gvl_wait][:count].should >= 3
+		end
+
+		it "can be reset" do
+			Verse.stats_enabled = true
+			Verse.update( 0.001 )
+			Verse.reset_stats
+
+			Verse.stats[:update][:count].should == 0
+		end
+
+		it "time each observer's callbacks" do
+			observer = Class.new do
+				include Verse::PingObserver
+				def on_ping( address, data ); @pinged = true; end
+				def pinged?; @pinged; end
+			end.new
+
+			Verse.stats_enabled = true
+			Verse.add_observer( observer )
+			Verse.ping( "127.0.0.1:#@port", 'slow?' )
+			10.times do
+				Verse.update( 0.1 )
+				break if observer.pinged?
+			end
+			Verse.remove_observers
+
+			slowest = Verse.slowest_observers
+			slowest.should have( 1 ).entry
+			slowest.first[:observer].should equal( observer )
+			slowest.first[:method].should == :on_ping
+			slowest.first[:calls].should == 1
+		end
+
+		it "don't have an observer budget by default" do
+			Verse.observer_budget.should be_nil()
+		end
+
+		it "can have an observer budget set" do
+			begin
+				Verse.observer_budget = 0.005
+				Verse.observer_budget.should be_within( 0.000001 ).of( 0.005 )
+			ensure
+				Verse.observer_budget = nil
+			end
+		end
+
+	end
+
+
+	describe "tracing" do
+
+		after( :each ) do
+			Verse.stop_trace
+		end
+
+		it "is off by default" do
+			Verse.should_not be_tracing()
+		end
+
+		it "exports the spans it recorded as Chrome trace JSON" do
+			Verse.start_trace( 1024 )
+			Verse.should be_tracing()
+			2.times { Verse.update(0.001) }
+			Verse.stop_trace
+
+			trace = JSON.parse( Verse.trace_json )
+			trace.should include( 'traceEvents' )
+			names = trace['traceEvents'].map {|event| event['name'] }
+			names.should include( 'Verse.update' )
+		end
+
+		it "refuses a capacity too large to allocate" do
+			expect {
+				Verse.start_trace( 2 ** 40 )
+			}.to raise_error( ArgumentError, /capacity/ )
+			Verse.should_not be_tracing()
+		end
+
+	end
+
+
+	it "reports statistics for the pools sessions and nodes are allocated from" do
+		before = Verse.pool_stats[:object_node][:allocations]
+		node = Verse::ObjectNode.new
+
+		Verse.pool_stats.should include( :session, :object_node, :geometry_node )
+		Verse.pool_stats[:object_node][:allocations].should == before + 1
+		Verse.pool_stats[:object_node][:in_use].should > 0
+	end
+
+
 	describe Verse::PingObserver do
 
 		before( :each ) do
@@ -115,6 +344,91 @@ describe Verse do
 
 	end
 
+	describe "event queue" do
+
+		before( :each ) do
+			@observer = Class.new do
+				include Verse::PingObserver
+
+				def initialize; @pings = []; @on_ping = nil; end
+				attr_reader :pings
+
+				def on_ping( address, data )
+					@pings << data
+					@on_ping.call( data ) if @on_ping
+				end
+
+				def when_pinged( &block ); @on_ping = block; end
+			end.new
+
+			Verse.process_pending
+			Verse.add_observer( @observer )
+		end
+
+		after( :each ) do
+			Verse.remove_observers
+			Verse.process_pending
+		end
+
+		def queue_pings( *messages )
+			messages.each do |msg|
+				Verse::Testing.callback( nil, :ping, "127.0.0.1:#@port", msg )
+			end
+		end
+
+
+		it "doesn't dispatch events until they've been published" do
+			queue_pings( 'one' )
+
+			Verse.pending_events.should == 0
+			Verse.process_pending.should == 0
+			@observer.pings.should be_empty()
+
+			Verse::Testing.publish
+			Verse.pending_events.should == 1
+			Verse.process_pending.should == 1
+			@observer.pings.should == [ 'one' ]
+		end
+
+		it "dispatches events in the order they were received" do
+			queue_pings( 'one', 'two', 'three' )
+			Verse::Testing.publish
+			Verse.process_pending
+
+			@observer.pings.should == [ 'one', 'two', 'three' ]
+		end
+
+		it "dispatches each event exactly once if a handler drains the queue itself" do
+			@observer.when_pinged do |data|
+				Verse.process_pending if data == 'one'
+			end
+
+			queue_pings( 'one', 'two', 'three' )
+			Verse::Testing.publish
+			Verse.process_pending
+
+			@observer.pings.should == [ 'one', 'two', 'three' ]
+			Verse.pending_events.should == 0
+		end
+
+		it "re-uses its blocks once they've been drained" do
+			message = 'x' * 1024
+
+			queue_pings( *([message] * 200) )
+			Verse::Testing.publish
+			Verse.process_pending.should == 200
+			blocks = Verse::Testing.event_blocks
+			blocks.should > 1
+
+			queue_pings( *([message] * 200) )
+			Verse::Testing.publish
+			Verse.process_pending.should == 200
+			Verse::Testing.event_blocks.should == blocks
+		end
+
+	end
+
+
 	describe "host ID functions" do
 
 		before( :each ) do
@@ -174,6 +488,36 @@ describe Verse do
 			Verse.logger.formatter.should equal( Verse.default_log_formatter )
 		end
 
+		it "keeps the extension's copy of the log level in sync with the logger" do
+			logger = Logger.new( $stderr )
+			Verse.logger = logger
+			logger.should be_a( Verse::LogLevelTracking )
+
+			logger.level = Logger::ERROR
+			Verse::Testing.log_level.should == Logger::ERROR
+			Verse.logger.level = Logger::DEBUG
+			Verse::Testing.log_level.should == Logger::DEBUG
+		end
+
+		it "keeps the extension's copy of the log level in sync when it's set via #sev_threshold=" do
+			Verse.logger = Logger.new( $stderr )
+			Verse.logger.sev_threshold = Logger::INFO
+			Verse::Testing.log_level.should == Logger::INFO
+		end
+
+		it "lowers the extension's copy of the log level while in a #with_level block" do
+			Verse.logger = Logger.new( $stderr )
+			Verse.logger.level = Logger::ERROR
+
+			level_in_block = nil
+			Verse.logger.with_level( Logger::DEBUG ) do
+				level_in_block = Verse::Testing.log_level
+			end
+
+			level_in_block.should == Logger::DEBUG
+			Verse::Testing.log_level.should == Logger::ERROR
+		end
+
 		describe "with new defaults" do
 			before( :all ) do
 				@original_logger = Verse.default_logger